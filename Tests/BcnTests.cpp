@@ -0,0 +1,169 @@
+#include "Test.h"
+#include "bcn.h"
+
+#include <array>
+#include <initializer_list>
+
+namespace
+{
+	using Rgba = std::array<uint8_t, 4>;
+
+	Rgba Texel(const uint8_t rgba[64], int texel)
+	{
+		return { rgba[texel * 4], rgba[texel * 4 + 1], rgba[texel * 4 + 2], rgba[texel * 4 + 3] };
+	}
+
+	// Writes fields of a 128 bit block from the lowest bit up, the inverse of bcn::BitReader
+	class BitWriter
+	{
+	public:
+		BitWriter& Write(uint32_t value, uint32_t count)
+		{
+			for (uint32_t i = 0; i < count; i++, m_Position++)
+				m_Block[m_Position >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (m_Position & 7));
+			return *this;
+		}
+
+		uint32_t Position() const { return m_Position; }
+		const uint8_t* Data() const { return m_Block; }
+
+	private:
+		uint8_t		m_Block[16] = {};
+		uint32_t	m_Position = 0;
+	};
+}
+
+TEST(Bc1Decode)
+{
+	uint8_t rgba[64];
+
+	// Red then blue, texels 0 to 3 pick palette entries 0 to 3
+	const uint8_t fourColors[8] = { 0x00, 0xF8, 0x1F, 0x00, 0xE4, 0xE4, 0xE4, 0xE4 };
+	bcn::DecodeColorBlock(fourColors, rgba, true);
+	CHECK((Texel(rgba, 0) == Rgba{ 255, 0, 0, 255 }));
+	CHECK((Texel(rgba, 1) == Rgba{ 0, 0, 255, 255 }));
+	CHECK((Texel(rgba, 2) == Rgba{ 170, 0, 85, 255 }));
+	CHECK((Texel(rgba, 3) == Rgba{ 85, 0, 170, 255 }));
+	CHECK((Texel(rgba, 15) == Rgba{ 85, 0, 170, 255 }));
+
+	// Blue then red switches to three colours and transparent black
+	const uint8_t threeColors[8] = { 0x1F, 0x00, 0x00, 0xF8, 0xE4, 0xE4, 0xE4, 0xE4 };
+	bcn::DecodeColorBlock(threeColors, rgba, true);
+	CHECK((Texel(rgba, 2) == Rgba{ 127, 0, 127, 255 }));
+	CHECK((Texel(rgba, 3) == Rgba{ 0, 0, 0, 0 }));
+
+	// BC3's colour block never does
+	bcn::DecodeColorBlock(threeColors, rgba, false);
+	CHECK((Texel(rgba, 3) == Rgba{ 170, 0, 85, 255 }));
+
+	// 565 bits are replicated into the low bits
+	uint8_t rgb[3];
+	bcn::Unpack565(0x8410, rgb);
+	CHECK(rgb[0] == 132 && rgb[1] == 130 && rgb[2] == 132);
+}
+
+TEST(Bc1RgbIgnoresTransparentBlack)
+{
+	const uint8_t threeColors[8] = { 0x1F, 0x00, 0x00, 0xF8, 0xFF, 0xFF, 0xFF, 0xFF };
+	uint8_t rgba[4 * 4 * 4];
+	bcn::DecodeImage(VK_FORMAT_BC1_RGBA_UNORM_BLOCK, threeColors, 4, 4, rgba);
+	CHECK((Texel(rgba, 0) == Rgba{ 0, 0, 0, 0 }));
+	bcn::DecodeImage(VK_FORMAT_BC1_RGB_UNORM_BLOCK, threeColors, 4, 4, rgba);
+	CHECK((Texel(rgba, 0) == Rgba{ 0, 0, 0, 255 }));
+}
+
+TEST(Bc3Decode)
+{
+	// Alpha 255 and 0 with eight values, texels 0 to 3 pick 0, 1, 2 and 7; colour texel 3 is palette entry 3
+	const uint8_t block[16] = { 255, 0, 0x88, 0x0E, 0, 0, 0, 0, 0x1F, 0x00, 0x00, 0xF8, 0xC0, 0, 0, 0 };
+	uint8_t rgba[4 * 4 * 4];
+	bcn::DecodeImage(VK_FORMAT_BC3_UNORM_BLOCK, block, 4, 4, rgba);
+	CHECK((Texel(rgba, 0) == Rgba{ 0, 0, 255, 255 }));
+	CHECK((Texel(rgba, 1) == Rgba{ 0, 0, 255, 0 }));
+	CHECK((Texel(rgba, 2) == Rgba{ 0, 0, 255, 218 }));
+	CHECK((Texel(rgba, 3) == Rgba{ 170, 0, 85, 36 }));
+}
+
+TEST(Bc5Decode)
+{
+	// Red 0 and 255 with six values and the two extremes, green 200 and 100 with eight values
+	const uint8_t block[16] = { 0, 255, 0xF2, 0x01, 0, 0, 0, 0, 200, 100, 0x19, 0, 0, 0, 0, 0 };
+	uint8_t rgba[4 * 4 * 4];
+	bcn::DecodeImage(VK_FORMAT_BC5_UNORM_BLOCK, block, 4, 4, rgba);
+	CHECK((Texel(rgba, 0) == Rgba{ 51, 100, 0, 255 }));	// red index 2, green index 1
+	CHECK((Texel(rgba, 1) == Rgba{ 0, 171, 0, 255 }));	// red index 6, green index 3
+	CHECK((Texel(rgba, 2) == Rgba{ 255, 200, 0, 255 }));	// red index 7, green index 0
+	CHECK((Texel(rgba, 3) == Rgba{ 0, 200, 0, 255 }));
+}
+
+TEST(Bc7Mode6Decode)
+{
+	BitWriter bits;
+	bits.Write(1 << 6, 7);
+	for (uint32_t value : { 127, 0, 0, 127, 64, 0, 127, 63 }) bits.Write(value, 7);	// R0 R1 G0 G1 B0 B1 A0 A1
+	bits.Write(1, 1).Write(0, 1);	// p-bits
+	bits.Write(0, 3).Write(15, 4).Write(8, 4);
+	for (int texel = 3; texel < 16; texel++) bits.Write(0, 4);
+	REQUIRE(bits.Position() == 128);
+
+	uint8_t rgba[64];
+	bcn::DecodeBc7Block(bits.Data(), rgba);
+	CHECK((Texel(rgba, 0) == Rgba{ 255, 1, 129, 255 }));
+	CHECK((Texel(rgba, 1) == Rgba{ 0, 254, 0, 126 }));
+	CHECK((Texel(rgba, 2) == Rgba{ 120, 135, 60, 186 }));
+	CHECK((Texel(rgba, 15) == Rgba{ 255, 1, 129, 255 }));
+}
+
+TEST(Bc7Mode1Decode)
+{
+	// Partition 17 puts texels 1, 2, 3 and 7 in the second subset, whose anchor is texel 2
+	BitWriter bits;
+	bits.Write(1 << 1, 2).Write(17, 6);
+	for (uint32_t value : { 63, 0, 0, 0 }) bits.Write(value, 6);	// reds of both endpoints of both subsets
+	for (uint32_t value : { 0, 0, 0, 0 }) bits.Write(value, 6);
+	for (uint32_t value : { 0, 0, 63, 0 }) bits.Write(value, 6);
+	bits.Write(1, 1).Write(0, 1);	// shared p-bits
+	for (int texel = 0; texel < 16; texel++)
+	{
+		bool anchor = texel == 0 || texel == 2;
+		bits.Write(texel == 2 ? 3 : texel == 3 ? 7 : 0, anchor ? 2 : 3);
+	}
+	REQUIRE(bits.Position() == 128);
+
+	uint8_t rgba[64];
+	bcn::DecodeBc7Block(bits.Data(), rgba);
+	CHECK((Texel(rgba, 0) == Rgba{ 255, 2, 2, 255 }));
+	CHECK((Texel(rgba, 15) == Rgba{ 255, 2, 2, 255 }));
+	CHECK((Texel(rgba, 1) == Rgba{ 0, 0, 253, 255 }));
+	CHECK((Texel(rgba, 7) == Rgba{ 0, 0, 253, 255 }));
+	CHECK((Texel(rgba, 2) == Rgba{ 0, 0, 146, 255 }));
+	CHECK((Texel(rgba, 3) == Rgba{ 0, 0, 0, 255 }));
+}
+
+TEST(Bc7ReservedModeIsTransparentBlack)
+{
+	const uint8_t block[16] = { 0, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+	uint8_t rgba[64];
+	memset(rgba, 0xCD, sizeof(rgba));
+	bcn::DecodeBc7Block(block, rgba);
+	for (uint8_t value : rgba) CHECK(value == 0);
+}
+
+TEST(DecodeImageClipsEdgeBlocks)
+{
+	// Two BC1 blocks side by side for a 5 x 3 image: solid red, then texel (0, 2) of the second is blue
+	const uint8_t blocks[16] = {
+		0x00, 0xF8, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0xF8, 0x1F, 0x00, 0x00, 0x00, 0x01, 0x00,
+	};
+	std::vector<uint8_t> rgba(5 * 3 * 4 + 16, 0xCD);
+	bcn::DecodeImage(VK_FORMAT_BC1_RGBA_UNORM_BLOCK, blocks, 5, 3, rgba.data());
+	CHECK((Texel(rgba.data(), 0) == Rgba{ 255, 0, 0, 255 }));
+	CHECK((Texel(rgba.data(), 2 * 5 + 4) == Rgba{ 0, 0, 255, 255 }));
+	CHECK((Texel(rgba.data(), 2 * 5 + 3) == Rgba{ 255, 0, 0, 255 }));
+	for (size_t i = 5 * 3 * 4; i < rgba.size(); i++) CHECK(rgba[i] == 0xCD);
+
+	CHECK(bcn::CanDecode(VK_FORMAT_BC7_SRGB_BLOCK));
+	CHECK(!bcn::CanDecode(VK_FORMAT_ASTC_4x4_SRGB_BLOCK));
+	CHECK(!bcn::CanDecode(VK_FORMAT_R8G8B8A8_SRGB));
+}
@@ -0,0 +1,66 @@
+#include "Test.h"
+#include "FlatIndexMap.h"
+
+#include <random>
+#include <unordered_map>
+
+TEST(FlatIndexMapMatchesUnorderedMap)
+{
+	// Sized far too small on purpose so the table grows several times
+	FlatIndexMap<CornerKey, CornerKeyHash> map(10);
+	std::unordered_map<uint64_t, uint32_t> reference;
+	std::mt19937 random(34);
+	std::uniform_int_distribution<int> index(-50, 2000);
+	for (uint32_t i = 0; i < 100000; i++)
+	{
+		CornerKey key{ index(random), index(random) % 40, index(random) % 3 };
+		uint64_t packed = (static_cast<uint64_t>(static_cast<uint32_t>(key.vertex)) << 32) |
+			(static_cast<uint64_t>(static_cast<uint16_t>(key.normal)) << 16) | static_cast<uint16_t>(key.texcoord);
+
+		auto inserted = map.Insert(key, i);
+		auto expected = reference.emplace(packed, i);
+		CHECK(inserted.second == expected.second);
+		CHECK(inserted.first == expected.first->second);
+	}
+	CHECK(map.Size() == reference.size());
+	CHECK(map.Size() * 2 <= map.Capacity());
+	CHECK((map.Capacity() & (map.Capacity() - 1)) == 0);
+}
+
+TEST(FlatIndexMapSizing)
+{
+	FlatIndexMap<CornerKey, CornerKeyHash> map(100);
+	CHECK(map.Capacity() == 256);
+	for (int i = 0; i < 128; i++) map.Insert({ i, 0, 0 }, static_cast<uint32_t>(i));
+	CHECK(map.Capacity() == 256);		// at most half full
+	map.Insert({ 128, 0, 0 }, 128);
+	CHECK(map.Capacity() == 512);
+
+	// The returned reference writes the stored value
+	map.Insert({ 5, 0, 0 }, 0).first = 1000;
+	CHECK(map.Insert({ 5, 0, 0 }, 0).first == 1000);
+	CHECK(!map.Insert({ 5, 0, 0 }, 0).second);
+}
+
+// Vertices equal by operator== must hash the same, including zeros of either sign
+TEST(VertexHashFoldsNegativeZero)
+{
+	Vertex a{}, b{};
+	a.position		= glm::vec3(0.0f, 1.0f, -2.0f);
+	a.normal		= glm::vec3(0.0f, -0.0f, 1.0f);
+	a.textureCoords	= glm::vec2(-0.0f, 0.5f);
+	b.position		= glm::vec3(-0.0f, 1.0f, -2.0f);
+	b.normal		= glm::vec3(-0.0f, 0.0f, 1.0f);
+	b.textureCoords	= glm::vec2(0.0f, 0.5f);
+	CHECK(a == b);
+	CHECK(VertexHash()(a) == VertexHash()(b));
+	CHECK(PositionHash()(a.position) == PositionHash()(b.position));
+
+	b.textureCoords.y = 0.25f;
+	CHECK(VertexHash()(a) != VertexHash()(b));
+
+	FlatIndexMap<Vertex, VertexHash> vertices(4);
+	CHECK(vertices.Insert(a, 0).second);
+	CHECK(!vertices.Insert(a, 1).second);
+	CHECK(vertices.Insert(b, 1).second);
+}
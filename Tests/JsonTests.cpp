@@ -0,0 +1,51 @@
+#include "Test.h"
+#include "json.h"
+
+namespace
+{
+	bool Rejects(const std::string& text)
+	{
+		try
+		{
+			json::ParseNumbers(text);
+		}
+		catch (const std::runtime_error&)
+		{
+			return true;
+		}
+		return false;
+	}
+}
+
+TEST(JsonFlattensNumbers)
+{
+	auto numbers = json::ParseNumbers(
+		"{ \"device\": \"GPU \\\"X\\\"\", \"frame_time_ms\": { \"p50\": 1.5, \"p95\": 2e1 },\n"
+		"  \"stages\": [ [\"a\", 3], [\"b\", -4.25] ], \"ok\": true, \"none\": null, \"empty\": {}, \"list\": [] }");
+	CHECK(numbers.size() == 4);
+	CHECK(numbers["frame_time_ms.p50"] == 1.5);
+	CHECK(numbers["frame_time_ms.p95"] == 20.0);
+	CHECK(numbers["stages[0][1]"] == 3.0);
+	CHECK(numbers["stages[1][1]"] == -4.25);
+}
+
+// Each of these used to loop forever or read past the end of the text
+TEST(JsonRejectsMalformedBaselines)
+{
+	const char* const malformed[] = {
+		"", "{", "[", "{\"a\": [-]}", "[1 2]", "{\"a\": 1 \"b\": 2}", "{\"a\" 1}", "{a: 1}", "{\"a\": 1,}",
+		"[1,]", "[1", "{\"a\": [1, 2}", "{\"a\": \"unterminated}", "{\"a\": tru}", "{\"a\": -}", "{} {}", "[.]",
+	};
+	for (const char* text : malformed)
+		CHECK(Rejects(text));
+}
+
+TEST(JsonEscapesReportStrings)
+{
+	std::string name = "GPU \"X\" C:\\assets\\a.obj\n\t";
+	std::string escaped = json::Escape(name);
+	CHECK(escaped == "GPU \\\"X\\\" C:\\\\assets\\\\a.obj");
+	auto numbers = json::ParseNumbers("{ \"device\": \"" + escaped + "\", \"" + escaped + "\": 2 }");
+	CHECK(numbers.size() == 1);
+	CHECK(numbers["GPU \"X\" C:\\assets\\a.obj"] == 2.0);
+}
@@ -0,0 +1,113 @@
+#include "Test.h"
+#include "ktx2.h"
+
+namespace
+{
+	std::vector<std::vector<uint8_t>> MakeLevels(const ktx2::FormatInfo& info, uint32_t width, uint32_t height, uint32_t levelCount)
+	{
+		std::vector<std::vector<uint8_t>> levels(levelCount);
+		for (uint32_t i = 0; i < levelCount; i++)
+		{
+			levels[i].resize(ktx2::LevelBytes(info, std::max(width >> i, 1u), std::max(height >> i, 1u)));
+			for (size_t b = 0; b < levels[i].size(); b++) levels[i][b] = static_cast<uint8_t>(b * 7 + i * 31);
+		}
+		return levels;
+	}
+
+	void Write32(std::vector<uint8_t>& file, size_t offset, uint32_t value)
+	{
+		memcpy(file.data() + offset, &value, sizeof(value));
+	}
+}
+
+TEST(Ktx2WriteParseRoundTrip)
+{
+	const uint32_t sizes[][3] = { { 1, 1, 1 }, { 13, 7, 4 }, { 64, 64, 7 }, { 256, 32, 9 }, { 5, 300, 2 } };
+	for (const ktx2::FormatInfo& info : ktx2::FORMATS)
+	{
+		for (const auto& size : sizes)
+		{
+			std::vector<std::vector<uint8_t>> levels = MakeLevels(info, size[0], size[1], size[2]);
+			std::vector<uint8_t> file = ktx2::Write(info.format, size[0], size[1], levels);
+
+			ktx2::Image image;
+			std::string error;
+			REQUIRE(ktx2::Parse(file.data(), file.size(), image, error));
+			CHECK(error.empty());
+			CHECK(image.format == info.format);
+			CHECK(image.width == size[0]);
+			CHECK(image.height == size[1]);
+			REQUIRE(image.levels.size() == levels.size());
+			for (size_t i = 0; i < levels.size(); i++)
+			{
+				const ktx2::Level& level = image.levels[i];
+				CHECK(level.width == std::max(size[0] >> i, 1u));
+				CHECK(level.height == std::max(size[1] >> i, 1u));
+				CHECK(level.offset % info.blockBytes == 0);
+				REQUIRE(level.size == levels[i].size());
+				CHECK(memcmp(file.data() + level.offset, levels[i].data(), levels[i].size()) == 0);
+			}
+		}
+	}
+}
+
+TEST(Ktx2RejectsTruncatedFiles)
+{
+	const ktx2::FormatInfo& info = *ktx2::FindFormat(VK_FORMAT_BC7_SRGB_BLOCK);
+	std::vector<uint8_t> file = ktx2::Write(info.format, 32, 16, MakeLevels(info, 32, 16, 6));
+
+	// Level 0 is stored last, so every prefix cuts into it
+	ktx2::Image image;
+	for (size_t size = 0; size < file.size(); size++)
+	{
+		std::string error;
+		CHECK(!ktx2::Parse(file.data(), size, image, error));
+		CHECK(!error.empty());
+	}
+}
+
+TEST(Ktx2RejectsWhatItCannotUpload)
+{
+	const ktx2::FormatInfo& info = *ktx2::FindFormat(VK_FORMAT_BC1_RGBA_UNORM_BLOCK);
+	const std::vector<uint8_t> file = ktx2::Write(info.format, 16, 16, MakeLevels(info, 16, 16, 5));
+	auto parses = [](const std::vector<uint8_t>& bytes) {
+		ktx2::Image image;
+		std::string error;
+		return ktx2::Parse(bytes.data(), bytes.size(), image, error);
+	};
+	CHECK(parses(file));
+
+	std::vector<uint8_t> changed = file;
+	changed[1] = 'X';
+	CHECK(!parses(changed));
+
+	changed = file;
+	Write32(changed, 12, VK_FORMAT_R16G16B16A16_UNORM);
+	CHECK(!parses(changed));
+
+	changed = file;
+	Write32(changed, 44, 2);	// zstd supercompression
+	CHECK(!parses(changed));
+
+	changed = file;
+	Write32(changed, 32, 2);	// array layers
+	CHECK(!parses(changed));
+
+	changed = file;
+	Write32(changed, 36, 6);	// cube faces
+	CHECK(!parses(changed));
+
+	changed = file;
+	Write32(changed, 40, 6);	// one level more than 16x16 has
+	CHECK(!parses(changed));
+
+	changed = file;
+	Write32(changed, ktx2::HEADER_BYTES, static_cast<uint32_t>(file.size() - 4));	// level 0 past the end
+	CHECK(!parses(changed));
+
+	changed = file;
+	uint64_t offset;
+	memcpy(&offset, changed.data() + ktx2::HEADER_BYTES, sizeof(offset));
+	Write32(changed, ktx2::HEADER_BYTES, static_cast<uint32_t>(offset - 4));	// not on a block boundary
+	CHECK(!parses(changed));
+}
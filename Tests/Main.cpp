@@ -0,0 +1,20 @@
+// Main.cpp : Runs every TEST, the exit code is the number of failed test cases so a failure also fails
+// the post-build step
+//
+
+#include "Test.h"
+
+int main()
+{
+	int failedCases = 0;
+	for (const TestCase& test : TestCases())
+	{
+		int failures = TestFailures();
+		test.function();
+		bool passed = TestFailures() == failures;
+		std::printf("%s %s\n", passed ? "[  OK  ]" : "[ FAIL ]", test.name);
+		if (!passed) failedCases++;
+	}
+	std::printf("%zu tests, %d failed\n", TestCases().size(), failedCases);
+	return failedCases;
+}
@@ -0,0 +1,66 @@
+#include "Test.h"
+#include "MeshCache.h"
+
+// The header is written and read as raw bytes, so a change in its layout needs a new MESH_CACHE_VERSION
+TEST(MeshCacheHeaderLayout)
+{
+	CHECK(sizeof(MeshLod) == 20);
+	CHECK(sizeof(MeshBatch) == 12);
+	CHECK(sizeof(MeshCacheHeader) == 264);
+	CHECK(MESH_CACHE_VERSION == 4);
+}
+
+TEST(MaterialTableRoundTrip)
+{
+	std::vector<MeshMaterial> materials = {
+		{ "stone", "textures/stone.png", "textures/stone_spec.png" },
+		{ "", "", "" },
+		{ std::string("nul\0inside", 10), "textures/a b.jpg", "" },
+	};
+	std::string bytes = SerializeMaterials(materials);
+	CHECK(bytes.size() == 3 * 3 * sizeof(uint32_t) + 5 + 18 + 23 + 10 + 16);
+
+	std::vector<MeshMaterial> read;
+	REQUIRE(DeserializeMaterials(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size(), 3, read));
+	REQUIRE(read.size() == materials.size());
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		CHECK(read[i].name == materials[i].name);
+		CHECK(read[i].diffuseTexture == materials[i].diffuseTexture);
+		CHECK(read[i].specularTexture == materials[i].specularTexture);
+	}
+}
+
+TEST(MaterialTableRejectsDamagedTables)
+{
+	std::string bytes = SerializeMaterials({ { "a", "b.png", "c.png" }, { "d", "", "" } });
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(bytes.data());
+	std::vector<MeshMaterial> read;
+	for (size_t size = 0; size < bytes.size(); size++)
+		CHECK(!DeserializeMaterials(data, size, 2, read));
+
+	std::string trailing = bytes + '\0';
+	CHECK(!DeserializeMaterials(reinterpret_cast<const uint8_t*>(trailing.data()), trailing.size(), 2, read));
+	CHECK(!DeserializeMaterials(data, bytes.size(), 1, read));
+	CHECK(!DeserializeMaterials(data, bytes.size(), 3, read));
+
+	std::string oversized = bytes;
+	oversized[0] = '\xff';	// the first length now runs past the end
+	CHECK(!DeserializeMaterials(reinterpret_cast<const uint8_t*>(oversized.data()), oversized.size(), 2, read));
+}
+
+TEST(SelectLodHysteresis)
+{
+	std::vector<MeshLod> lods(3);
+	lods[1].error = 0.01f;
+	lods[2].error = 0.1f;
+
+	// LOD 1 projects to 1 pixel at 100 pixels per unit
+	CHECK(SelectLod(lods, 0, 100.0f, 1.0f) == 0);		// not below the hysteresis yet
+	CHECK(SelectLod(lods, 0, 70.0f, 1.0f) == 1);
+	CHECK(SelectLod(lods, 1, 90.0f, 1.0f) == 1);		// stays until the threshold itself is crossed
+	CHECK(SelectLod(lods, 1, 110.0f, 1.0f) == 0);
+	CHECK(SelectLod(lods, 0, 1.0f, 1.0f) == 2);
+	CHECK(SelectLod(lods, 2, 1000.0f, 1.0f) == 0);
+	CHECK(SelectLod(lods, 7, 1.0f, 1.0f) == 2);		// an index past the end is clamped
+}
@@ -0,0 +1,203 @@
+#include "Test.h"
+#include "meshopt.h"
+
+#include <algorithm>
+#include <array>
+#include <random>
+
+namespace
+{
+	// A size x size grid of quads in the z = height(x, y) plane, with its triangles shuffled
+	struct Grid
+	{
+		std::vector<Vertex>		vertices;
+		std::vector<uint32_t>	indices;
+	};
+
+	template<typename Height>
+	Grid MakeGrid(uint32_t size, Height height, uint32_t seed = 35)
+	{
+		Grid grid;
+		for (uint32_t y = 0; y <= size; y++)
+			for (uint32_t x = 0; x <= size; x++)
+			{
+				Vertex vertex{};
+				vertex.position			= glm::vec3(static_cast<float>(x), static_cast<float>(y), height(x, y));
+				vertex.normal			= glm::vec3(0.0f, 0.0f, 1.0f);
+				vertex.textureCoords	= glm::vec2(static_cast<float>(x) / static_cast<float>(size), static_cast<float>(y) / static_cast<float>(size));
+				grid.vertices.push_back(vertex);
+			}
+
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for (uint32_t y = 0; y < size; y++)
+			for (uint32_t x = 0; x < size; x++)
+			{
+				uint32_t corner = y * (size + 1) + x;
+				triangles.push_back({ corner, corner + 1, corner + size + 2 });
+				triangles.push_back({ corner, corner + size + 2, corner + size + 1 });
+			}
+		std::shuffle(triangles.begin(), triangles.end(), std::mt19937(seed));
+		for (const auto& triangle : triangles)
+			grid.indices.insert(grid.indices.end(), triangle.begin(), triangle.end());
+		return grid;
+	}
+
+	Grid MakeFlatGrid(uint32_t size)
+	{
+		return MakeGrid(size, [](uint32_t, uint32_t) { return 0.0f; });
+	}
+
+	// Triangles by their corner positions, rotated to start at the smallest so winding is kept, and sorted
+	std::vector<std::array<float, 9>> Triangles(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		std::vector<std::array<float, 9>> triangles;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			std::array<std::array<float, 3>, 3> corners;
+			for (size_t k = 0; k < 3; k++)
+			{
+				const glm::vec3& p = vertices[indices[i + k]].position;
+				corners[k] = { p.x, p.y, p.z };
+			}
+			std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end()), corners.end());
+			std::array<float, 9> triangle;
+			for (size_t k = 0; k < 9; k++) triangle[k] = corners[k / 3][k % 3];
+			triangles.push_back(triangle);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+}
+
+TEST(OptimizeVertexCacheKeepsTrianglesAndLowersAcmr)
+{
+	Grid grid = MakeFlatGrid(64);
+	auto before = meshopt::Analyze(grid.indices.data(), grid.indices.size(), grid.vertices.size(), sizeof(Vertex));
+
+	std::vector<uint32_t> indices = grid.indices, clusters;
+	meshopt::OptimizeVertexCache(indices, grid.vertices.size(), clusters);
+	CHECK(Triangles(grid.vertices, indices) == Triangles(grid.vertices, grid.indices));
+
+	REQUIRE(!clusters.empty());
+	CHECK(clusters[0] == 0);
+	CHECK(std::is_sorted(clusters.begin(), clusters.end()));
+	CHECK(std::adjacent_find(clusters.begin(), clusters.end()) == clusters.end());
+	CHECK(clusters.back() < indices.size() / 3);
+
+	// A shuffled grid shades nearly every corner, Tipsify should get well under 1 vertex per triangle
+	auto after = meshopt::Analyze(indices.data(), indices.size(), grid.vertices.size(), sizeof(Vertex));
+	CHECK(before.acmr > 1.2);
+	CHECK(after.acmr < 0.8);
+	CHECK(after.atvr < before.atvr);
+
+	meshopt::OptimizeOverdraw(indices, grid.vertices, clusters);
+	CHECK(Triangles(grid.vertices, indices) == Triangles(grid.vertices, grid.indices));
+	auto sorted = meshopt::Analyze(indices.data(), indices.size(), grid.vertices.size(), sizeof(Vertex));
+	CHECK(sorted.acmr < 0.9);
+}
+
+TEST(OptimizeVertexFetchRenumbersByFirstUse)
+{
+	Grid grid = MakeFlatGrid(32);
+	std::vector<uint32_t> indices = grid.indices, clusters;
+	meshopt::OptimizeVertexCache(indices, grid.vertices.size(), clusters);
+	auto before = meshopt::Analyze(indices.data(), indices.size(), grid.vertices.size(), sizeof(Vertex));
+
+	std::vector<Vertex> vertices = grid.vertices;
+	meshopt::OptimizeVertexFetch(vertices, indices);
+	CHECK(vertices.size() == grid.vertices.size());
+	CHECK(Triangles(vertices, indices) == Triangles(grid.vertices, grid.indices));
+
+	uint32_t next = 0;
+	bool firstUse = true;
+	for (uint32_t index : indices)
+	{
+		if (index > next) firstUse = false;
+		if (index == next) next++;
+	}
+	CHECK(firstUse);
+	CHECK(next == vertices.size());
+
+	auto after = meshopt::Analyze(indices.data(), indices.size(), vertices.size(), sizeof(Vertex));
+	CHECK(after.acmr == before.acmr);
+	CHECK(after.overfetch <= before.overfetch);
+}
+
+TEST(SimplifyFlatGrid)
+{
+	Grid grid = MakeFlatGrid(32);
+	std::vector<uint32_t> groups(grid.indices.size() / 3);
+	for (size_t i = 0; i < groups.size(); i++) groups[i] = i % 2 == 0 ? 7 : 9;
+
+	float error = -1.0f;
+	std::vector<uint32_t> simplified = meshopt::Simplify(grid.vertices, grid.indices, grid.indices.size() / 4, 0.01f, error, groups);
+	CHECK(!simplified.empty());
+	CHECK(simplified.size() % 3 == 0);
+	CHECK(simplified.size() <= grid.indices.size() / 2);
+	CHECK(groups.size() == simplified.size() / 3);
+	CHECK(error >= 0.0f && error <= 0.01f);
+	for (uint32_t index : simplified) CHECK(index < grid.vertices.size());
+
+	// A flat square stays a flat square of the same area, facing the same way
+	float area = 0.0f;
+	for (size_t i = 0; i < simplified.size(); i += 3)
+	{
+		const glm::vec3& a = grid.vertices[simplified[i]].position;
+		glm::vec3 normal = glm::cross(grid.vertices[simplified[i + 1]].position - a, grid.vertices[simplified[i + 2]].position - a);
+		CHECK(normal.z >= 0.0f);
+		area += normal.z * 0.5f;
+	}
+	CHECK(std::abs(area - 32.0f * 32.0f) < 1e-3f);
+}
+
+TEST(SimplifyStopsAtMaxError)
+{
+	// Random heights leave no collapse that is close to free
+	std::mt19937 random(35);
+	std::uniform_real_distribution<float> height(-0.5f, 0.5f);
+	Grid grid = MakeGrid(32, [&](uint32_t, uint32_t) { return height(random); });
+	std::vector<uint32_t> groups(grid.indices.size() / 3, 0);
+	float error = -1.0f;
+	std::vector<uint32_t> simplified = meshopt::Simplify(grid.vertices, grid.indices, 0, 0.05f, error, groups);
+	CHECK(error <= 0.05f);
+	CHECK(simplified.size() * 2 > grid.indices.size());
+}
+
+TEST(BuildMeshletsCoverTheRanges)
+{
+	Grid grid = MakeFlatGrid(48);
+	std::vector<uint32_t> indices = grid.indices, clusters;
+	meshopt::OptimizeVertexCache(indices, grid.vertices.size(), clusters);
+
+	uint32_t half = static_cast<uint32_t>(indices.size() / 6 * 3);
+	std::vector<IndexRange> ranges = {
+		{ 0, half, 0 },
+		{ half, static_cast<uint32_t>(indices.size()) - half, 0 },
+	};
+	std::vector<meshopt::Meshlet> meshlets = meshopt::BuildMeshlets(indices.data(), grid.vertices.data(), grid.vertices.size(), ranges);
+	REQUIRE(!meshlets.empty());
+
+	uint32_t covered = 0;
+	for (const meshopt::Meshlet& meshlet : meshlets)
+	{
+		CHECK(meshlet.firstIndex == covered);
+		CHECK(meshlet.indexCount % 3 == 0);
+		CHECK(meshlet.indexCount / 3 <= meshopt::MESHLET_MAX_TRIANGLES);
+		CHECK(meshlet.firstIndex >= half || meshlet.firstIndex + meshlet.indexCount <= half);
+		covered += meshlet.indexCount;
+
+		std::vector<uint32_t> distinct(indices.begin() + meshlet.firstIndex, indices.begin() + meshlet.firstIndex + meshlet.indexCount);
+		std::sort(distinct.begin(), distinct.end());
+		distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+		CHECK(distinct.size() <= meshopt::MESHLET_MAX_VERTICES);
+
+		glm::vec3 centre(meshlet.sphere.x, meshlet.sphere.y, meshlet.sphere.z);
+		for (uint32_t vertex : distinct)
+			CHECK(glm::length(grid.vertices[vertex].position - centre) <= meshlet.sphere.w * 1.0001f);
+
+		// Every triangle of a flat grid faces +z, so the cone is a line
+		CHECK(std::abs(meshlet.cone.z - 1.0f) < 1e-5f);
+		CHECK(meshlet.cone.w < 1e-3f);
+	}
+	CHECK(covered == indices.size());
+}
@@ -0,0 +1,212 @@
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tol/tiny_obj_loader.h"
+
+#include "Test.h"
+#include "objparallel.h"
+
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+
+namespace {
+	const char* const MATERIALS =
+		"newmtl stone\nmap_Kd stone.png\n"
+		"newmtl wood\r\nmap_Kd wood.png\r\nmap_Ks wood_spec.png\r\n";
+
+	struct ObjResult
+	{
+		bool								loaded = false;
+		tinyobj::attrib_t					attrib;
+		std::vector<tinyobj::shape_t>		shapes;
+		std::vector<tinyobj::material_t>	materials;
+		std::string							warn, err;
+	};
+
+	ObjResult LoadWithTinyobj(const std::string& obj)
+	{
+		ObjResult result;
+		std::istringstream stream(obj), materialStream(MATERIALS);
+		tinyobj::MaterialStreamReader materialReader(materialStream);
+		result.loaded = tinyobj::LoadObj(&result.attrib, &result.shapes, &result.materials, &result.warn, &result.err, &stream, &materialReader);
+		return result;
+	}
+
+	ObjResult LoadWithObjParallel(const std::string& obj, size_t chunkCount)
+	{
+		ObjResult result;
+		std::istringstream materialStream(MATERIALS);
+		tinyobj::MaterialStreamReader materialReader(materialStream);
+		result.loaded = objparallel::LoadObj(&result.attrib, &result.shapes, &result.materials, &result.warn, &result.err,
+			obj.data(), obj.size(), &materialReader, chunkCount);
+		return result;
+	}
+
+	// Floats are compared by their bits, so -0.0 against 0.0 or a rounding difference in the last bit fails
+	bool SameBits(const std::vector<tinyobj::real_t>& a, const std::vector<tinyobj::real_t>& b)
+	{
+		return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(tinyobj::real_t)) == 0);
+	}
+
+	bool SameIndices(const std::vector<tinyobj::index_t>& a, const std::vector<tinyobj::index_t>& b)
+	{
+		if (a.size() != b.size()) return false;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (a[i].vertex_index != b[i].vertex_index || a[i].normal_index != b[i].normal_index || a[i].texcoord_index != b[i].texcoord_index)
+				return false;
+		}
+		return true;
+	}
+
+	void CheckSameResult(const ObjResult& expected, const ObjResult& actual)
+	{
+		CHECK(actual.loaded == expected.loaded);
+		CHECK(actual.err == expected.err);
+		CHECK(actual.warn == expected.warn);
+		CHECK(SameBits(actual.attrib.vertices, expected.attrib.vertices));
+		CHECK(SameBits(actual.attrib.vertex_weights, expected.attrib.vertex_weights));
+		CHECK(SameBits(actual.attrib.normals, expected.attrib.normals));
+		CHECK(SameBits(actual.attrib.texcoords, expected.attrib.texcoords));
+		CHECK(SameBits(actual.attrib.texcoord_ws, expected.attrib.texcoord_ws));
+		CHECK(SameBits(actual.attrib.colors, expected.attrib.colors));
+
+		REQUIRE(actual.materials.size() == expected.materials.size());
+		for (size_t i = 0; i < expected.materials.size(); i++)
+		{
+			CHECK(actual.materials[i].name == expected.materials[i].name);
+			CHECK(actual.materials[i].diffuse_texname == expected.materials[i].diffuse_texname);
+			CHECK(actual.materials[i].specular_texname == expected.materials[i].specular_texname);
+		}
+
+		REQUIRE(actual.shapes.size() == expected.shapes.size());
+		for (size_t i = 0; i < expected.shapes.size(); i++)
+		{
+			const tinyobj::mesh_t& a = actual.shapes[i].mesh;
+			const tinyobj::mesh_t& b = expected.shapes[i].mesh;
+			CHECK(actual.shapes[i].name == expected.shapes[i].name);
+			CHECK(SameIndices(a.indices, b.indices));
+			CHECK(a.num_face_vertices == b.num_face_vertices);
+			CHECK(a.material_ids == b.material_ids);
+			CHECK(a.smoothing_group_ids == b.smoothing_group_ids);
+		}
+	}
+
+	void CheckAllChunkCounts(const std::string& obj)
+	{
+		ObjResult expected = LoadWithTinyobj(obj);
+		for (size_t chunkCount : { 0, 1, 2, 3, 7, 64 })
+			CheckSameResult(expected, LoadWithObjParallel(obj, chunkCount));
+	}
+
+	// Grid of quads split into groups with alternating materials, every other row indexing its corners
+	// relative to the end and every third row leaving out the normals
+	std::string GenerateGrid(uint32_t size, bool crlf)
+	{
+		std::mt19937 random(size);
+		std::uniform_real_distribution<float> jitter(-0.001f, 0.001f);
+		const char* newline = crlf ? "\r\n" : "\n";
+		std::ostringstream obj;
+		obj.precision(9);
+		obj << "# generated" << newline << "mtllib materials.mtl" << newline;
+		for (uint32_t y = 0; y <= size; y++)
+		{
+			for (uint32_t x = 0; x <= size; x++)
+			{
+				obj << "v " << static_cast<float>(x) + jitter(random) << ' ' << jitter(random) << ' ' << -static_cast<float>(y) << newline;
+				obj << "vt " << static_cast<float>(x) / static_cast<float>(size) << ' ' << static_cast<float>(y) / static_cast<float>(size) << newline;
+				obj << "vn 0 1 " << jitter(random) << newline;
+			}
+		}
+
+		const uint32_t verticesPerRow = size + 1, vertexCount = verticesPerRow * verticesPerRow;
+		for (uint32_t y = 0; y < size; y++)
+		{
+			if (y % 8 == 0) obj << "g rows" << y << newline << "usemtl " << (y % 16 ? "wood" : "stone") << newline;
+			if (y % 5 == 0) obj << "s " << (y % 10 ? "off" : "1") << newline;
+			for (uint32_t x = 0; x < size; x++)
+			{
+				uint32_t corners[4] = { y * verticesPerRow + x + 1, y * verticesPerRow + x + 2, (y + 1) * verticesPerRow + x + 2, (y + 1) * verticesPerRow + x + 1 };
+				obj << 'f';
+				for (uint32_t corner : corners)
+				{
+					long long index = y % 2 ? static_cast<long long>(corner) - vertexCount - 1 : corner;
+					if (y % 3 == 0) obj << ' ' << index << '/' << index;
+					else obj << ' ' << index << '/' << index << '/' << index;
+				}
+				obj << newline;
+			}
+		}
+		return obj.str();
+	}
+}
+
+TEST(ObjParallelMatchesTinyobjOnEdgeCases)
+{
+	CheckAllChunkCounts(
+		"mtllib materials.mtl\n"
+		"v 1 2 3\nv -1.5 +2.25e1 .5\nv 0 0 0 0.5\nv 1e-3 -0 4 0.25 0.5 0.75\n"
+		"vt 0 1\nvt 0.5 0.25 1\nvn 0 0 1\n"
+		"o first\nusemtl stone\nf 1/1/1 2/2/1 3/1/1\nf -1/-1/-1 -2/-2/-1 -3/-1/-1\n"
+		"\t# comment\n\ng second\ns 3\nusemtl missing\nf 1//1 2//1 3//1 4//1\nf 1 2 3 4 1\n"
+		"usemtl wood\ns off\nf 4 3 2\r\n"
+		"g\nf 1/1 2/2 3/1");
+}
+
+TEST(ObjParallelMatchesTinyobjOnGrids)
+{
+	CheckAllChunkCounts(GenerateGrid(40, false));
+	CheckAllChunkCounts(GenerateGrid(33, true));
+}
+
+TEST(ObjParallelReportsBadFacesLikeTinyobj)
+{
+	CheckAllChunkCounts("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\nf 0 1 2\n");
+}
+
+namespace {
+	// Parses text with tinyobj's fast path and with its original loop, both must agree on whether it is
+	// a number and, if so, give the same float
+	bool SameFloatFromBothParsers(const std::string& text)
+	{
+		double fast = 0.0, loop = 0.0;
+		bool fastParsed = tinyobj::tryParseDouble(text.data(), text.data() + text.size(), &fast);
+		bool loopParsed = tinyobj::tryParseDoubleLoop(text.data(), text.data() + text.size(), &loop);
+		if (fastParsed != loopParsed) return false;
+		if (!fastParsed) return true;
+
+		float fastFloat = static_cast<float>(fast), loopFloat = static_cast<float>(loop);
+		return memcmp(&fastFloat, &loopFloat, sizeof(float)) == 0 || (fastFloat != fastFloat && loopFloat != loopFloat);
+	}
+}
+
+// Fixed notation numbers as exporters write them, with up to 9 decimals, parse to the same float
+TEST(FloatParsingMatchesOriginalParser)
+{
+	std::mt19937 random(33);
+	std::uniform_int_distribution<int> sign(0, 2), decimals(0, 9), magnitude(0, 6);
+	std::uniform_int_distribution<uint64_t> digits(0, 999999999999999ull);
+	int mismatches = 0;
+	for (int i = 0; i < 200000; i++)
+	{
+		uint64_t integer = digits(random);
+		for (int m = magnitude(random); m < 15; m++) integer /= 10;
+		std::string fraction = std::to_string(digits(random)).substr(0, decimals(random));
+
+		int signs = sign(random);
+		std::string text = signs == 0 ? "-" : signs == 1 ? "+" : "";
+		text += std::to_string(integer);
+		if (!fraction.empty() || i % 7 == 0) text += "." + fraction;
+		if (!SameFloatFromBothParsers(text) && mismatches++ < 10)
+			std::printf("  %s parses differently\n", text.c_str());
+	}
+	CHECK(mismatches == 0);
+}
+
+// Input the fast path hands to the loop, or that sits at the edge of what it accepts
+TEST(FloatParsingEdgeCases)
+{
+	for (const char* text : { "0", "-0", "+0", "-0.0", ".5", "-.5", "+.5", "5.", "00012.5000", "1e5", "1E-5", "-1.5e+3", ".7e+2",
+		"1e", "1e+", "1.5e", ".", "-", "+", "-.", "inf", "-inf", "nan", "abc", "12abc", "1.2.3", "1e400", "1e-400", "123456789012345678901234567890" })
+		CHECK(SameFloatFromBothParsers(text));
+}
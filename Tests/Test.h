@@ -0,0 +1,40 @@
+// Minimal test harness. TEST(Name) defines a test case Main.cpp runs, CHECK records a failure and
+// carries on, REQUIRE records it and leaves the test case.
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+struct TestCase
+{
+	const char*	name;
+	void		(*function)();
+};
+
+inline std::vector<TestCase>& TestCases()
+{
+	static std::vector<TestCase> cases;
+	return cases;
+}
+
+inline int& TestFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+struct TestRegistration
+{
+	TestRegistration(const char* name, void (*function)()) { TestCases().push_back({ name, function }); }
+};
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name); \
+	static void name()
+
+#define CHECK(condition) \
+	do { if (!(condition)) { std::printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); TestFailures()++; } } while (false)
+
+#define REQUIRE(condition) \
+	do { if (!(condition)) { std::printf("%s(%d): REQUIRE(%s) failed\n", __FILE__, __LINE__, #condition); TestFailures()++; return; } } while (false)
@@ -0,0 +1,175 @@
+#include "Test.h"
+#include "texbake.h"
+
+#include <random>
+
+namespace
+{
+	// Encodes a width x height RGBA8 image into format and decodes it again
+	std::vector<uint8_t> RoundTrip(VkFormat format, const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height)
+	{
+		std::vector<uint8_t> blocks(ktx2::LevelBytes(*ktx2::FindFormat(format), width, height));
+		texbake::EncodeBlockRows(format, rgba.data(), width, height, 0, (height + 3) / 4, blocks.data());
+		std::vector<uint8_t> decoded(rgba.size());
+		bcn::DecodeImage(format, blocks.data(), width, height, decoded.data());
+		return decoded;
+	}
+
+	// Smooth gradients in every channel, optionally with noise on top
+	std::vector<uint8_t> TestImage(uint32_t size, int noise)
+	{
+		std::mt19937 random(43);
+		std::vector<uint8_t> rgba(static_cast<size_t>(size) * size * 4);
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				const int values[4] = { static_cast<int>(x * 256 / size), static_cast<int>(y * 256 / size), static_cast<int>((x + y) * 128 / size), 255 - static_cast<int>(x * 128 / size) };
+				for (int c = 0; c < 4; c++)
+				{
+					int offset = noise ? static_cast<int>(random() % (2 * noise + 1)) - noise : 0;
+					rgba[(static_cast<size_t>(y) * size + x) * 4 + c] = static_cast<uint8_t>(std::clamp(values[c] + offset, 0, 255));
+				}
+			}
+		}
+		return rgba;
+	}
+}
+
+TEST(BuildTapsSumToOne)
+{
+	const uint32_t sizes[][2] = { { 2, 1 }, { 1, 1 }, { 7, 3 }, { 64, 32 }, { 5, 2 }, { 1000, 500 } };
+	for (texbake::MipFilter filter : { texbake::MipFilter::Box, texbake::MipFilter::Kaiser })
+	{
+		for (const auto& size : sizes)
+		{
+			auto taps = texbake::BuildTaps(size[0], size[1], filter);
+			REQUIRE(taps.size() == size[1]);
+			for (const auto& texel : taps)
+			{
+				double sum = 0.0;
+				for (const texbake::Tap& tap : texel)
+				{
+					CHECK(tap.index < size[0]);
+					sum += tap.weight;
+				}
+				CHECK(std::abs(sum - 1.0) < 1e-6);
+			}
+		}
+	}
+
+	// Halving with the box filter averages pairs, and odd sizes split the texel in the middle
+	auto half = texbake::BuildTaps(8, 4, texbake::MipFilter::Box);
+	REQUIRE(half[1].size() == 2);
+	CHECK(half[1][0].index == 2 && half[1][0].weight == 0.5f);
+	CHECK(half[1][1].index == 3 && half[1][1].weight == 0.5f);
+	auto odd = texbake::BuildTaps(5, 2, texbake::MipFilter::Box);
+	REQUIRE(odd[0].size() == 3);
+	CHECK(std::abs(odd[0][2].weight - 0.2f) < 1e-6f);
+}
+
+TEST(BoxDownsampleAveragesLinearTexels)
+{
+	std::mt19937 random(43);
+	std::uniform_real_distribution<float> value(0.0f, 1.0f);
+	texbake::MipImage image{ 8, 6, std::vector<float>(8 * 6 * 4) };
+	for (float& texel : image.texels) texel = value(random);
+
+	texbake::MipImage half = texbake::Downsample(image, texbake::MipFilter::Box);
+	REQUIRE(half.width == 4 && half.height == 3);
+	for (uint32_t y = 0; y < half.height; y++)
+	{
+		for (uint32_t x = 0; x < half.width; x++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				auto at = [&](uint32_t sx, uint32_t sy) { return image.texels[(sy * image.width + sx) * 4 + c]; };
+				float average = (at(2 * x, 2 * y) + at(2 * x + 1, 2 * y) + at(2 * x, 2 * y + 1) + at(2 * x + 1, 2 * y + 1)) / 4.0f;
+				CHECK(std::abs(half.texels[(y * half.width + x) * 4 + c] - average) < 1e-6f);
+			}
+		}
+	}
+}
+
+TEST(KaiserDownsampleKeepsFlatImages)
+{
+	texbake::MipImage image{ 16, 16, std::vector<float>(16 * 16 * 4) };
+	for (size_t i = 0; i < image.texels.size(); i++) image.texels[i] = 0.25f + 0.125f * static_cast<float>(i & 3);
+	texbake::MipImage half = texbake::Downsample(image, texbake::MipFilter::Kaiser);
+	REQUIRE(half.width == 8 && half.height == 8);
+	for (size_t i = 0; i < half.texels.size(); i++)
+		CHECK(std::abs(half.texels[i] - (0.25f + 0.125f * static_cast<float>(i & 3))) < 1e-5f);
+}
+
+TEST(SrgbConversionRoundTrips)
+{
+	std::vector<uint8_t> rgba(256 * 4);
+	for (size_t i = 0; i < rgba.size(); i++) rgba[i] = static_cast<uint8_t>(i / 4);
+	texbake::MipImage linear = texbake::FromRgba8(rgba.data(), 256, 1);
+	CHECK(texbake::ToRgba8(linear) == rgba);
+
+	// Colour is linearized and alpha is not
+	CHECK(std::abs(linear.texels[128 * 4] - 0.2158605f) < 1e-6f);
+	CHECK(linear.texels[128 * 4 + 3] == 128 / 255.0f);
+}
+
+TEST(BlockEncodersMeetQuality)
+{
+	const uint32_t SIZE = 64;
+	struct Expected
+	{
+		VkFormat	format;
+		double		smooth;
+		double		noisy;
+	};
+	const Expected expected[] = {
+		{ VK_FORMAT_BC1_RGB_SRGB_BLOCK,	38.0,	34.0 },
+		{ VK_FORMAT_BC3_SRGB_BLOCK,		38.0,	34.0 },
+		{ VK_FORMAT_BC7_SRGB_BLOCK,		39.0,	34.0 },
+	};
+	for (const Expected& format : expected)
+	{
+		for (int noise : { 0, 8 })
+		{
+			std::vector<uint8_t> image = TestImage(SIZE, noise);
+			std::vector<uint8_t> decoded = RoundTrip(format.format, image, SIZE, SIZE);
+			if (format.format == VK_FORMAT_BC1_RGB_SRGB_BLOCK)
+				for (size_t i = 3; i < image.size(); i += 4) decoded[i] = image[i];	// no alpha to compare
+			CHECK(texbake::Psnr(image, decoded) > (noise ? format.noisy : format.smooth));
+		}
+	}
+}
+
+TEST(BlockEncodersKeepSolidColours)
+{
+	std::mt19937 random(43);
+	for (int i = 0; i < 500; i++)
+	{
+		uint8_t color[4] = { static_cast<uint8_t>(random()), static_cast<uint8_t>(random()), static_cast<uint8_t>(random()), static_cast<uint8_t>(random()) };
+		std::vector<uint8_t> block(64);
+		for (int texel = 0; texel < 16; texel++) memcpy(block.data() + texel * 4, color, 4);
+
+		// BC7 has 8 bit endpoints, but all channels of one share the p-bit
+		std::vector<uint8_t> bc7 = RoundTrip(VK_FORMAT_BC7_SRGB_BLOCK, block, 4, 4);
+		for (size_t c = 0; c < bc7.size(); c++) CHECK(std::abs(bc7[c] - block[c]) <= 1);
+
+		// BC3 alpha is exact
+		std::vector<uint8_t> bc3 = RoundTrip(VK_FORMAT_BC3_SRGB_BLOCK, block, 4, 4);
+		for (size_t c = 3; c < bc3.size(); c += 4) CHECK(bc3[c] == block[c]);
+
+		// And so is BC1 for colours 565 can hold
+		uint8_t rgb[3];
+		bcn::Unpack565(static_cast<uint16_t>(random()), rgb);
+		for (int texel = 0; texel < 16; texel++) memcpy(block.data() + texel * 4, rgb, 3);
+		std::vector<uint8_t> bc1 = RoundTrip(VK_FORMAT_BC1_RGB_SRGB_BLOCK, block, 4, 4);
+		for (size_t c = 0; c < bc1.size(); c++)
+			if (c % 4 != 3) CHECK(bc1[c] == block[c]);
+	}
+}
+
+TEST(ParallelForVisitsEveryIndexOnce)
+{
+	std::vector<std::atomic<int>> visits(1000);
+	texbake::ParallelFor(visits.size(), [&](size_t i) { visits[i]++; });
+	for (const auto& count : visits) CHECK(count == 1);
+}
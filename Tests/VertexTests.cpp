@@ -0,0 +1,29 @@
+#include "Test.h"
+#include "Vertex.h"
+
+// The sizes are part of the mesh cache and vertex buffer formats
+TEST(VertexLayoutSizes)
+{
+	CHECK(sizeof(Vertex) == 32);
+	CHECK(sizeof(CompactVertex) == 20);
+	CHECK(sizeof(QuantizedVertex) == 16);
+	CHECK(Vertex::GetStride(VertexLayout::Full) == sizeof(Vertex));
+	CHECK(Vertex::GetStride(VertexLayout::Compact) == sizeof(CompactVertex));
+	CHECK(Vertex::GetStride(VertexLayout::Quantized) == sizeof(QuantizedVertex));
+}
+
+TEST(VertexAttributesFitTheirLayout)
+{
+	for (VertexLayout layout : { VertexLayout::Full, VertexLayout::Compact, VertexLayout::Quantized })
+	{
+		VkVertexInputBindingDescription binding = Vertex::GetBindingDescription(layout);
+		CHECK(binding.stride == Vertex::GetStride(layout));
+
+		std::array<VkVertexInputAttributeDescription, 3> attributes = Vertex::GetAttributeDescription(layout);
+		for (uint32_t i = 0; i < attributes.size(); i++)
+		{
+			CHECK(attributes[i].location == i);
+			CHECK(attributes[i].offset < binding.stride);
+		}
+	}
+}
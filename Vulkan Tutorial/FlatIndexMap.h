@@ -0,0 +1,146 @@
+// Open addressing table and the key hashes LoadModel deduplicates vertices with
+#pragma once
+
+#include "Vertex.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+/*
+Open addressing hash table from a key to a uint32_t, used to deduplicate vertices while loading.
+
+Slots live in one flat power of two sized array and collisions probe linearly, so a lookup touches
+one or two cache lines instead of chasing a bucket list. The table is sized up front from an
+estimate of the entry count and doubles once it gets more than half full. Entries are never erased.
+*/
+template<typename Key, typename Hash>
+class FlatIndexMap
+{
+public:
+	explicit FlatIndexMap(size_t expectedCount)
+	{
+		size_t capacity = 16;
+		while (capacity < (expectedCount + 1) * 2) capacity *= 2;
+		m_Slots.resize(capacity);
+	}
+
+	// Returns the value stored for key and false, or stores value for the new key and returns it and true.
+	// The reference stays valid until the next Insert.
+	std::pair<uint32_t&, bool> Insert(const Key& key, uint32_t value)
+	{
+		if ((m_Count + 1) * 2 > m_Slots.size()) Grow();
+
+		size_t mask = m_Slots.size() - 1;
+		for (size_t i = Hash()(key) & mask;; i = (i + 1) & mask)
+		{
+			Slot& slot = m_Slots[i];
+			if (!slot.used)
+			{
+				slot.key	= key;
+				slot.value	= value;
+				slot.used	= true;
+				m_Count++;
+				return { slot.value, true };
+			}
+			if (slot.key == key) return { slot.value, false };
+		}
+	}
+
+	size_t Size() const { return m_Count; }
+	size_t Capacity() const { return m_Slots.size(); }
+
+private:
+	struct Slot
+	{
+		Key			key{};
+		uint32_t	value	= 0;
+		bool		used	= false;
+	};
+
+	void Grow()
+	{
+		std::vector<Slot> slots(m_Slots.size() * 2);
+		size_t mask = slots.size() - 1;
+		for (const Slot& slot : m_Slots)
+		{
+			if (!slot.used) continue;
+			size_t i = Hash()(slot.key) & mask;
+			while (slots[i].used) i = (i + 1) & mask;
+			slots[i] = slot;
+		}
+		m_Slots.swap(slots);
+	}
+
+	std::vector<Slot>	m_Slots;
+	size_t				m_Count = 0;
+};
+
+// MurmurHash3's 64 bit finalizer, every input bit affects every output bit
+inline uint64_t MixHash(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdull;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ull;
+	key ^= key >> 33;
+	return key;
+}
+
+// Position, normal and texture coordinate indices of one OBJ face corner
+struct CornerKey
+{
+	int vertex		= 0;
+	int normal		= 0;
+	int texcoord	= 0;
+
+	bool operator==(const CornerKey& other) const {
+		return vertex == other.vertex && normal == other.normal && texcoord == other.texcoord;
+	}
+};
+
+struct CornerKeyHash
+{
+	size_t operator()(const CornerKey& key) const
+	{
+		uint64_t packed = (static_cast<uint64_t>(static_cast<uint32_t>(key.vertex)) << 32) ^
+			(static_cast<uint64_t>(static_cast<uint32_t>(key.normal)) << 16) ^ static_cast<uint32_t>(key.texcoord);
+		return static_cast<size_t>(MixHash(packed));
+	}
+};
+
+// Hashes the bytes of a vertex, -0.0 is folded into 0.0 so vertices equal by operator== hash the same
+struct VertexHash
+{
+	size_t operator()(const Vertex& vertex) const
+	{
+		const float values[] = {
+			vertex.position.x + 0.0f, vertex.position.y + 0.0f, vertex.position.z + 0.0f,
+			vertex.normal.x + 0.0f, vertex.normal.y + 0.0f, vertex.normal.z + 0.0f,
+			vertex.textureCoords.x + 0.0f, vertex.textureCoords.y + 0.0f
+		};
+		uint64_t hash = 0;
+		for (size_t i = 0; i < std::size(values); i += 2)
+		{
+			uint32_t low, high;
+			memcpy(&low, &values[i], sizeof(float));
+			memcpy(&high, &values[i + 1], sizeof(float));
+			hash = MixHash(hash ^ ((static_cast<uint64_t>(high) << 32) | low));
+		}
+		return static_cast<size_t>(hash);
+	}
+};
+
+// Hashes a position by its float bits, with -0.0 folded into 0.0 as glm::vec3's == does
+struct PositionHash
+{
+	size_t operator()(const glm::vec3& position) const
+	{
+		const float values[] = { position.x + 0.0f, position.y + 0.0f, position.z + 0.0f };
+		uint32_t bits[3];
+		memcpy(bits, values, sizeof(bits));
+		return static_cast<size_t>(MixHash(MixHash((static_cast<uint64_t>(bits[1]) << 32) | bits[0]) ^ bits[2]));
+	}
+};
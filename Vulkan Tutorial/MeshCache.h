@@ -0,0 +1,138 @@
+// File format of the binary mesh cache LoadModel bakes OBJ models into, and the LOD, batch and
+// material tables it stores
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+constexpr char		MESH_CACHE_MAGIC[4]		= { 'V', 'T', 'M', 'C' };
+constexpr uint32_t	MESH_CACHE_VERSION		= 4;
+// Bump whenever struct Vertex changes so caches baked with the old layout are rebuilt
+constexpr uint32_t	VERTEX_LAYOUT_VERSION	= 1;
+
+// Level of detail of a mesh: a run of the index buffer over the vertices all levels share, cut into
+// one batch per material
+struct MeshLod
+{
+	uint32_t	firstIndex	= 0;
+	uint32_t	indexCount	= 0;
+	float		error		= 0.0f;	// how far the surface may be from LOD 0, in object space units
+	uint32_t	firstBatch	= 0;
+	uint32_t	batchCount	= 0;
+};
+
+// Run of one LOD's indices drawn with one material
+struct MeshBatch
+{
+	uint32_t	firstIndex	= 0;
+	uint32_t	indexCount	= 0;
+	uint32_t	material	= 0;
+};
+
+// Material of a mesh from its MTL. Texture paths are relative to the working directory and empty
+// when the MTL names none, the default textures are used then.
+struct MeshMaterial
+{
+	std::string	name;
+	std::string	diffuseTexture;
+	std::string	specularTexture;
+};
+
+// Material table of a mesh cache: the strings of every material, each as a uint32_t length and its characters
+inline std::string SerializeMaterials(const std::vector<MeshMaterial>& materials)
+{
+	std::string bytes;
+	auto write = [&](const std::string& text) {
+		uint32_t length = static_cast<uint32_t>(text.size());
+		bytes.append(reinterpret_cast<const char*>(&length), sizeof(length));
+		bytes.append(text);
+	};
+	for (const MeshMaterial& material : materials)
+	{
+		write(material.name);
+		write(material.diffuseTexture);
+		write(material.specularTexture);
+	}
+	return bytes;
+}
+
+inline bool DeserializeMaterials(const uint8_t* data, size_t size, uint32_t count, std::vector<MeshMaterial>& materials)
+{
+	size_t offset = 0;
+	auto read = [&](std::string& text) {
+		uint32_t length;
+		if (size - offset < sizeof(length)) return false;
+		memcpy(&length, data + offset, sizeof(length));
+		offset += sizeof(length);
+		if (size - offset < length) return false;
+		text.assign(reinterpret_cast<const char*>(data + offset), length);
+		offset += length;
+		return true;
+	};
+	materials.resize(count);
+	for (MeshMaterial& material : materials)
+	{
+		if (!read(material.name) || !read(material.diffuseTexture) || !read(material.specularTexture))
+			return false;
+	}
+	return offset == size;
+}
+
+constexpr uint32_t	MAX_MESH_LODS			= 8;
+// Simplification stops at this error, as a fraction of the bounds diagonal
+constexpr float		LOD_MAX_ERROR			= 0.02f;
+// or once a level is this small, or keeps more than LOD_MIN_REDUCTION of the previous level's triangles
+constexpr size_t	LOD_MIN_TRIANGLES		= 64;
+constexpr float		LOD_MIN_REDUCTION		= 0.8f;
+// A coarser LOD is only picked once its error is this far below the threshold, see SelectLod
+constexpr float		LOD_HYSTERESIS			= 0.75f;
+
+/*
+Header of a .meshcache file, followed by vertexCount Vertex structs, indexCount uint32_t indices
+which hold the lodCount LODs one after another, batchCount MeshBatch structs and materialBytes of
+material table. The cache is valid while the source OBJ has the same size and either the same write
+time or, if only the time changed, the same content hash, and it was optimized the same way.
+*/
+struct MeshCacheHeader
+{
+	char		magic[4];
+	uint32_t	version;
+	uint32_t	vertexLayoutVersion;
+	uint32_t	vertexStride;
+	uint64_t	sourceSize;
+	int64_t		sourceWriteTime;
+	uint64_t	sourceHash;
+	uint64_t	vertexCount;
+	uint64_t	indexCount;
+	glm::vec3	boundsMin;
+	glm::vec3	boundsMax;
+	uint32_t	optimizations;	// MESH_OPTIMIZE_* bits the mesh was baked with
+	uint32_t	lodCount;
+	MeshLod		lods[MAX_MESH_LODS];
+	uint32_t	batchCount;
+	uint32_t	materialCount;
+	uint64_t	materialBytes;
+};
+
+// Passes run over a loaded mesh before it is cached, see namespace meshopt
+constexpr uint32_t	MESH_OPTIMIZE_VERTEX_CACHE	= 1;
+constexpr uint32_t	MESH_OPTIMIZE_OVERDRAW		= 2;
+constexpr uint32_t	MESH_OPTIMIZE_VERTEX_FETCH	= 4;
+constexpr uint32_t	MESH_OPTIMIZE_LODS			= 8;
+
+// Coarsest LOD whose error projects to at most thresholdPixels. Coarser LODs are only taken once their
+// error is LOD_HYSTERESIS below the threshold, so a camera resting near a switch does not flicker.
+inline size_t SelectLod(const std::vector<MeshLod>& lods, size_t current, float pixelsPerUnit, float thresholdPixels)
+{
+	current = std::min(current, lods.size() - 1);
+	while (current + 1 < lods.size() && lods[current + 1].error * pixelsPerUnit <= thresholdPixels * LOD_HYSTERESIS)
+		current++;
+	while (current > 0 && lods[current].error * pixelsPerUnit > thresholdPixels)
+		current--;
+	return current;
+}
@@ -0,0 +1,110 @@
+// Vertex formats of a mesh: Vertex on the CPU and in the mesh cache, and the compact layouts it can be
+// uploaded in
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Vertex formats a mesh can be uploaded in, Vertex itself stays the full precision format on the CPU
+enum class VertexLayout { Full, Compact, Quantized, Count };
+
+const char* const VERTEX_LAYOUT_NAMES[] = { "full", "compact", "quantized" };
+
+// 20 bytes: float position, octahedral normal in 2 x snorm16, half float texture coordinates
+struct CompactVertex
+{
+	glm::vec3	position;
+	int16_t		normal[2];
+	uint16_t	textureCoords[2];
+};
+
+// 16 bytes: position in unorm16 relative to the mesh bounds (w unused), octahedral normal in
+// 2 x snorm16, texture coordinates in unorm16 relative to their range in the mesh
+struct QuantizedVertex
+{
+	uint16_t	position[4];
+	int16_t		normal[2];
+	uint16_t	textureCoords[2];
+};
+
+struct Vertex
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 textureCoords;
+
+	static uint32_t GetStride(VertexLayout layout)
+	{
+		switch (layout)
+		{
+		case VertexLayout::Compact:		return sizeof(CompactVertex);
+		case VertexLayout::Quantized:	return sizeof(QuantizedVertex);
+		default:						return sizeof(Vertex);
+		}
+	}
+
+	static VkVertexInputBindingDescription GetBindingDescription(VertexLayout layout = VertexLayout::Full)
+	{
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = GetStride(layout);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return bindingDescription;
+	}
+
+	// The shader reads every layout through the same inputs, the formats do the unpacking and the
+	// rest is undone with the specialization constant and push constants set up in CreateGraphicsPipeline
+	static std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescription(VertexLayout layout = VertexLayout::Full)
+	{
+		std::array<VkVertexInputAttributeDescription, 3> result{};
+
+		VkVertexInputAttributeDescription positionAttribute{};
+		positionAttribute.binding	= 0;
+		positionAttribute.location	= 0;
+		positionAttribute.format	= VK_FORMAT_R32G32B32_SFLOAT;
+		positionAttribute.offset	= offsetof(Vertex, position);
+
+		VkVertexInputAttributeDescription normalAttribute{};
+		normalAttribute.binding	= 0;
+		normalAttribute.location = 1;
+		normalAttribute.format	= VK_FORMAT_R32G32B32_SFLOAT;
+		normalAttribute.offset	= offsetof(Vertex, normal);
+
+		VkVertexInputAttributeDescription textureCoordAttribute{};
+		textureCoordAttribute.binding	= 0;
+		textureCoordAttribute.location	= 2;
+		textureCoordAttribute.format	= VK_FORMAT_R32G32_SFLOAT;
+		textureCoordAttribute.offset	= offsetof(Vertex, textureCoords);
+
+		if (layout == VertexLayout::Compact)
+		{
+			positionAttribute.offset		= offsetof(CompactVertex, position);
+			normalAttribute.format			= VK_FORMAT_R16G16_SNORM;
+			normalAttribute.offset			= offsetof(CompactVertex, normal);
+			textureCoordAttribute.format	= VK_FORMAT_R16G16_SFLOAT;
+			textureCoordAttribute.offset	= offsetof(CompactVertex, textureCoords);
+		}
+		else if (layout == VertexLayout::Quantized)
+		{
+			positionAttribute.format		= VK_FORMAT_R16G16B16A16_UNORM;
+			positionAttribute.offset		= offsetof(QuantizedVertex, position);
+			normalAttribute.format			= VK_FORMAT_R16G16_SNORM;
+			normalAttribute.offset			= offsetof(QuantizedVertex, normal);
+			textureCoordAttribute.format	= VK_FORMAT_R16G16_UNORM;
+			textureCoordAttribute.offset	= offsetof(QuantizedVertex, textureCoords);
+		}
+
+		result[0] = positionAttribute;
+		result[1] = normalAttribute;
+		result[2] = textureCoordAttribute;
+		return result;
+	}
+
+	bool operator==(const Vertex& other) const {
+		return position == other.position && normal == other.normal && textureCoords == other.textureCoords;
+	}
+};
@@ -5,17 +5,46 @@
 #define GLM_FORCE_RADIANS
 #define STB_IMAGE_IMPLEMENTATION
 #define TINYOBJLOADER_IMPLEMENTATION
-#define GLM_ENABLE_EXPERIMENTAL
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include <GLFW/glfw3.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtx/hash.hpp>
+
+// stb_image allocates through these so a decode can write its image into memory it does not own, see StbiOutput
+void* StbiMalloc(size_t size);
+void* StbiRealloc(void* pointer, size_t size);
+void StbiFree(void* pointer);
+#define STBI_MALLOC(size)			StbiMalloc(size)
+#define STBI_REALLOC(pointer, size)	StbiRealloc(pointer, size)
+#define STBI_FREE(pointer)			StbiFree(pointer)
 
 #include "stb/stb_image.h"
 #include "tol/tiny_obj_loader.h"
 
+#include "Vertex.h"
+#include "FlatIndexMap.h"
+#include "MeshCache.h"
+#include "objparallel.h"
+#include "meshopt.h"
+#include "ktx2.h"
+#include "bcn.h"
+#include "texbake.h"
+#include "json.h"
+
 
 #include <iostream>
 #include <vector>
@@ -25,10 +54,33 @@
 #include <set>
 #include <array>
 #include <chrono>
+#include <map>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cmath>
+#include <cctype>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <filesystem>
+#include <limits>
+#include <thread>
+#include <future>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 
 constexpr uint32_t WIDTH	= 800;
 constexpr uint32_t HEIGHT	= 800;
 constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+constexpr uint32_t TIMESTAMPS_PER_FRAME = 3; // frame start, scene pass done, overlay pass done
+constexpr uint32_t OVERLAY_MAX_VERTICES = 65536;
+constexpr uint32_t CULLING_GROUP_SIZE = 64; // local_size_x of cull.comp
+constexpr float CAMERA_FOV_DEGREES = 45.0f; // vertical
+constexpr float CAMERA_NEAR = 0.1f;
+constexpr float CAMERA_FAR = 100.0f;
 size_t currentFrame = 0;
 
 const std::vector<const char*> g_ValidationLayers = {
@@ -40,7 +92,7 @@ const std::vector<const char*> g_DeviceExtensions = {
 };
 
 #ifdef NDEBUG
-constexpr bool enableValidationLayers = false;
+constexpr bool g_EnableValidationLayers = false;
 #else
 constexpr bool g_EnableValidationLayers = true;
 #endif // NDEBUG
@@ -60,53 +112,6 @@ struct SwapchainSupportDetails {
 	std::vector<VkPresentModeKHR> presentModes;
 };
 
-struct Vertex
-{
-	glm::vec3 position;
-	glm::vec3 normal;
-	glm::vec2 textureCoords;
-
-	static VkVertexInputBindingDescription GetBindingDescription()
-	{
-		VkVertexInputBindingDescription bindingDescription{};
-		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		return bindingDescription;
-	}
-
-	static std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescription()
-	{
-		std::array<VkVertexInputAttributeDescription, 3> result{};
-
-		VkVertexInputAttributeDescription positionAttribute{};
-		positionAttribute.binding	= 0;
-		positionAttribute.location	= 0;
-		positionAttribute.format	= VK_FORMAT_R32G32B32_SFLOAT;
-		positionAttribute.offset	= offsetof(Vertex, position);
-		result[0] = positionAttribute;
-
-		VkVertexInputAttributeDescription normalAttribute{};
-		normalAttribute.binding	= 0;
-		normalAttribute.location = 1;
-		normalAttribute.format	= VK_FORMAT_R32G32B32_SFLOAT;
-		normalAttribute.offset	= offsetof(Vertex, normal);
-		result[1] = normalAttribute;
-
-		VkVertexInputAttributeDescription textureCoordAttribute{};
-		textureCoordAttribute.binding	= 0;
-		textureCoordAttribute.location	= 2;
-		textureCoordAttribute.format	= VK_FORMAT_R32G32_SFLOAT;
-		textureCoordAttribute.offset	= offsetof(Vertex, textureCoords);
-		result[2] = textureCoordAttribute;
-		return result;
-	}
-
-	bool operator==(const Vertex& other) const {
-		return position == other.position && normal == other.normal && textureCoords == other.textureCoords;
-	}
-};
-
 struct Camera
 {
 	glm::vec3 position	= glm::vec3(2.0f, 2.0f, 2.0f);
@@ -123,16 +128,6 @@ struct Light
 	alignas(16) glm::vec3 color		= glm::vec3(1.0f, 1.0f, 1.0f);
 };
 
-namespace std {
-	template<> struct hash<Vertex> {
-		size_t operator()(Vertex const& vertex) const {
-			return ((hash<glm::vec3>()(vertex.position) ^
-				(hash<glm::vec3>()(vertex.normal) << 1)) >> 1) ^
-				(hash<glm::vec2>()(vertex.textureCoords) << 1);
-		}
-	};
-}
-
 struct UniformBufferObject
 {
 	glm::mat4 model;
@@ -140,995 +135,4601 @@ struct UniformBufferObject
 	glm::mat4 projection;
 };
 
+// Push constants of cull.comp, everything in the mesh's object space so meshlet bounds are used as stored
+struct MeshletCullingConstants
+{
+	glm::vec4	frustum[6];		// planes with unit normals pointing inside
+	glm::vec4	cameraPosition;
+	uint32_t	firstMeshlet = 0;	// of the current LOD
+	uint32_t	meshletCount = 0;
+};
+
+// Push constants of mipgen.comp, one pass writes up to MIP_LEVELS_PER_PASS levels below sourceSize
+struct MipGenerationConstants
+{
+	glm::ivec2	sourceSize;
+	uint32_t	levelCount	= 0;
+	uint32_t	srgb		= 0;
+};
+
+constexpr uint32_t MIP_LEVELS_PER_PASS	= 6;
+constexpr uint32_t MIP_GENERATION_TILE	= 64;	// source texels per workgroup along each axis, 1 << MIP_LEVELS_PER_PASS
+
+// Texture streaming, see Application::UpdateTextureStreaming
+constexpr uint32_t		NO_FEEDBACK					= 0xffffffff;
+constexpr uint32_t		STREAMING_FEEDBACK_SLOTS	= 4096;			// textures that can be streamed
+constexpr uint32_t		STREAMING_TAIL_EXTENT		= 128;			// levels this size and smaller are always resident
+constexpr VkDeviceSize	STREAMING_UPLOAD_BYTES		= 32ull << 20;	// streamed in per frame, unless a single level is larger
+
+// Fragment shader push constants of one material batch, placed after MeshPushConstants. Streamed
+// textures report the mip level they were sampled at into the feedback buffer, see basic.frag.
+struct MaterialPushConstants
+{
+	uint32_t	feedbackSlots[2]	= { NO_FEEDBACK, NO_FEEDBACK };	// diffuse, specular
+	uint32_t	residentLevels[2]	= { 0, 0 };						// level of the full chain the bound image starts at
+	uint32_t	feedbackPixel[2]	= { 0, 0 };						// the pixel of every 8x8 block that reports
+};
+
+// Bindless textures, see Application::CreateBindlessTextures. Texture indices double as feedback slots.
+constexpr uint32_t BINDLESS_TEXTURE_CAPACITY	= STREAMING_FEEDBACK_SLOTS;	// unless the device allows fewer
+constexpr uint32_t BINDLESS_MATERIAL_CAPACITY	= 4096;
+constexpr uint32_t BINDLESS_PROXY_MATERIAL		= BINDLESS_MATERIAL_CAPACITY - 1;
+
+// Material table entry of bindless textures, laid out like struct Material in basic.frag (std430)
+struct BindlessMaterial
+{
+	uint32_t	textures[2]			= { 0, 0 };						// diffuse, specular, into the texture array
+	uint32_t	feedbackSlots[2]	= { NO_FEEDBACK, NO_FEEDBACK };
+	uint32_t	mipLevels[2]		= { 1, 1 };						// of the full chains
+};
+
+inline MeshletCullingConstants MakeMeshletCulling(const UniformBufferObject& ubo, glm::vec3 cameraPosition, uint32_t firstMeshlet, uint32_t meshletCount)
+{
+	// Gribb and Hartmann: the clip volume planes are sums and differences of the rows of the
+	// combined matrix. Vulkan's depth range is 0 to 1, so the near plane is the third row alone.
+	glm::mat4 clip = ubo.projection * ubo.view * ubo.model;
+	auto row = [&](int i) { return glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]); };
+	glm::vec4 planes[6] = { row(3) + row(0), row(3) - row(0), row(3) + row(1), row(3) - row(1), row(2), row(3) - row(2) };
+
+	MeshletCullingConstants constants;
+	for (int i = 0; i < 6; i++)
+		constants.frustum[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+	constants.cameraPosition	= glm::inverse(ubo.model) * glm::vec4(cameraPosition, 1.0f);
+	constants.firstMeshlet		= firstMeshlet;
+	constants.meshletCount		= meshletCount;
+	return constants;
+}
+
 std::vector<Vertex> g_Vertices;
-std::unordered_map<Vertex, uint32_t> g_UniqueVertices{};
 std::vector<uint32_t> g_Indices;
 
 const std::string MODEL_PATH = "models/backpack.obj";
 const std::string TEXTURE_PATH = "textures/diffuse.jpg";
 const std::string SPEC_TEXTURE_PATH = "textures/specular.jpg";
 
+using Clock = std::chrono::high_resolution_clock;
 
+inline double ElapsedMs(Clock::time_point start, Clock::time_point end = Clock::now())
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
 
+// Options parsed from the command line, see ParseLaunchOptions
+struct LaunchOptions
+{
+	bool		benchmark				= false;
+	uint32_t	benchmarkWarmupFrames	= 60;
+	uint32_t	benchmarkFrames			= 1000;
+	std::string	benchmarkOutput			= "benchmark.json";
+	std::string	benchmarkBaseline;
+	double		regressionThreshold		= 0.10;
+	bool		trackHostAllocations	= false;
+	bool		pooledHostAllocations	= false;
+	double		stutterMultiple			= 2.0;
+	size_t		stutterLogFrames		= 30;
+	std::string	stutterLog				= "stutter.log";
+	bool		showHud					= false;
+	bool		headless				= false;
+	std::string	assetReport;
+	bool		optimizeOverdraw		= false;
+	VertexLayout	vertexLayout		= VertexLayout::Quantized;
+	bool		meshletCulling			= true;
+	float		lodThresholdPixels		= 1.0f;
+	bool		syncLoad				= false;
+	std::string	bakeTextures;			// directory, see Application::RunTextureBake
+	std::string	bakeFormat				= "bc7";
+	std::string	bakeFilter				= "kaiser";
+	std::string	mipGenerator			= "compute";	// or "blit", see Application::GenerateMipmaps
+	bool		textureStreaming		= true;
+	uint32_t	textureBudgetMiB		= 256;			// streamed textures, see Application::UpdateTextureStreaming
+	bool		bindless				= true;			// see Application::CreateBindlessTextures
+	std::string	textureCache			= "texture_cache";	// directory, empty to disable, see Application::DecodeTexture
+	uint32_t	textureCacheBudgetMiB	= 1024;			// see Application::PruneTextureCache
+	bool		verbose					= false;		// reports what loading and baking did
+};
 
-// Proxy function that finds the real CreateDebugUtilsMessengerEXT function 
-VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger) {
-	auto func = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
-	if (func != nullptr) {
-		return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
-	}
-	else {
-		return VK_ERROR_EXTENSION_NOT_PRESENT;
+LaunchOptions g_LaunchOptions;
+
+void ParseLaunchOptions(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--benchmark")
+			g_LaunchOptions.benchmark = true;
+		else if (arg == "--benchmark-frames" && hasValue)
+			g_LaunchOptions.benchmarkFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (arg == "--benchmark-warmup" && hasValue)
+			g_LaunchOptions.benchmarkWarmupFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (arg == "--benchmark-output" && hasValue)
+			g_LaunchOptions.benchmarkOutput = argv[++i];
+		else if (arg == "--benchmark-baseline" && hasValue)
+			g_LaunchOptions.benchmarkBaseline = argv[++i];
+		else if (arg == "--regression-threshold" && hasValue)
+			g_LaunchOptions.regressionThreshold = std::stod(argv[++i]) / 100.0;
+		else if (arg == "--track-host-allocations")
+			g_LaunchOptions.trackHostAllocations = true;
+		else if (arg == "--pooled-host-allocations")
+			g_LaunchOptions.trackHostAllocations = g_LaunchOptions.pooledHostAllocations = true;
+		else if (arg == "--stutter-multiple" && hasValue)
+			g_LaunchOptions.stutterMultiple = std::stod(argv[++i]);
+		else if (arg == "--stutter-log-frames" && hasValue)
+			g_LaunchOptions.stutterLogFrames = std::stoul(argv[++i]);
+		else if (arg == "--stutter-log" && hasValue)
+			g_LaunchOptions.stutterLog = argv[++i];
+		else if (arg == "--verbose")
+			g_LaunchOptions.verbose = true;
+		else if (arg == "--hud")
+			g_LaunchOptions.showHud = true;
+		else if (arg == "--headless")
+			g_LaunchOptions.headless = true;
+		else if (arg == "--asset-report" && hasValue)
+			g_LaunchOptions.assetReport = argv[++i];
+		else if (arg == "--optimize-overdraw")
+			g_LaunchOptions.optimizeOverdraw = true;
+		else if (arg == "--no-meshlet-culling")
+			g_LaunchOptions.meshletCulling = false;
+		else if (arg == "--lod-threshold" && hasValue)
+			g_LaunchOptions.lodThresholdPixels = std::stof(argv[++i]);
+		else if (arg == "--sync-load")
+			g_LaunchOptions.syncLoad = true;
+		else if (arg == "--bake-textures" && hasValue)
+			g_LaunchOptions.bakeTextures = argv[++i];
+		else if (arg == "--bake-format" && hasValue)
+			g_LaunchOptions.bakeFormat = argv[++i];
+		else if (arg == "--bake-filter" && hasValue)
+			g_LaunchOptions.bakeFilter = argv[++i];
+		else if (arg == "--no-texture-streaming")
+			g_LaunchOptions.textureStreaming = false;
+		else if (arg == "--no-bindless")
+			g_LaunchOptions.bindless = false;
+		else if (arg == "--texture-cache" && hasValue)
+			g_LaunchOptions.textureCache = argv[++i];
+		else if (arg == "--no-texture-cache")
+			g_LaunchOptions.textureCache.clear();
+		else if (arg == "--texture-cache-budget" && hasValue)
+			g_LaunchOptions.textureCacheBudgetMiB = std::stoul(argv[++i]);
+		else if (arg == "--texture-budget" && hasValue)
+			g_LaunchOptions.textureBudgetMiB = std::stoul(argv[++i]);
+		else if (arg == "--mip-generator" && hasValue)
+		{
+			g_LaunchOptions.mipGenerator = argv[++i];
+			if (g_LaunchOptions.mipGenerator != "compute" && g_LaunchOptions.mipGenerator != "blit")
+				throw std::runtime_error("unknown mip generator: " + g_LaunchOptions.mipGenerator);
+		}
+		else if (arg == "--vertex-layout" && hasValue)
+		{
+			std::string name = argv[++i];
+			auto found = std::find(std::begin(VERTEX_LAYOUT_NAMES), std::end(VERTEX_LAYOUT_NAMES), name);
+			if (found == std::end(VERTEX_LAYOUT_NAMES))
+				throw std::runtime_error("unknown vertex layout: " + name);
+			g_LaunchOptions.vertexLayout = static_cast<VertexLayout>(found - std::begin(VERTEX_LAYOUT_NAMES));
+		}
+		else
+			throw std::runtime_error("unknown or incomplete argument: " + arg);
 	}
 }
 
-// Proxy function that finds the real DestroyDebugUtilsMessengerEXT function 
-void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator) {
-	auto func = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
-	if (func != nullptr) {
-		func(instance, debugMessenger, pAllocator);
-	}
+// Peak resident set size of the process in bytes
+uint64_t GetPeakHostMemoryBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return static_cast<uint64_t>(counters.PeakWorkingSetSize);
+	return 0;
+#else
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // ru_maxrss is reported in kilobytes
+#endif
 }
 
-class Application
+struct FrameStatistics
+{
+	double p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0, mean = 0.0;
+};
+
+// Nearest-rank percentiles over a set of millisecond samples
+FrameStatistics ComputeFrameStatistics(std::vector<double> samples)
+{
+	FrameStatistics stats{};
+	if (samples.empty()) return stats;
+
+	std::sort(samples.begin(), samples.end());
+	auto percentile = [&](double p) {
+		size_t rank = static_cast<size_t>(std::ceil(p * samples.size()));
+		return samples[std::min(samples.size() - 1, rank > 0 ? rank - 1 : 0)];
+	};
+
+	stats.p50 = percentile(0.50);
+	stats.p95 = percentile(0.95);
+	stats.p99 = percentile(0.99);
+	stats.max = samples.back();
+
+	double sum = 0.0;
+	for (double sample : samples) sum += sample;
+	stats.mean = sum / samples.size();
+	return stats;
+}
+
+// Records how long a scope took into a named list of timings
+class ScopedTimer
 {
 public:
-	void Run()
-	{
-		InitWindow();
-		InitVulkan();
-		MainLoop();
-		Cleanup();
-	}
+	ScopedTimer(std::vector<std::pair<std::string, double>>& sink, std::string name)
+		: m_Sink(sink), m_Name(std::move(name)), m_Start(Clock::now()) {}
+
+	~ScopedTimer() { m_Sink.emplace_back(m_Name, ElapsedMs(m_Start)); }
+
 private:
+	std::vector<std::pair<std::string, double>>&	m_Sink;
+	std::string										m_Name;
+	Clock::time_point								m_Start;
+};
 
-	void InitWindow()
+// Everything measured by a --benchmark run
+struct BenchmarkReport
+{
+	std::string									deviceName;
+	double										timeToFirstFrameMs = 0.0;
+	double										timeToModelMs = 0.0;	// until the model replaced the proxy
+	std::vector<std::pair<std::string, double>>	initStages;
+	std::vector<std::pair<std::string, double>>	assetLoads;
+	std::vector<std::pair<std::string, double>>	meshStatistics;	// counts that follow from the options of the run, not compared
+	std::vector<std::pair<std::string, double>>	meshTimings;
+	std::vector<double>							frameIntervalsMs, cpuFrameMs, gpuFrameMs;
+	uint64_t									peakHostMemoryBytes = 0, peakDeviceMemoryBytes = 0;
+	uint64_t									stutterCount = 0;
+
+	// Flat list of the metrics that are compared against a baseline, lower is better for all of them.
+	// The mesh statistics are left out: a run with other options has other counts, not a regression.
+	std::map<std::string, double> Metrics() const
 	{
-		glfwInit();
-		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-		//glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-			
-		m_Window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", NULL, NULL);
-		glfwSetInputMode(m_Window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-		
-		glfwSetWindowUserPointer(m_Window, this);
-		glfwSetCursorPosCallback(m_Window, MouseCallback);
-		glfwSetFramebufferSizeCallback(m_Window, FramebufferResizeCallback);
-	}
+		std::map<std::string, double> metrics;
+		double initTotal = 0.0, assetTotal = 0.0;
+		for (const auto& stage : initStages) initTotal += stage.second;
+		for (const auto& asset : assetLoads) assetTotal += asset.second;
+
+		metrics["time_to_first_frame_ms"]	= timeToFirstFrameMs;
+		metrics["time_to_model_ms"]			= timeToModelMs;
+		metrics["init_total_ms"]			= initTotal;
+		metrics["asset_load_total_ms"]		= assetTotal;
+
+		auto addStatistics = [&](const std::string& name, const std::vector<double>& samples) {
+			FrameStatistics stats = ComputeFrameStatistics(samples);
+			metrics[name + ".p50"] = stats.p50;
+			metrics[name + ".p95"] = stats.p95;
+			metrics[name + ".p99"] = stats.p99;
+			metrics[name + ".max"] = stats.max;
+		};
+		addStatistics("frame_time_ms", frameIntervalsMs);
+		addStatistics("cpu_frame_ms", cpuFrameMs);
+		if (!gpuFrameMs.empty()) addStatistics("gpu_frame_ms", gpuFrameMs);
 
-	static void MouseCallback(GLFWwindow* window, double x, double y)
-	{
-		auto app = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
-		app->ProcessMouseMovement(x, y);
-	}
+		for (const auto& timing : meshTimings)
+			metrics["mesh." + timing.first] = timing.second;
 
-	static void FramebufferResizeCallback(GLFWwindow* window, int width, int height)
-	{
-		auto app = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
-		app->m_FramebufferResized = true;
+		metrics["memory.peak_host_bytes"]	= static_cast<double>(peakHostMemoryBytes);
+		metrics["memory.peak_device_bytes"] = static_cast<double>(peakDeviceMemoryBytes);
+		return metrics;
 	}
 
-	void InitVulkan()
+	void WriteJson(const std::string& path) const
 	{
-		CreateInstance();
-		SetupDebugMessenger();
-		CreateSurface();
-		PickPhysicalDevice();
-		CreateLogicalDevice();
-		CreateSwapchain();
-		CreateImageViews();
-		CreateRenderPass();
-		CreateDescriptiorSetLayout();
-		CreateGraphicsPipeline();
-		CreateCommandPool();
-		CreateColorResources();
-		CreateDepthResources();
-		CreateFrameBuffers();
-		CreateTextureImage();
-		CreateTextureImageView();
-		CreateTextureSampler();
-		LoadModel();
-		CreateVertexBuffer();
-		CreateIndexBuffer();
-		CreateUniformBuffers();
-		CreateDescriptorPool();
-		CreateDescriptorSets();
-		//CreateCommandBuffers();
-		AllocateCommandBuffers();
-		CreateSemaphores();
-	}
+		std::ofstream file(path);
+		if (!file.is_open()) throw std::runtime_error("failed to open " + path + " for writing");
+
+		auto writeTimings = [&](const char* name, const std::vector<std::pair<std::string, double>>& timings) {
+			file << "  \"" << name << "\": {";
+			for (size_t i = 0; i < timings.size(); i++)
+				file << (i ? ", " : "") << "\"" << json::Escape(timings[i].first) << "\": " << timings[i].second;
+			file << "},\n";
+		};
+		auto writeStatistics = [&](const char* name, const std::vector<double>& samples, bool last) {
+			FrameStatistics stats = ComputeFrameStatistics(samples);
+			file << "  \"" << name << "\": {\"p50\": " << stats.p50 << ", \"p95\": " << stats.p95 << ", \"p99\": " << stats.p99
+				<< ", \"max\": " << stats.max << ", \"mean\": " << stats.mean << ", \"samples\": " << samples.size() << "}" << (last ? "\n" : ",\n");
+		};
 
-	// Fill VkDebugUtilsMessengerCreateInfoEXT struct
-	void PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo)
-	{
-		createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-		createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-		createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
-		createInfo.pfnUserCallback = DebugCallbak;
-		createInfo.pUserData = nullptr;
+		auto metrics = Metrics();
+		file << std::fixed << std::setprecision(4);
+		file << "{\n";
+		file << "  \"device\": \"" << json::Escape(deviceName) << "\",\n";
+		file << "  \"time_to_first_frame_ms\": " << timeToFirstFrameMs << ",\n";
+		file << "  \"time_to_model_ms\": " << timeToModelMs << ",\n";
+		file << "  \"init_total_ms\": " << metrics["init_total_ms"] << ",\n";
+		file << "  \"asset_load_total_ms\": " << metrics["asset_load_total_ms"] << ",\n";
+		writeTimings("init_stages_ms", initStages);
+		writeTimings("asset_loads_ms", assetLoads);
+		std::vector<std::pair<std::string, double>> mesh = meshStatistics;
+		mesh.insert(mesh.end(), meshTimings.begin(), meshTimings.end());
+		writeTimings("mesh", mesh);
+		file << "  \"stutter_count\": " << stutterCount << ",\n";
+		file << "  \"memory\": {\"peak_host_bytes\": " << peakHostMemoryBytes << ", \"peak_device_bytes\": " << peakDeviceMemoryBytes << "},\n";
+		writeStatistics("frame_time_ms", frameIntervalsMs, false);
+		writeStatistics("cpu_frame_ms", cpuFrameMs, gpuFrameMs.empty());
+		if (!gpuFrameMs.empty()) writeStatistics("gpu_frame_ms", gpuFrameMs, true);
+		file << "}\n";
 	}
 
-	// Create VKInstance
-	void CreateInstance()
+	// Returns false if any metric is worse than the baseline by more than threshold (0.1 = 10%). The
+	// mesh statistics are printed next to the baseline's for reference only.
+	bool CompareWithBaseline(const std::string& path, double threshold) const
 	{
-		if (g_EnableValidationLayers && !CheckValidationLayerSupport())
-		{
-			throw std::runtime_error("validation layer requested, but not available!");
-		}
-
-		VkApplicationInfo appInfo{};
-		appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-		appInfo.pApplicationName = "Hello Triangle";
-		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.pEngineName = "NONE";
-		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.apiVersion = VK_API_VERSION_1_0;
-
-		VkInstanceCreateInfo createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-		createInfo.pApplicationInfo = &appInfo;
-		auto extensions = GetRequiredExtensions();
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
-		createInfo.ppEnabledExtensionNames = extensions.data();
+		auto baseline = json::ReadNumbers(path);
+		bool passed = true;
+
+		auto print = [&](const char* verdict, const std::string& name, double before, double value) {
+			double change = (value - before) / before;
+			std::cout << verdict << std::left << std::setw(28) << name
+				<< std::right << std::setw(14) << before << " -> " << std::setw(14) << value
+				<< " (" << std::showpos << change * 100.0 << std::noshowpos << "%)" << std::endl;
+		};
 
-		VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
-		if (g_EnableValidationLayers)
+		std::cout << "Comparing against baseline " << path << " (threshold " << threshold * 100.0 << "%)" << std::endl;
+		for (const auto& [name, value] : Metrics())
 		{
-			createInfo.enabledLayerCount = static_cast<uint32_t>(g_ValidationLayers.size());
-			createInfo.ppEnabledLayerNames = g_ValidationLayers.data();
-			PopulateDebugMessengerCreateInfo(debugCreateInfo);
-			createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*)&debugCreateInfo;
+			auto it = baseline.find(name);
+			if (it == baseline.end() || it->second <= 0.0) continue;
+
+			bool regressed = (value - it->second) / it->second > threshold;
+			passed = passed && !regressed;
+			print(regressed ? "  REGRESSION " : "  ok         ", name, it->second, value);
 		}
-		else
+		for (const auto& [name, value] : meshStatistics)
 		{
-			createInfo.enabledLayerCount = 0;
-			createInfo.pNext = nullptr;
-		}
-
-		if (vkCreateInstance(&createInfo, nullptr, &m_Instance) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create instance!");
+			auto it = baseline.find("mesh." + name);
+			if (it != baseline.end() && it->second > 0.0)
+				print("  info       ", "mesh." + name, it->second, value);
 		}
+		return passed;
 	}
+};
 
-	// Create windows surface
-	void CreateSurface()
-	{
-		if (glfwCreateWindowSurface(m_Instance, m_Window, nullptr, &m_Surface) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create window surface!");
-		}
-	}
 
-	// Setup callback for debug layers
-	void SetupDebugMessenger()
-	{
-		if (!g_EnableValidationLayers) return;
-		VkDebugUtilsMessengerCreateInfoEXT createInfo{};
-		PopulateDebugMessengerCreateInfo(createInfo);
-		
-		if (CreateDebugUtilsMessengerEXT(m_Instance, &createInfo, nullptr, &m_DebugMessenger) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to set up debug messenger!");
-		}
-	}
+// Stages an asset goes through on its way from disk to the GPU, see AssetLoadProfiler
+enum class AssetStage { FileIO, Decode, Dedup, Optimize, StagingCopy, GpuUpload, MipGeneration, Compress, Count };
 
-	// Check validation layers against requireed g_ValidationLayers list
-	bool CheckValidationLayerSupport()
+const char* const ASSET_STAGE_NAMES[] = { "file_io", "decode", "dedup", "optimize", "staging_copy", "gpu_upload", "mip_generation", "compress" };
+
+/*
+Per asset breakdown of load time. Every stage records how long it took and how many bytes it
+produced: the file size for file_io, the decoded data for decode and dedup, and the bytes moved
+for staging_copy, gpu_upload and mip_generation. Stages hit more than once are accumulated.
+*/
+class AssetLoadProfiler
+{
+public:
+	struct StageTiming
 	{
-		uint32_t layerCount;
-		vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+		double		ms		= 0.0;
+		uint64_t	bytes	= 0;
+	};
 
-		std::vector<VkLayerProperties> availableLayers(layerCount);
-		vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
+	struct Asset
+	{
+		std::string	name;
+		std::array<StageTiming, static_cast<size_t>(AssetStage::Count)>	stages{};
 
-		for (auto& layerName : g_ValidationLayers)
+		double TotalMs() const
 		{
-			bool layerFound = false;
-
-			for (const auto& layerProperties : availableLayers )
-				if (strcmp(layerProperties.layerName, layerName) == 0)
-				{
-					layerFound = true;
-					break;
-				}
-			
-			if (!layerFound) return false;
+			double total = 0.0;
+			for (const auto& stage : stages) total += stage.ms;
+			return total;
 		}
-		return true;
-	}
+	};
 
-	// Set member variable m_Device to preferred device, based on IsDeviceSuitable
-	void PickPhysicalDevice()
+	// Times one stage of an asset, bytes can be set once they are known
+	class Scope
 	{
-		uint32_t physicalDeviceCount;
-		vkEnumeratePhysicalDevices(m_Instance, &physicalDeviceCount, nullptr);
+	public:
+		Scope(AssetLoadProfiler& profiler, std::string asset, AssetStage stage, uint64_t bytes = 0)
+			: bytes(bytes), m_Profiler(profiler), m_Asset(std::move(asset)), m_Stage(stage), m_Start(Clock::now()) {}
 
-		if (physicalDeviceCount == 0)
-		{
-			throw std::runtime_error("No device with Vulkan support found");
-		}
+		~Scope() { m_Profiler.Add(m_Asset, m_Stage, ElapsedMs(m_Start), bytes); }
 
-		std::vector<VkPhysicalDevice> physicalDevices(physicalDeviceCount);
-		vkEnumeratePhysicalDevices(m_Instance, &physicalDeviceCount, physicalDevices.data());
+		uint64_t bytes;
 
-		for (const auto& device : physicalDevices)
-		{
-			if (IsDeviceSuitable(device))
-			{
-				m_PhysicalDevice = device;
-				m_MsaaSamples = GetMaximumSamples();
-				break;
-			}
-		}
+	private:
+		AssetLoadProfiler&	m_Profiler;
+		std::string			m_Asset;
+		AssetStage			m_Stage;
+		Clock::time_point	m_Start;
+	};
 
-		if (m_PhysicalDevice == VK_NULL_HANDLE)
+	void Add(const std::string& asset, AssetStage stage, double ms, uint64_t bytes)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto it = std::find_if(m_Assets.begin(), m_Assets.end(), [&](const Asset& a) { return a.name == asset; });
+		if (it == m_Assets.end())
 		{
-			throw std::runtime_error("No suitatble device found");
+			m_Assets.push_back({ asset });
+			it = m_Assets.end() - 1;
 		}
+
+		StageTiming& timing = it->stages[static_cast<size_t>(stage)];
+		timing.ms		+= ms;
+		timing.bytes	+= bytes;
 	}
 
-	// Return Queue families supported by device
-	QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device)
+	const std::vector<Asset>& Assets() const { return m_Assets; }
+
+	double TotalMs() const
 	{
-		QueueFamilyIndices indices;
-		uint32_t queueFamilyCount = 0;
-		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+		double total = 0.0;
+		for (const auto& asset : m_Assets) total += asset.TotalMs();
+		return total;
+	}
 
-		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+	void PrintTable(std::ostream& out) const
+	{
+		const double MiB = 1024.0 * 1024.0;
+		out << std::fixed << std::setprecision(3);
+		out << "Asset load profile, " << TotalMs() << " ms total" << std::endl;
+		out << "  " << std::left << std::setw(32) << "asset" << std::setw(16) << "stage" << std::right
+			<< std::setw(12) << "ms" << std::setw(12) << "MiB" << std::setw(12) << "MiB/s" << std::endl;
 
-		int i = 0;
-		for (const auto& queueFamily : queueFamilies)
+		for (const auto& asset : m_Assets)
 		{
-			if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
-				indices.graphicsFamily = i;
-
-			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_Surface, &presentSupport);
+			for (size_t stage = 0; stage < asset.stages.size(); stage++)
+			{
+				const StageTiming& timing = asset.stages[stage];
+				if (timing.ms == 0.0 && timing.bytes == 0) continue;
 
-			if (presentSupport) {
-				indices.presentFamily = i;
+				double throughput = timing.ms > 0.0 ? timing.bytes / MiB / (timing.ms / 1000.0) : 0.0;
+				out << "  " << std::left << std::setw(32) << asset.name << std::setw(16) << ASSET_STAGE_NAMES[stage] << std::right
+					<< std::setw(12) << timing.ms << std::setw(12) << timing.bytes / MiB << std::setw(12) << throughput << std::endl;
 			}
+		}
+	}
 
-			if (indices.IsComplete())
+	void WriteJson(const std::string& path) const
+	{
+		std::ofstream file(path);
+		if (!file.is_open()) throw std::runtime_error("failed to open " + path + " for writing");
+
+		file << std::fixed << std::setprecision(4);
+		file << "{\n";
+		file << "  \"total_ms\": " << TotalMs() << ",\n";
+		file << "  \"assets\": [\n";
+		for (size_t i = 0; i < m_Assets.size(); i++)
+		{
+			const Asset& asset = m_Assets[i];
+			file << "    {\"name\": \"" << json::Escape(asset.name) << "\", \"total_ms\": " << asset.TotalMs() << ", \"stages\": {";
+			for (size_t stage = 0; stage < asset.stages.size(); stage++)
 			{
-				break;
+				file << (stage ? ", " : "") << "\"" << ASSET_STAGE_NAMES[stage] << "\": {\"ms\": " << asset.stages[stage].ms
+					<< ", \"bytes\": " << asset.stages[stage].bytes << "}";
 			}
-			i++;
+			file << "}}" << (i + 1 < m_Assets.size() ? ",\n" : "\n");
 		}
-
-		return indices;
+		file << "  ]\n";
+		file << "}\n";
 	}
 
-	// Return capabilities, surface formats, present modes for device
-	SwapchainSupportDetails QuerySwapchainSupport(VkPhysicalDevice device) {
-		SwapchainSupportDetails details;
+private:
+	std::mutex			m_Mutex;
+	std::vector<Asset>	m_Assets;
+};
 
-		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, m_Surface, &details.capabilities);
-		uint32_t formatCount;
-		vkGetPhysicalDeviceSurfaceFormatsKHR(device, m_Surface, &formatCount, nullptr);
+AssetLoadProfiler g_AssetProfiler;
+
+/*
+Memory the next stb_image decode on this thread writes its image into. stb_image has no option for
+that, but it allocates the image it returns like any other buffer, so the first allocation of the
+image size (plus the byte the JPEG decoder writes past the end) is given this memory instead of the
+heap. The size match is only a guess that relies on the order in which stb_image allocates, and it
+is only safe because the caller checks the pointer stbi_load_from_memory returns: if the guess lands
+on a scratch buffer, or the decoder converts into a new buffer at the end, the image comes back
+somewhere else and the caller copies it as before. The decoder reads back what it wrote, so only
+host cached memory is handed out this way.
+*/
+struct StbiOutput
+{
+	void*	memory	= nullptr;
+	size_t	size	= 0;		// bytes, at least the image size plus STBI_OUTPUT_SLACK
+	bool	taken	= false;	// handed out and not freed since
+};
 
-		if (formatCount != 0) {
-			details.formats.resize(formatCount);
-			vkGetPhysicalDeviceSurfaceFormatsKHR(device, m_Surface, &formatCount, details.formats.data());
-		}
+constexpr size_t STBI_OUTPUT_SLACK = 16;
 
-		uint32_t presentModeCount;
-		vkGetPhysicalDeviceSurfacePresentModesKHR(device, m_Surface, &presentModeCount, nullptr);
+thread_local StbiOutput t_StbiOutput;
 
-		if (presentModeCount != 0) {
-			details.presentModes.resize(presentModeCount);
-			vkGetPhysicalDeviceSurfacePresentModesKHR(device, m_Surface, &presentModeCount, details.presentModes.data());
-		}
+void* StbiMalloc(size_t size)
+{
+	StbiOutput& output = t_StbiOutput;
+	if (output.memory && !output.taken && size + STBI_OUTPUT_SLACK >= output.size && size <= output.size)
+	{
+		output.taken = true;
+		return output.memory;
+	}
+	return malloc(size);
+}
 
-		return details;
+void* StbiRealloc(void* pointer, size_t size)
+{
+	StbiOutput& output = t_StbiOutput;
+	if (!pointer || pointer != output.memory) return realloc(pointer, size);
+
+	// The output memory cannot grow, move the buffer to the heap
+	void* moved = malloc(size);
+	if (moved)
+	{
+		memcpy(moved, pointer, std::min(size, output.size));
+		output.taken = false;
 	}
+	return moved;
+}
 
-	/*
-	Choose properties for creating swap chains
-	*/
+void StbiFree(void* pointer)
+{
+	if (pointer && pointer == t_StbiOutput.memory)
+		t_StbiOutput.taken = false;
+	else
+		free(pointer);
+}
 
-	VkSurfaceFormatKHR ChooseSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
+// Host visible buffer feeding an upload, freed once the upload has completed
+struct StagingBuffer
+{
+	VkBuffer		buffer	= VK_NULL_HANDLE;
+	VkDeviceMemory	memory	= VK_NULL_HANDLE;
+	VkDeviceSize	size	= 0;
+};
+
+// RGBA8 pixels decoded by stb_image or read from the texture cache. They are either in the mapped
+// staging buffer, or on the heap and freed with stbi_image_free if staging.buffer is VK_NULL_HANDLE.
+struct DecodedImage
+{
+	stbi_uc*		pixels		= nullptr;
+	int				width		= 0;
+	int				height		= 0;
+	VkDeviceSize	size		= 0;
+	StagingBuffer	staging;
+	uint64_t		contentHash	= 0;	// HashBytes of the image file
+};
+
+/*
+Fixed set of threads running submitted jobs in the order they were submitted. Submit returns a
+future for the job's result, so the submitter only blocks where it actually needs the result and
+an exception thrown by the job is rethrown there. Jobs already submitted finish before the pool is
+destroyed.
+*/
+class WorkerPool
+{
+public:
+	explicit WorkerPool(unsigned int threads)
+	{
+		for (unsigned int i = 0; i < std::max(threads, 1u); i++)
+			m_Workers.emplace_back(&WorkerPool::Work, this);
+	}
+
+	~WorkerPool()
 	{
-		for (const auto& format : availableFormats)
 		{
-			if (format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR && format.format == VK_FORMAT_B8G8R8A8_SRGB)
-			{
-				return format;
-			}
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stopping = true;
 		}
-		
-		return availableFormats[0];
+		m_Wake.notify_all();
+		for (auto& worker : m_Workers) worker.join();
 	}
 
-	VkPresentModeKHR ChoosePresentMode(const std::vector<VkPresentModeKHR>& availableModes)
+	template<typename Function>
+	auto Submit(Function function) -> std::future<decltype(function())>
 	{
-		for (const auto& mode : availableModes)
+		auto job = std::make_shared<std::packaged_task<decltype(function())()>>(std::move(function));
+		auto result = job->get_future();
 		{
-			if (mode == VK_PRESENT_MODE_MAILBOX_KHR)
-				return mode;
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Jobs.push_back([job]() { (*job)(); });
 		}
-		return VK_PRESENT_MODE_FIFO_KHR;
+		m_Wake.notify_one();
+		return result;
 	}
 
-	VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capability)
+private:
+	void Work()
 	{
-		if (capability.currentExtent.width != UINT32_MAX)
+		for (;;)
 		{
-			return capability.currentExtent;
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_Wake.wait(lock, [this]() { return m_Stopping || !m_Jobs.empty(); });
+				if (m_Jobs.empty()) return;
+				job = std::move(m_Jobs.front());
+				m_Jobs.pop_front();
+			}
+			job();
 		}
-		int width, height;
-		glfwGetWindowSize(m_Window, &width, &height);
-		VkExtent2D actualExtent = { 
-			static_cast<uint32_t>(width),
-			static_cast<uint32_t>(height)
-		};
-
-		actualExtent.width = std::max(capability.minImageExtent.width, std::min(capability.maxImageExtent.width, actualExtent.width));
-		actualExtent.width = std::max(capability.minImageExtent.height, std::min(capability.maxImageExtent.width, actualExtent.width));
-
-		return actualExtent;
 	}
 
-	// Report suitability of device
-	bool IsDeviceSuitable(VkPhysicalDevice device) {
-		VkPhysicalDeviceProperties prop;
-		vkGetPhysicalDeviceProperties(device, &prop);
-		VkPhysicalDeviceFeatures feat;
-		vkGetPhysicalDeviceFeatures(device, &feat);
-		QueueFamilyIndices indices = FindQueueFamilies(device);
-		VkPhysicalDeviceFeatures supportedFeatures;
-		vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
-
-		bool extensionsSupported = CheckDeviceExtensionSupport(device);
-
-		bool swapChainAdequate = false;
-		if (extensionsSupported) {
-			SwapchainSupportDetails swapChainSupport = QuerySwapchainSupport(device);
-			swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
-		}
+	std::mutex							m_Mutex;
+	std::condition_variable				m_Wake;
+	std::deque<std::function<void()>>	m_Jobs;
+	std::vector<std::thread>			m_Workers;
+	bool								m_Stopping = false;
+};
 
-		return indices.IsComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
-	}
+// Sampled image loaded from a file, shared by every material that uses a file with the same contents
+// the same way
+struct Texture
+{
+	VkImage			image			= VK_NULL_HANDLE;
+	VkDeviceMemory	memory			= VK_NULL_HANDLE;
+	VkImageView		view			= VK_NULL_HANDLE;
+	VkSampler		sampler			= VK_NULL_HANDLE;	// shared by all textures with as many mip levels
+	VkFormat		format			= VK_FORMAT_R8G8B8A8_SRGB;
+	uint32_t		width			= 0;
+	uint32_t		height			= 0;
+	uint32_t		mipLevels		= 1;
+	uint32_t		residentLevel	= 0;	// first level of the chain the image holds, above 0 while streamed
+	VkDeviceSize	size			= 0;	// texel data of the resident levels
+};
 
-	// Check for required device extension support
-	bool CheckDeviceExtensionSupport(VkPhysicalDevice device) {
-		uint32_t extensionCount;
-		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+/*
+Read-only memory mapping of a whole file. Pages are only read from disk when touched, so data
+can be copied from the file straight into a staging buffer without an intermediate copy.
+*/
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { Close(); }
 
-		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+	// Returns false if the file does not exist, is empty or cannot be mapped
+	bool Open(const std::string& path)
+	{
+		Close();
+#ifdef _WIN32
+		m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (m_File == INVALID_HANDLE_VALUE) return false;
 
-		std::set<std::string> requiredExtensions(g_DeviceExtensions.begin(), g_DeviceExtensions.end());
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0) { Close(); return false; }
+		m_Size = static_cast<uint64_t>(size.QuadPart);
 
-		for (const auto& extension : availableExtensions) {
-			requiredExtensions.erase(extension.extensionName);
-		}
+		m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!m_Mapping) { Close(); return false; }
 
-		return requiredExtensions.empty();
+		m_Data = static_cast<const uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+		int file = open(path.c_str(), O_RDONLY);
+		if (file < 0) return false;
+
+		struct stat info{};
+		if (fstat(file, &info) != 0 || info.st_size == 0) { close(file); return false; }
+		m_Size = static_cast<uint64_t>(info.st_size);
+
+		void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, file, 0);
+		close(file);
+		m_Data = data == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(data);
+#endif
+		if (!m_Data) { Close(); return false; }
+		return true;
 	}
 
-	// Get required instance extensions from glfw, add debug extension if in debug mode
-	std::vector<const char*> GetRequiredExtensions()
+	void Close()
 	{
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
-
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-		std::vector<const char*> extensions = std::vector(glfwExtensions, glfwExtensions + glfwExtensionCount);
+#ifdef _WIN32
+		if (m_Data) UnmapViewOfFile(m_Data);
+		if (m_Mapping) CloseHandle(m_Mapping);
+		if (m_File != INVALID_HANDLE_VALUE) CloseHandle(m_File);
+		m_Mapping	= nullptr;
+		m_File		= INVALID_HANDLE_VALUE;
+#else
+		if (m_Data) munmap(const_cast<uint8_t*>(m_Data), m_Size);
+#endif
+		m_Data = nullptr;
+		m_Size = 0;
+	}
 
-		if (g_EnableValidationLayers)
-		{
-			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-		}
+	bool			IsOpen() const	{ return m_Data != nullptr; }
+	const uint8_t*	Data() const	{ return m_Data; }
+	uint64_t		Size() const	{ return m_Size; }
 
-		return extensions;
-	}
+private:
+#ifdef _WIN32
+	HANDLE			m_File		= INVALID_HANDLE_VALUE;
+	HANDLE			m_Mapping	= nullptr;
+#endif
+	const uint8_t*	m_Data		= nullptr;
+	uint64_t		m_Size		= 0;
+};
 
-	// Logical Device Creation
-	void CreateLogicalDevice()
+// 64-bit FNV-1a
+uint64_t HashBytes(const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < size; i++)
 	{
-		QueueFamilyIndices indices = FindQueueFamilies(m_PhysicalDevice);
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
 
-		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+// Vertex and index data ready for upload, pointing either into g_Vertices / g_Indices or into a mapped mesh cache
+struct MeshView
+{
+	const Vertex*	vertices	= nullptr;
+	const uint32_t*	indices		= nullptr;
+	uint64_t		vertexCount	= 0;
+	uint64_t		indexCount	= 0;
+	std::vector<MeshLod>	lods;	// at least LOD 0, which covers the indices before the others
+	std::vector<MeshBatch>	batches;
+	std::vector<MeshMaterial>	materials;
+};
 
-		float queuePriority = 1.0f;
-		for (uint32_t queueFamily : uniqueQueueFamilies) {
-			VkDeviceQueueCreateInfo queueCreateInfo{};
-			queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-			queueCreateInfo.queueFamilyIndex = queueFamily;
-			queueCreateInfo.queueCount = 1;
-			queueCreateInfo.pQueuePriorities = &queuePriority;
-			queueCreateInfos.push_back(queueCreateInfo);
+// Box over the bounds with outward facing, counter clockwise triangles and four vertices per face so
+// each face keeps its own normal
+inline void BuildBoundsBox(glm::vec3 boundsMin, glm::vec3 boundsMax, std::vector<Vertex>& vertices, std::vector<uint16_t>& indices)
+{
+	const glm::vec2 corners[4] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+	vertices.clear();
+	indices.clear();
+	for (int axis = 0; axis < 3; axis++)
+	{
+		// u x v points along axis, walking the corners backwards turns the face around
+		int u = (axis + 1) % 3, v = (axis + 2) % 3;
+		for (int side = 0; side < 2; side++)
+		{
+			uint16_t first = static_cast<uint16_t>(vertices.size());
+			for (int c = 0; c < 4; c++)
+			{
+				glm::vec2 corner = corners[side ? c : 3 - c];
+				Vertex vertex{};
+				vertex.position[axis]	= side ? boundsMax[axis] : boundsMin[axis];
+				vertex.position[u]		= corner.x > 0.0f ? boundsMax[u] : boundsMin[u];
+				vertex.position[v]		= corner.y > 0.0f ? boundsMax[v] : boundsMin[v];
+				vertex.normal			= glm::vec3(0.0f);
+				vertex.normal[axis]		= side ? 1.0f : -1.0f;
+				vertex.textureCoords	= corner;
+				vertices.push_back(vertex);
+			}
+			for (uint16_t index : { 0, 1, 2, 0, 2, 3 })
+				indices.push_back(static_cast<uint16_t>(first + index));
 		}
+	}
+}
 
-		VkPhysicalDeviceFeatures deviceFeatures{};
-		deviceFeatures.samplerAnisotropy = VK_TRUE;
-		deviceFeatures.sampleRateShading = VK_TRUE;
+// Vertex shader push constants that turn the stored attributes back into object space values,
+// identity except for QuantizedVertex
+struct MeshPushConstants
+{
+	glm::vec4 positionOffset		= glm::vec4(0.0f);
+	glm::vec4 positionScale			= glm::vec4(1.0f);
+	glm::vec4 textureCoordTransform	= glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);	// offset in xy, scale in zw
+};
 
-		VkDeviceCreateInfo deviceCreateInfo{};
-		deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+// IEEE half float, rounded to nearest even
+inline uint16_t FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+	uint32_t mantissa = bits & 0x7fffff;
+
+	if (((bits >> 23) & 0xff) == 0xff)
+		return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+	if (exponent >= 31)
+		return static_cast<uint16_t>(sign | 0x7c00);
+	if (exponent <= 0)
+	{
+		// Subnormal or zero, shift the implicit one in and round on what falls off
+		if (exponent < -10) return static_cast<uint16_t>(sign);
+		mantissa |= 0x800000;
+		uint32_t shift = static_cast<uint32_t>(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1))) half++;
+		return static_cast<uint16_t>(sign | half);
+	}
 
-		deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
-		deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
+	uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;	// may carry into the exponent, up to infinity
+	return static_cast<uint16_t>(sign | half);
+}
 
-		deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(g_DeviceExtensions.size());
-		deviceCreateInfo.ppEnabledExtensionNames = g_DeviceExtensions.data();
+inline float HalfToFloat(uint16_t half)
+{
+	uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1f;
+	uint32_t mantissa = half & 0x3ff;
+	uint32_t bits;
+	if (exponent == 0x1f)
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	else if (exponent != 0)
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	else if (mantissa == 0)
+		bits = sign;
+	else
+	{
+		float value = std::ldexp(static_cast<float>(mantissa), -24);
+		return sign ? -value : value;
+	}
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
 
-		deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
-		if (g_EnableValidationLayers) {
-			deviceCreateInfo.enabledLayerCount = static_cast<uint32_t>(g_ValidationLayers.size());
-			deviceCreateInfo.ppEnabledLayerNames = g_ValidationLayers.data();
-		}
-		else {
-			deviceCreateInfo.enabledLayerCount = 0;
-		}
+inline int16_t FloatToSnorm16(float value) { return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f)); }
+inline float Snorm16ToFloat(int16_t value) { return std::max(value / 32767.0f, -1.0f); }
+inline uint16_t FloatToUnorm16(float value) { return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f)); }
+inline float Unorm16ToFloat(uint16_t value) { return value / 65535.0f; }
 
-		if (vkCreateDevice(m_PhysicalDevice, &deviceCreateInfo, nullptr, &m_Device) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create logical device!");
-		}
+// Same decode as OctDecode in basic.vert
+inline glm::vec3 OctDecode(glm::vec2 encoded)
+{
+	glm::vec3 normal(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+	float t = std::max(-normal.z, 0.0f);
+	normal.x += normal.x >= 0.0f ? -t : t;
+	normal.y += normal.y >= 0.0f ? -t : t;
+	return glm::normalize(normal);
+}
 
-		vkGetDeviceQueue(m_Device, indices.graphicsFamily.value(), 0, &m_GraphicsQueue);
-		vkGetDeviceQueue(m_Device, indices.presentFamily.value(), 0, &m_PresentQueue);
+// Octahedral normal encoding into 2 x snorm16. Of the four roundings around the exact point the one
+// that decodes closest to the input is kept, which about halves the worst case error.
+inline void OctEncode(glm::vec3 normal, int16_t encoded[2])
+{
+	float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	if (length <= 0.0f)
+	{
+		encoded[0] = encoded[1] = 0;
+		return;
+	}
+	normal /= length;
+	glm::vec2 projected(normal.x, normal.y);
+	if (normal.z < 0.0f)
+	{
+		projected.x = (1.0f - std::abs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f);
+		projected.y = (1.0f - std::abs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f);
 	}
 
-	void RecreateSwapchain()
+	glm::vec3 target = glm::normalize(normal);
+	float bestDot = -2.0f;
+	for (int i = 0; i < 4; i++)
 	{
-		int width = 0, height = 0;
-		glfwGetFramebufferSize(m_Window, &width, &height);
-		while (width == 0 || height == 0) {
-			glfwGetFramebufferSize(m_Window, &width, &height);
-			glfwWaitEvents();
+		float x = (i & 1) ? std::ceil(projected.x * 32767.0f) : std::floor(projected.x * 32767.0f);
+		float y = (i & 2) ? std::ceil(projected.y * 32767.0f) : std::floor(projected.y * 32767.0f);
+		int16_t candidate[2] = { FloatToSnorm16(x / 32767.0f), FloatToSnorm16(y / 32767.0f) };
+		float dot = glm::dot(OctDecode({ Snorm16ToFloat(candidate[0]), Snorm16ToFloat(candidate[1]) }), target);
+		if (dot > bestDot)
+		{
+			bestDot		= dot;
+			encoded[0]	= candidate[0];
+			encoded[1]	= candidate[1];
 		}
+	}
+}
 
-		vkDeviceWaitIdle(m_Device);
-
-		CleanupSwapchain();
+// Vertices of one mesh in the layout they are uploaded in, with the largest difference between
+// what the shader decodes and the source
+struct PackedVertices
+{
+	std::vector<uint8_t>	data;
+	MeshPushConstants		decode;
+	float					maxPositionError		= 0.0f;	// object space units
+	float					maxNormalErrorDegrees	= 0.0f;
+	float					maxTextureCoordError	= 0.0f;
+};
 
-		CreateSwapchain();
-		CreateImageViews();
-		CreateRenderPass();
-		CreateGraphicsPipeline();
-		CreateColorResources();
-		CreateDepthResources();
-		CreateFrameBuffers();
-		CreateUniformBuffers();
-		CreateDescriptorPool();
-		CreateDescriptorSets();
-		//CreateCommandBuffers();
-		AllocateCommandBuffers();
+inline PackedVertices PackVertices(VertexLayout layout, const Vertex* vertices, size_t count, glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+	PackedVertices packed;
+	packed.data.resize(count * Vertex::GetStride(layout));
+	if (layout == VertexLayout::Full)
+	{
+		if (count > 0) memcpy(packed.data.data(), vertices, packed.data.size());
+		return packed;
 	}
 
-	void CreateSwapchain()
+	glm::vec2 textureCoordMin(std::numeric_limits<float>::max()), textureCoordMax(std::numeric_limits<float>::lowest());
+	for (size_t i = 0; i < count; i++)
 	{
-		SwapchainSupportDetails swapChainDetails = QuerySwapchainSupport(m_PhysicalDevice);
-
-		m_SurfaceFormat = ChooseSurfaceFormat(swapChainDetails.formats);
-		m_SwapchainFormat = m_SurfaceFormat.format;
-		VkPresentModeKHR presentMode = ChoosePresentMode(swapChainDetails.presentModes);
-		m_Extent = ChooseSwapExtent(swapChainDetails.capabilities);
-
-		uint32_t imageCount = swapChainDetails.capabilities.minImageCount + 1;
-
-		if (swapChainDetails.capabilities.maxImageCount > 0 and swapChainDetails.capabilities.maxImageCount < imageCount)
-			imageCount = swapChainDetails.capabilities.maxImageCount;
+		textureCoordMin = glm::min(textureCoordMin, vertices[i].textureCoords);
+		textureCoordMax = glm::max(textureCoordMax, vertices[i].textureCoords);
+	}
 
-		VkSwapchainCreateInfoKHR swapchainCreateInfo{};
-		swapchainCreateInfo.sType			= VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-		swapchainCreateInfo.surface			= m_Surface;
-		swapchainCreateInfo.minImageCount	= imageCount;
-		swapchainCreateInfo.imageFormat		= m_SurfaceFormat.format;
-		swapchainCreateInfo.imageColorSpace = m_SurfaceFormat.colorSpace;
-		swapchainCreateInfo.presentMode		= presentMode;
-		swapchainCreateInfo.imageExtent		= m_Extent;
+	glm::vec3 positionExtent = boundsMax - boundsMin;
+	glm::vec2 textureCoordExtent = textureCoordMax - textureCoordMin;
+	if (layout == VertexLayout::Quantized && count > 0)
+	{
+		packed.decode.positionOffset		= glm::vec4(boundsMin, 0.0f);
+		packed.decode.positionScale			= glm::vec4(positionExtent, 0.0f);
+		packed.decode.textureCoordTransform	= glm::vec4(textureCoordMin, textureCoordExtent);
+	}
 
-		swapchainCreateInfo.imageArrayLayers = 1;
-		swapchainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	auto quantize = [](float value, float minimum, float extent) {
+		return FloatToUnorm16(extent > 0.0f ? (value - minimum) / extent : 0.0f);
+	};
 
-		QueueFamilyIndices indices = FindQueueFamilies(m_PhysicalDevice);
-		uint32_t qFamilyIndices[] = { indices.graphicsFamily.value() , indices.presentFamily.value() };
+	for (size_t i = 0; i < count; i++)
+	{
+		const Vertex& vertex = vertices[i];
+		glm::vec3 position;
+		glm::vec2 textureCoords;
+		int16_t normal[2];
+		OctEncode(vertex.normal, normal);
 
-		if (indices.presentFamily != indices.graphicsFamily)
+		if (layout == VertexLayout::Compact)
 		{
-			swapchainCreateInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT ;
-			swapchainCreateInfo.queueFamilyIndexCount = 2;
-			swapchainCreateInfo.pQueueFamilyIndices = qFamilyIndices;
+			CompactVertex& out = reinterpret_cast<CompactVertex*>(packed.data.data())[i];
+			out.position			= vertex.position;
+			out.normal[0]			= normal[0];
+			out.normal[1]			= normal[1];
+			out.textureCoords[0]	= FloatToHalf(vertex.textureCoords.x);
+			out.textureCoords[1]	= FloatToHalf(vertex.textureCoords.y);
+
+			position		= out.position;
+			textureCoords	= { HalfToFloat(out.textureCoords[0]), HalfToFloat(out.textureCoords[1]) };
 		}
 		else
 		{
-			swapchainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			QuantizedVertex& out = reinterpret_cast<QuantizedVertex*>(packed.data.data())[i];
+			for (int k = 0; k < 3; k++)
+				out.position[k] = quantize(vertex.position[k], boundsMin[k], positionExtent[k]);
+			out.position[3]			= 0;
+			out.normal[0]			= normal[0];
+			out.normal[1]			= normal[1];
+			out.textureCoords[0]	= quantize(vertex.textureCoords.x, textureCoordMin.x, textureCoordExtent.x);
+			out.textureCoords[1]	= quantize(vertex.textureCoords.y, textureCoordMin.y, textureCoordExtent.y);
+
+			for (int k = 0; k < 3; k++)
+				position[k] = Unorm16ToFloat(out.position[k]) * positionExtent[k] + boundsMin[k];
+			textureCoords = glm::vec2(Unorm16ToFloat(out.textureCoords[0]), Unorm16ToFloat(out.textureCoords[1])) * textureCoordExtent + textureCoordMin;
 		}
 
-		swapchainCreateInfo.preTransform = swapChainDetails.capabilities.currentTransform;
-		swapchainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+		glm::vec3 positionError = glm::abs(position - vertex.position);
+		glm::vec2 textureCoordError = glm::abs(textureCoords - vertex.textureCoords);
+		packed.maxPositionError		= std::max(packed.maxPositionError, std::max(positionError.x, std::max(positionError.y, positionError.z)));
+		packed.maxTextureCoordError	= std::max(packed.maxTextureCoordError, std::max(textureCoordError.x, textureCoordError.y));
+		if (glm::dot(vertex.normal, vertex.normal) > 0.0f)
+		{
+			// atan2 of the cross and dot products keeps its precision for angles this small, acos of a float dot does not
+			glm::vec3 decoded = OctDecode({ Snorm16ToFloat(normal[0]), Snorm16ToFloat(normal[1]) });
+			double angle = std::atan2(static_cast<double>(glm::length(glm::cross(decoded, vertex.normal))), static_cast<double>(glm::dot(decoded, vertex.normal)));
+			packed.maxNormalErrorDegrees = std::max(packed.maxNormalErrorDegrees, static_cast<float>(angle * 180.0 / 3.14159265358979323846));
+		}
+	}
+	return packed;
+}
 
-		swapchainCreateInfo.clipped = VK_TRUE;
+// Indices of one mesh in the type they are uploaded in, with the draws that cover them. When the mesh
+// had to be split, vertexRemap lists the source vertex of every vertex the indices now refer to.
+struct PackedIndices
+{
+	std::vector<uint8_t>	data;
+	VkIndexType				type	= VK_INDEX_TYPE_UINT16;
+	std::vector<IndexRange>	ranges;
+	std::vector<uint32_t>	vertexRemap;
+};
 
-		swapchainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+// Index ranges and meshlets that draw one batch
+struct BatchDraws
+{
+	uint32_t	firstRange		= 0;
+	uint32_t	rangeCount		= 0;
+	uint32_t	firstMeshlet	= 0;
+	uint32_t	meshletCount	= 0;
+};
+
+// Packs indices into 16 bits. Meshes with more vertices than that addresses are cut into runs of
+// triangles that use at most 65536 distinct vertices; each run gets its own copy of those vertices,
+// numbered in order of first use, and is drawn with the first of them as vertex offset. Only vertices
+// shared across a cut are duplicated, unless the triangles have no locality at all; if the duplicates
+// would take more memory than the smaller indices save the mesh keeps 32 bit indices, one range per batch.
+// A range never spans two batches, so each batch is drawn by a run of whole ranges.
+inline PackedIndices PackIndices(const uint32_t* indices, size_t indexCount, size_t vertexCount, size_t vertexStride, const std::vector<MeshBatch>& batches)
+{
+	const uint32_t addressable = std::numeric_limits<uint16_t>::max() + 1u;
+	PackedIndices packed;
+	packed.data.resize(indexCount * sizeof(uint16_t));
+	uint16_t* output = reinterpret_cast<uint16_t*>(packed.data.data());
+
+	auto batchRanges = [&]() {
+		std::vector<IndexRange> ranges;
+		for (const MeshBatch& batch : batches)
+			ranges.push_back({ batch.firstIndex, batch.indexCount, 0 });
+		if (ranges.empty()) ranges.push_back({ 0, static_cast<uint32_t>(indexCount), 0 });
+		return ranges;
+	};
+
+	if (vertexCount <= addressable)
+	{
+		for (size_t i = 0; i < indexCount; i++)
+			output[i] = static_cast<uint16_t>(indices[i]);
+		packed.ranges = batchRanges();
+		return packed;
+	}
+
+	// localIndex is only valid for vertices whose chunkOf is the current chunk
+	const uint32_t none = std::numeric_limits<uint32_t>::max();
+	std::vector<uint32_t> chunkOf(vertexCount, none), localIndex(vertexCount);
+	packed.vertexRemap.reserve(vertexCount + vertexCount / 16);
+	uint32_t chunk = 0, chunkStart = 0, chunkVertices = 0;
+	packed.ranges.push_back({ 0, 0, 0 });
+	size_t nextBatch = 1;
 
-		if (vkCreateSwapchainKHR(m_Device, &swapchainCreateInfo, nullptr, &m_Swapchain) != VK_SUCCESS)
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		uint32_t newVertices = 0;
+		for (size_t k = 0; k < 3; k++)
+			newVertices += chunkOf[indices[i + k]] != chunk;
+		bool batchStart = nextBatch < batches.size() && i == batches[nextBatch].firstIndex;
+		if (batchStart) nextBatch++;
+		if (chunkVertices + newVertices > addressable || (batchStart && i > 0))
 		{
-			throw std::runtime_error("Swapchain Creation failed");
+			packed.ranges.back().indexCount = static_cast<uint32_t>(i) - packed.ranges.back().firstIndex;
+			packed.ranges.push_back({ static_cast<uint32_t>(i), 0, static_cast<int32_t>(packed.vertexRemap.size()) });
+			chunk++;
+			chunkStart		= static_cast<uint32_t>(packed.vertexRemap.size());
+			chunkVertices	= 0;
 		}
 
-		vkGetSwapchainImagesKHR(m_Device, m_Swapchain, &imageCount, nullptr);
-		m_SwapchainImages.resize(imageCount);
-		vkGetSwapchainImagesKHR(m_Device, m_Swapchain, &imageCount, m_SwapchainImages.data());
+		for (size_t k = 0; k < 3; k++)
+		{
+			uint32_t vertex = indices[i + k];
+			if (chunkOf[vertex] != chunk)
+			{
+				chunkOf[vertex]		= chunk;
+				localIndex[vertex]	= chunkVertices++;
+				packed.vertexRemap.push_back(vertex);
+			}
+			output[i + k] = static_cast<uint16_t>(localIndex[vertex]);
+		}
 	}
+	packed.ranges.back().indexCount = static_cast<uint32_t>(indexCount) - packed.ranges.back().firstIndex;
 
-	void CreateImageViews()
+	if (packed.vertexRemap.size() > vertexCount && (packed.vertexRemap.size() - vertexCount) * vertexStride > indexCount * (sizeof(uint32_t) - sizeof(uint16_t)))
 	{
-		m_SwapchainImageViews.resize(m_SwapchainImages.size());
+		packed.type = VK_INDEX_TYPE_UINT32;
+		packed.ranges = batchRanges();
+		packed.vertexRemap.clear();
+		packed.data.resize(indexCount * sizeof(uint32_t));
+		memcpy(packed.data.data(), indices, packed.data.size());
+	}
+	return packed;
+}
 
-		for (size_t i = 0; i < m_SwapchainImageViews.size(); i++)
+
+
+/*
+Host allocation tracker plugged into every Vulkan call through VkAllocationCallbacks.
+Allocations are counted per VkSystemAllocationScope and per call site, where a call site is the
+stack of HostAllocationTracker::Tag names active on the allocating thread. Small allocations
+can optionally be served from size-class pools instead of the C heap.
+*/
+class HostAllocationTracker
+{
+public:
+	static constexpr uint32_t	SCOPE_COUNT				= VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+	static constexpr uint64_t	STEADY_STATE_FRAME		= 10; // ignore lazy driver setup during the first frames
+	static constexpr size_t		POOL_CHUNK_SIZE			= 64 * 1024;
+	static constexpr size_t		POOL_SIZE_CLASSES[]		= { 64, 128, 256, 512, 1024, 2048 };
+
+	struct Counters
+	{
+		uint64_t allocations = 0, reallocations = 0, frees = 0;
+		uint64_t bytesAllocated = 0, liveBytes = 0, peakLiveBytes = 0;
+	};
+
+	struct Site
+	{
+		std::string name;
+		Counters	counters;
+		uint64_t	allocationsAtFrameStart = 0, bytesAtFrameStart = 0;
+		uint64_t	steadyStateAllocations = 0, steadyStateBytes = 0, maxAllocationsPerFrame = 0;
+	};
+
+	// Tags every allocation made on this thread while alive, tags nest ("DrawFrame > vkQueueSubmit")
+	class Tag
+	{
+	public:
+		Tag(HostAllocationTracker& tracker, const char* name) : m_Tracker(tracker), m_PreviousSite(t_CurrentSite)
 		{
-			m_SwapchainImageViews[i] = CreateImageView(m_SwapchainImages[i], VK_FORMAT_B8G8R8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+			if (!m_Tracker.m_Enabled) return;
+			std::string siteName = m_PreviousSite == 0 ? name : m_Tracker.SiteName(m_PreviousSite) + " > " + name;
+			t_CurrentSite = m_Tracker.FindOrAddSite(siteName);
 		}
+
+		~Tag() { t_CurrentSite = m_PreviousSite; }
+
+	private:
+		HostAllocationTracker&	m_Tracker;
+		uint32_t				m_PreviousSite;
+	};
+
+	HostAllocationTracker()
+	{
+		m_Sites.push_back({ "untagged" });
 	}
 
-	void CreateRenderPass()
+	~HostAllocationTracker()
 	{
-		VkAttachmentDescription colorAttachment{};
-		colorAttachment.format			= m_SwapchainFormat;
-		colorAttachment.samples			= m_MsaaSamples;
+		for (void* chunk : m_PoolChunks) std::free(chunk);
+	}
 
-		colorAttachment.loadOp			= VK_ATTACHMENT_LOAD_OP_CLEAR;
-		colorAttachment.storeOp			= VK_ATTACHMENT_STORE_OP_STORE;
-		colorAttachment.stencilLoadOp	= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		colorAttachment.stencilStoreOp	= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	void Enable(bool pooled)
+	{
+		m_Enabled	= true;
+		m_Pooled	= pooled;
+
+		m_Callbacks.pUserData				= this;
+		m_Callbacks.pfnAllocation			= Allocate;
+		m_Callbacks.pfnReallocation			= Reallocate;
+		m_Callbacks.pfnFree					= Free;
+		m_Callbacks.pfnInternalAllocation	= InternalAllocation;
+		m_Callbacks.pfnInternalFree			= InternalFree;
+	}
 
-		colorAttachment.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachment.finalLayout		= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	// nullptr when tracking is disabled so the driver keeps using its own allocator
+	const VkAllocationCallbacks* Callbacks() const { return m_Enabled ? &m_Callbacks : nullptr; }
 
-		VkAttachmentDescription depthAttachment{};
-		depthAttachment.format	= findDepthFormat();
-		depthAttachment.samples = m_MsaaSamples;
+	// Accumulates how many allocations each call site made during the frame that just ended
+	void EndFrame()
+	{
+		if (!m_Enabled) return;
+		std::lock_guard<std::mutex> lock(m_Mutex);
 
-		depthAttachment.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
-		depthAttachment.finalLayout		= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		bool steadyState = ++m_FrameCount > STEADY_STATE_FRAME;
+		for (auto& site : m_Sites)
+		{
+			uint64_t frameAllocations	= site.counters.allocations + site.counters.reallocations - site.allocationsAtFrameStart;
+			uint64_t frameBytes			= site.counters.bytesAllocated - site.bytesAtFrameStart;
+			if (steadyState)
+			{
+				site.steadyStateAllocations	+= frameAllocations;
+				site.steadyStateBytes		+= frameBytes;
+				site.maxAllocationsPerFrame	= std::max(site.maxAllocationsPerFrame, frameAllocations);
+			}
+			site.allocationsAtFrameStart	= site.counters.allocations + site.counters.reallocations;
+			site.bytesAtFrameStart			= site.counters.bytesAllocated;
+		}
+	}
 
-		depthAttachment.loadOp			= VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depthAttachment.storeOp			= VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.stencilLoadOp	= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		depthAttachment.stencilStoreOp	= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	void PrintReport(std::ostream& out)
+	{
+		if (!m_Enabled) return;
+		std::lock_guard<std::mutex> lock(m_Mutex);
 
-		VkAttachmentDescription colorAttachmentResolve{};
-		colorAttachmentResolve.format = m_SwapchainFormat;
-		colorAttachmentResolve.samples = VK_SAMPLE_COUNT_1_BIT;
-		colorAttachmentResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		static const char* scopeNames[SCOPE_COUNT] = { "command", "object", "cache", "device", "instance" };
 
+		out << "Vulkan host allocations" << (m_Pooled ? " (pooled)" : "") << std::endl;
+		out << "  " << std::left << std::setw(12) << "scope" << std::right << std::setw(12) << "allocs" << std::setw(12) << "reallocs"
+			<< std::setw(14) << "bytes" << std::setw(14) << "peak live" << std::setw(12) << "internal" << std::endl;
+		for (uint32_t scope = 0; scope < SCOPE_COUNT; scope++)
+		{
+			const Counters& c = m_ScopeCounters[scope];
+			out << "  " << std::left << std::setw(12) << scopeNames[scope] << std::right << std::setw(12) << c.allocations << std::setw(12) << c.reallocations
+				<< std::setw(14) << c.bytesAllocated << std::setw(14) << c.peakLiveBytes << std::setw(12) << m_InternalBytes[scope] << std::endl;
+		}
 
-		VkAttachmentReference colorAttachmentRef{};
-		colorAttachmentRef.attachment	= 0;
-		colorAttachmentRef.layout		= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-		
-		VkAttachmentReference depthAttachmentRef{};
-		depthAttachmentRef.attachment	= 1;
-		depthAttachmentRef.layout		= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		std::vector<const Site*> sites;
+		for (const auto& site : m_Sites) sites.push_back(&site);
 
-		VkAttachmentReference colorAttachmentResolveRef{};
-		colorAttachmentResolveRef.attachment = 2;
-		colorAttachmentResolveRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		std::sort(sites.begin(), sites.end(), [](const Site* a, const Site* b) { return a->counters.allocations > b->counters.allocations; });
+		out << "  By call site:" << std::endl;
+		for (const Site* site : sites)
+		{
+			if (site->counters.allocations == 0) continue;
+			out << "    " << std::left << std::setw(52) << site->name << std::right << std::setw(10) << site->counters.allocations << " allocs "
+				<< std::setw(12) << site->counters.bytesAllocated << " bytes, peak live " << site->counters.peakLiveBytes << std::endl;
+		}
 
-		VkSubpassDescription subpass{};
-		subpass.pipelineBindPoint		= VK_PIPELINE_BIND_POINT_GRAPHICS;
-		
-		subpass.colorAttachmentCount	= 1;
-		subpass.pColorAttachments		= &colorAttachmentRef;
-		subpass.pDepthStencilAttachment = &depthAttachmentRef;
-		subpass.pResolveAttachments		= &colorAttachmentResolveRef;
+		uint64_t steadyFrames = m_FrameCount > STEADY_STATE_FRAME ? m_FrameCount - STEADY_STATE_FRAME : 0;
+		if (steadyFrames == 0) return;
 
-		VkSubpassDependency dependency{};
-		dependency.srcSubpass		= VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass		= 0;
-		dependency.srcStageMask		= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.srcAccessMask	= 0;
-		dependency.dstStageMask		= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.dstAccessMask	= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		
-		std::array<VkAttachmentDescription, 3> attachments = { colorAttachment, depthAttachment, colorAttachmentResolve };
-		VkRenderPassCreateInfo renderPass{};
-		renderPass.sType			= VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPass.attachmentCount	= static_cast<uint32_t>(attachments.size());
-		renderPass.pAttachments		= attachments.data();
-		renderPass.subpassCount		= 1;
-		renderPass.pSubpasses		= &subpass;
-		renderPass.dependencyCount	= 1;
-		renderPass.pDependencies	= &dependency;
+		std::sort(sites.begin(), sites.end(), [](const Site* a, const Site* b) { return a->steadyStateAllocations > b->steadyStateAllocations; });
+		out << "  Hottest call sites per frame (" << steadyFrames << " steady state frames):" << std::endl;
+		for (size_t i = 0; i < sites.size() && i < 10 && sites[i]->steadyStateAllocations > 0; i++)
+		{
+			out << "    " << std::left << std::setw(52) << sites[i]->name << std::right << std::fixed << std::setprecision(2)
+				<< std::setw(10) << static_cast<double>(sites[i]->steadyStateAllocations) / steadyFrames << " allocs/frame "
+				<< std::setw(12) << static_cast<double>(sites[i]->steadyStateBytes) / steadyFrames << " bytes/frame, max "
+				<< sites[i]->maxAllocationsPerFrame << std::endl;
+		}
+	}
 
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
-		clearValues[1].depthStencil = { 1.0f, 0 };
+private:
+	struct AllocationHeader
+	{
+		void*		raw;
+		size_t		size;
+		uint32_t	site;
+		uint8_t		scope;
+		uint8_t		sizeClass; // 0 for heap allocations, otherwise pool size class + 1
+	};
+
+	std::string SiteName(uint32_t site)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Sites[site].name;
+	}
 
+	uint32_t FindOrAddSite(const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto it = m_SiteLookup.find(name);
+		if (it != m_SiteLookup.end()) return it->second;
+
+		uint32_t index = static_cast<uint32_t>(m_Sites.size());
+		m_Sites.push_back({ name });
+		m_SiteLookup[name] = index;
+		return index;
+	}
 
-		if (vkCreateRenderPass(m_Device, &renderPass, nullptr, &m_RenderPass) != VK_SUCCESS)
+	// Called with m_Mutex held
+	void* AllocateRaw(size_t bytes, uint8_t& sizeClass)
+	{
+		sizeClass = 0;
+		if (m_Pooled)
 		{
-			throw std::runtime_error("Failed to create renderpass");
+			for (size_t i = 0; i < std::size(POOL_SIZE_CLASSES); i++)
+			{
+				if (bytes > POOL_SIZE_CLASSES[i]) continue;
+
+				auto& freeList = m_FreeLists[i];
+				if (freeList.empty())
+				{
+					char* chunk = static_cast<char*>(std::malloc(POOL_CHUNK_SIZE));
+					if (!chunk) return nullptr;
+					m_PoolChunks.push_back(chunk);
+					for (size_t offset = 0; offset + POOL_SIZE_CLASSES[i] <= POOL_CHUNK_SIZE; offset += POOL_SIZE_CLASSES[i])
+						freeList.push_back(chunk + offset);
+				}
+
+				void* block = freeList.back();
+				freeList.pop_back();
+				sizeClass = static_cast<uint8_t>(i + 1);
+				return block;
+			}
 		}
+		return std::malloc(bytes);
 	}
 
-	void CreateDescriptiorSetLayout()
+	void* TrackedAllocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
 	{
-		VkDescriptorSetLayoutBinding uboLayoutBinding{};
-		uboLayoutBinding.binding			= 0;
-		uboLayoutBinding.descriptorType		= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		uboLayoutBinding.descriptorCount	= 1;
-		uboLayoutBinding.stageFlags			= VK_SHADER_STAGE_VERTEX_BIT;
-		uboLayoutBinding.pImmutableSamplers = nullptr;
+		alignment = std::max(alignment, alignof(AllocationHeader));
+		size_t bytes = size + alignment - 1 + sizeof(AllocationHeader);
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		uint8_t sizeClass;
+		char* raw = static_cast<char*>(AllocateRaw(bytes, sizeClass));
+		if (!raw) return nullptr;
+
+		uintptr_t user = (reinterpret_cast<uintptr_t>(raw) + sizeof(AllocationHeader) + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+		AllocationHeader* header = reinterpret_cast<AllocationHeader*>(user) - 1;
+		header->raw			= raw;
+		header->size		= size;
+		header->site		= t_CurrentSite;
+		header->scope		= static_cast<uint8_t>(scope);
+		header->sizeClass	= sizeClass;
+
+		for (Counters* c : { &m_ScopeCounters[scope], &m_Sites[header->site].counters })
+		{
+			c->allocations++;
+			c->bytesAllocated	+= size;
+			c->liveBytes		+= size;
+			c->peakLiveBytes	= std::max(c->peakLiveBytes, c->liveBytes);
+		}
+		return reinterpret_cast<void*>(user);
+	}
 
-		VkDescriptorSetLayoutBinding samplerBinding{};
-		samplerBinding.binding				= 1;
-		samplerBinding.descriptorCount		= 1;
-		samplerBinding.descriptorType		= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		samplerBinding.stageFlags			= VK_SHADER_STAGE_FRAGMENT_BIT;
-		samplerBinding.pImmutableSamplers	= nullptr;
+	void TrackedFree(void* memory)
+	{
+		if (!memory) return;
+		AllocationHeader* header = static_cast<AllocationHeader*>(memory) - 1;
 
-		VkDescriptorSetLayoutBinding lightLayoutBinding{};
-		lightLayoutBinding.binding				= 2;
-		lightLayoutBinding.descriptorType		= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		lightLayoutBinding.descriptorCount		= 1;
-		lightLayoutBinding.stageFlags			= VK_SHADER_STAGE_FRAGMENT_BIT;
-		lightLayoutBinding.pImmutableSamplers	= nullptr;
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (Counters* c : { &m_ScopeCounters[header->scope], &m_Sites[header->site].counters })
+		{
+			c->frees++;
+			c->liveBytes -= header->size;
+		}
 
-		VkDescriptorSetLayoutBinding cameraLayoutBinding{};
-		cameraLayoutBinding.binding				= 3;
-		cameraLayoutBinding.descriptorType		= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		cameraLayoutBinding.descriptorCount		= 1;
-		cameraLayoutBinding.stageFlags			= VK_SHADER_STAGE_FRAGMENT_BIT;
-		cameraLayoutBinding.pImmutableSamplers	= nullptr;
+		if (header->sizeClass > 0)
+			m_FreeLists[header->sizeClass - 1].push_back(header->raw);
+		else
+			std::free(header->raw);
+	}
+
+	static void* VKAPI_CALL Allocate(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+	{
+		return static_cast<HostAllocationTracker*>(userData)->TrackedAllocate(size, alignment, scope);
+	}
 
-		VkDescriptorSetLayoutBinding specularSamplerBinding{};
-		specularSamplerBinding.binding				= 4;
-		specularSamplerBinding.descriptorCount		= 1;
-		specularSamplerBinding.descriptorType		= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		specularSamplerBinding.stageFlags			= VK_SHADER_STAGE_FRAGMENT_BIT;
-		specularSamplerBinding.pImmutableSamplers	= nullptr;
+	static void* VKAPI_CALL Reallocate(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+	{
+		auto tracker = static_cast<HostAllocationTracker*>(userData);
+		if (!original) return tracker->TrackedAllocate(size, alignment, scope);
+		if (size == 0)
+		{
+			tracker->TrackedFree(original);
+			return nullptr;
+		}
 
+		void* memory = tracker->TrackedAllocate(size, alignment, scope);
+		if (!memory) return nullptr;
 
-		std::array<VkDescriptorSetLayoutBinding, 5> bindings = { uboLayoutBinding, samplerBinding, lightLayoutBinding, cameraLayoutBinding, specularSamplerBinding };
+		AllocationHeader* header		= static_cast<AllocationHeader*>(original) - 1;
+		uint32_t originalSite			= header->site;
+		uint8_t originalScope			= header->scope;
+		std::memcpy(memory, original, std::min(size, header->size));
+		tracker->TrackedFree(original);
 
-		VkDescriptorSetLayoutCreateInfo layoutCreateInfo{};
-		layoutCreateInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layoutCreateInfo.bindingCount	= static_cast<uint32_t>(bindings.size());
-		layoutCreateInfo.pBindings		= bindings.data();
-		
-		if (vkCreateDescriptorSetLayout(m_Device, &layoutCreateInfo, nullptr, &m_DescriptorSetLayout) != VK_SUCCESS)
+		// Count the pair above as a single reallocation rather than an allocation and a free
+		std::lock_guard<std::mutex> lock(tracker->m_Mutex);
+		for (Counters* c : { &tracker->m_ScopeCounters[scope], &tracker->m_Sites[t_CurrentSite].counters })
 		{
-			throw std::runtime_error("Failed to create descriptor set layout.");
+			c->allocations--;
+			c->reallocations++;
 		}
+		tracker->m_ScopeCounters[originalScope].frees--;
+		tracker->m_Sites[originalSite].counters.frees--;
+		return memory;
+	}
 
+	static void VKAPI_CALL Free(void* userData, void* memory)
+	{
+		static_cast<HostAllocationTracker*>(userData)->TrackedFree(memory);
 	}
 
-	void CreateGraphicsPipeline()
+	static void VKAPI_CALL InternalAllocation(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope)
 	{
-		auto vertShaderCode = ReadFile("shaders/vert.spv");
-		auto fragShaderCode = ReadFile("shaders/frag.spv");
-		
-		VkShaderModule vertShaderModule = CreateShaderModule(vertShaderCode);
-		VkShaderModule fragShaderModule = CreateShaderModule(fragShaderCode);
+		auto tracker = static_cast<HostAllocationTracker*>(userData);
+		std::lock_guard<std::mutex> lock(tracker->m_Mutex);
+		tracker->m_InternalBytes[scope] += size;
+	}
 
-		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-		vertShaderStageInfo.sType	= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vertShaderStageInfo.stage	= VK_SHADER_STAGE_VERTEX_BIT;
-		vertShaderStageInfo.module	= vertShaderModule;
-		vertShaderStageInfo.pName	= "main";
+	static void VKAPI_CALL InternalFree(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope)
+	{
+		auto tracker = static_cast<HostAllocationTracker*>(userData);
+		std::lock_guard<std::mutex> lock(tracker->m_Mutex);
+		tracker->m_InternalBytes[scope] -= size;
+	}
 
-		VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-		fragShaderStageInfo.sType	= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		fragShaderStageInfo.stage	= VK_SHADER_STAGE_FRAGMENT_BIT;
-		fragShaderStageInfo.module	= fragShaderModule;
-		fragShaderStageInfo.pName	= "main";
+	inline static thread_local uint32_t					t_CurrentSite = 0;
 
-		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+	bool												m_Enabled = false, m_Pooled = false;
+	VkAllocationCallbacks								m_Callbacks{};
+	std::mutex											m_Mutex;
 
-		auto bindingInfo	= Vertex::GetBindingDescription();
-		auto attributeInfo	= Vertex::GetAttributeDescription();
-		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputInfo.vertexBindingDescriptionCount	= 1;
-		vertexInputInfo.pVertexBindingDescriptions		= &bindingInfo;
-		vertexInputInfo.vertexAttributeDescriptionCount = attributeInfo.size();
-		vertexInputInfo.pVertexAttributeDescriptions	= attributeInfo.data(); 
+	std::vector<Site>									m_Sites;
+	std::unordered_map<std::string, uint32_t>			m_SiteLookup;
+	std::array<Counters, SCOPE_COUNT>					m_ScopeCounters{};
+	std::array<int64_t, SCOPE_COUNT>					m_InternalBytes{};
+	uint64_t											m_FrameCount = 0;
 
-		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-		inputAssembly.primitiveRestartEnable = VK_FALSE;
+	std::array<std::vector<void*>, std::size(POOL_SIZE_CLASSES)>	m_FreeLists;
+	std::vector<void*>									m_PoolChunks;
+};
 
-		VkViewport viewport{};
-		viewport.x			= 0.0f;
-		viewport.y			= 0.0f;
-		viewport.width		= (float)m_Extent.width;
-		viewport.height		= (float)m_Extent.height;
-		viewport.minDepth	= 0.0f;
-		viewport.maxDepth	= 1.0f;
+HostAllocationTracker g_HostAllocations;
 
-		VkRect2D scissor{};
-		scissor.offset = { 0, 0 };
-		scissor.extent = m_Extent;
-		
-		VkPipelineViewportStateCreateInfo viewportState{};
-		viewportState.sType			= VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportState.viewportCount = 1;
-		viewportState.pViewports	= &viewport;
-		viewportState.scissorCount	= 1;
-		viewportState.pScissors		= &scissor;
+/*
+Lock-free log-scale histogram of durations with four buckets per octave, from 1us up to ~16s.
+Recorded from the render thread, safe to read from any thread.
+*/
+class DurationHistogram
+{
+public:
+	static constexpr uint32_t BUCKETS_PER_OCTAVE	= 4;
+	static constexpr uint32_t BUCKET_COUNT			= 24 * BUCKETS_PER_OCTAVE;
 
-		VkPipelineRasterizationStateCreateInfo rasterizer{};
-		rasterizer.sType =						VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		rasterizer.depthClampEnable =			VK_FALSE; 
-		rasterizer.rasterizerDiscardEnable =	VK_FALSE;
-		rasterizer.polygonMode =				VK_POLYGON_MODE_FILL;
-		rasterizer.lineWidth =					1.0f;
-		rasterizer.cullMode =					VK_CULL_MODE_BACK_BIT;
-		rasterizer.frontFace =					VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	void Record(double ms)
+	{
+		double us = std::max(ms * 1000.0, 1.0);
+		uint32_t bucket = std::min(static_cast<uint32_t>(std::log2(us) * BUCKETS_PER_OCTAVE), BUCKET_COUNT - 1);
+		m_Buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+		m_Count.fetch_add(1, std::memory_order_relaxed);
+	}
 
-		rasterizer.depthBiasEnable =			VK_FALSE;
-		rasterizer.depthBiasConstantFactor =	0.0f; // Optional
-		rasterizer.depthBiasClamp =				0.0f; // Optional
-		rasterizer.depthBiasSlopeFactor =		0.0f; // Optional
+	uint64_t Count() const { return m_Count.load(std::memory_order_relaxed); }
+
+	// Geometric center of the bucket holding the p-th sample, in milliseconds
+	double Percentile(double p) const
+	{
+		uint64_t count = Count();
+		if (count == 0) return 0.0;
+
+		uint64_t target = static_cast<uint64_t>(std::ceil(p * count)), seen = 0;
+		for (uint32_t bucket = 0; bucket < BUCKET_COUNT; bucket++)
+		{
+			seen += m_Buckets[bucket].load(std::memory_order_relaxed);
+			if (seen >= target)
+				return std::exp2((bucket + 0.5) / BUCKETS_PER_OCTAVE) / 1000.0;
+		}
+		return std::exp2(static_cast<double>(BUCKET_COUNT) / BUCKETS_PER_OCTAVE) / 1000.0;
+	}
+
+private:
+	std::array<std::atomic<uint32_t>, BUCKET_COUNT>	m_Buckets{};
+	std::atomic<uint64_t>							m_Count{ 0 };
+};
+
+// Where the time of one DrawFrame call went, all in milliseconds
+struct FramePhaseTimings
+{
+	uint64_t	frame		= 0;
+	double		intervalMs	= 0.0; // since the previous frame started
+	double		fenceWaitMs = 0.0, acquireMs = 0.0, imageWaitMs = 0.0;
+	double		updateMs	= 0.0, recordMs = 0.0, submitMs = 0.0, presentMs = 0.0;
+	double		totalMs		= 0.0, gpuMs = -1.0;
+
+	double CpuMs() const { return totalMs - fenceWaitMs - acquireMs - imageWaitMs; }
+};
+
+/*
+Keeps histograms of frame intervals and of fence/acquire waits, plus the phase timings of the
+most recent frames. A frame whose interval exceeds stutterMultiple times the median of the
+recent frames is reported as a stutter and the preceding frames are appended to a log.
+*/
+class FrameTimingMonitor
+{
+public:
+	static constexpr size_t HISTORY_SIZE = 128;
+
+	void Configure(double stutterMultiple, size_t logFrames, std::string logPath)
+	{
+		m_StutterMultiple	= stutterMultiple;
+		m_LogFrames			= std::min(logFrames, HISTORY_SIZE);
+		m_LogPath			= std::move(logPath);
+	}
+
+	void Record(const FramePhaseTimings& timings)
+	{
+		m_FenceWaits.Record(timings.fenceWaitMs);
+		m_AcquireWaits.Record(timings.acquireMs + timings.imageWaitMs);
+		if (timings.frame > 0) m_FrameIntervals.Record(timings.intervalMs);
+
+		m_History[m_HistoryCount % HISTORY_SIZE] = timings;
+		m_HistoryCount++;
+
+		// Logging a stutter takes time itself, don't flag the frame right after one
+		if (m_Cooldown)
+		{
+			m_Cooldown = false;
+			return;
+		}
+		if (m_HistoryCount < 30 || timings.frame == 0) return;
+
+		double median = RecentMedianInterval();
+		if (median > 0.0 && timings.intervalMs > m_StutterMultiple * median)
+		{
+			m_StutterCount++;
+			LogStutter(timings, median);
+			m_Cooldown = true;
+		}
+	}
+
+	size_t						RecentCount() const		{ return std::min<size_t>(m_HistoryCount, HISTORY_SIZE); }
+	// Age 0 is the most recently recorded frame
+	const FramePhaseTimings&	Recent(size_t age) const { return m_History[(m_HistoryCount - 1 - age) % HISTORY_SIZE]; }
+
+	const DurationHistogram&	FrameIntervals() const	{ return m_FrameIntervals; }
+	const DurationHistogram&	FenceWaits() const		{ return m_FenceWaits; }
+	const DurationHistogram&	AcquireWaits() const	{ return m_AcquireWaits; }
+	uint64_t					StutterCount() const	{ return m_StutterCount; }
+
+	void PrintSummary(std::ostream& out) const
+	{
+		auto line = [&](const char* name, const DurationHistogram& histogram) {
+			out << "  " << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(3)
+				<< "p50 " << histogram.Percentile(0.50) << "  p99 " << histogram.Percentile(0.99) << "  p99.9 " << histogram.Percentile(0.999) << " ms" << std::endl;
+		};
+		out << "Frame timing histograms (" << m_FrameIntervals.Count() << " frames, " << m_StutterCount << " stutters";
+		if (m_StutterCount > 0) out << " logged to " << m_LogPath;
+		out << ")" << std::endl;
+		line("frame interval", m_FrameIntervals);
+		line("fence wait", m_FenceWaits);
+		line("acquire wait", m_AcquireWaits);
+	}
+
+private:
+	double RecentMedianInterval() const
+	{
+		size_t count = std::min<size_t>(m_HistoryCount, HISTORY_SIZE);
+		std::array<double, HISTORY_SIZE> intervals;
+		for (size_t i = 0; i < count; i++) intervals[i] = m_History[i].intervalMs;
+
+		std::nth_element(intervals.begin(), intervals.begin() + count / 2, intervals.begin() + count);
+		return intervals[count / 2];
+	}
+
+	void LogStutter(const FramePhaseTimings& stutter, double median)
+	{
+		std::ofstream log(m_LogPath, std::ios::app);
+		if (!log.is_open()) return;
+
+		log << std::fixed << std::setprecision(3);
+		log << "Stutter at frame " << stutter.frame << ": " << stutter.intervalMs << " ms interval, median " << median
+			<< " ms (" << stutter.intervalMs / median << "x)" << std::endl;
+		log << "     frame  interval     fence   acquire  imgwait    update    record    submit   present       cpu       gpu" << std::endl;
+
+		size_t count = std::min<size_t>({ m_HistoryCount, m_LogFrames + 1, HISTORY_SIZE });
+		for (size_t i = count; i > 0; i--)
+		{
+			const FramePhaseTimings& t = m_History[(m_HistoryCount - i) % HISTORY_SIZE];
+			log << std::setw(10) << t.frame << std::setw(10) << t.intervalMs << std::setw(10) << t.fenceWaitMs << std::setw(10) << t.acquireMs
+				<< std::setw(9) << t.imageWaitMs << std::setw(10) << t.updateMs << std::setw(10) << t.recordMs << std::setw(10) << t.submitMs
+				<< std::setw(10) << t.presentMs << std::setw(10) << t.CpuMs() << std::setw(10) << t.gpuMs << std::endl;
+		}
+		log << std::endl;
+	}
+
+	DurationHistogram								m_FrameIntervals, m_FenceWaits, m_AcquireWaits;
+	std::array<FramePhaseTimings, HISTORY_SIZE>		m_History{};
+	uint64_t										m_HistoryCount = 0, m_StutterCount = 0;
+	bool											m_Cooldown = false;
+
+	double											m_StutterMultiple = 2.0;
+	size_t											m_LogFrames = 30;
+	std::string										m_LogPath = "stutter.log";
+};
+
+struct HudVertex
+{
+	glm::vec2	position; // in pixels, origin at the top left corner
+	uint32_t	color;    // RGBA8, red in the lowest byte
+};
+
+constexpr uint32_t HudColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255)
+{
+	return static_cast<uint32_t>(r) | (static_cast<uint32_t>(g) << 8) | (static_cast<uint32_t>(b) << 16) | (static_cast<uint32_t>(a) << 24);
+}
+
+// 5x7 bitmap font for ASCII 32-95, one byte per row with the leftmost pixel in bit 4
+const uint8_t HUD_FONT[64][7] = {
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // space
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // !
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // "
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // #
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // $
+	{ 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 }, // %
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // &
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '
+	{ 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 }, // (
+	{ 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 }, // )
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // *
+	{ 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 }, // +
+	{ 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 }, // ,
+	{ 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 }, // -
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C }, // .
+	{ 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 }, // /
+	{ 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E }, // 0
+	{ 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E }, // 1
+	{ 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F }, // 2
+	{ 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E }, // 3
+	{ 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 }, // 4
+	{ 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E }, // 5
+	{ 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E }, // 6
+	{ 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 }, // 7
+	{ 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E }, // 8
+	{ 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C }, // 9
+	{ 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 }, // :
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ;
+	{ 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 }, // <
+	{ 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 }, // =
+	{ 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 }, // >
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ?
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // @
+	{ 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, // A
+	{ 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E }, // B
+	{ 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E }, // C
+	{ 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C }, // D
+	{ 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F }, // E
+	{ 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 }, // F
+	{ 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F }, // G
+	{ 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, // H
+	{ 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E }, // I
+	{ 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C }, // J
+	{ 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 }, // K
+	{ 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F }, // L
+	{ 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 }, // M
+	{ 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 }, // N
+	{ 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, // O
+	{ 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 }, // P
+	{ 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D }, // Q
+	{ 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 }, // R
+	{ 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E }, // S
+	{ 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, // T
+	{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, // U
+	{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 }, // V
+	{ 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A }, // W
+	{ 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 }, // X
+	{ 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 }, // Y
+	{ 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F }, // Z
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // [
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // backslash
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ]
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ^
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F }, // _
+};
+
+/*
+Builds the HUD geometry as plain colored triangles written straight into a mapped vertex buffer,
+so the whole overlay is a single draw. Glyphs are emitted as one quad per horizontal run of pixels.
+*/
+class HudBuilder
+{
+public:
+	static constexpr float GLYPH_ADVANCE	= 6.0f;
+	static constexpr float LINE_HEIGHT		= 9.0f;
+
+	HudBuilder(HudVertex* vertices, uint32_t capacity) : m_Vertices(vertices), m_Capacity(capacity) {}
+
+	void AddRect(float x, float y, float width, float height, uint32_t color)
+	{
+		if (m_Count + 6 > m_Capacity) return;
+
+		HudVertex* v = m_Vertices + m_Count;
+		v[0] = { { x, y }, color };
+		v[1] = { { x + width, y }, color };
+		v[2] = { { x + width, y + height }, color };
+		v[3] = { { x, y }, color };
+		v[4] = { { x + width, y + height }, color };
+		v[5] = { { x, y + height }, color };
+		m_Count += 6;
+	}
+
+	// Returns the x coordinate just after the last glyph
+	float AddText(float x, float y, const char* text, float scale, uint32_t color)
+	{
+		for (const char* c = text; *c; c++, x += GLYPH_ADVANCE * scale)
+		{
+			int code = std::toupper(static_cast<unsigned char>(*c));
+			if (code < 32 || code > 95) continue;
+
+			const uint8_t* rows = HUD_FONT[code - 32];
+			for (int row = 0; row < 7; row++)
+			{
+				for (int column = 0; column < 5;)
+				{
+					if (!(rows[row] & (0x10 >> column))) { column++; continue; }
+
+					int runStart = column;
+					while (column < 5 && (rows[row] & (0x10 >> column))) column++;
+					AddRect(x + runStart * scale, y + row * scale, (column - runStart) * scale, scale, color);
+				}
+			}
+		}
+		return x;
+	}
+
+	uint32_t VertexCount() const { return m_Count; }
+
+private:
+	HudVertex*	m_Vertices;
+	uint32_t	m_Capacity;
+	uint32_t	m_Count = 0;
+};
+
+// Proxy function that finds the real CreateDebugUtilsMessengerEXT function
+VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger) {
+	auto func = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
+	if (func != nullptr) {
+		return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
+	}
+	else {
+		return VK_ERROR_EXTENSION_NOT_PRESENT;
+	}
+}
+
+// Proxy function that finds the real DestroyDebugUtilsMessengerEXT function 
+void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator) {
+	auto func = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
+	if (func != nullptr) {
+		func(instance, debugMessenger, pAllocator);
+	}
+}
+
+class Application
+{
+public:
+	int Run()
+	{
+		m_StartTime = Clock::now();
+		if (g_LaunchOptions.trackHostAllocations)
+		{
+			g_HostAllocations.Enable(g_LaunchOptions.pooledHostAllocations);
+			m_Allocator = g_HostAllocations.Callbacks();
+		}
+
+		m_FrameMonitor.Configure(g_LaunchOptions.stutterMultiple, g_LaunchOptions.stutterLogFrames, g_LaunchOptions.stutterLog);
+		m_OverlayVisible = g_LaunchOptions.showHud;
+		m_VertexLayout = g_LaunchOptions.vertexLayout;
+
+		if (g_LaunchOptions.headless)
+			return RunHeadless();
+		if (!g_LaunchOptions.bakeTextures.empty())
+			return RunTextureBake();
+
+		RunStage("InitWindow", &Application::InitWindow);
+		InitVulkan();
+		MainLoop();
+
+		bool passed = true;
+		if (g_LaunchOptions.benchmark)
+			passed = FinishBenchmark();
+
+		{
+			HostAllocationTracker::Tag tag(g_HostAllocations, "Cleanup");
+			Cleanup();
+		}
+
+		if (g_LaunchOptions.benchmark || m_FrameMonitor.StutterCount() > 0)
+			m_FrameMonitor.PrintSummary(std::cout);
+		g_HostAllocations.PrintReport(std::cout);
+		return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+private:
+
+	// Runs only the CPU side of asset loading, without a window or a Vulkan device
+	int RunHeadless()
+	{
+		PrefetchCachedTextures();
+		LoadModel();
+		PrefetchTextures(m_Mesh.materials);
+		for (const auto& [path, decode] : m_TextureDecodes)
+			decode.get();	// rethrows a failed decode
+		ReleaseTextureDecodes();
+
+		ReportAssetLoads();
+		return EXIT_SUCCESS;
+	}
+
+	// Bakes every .jpg and .png in the --bake-textures directory into a KTX2 file next to it, without a
+	// window or a Vulkan device. Textures are decoded and filtered one per worker, then every level is
+	// encoded in bands of block rows spread over all workers.
+	int RunTextureBake()
+	{
+		auto formatFound = std::find_if(std::begin(texbake::BAKE_FORMATS), std::end(texbake::BAKE_FORMATS),
+			[](const texbake::BakeFormat& format) { return g_LaunchOptions.bakeFormat == format.name; });
+		if (formatFound == std::end(texbake::BAKE_FORMATS))
+			throw std::runtime_error("unknown bake format: " + g_LaunchOptions.bakeFormat);
+		auto filterFound = std::find(std::begin(texbake::MIP_FILTER_NAMES), std::end(texbake::MIP_FILTER_NAMES), g_LaunchOptions.bakeFilter);
+		if (filterFound == std::end(texbake::MIP_FILTER_NAMES))
+			throw std::runtime_error("unknown mip filter: " + g_LaunchOptions.bakeFilter);
+		const VkFormat format = formatFound->format;
+		const texbake::MipFilter filter = static_cast<texbake::MipFilter>(filterFound - std::begin(texbake::MIP_FILTER_NAMES));
+		const ktx2::FormatInfo& info = *ktx2::FindFormat(format);
+
+		std::vector<std::string> paths;
+		for (const auto& entry : std::filesystem::directory_iterator(g_LaunchOptions.bakeTextures))
+		{
+			std::string extension = entry.path().extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			if (entry.is_regular_file() && (extension == ".jpg" || extension == ".jpeg" || extension == ".png"))
+				paths.push_back(entry.path().generic_string());
+		}
+		if (paths.empty())
+			throw std::runtime_error("no .jpg or .png files in " + g_LaunchOptions.bakeTextures);
+		std::sort(paths.begin(), paths.end());
+
+		struct Bake
+		{
+			std::string							path;
+			uint32_t							width	= 0;
+			uint32_t							height	= 0;
+			std::vector<std::vector<uint8_t>>	levels;		// RGBA8, largest first
+			std::vector<std::vector<uint8_t>>	encoded;	// in the output format
+			std::string							error;
+		};
+		std::vector<Bake> bakes(paths.size());
+		auto start = Clock::now();
+
+		texbake::ParallelFor(bakes.size(), [&](size_t i) {
+			Bake& bake = bakes[i];
+			bake.path = paths[i];
+			try
+			{
+				DecodedImage decoded = DecodeTexture(bake.path, false);
+				bake.width	= static_cast<uint32_t>(decoded.width);
+				bake.height	= static_cast<uint32_t>(decoded.height);
+				bake.levels.emplace_back(decoded.pixels, decoded.pixels + decoded.size);
+				stbi_image_free(decoded.pixels);
+
+				AssetLoadProfiler::Scope scope(g_AssetProfiler, bake.path, AssetStage::MipGeneration);
+				texbake::MipImage level = texbake::FromRgba8(bake.levels[0].data(), bake.width, bake.height);
+				while (level.width > 1 || level.height > 1)
+				{
+					level = texbake::Downsample(level, filter);
+					bake.levels.push_back(texbake::ToRgba8(level));
+					scope.bytes += bake.levels.back().size();
+				}
+			}
+			catch (const std::exception& e)
+			{
+				bake.error = e.what();
+			}
+		});
+
+		struct EncodeJob
+		{
+			size_t		bake;
+			uint32_t	level;
+			uint32_t	firstRow;
+			uint32_t	lastRow;
+		};
+		const uint32_t BAND_ROWS = 16;	// block rows per job
+		std::vector<EncodeJob> jobs;
+		for (size_t b = 0; b < bakes.size(); b++)
+		{
+			Bake& bake = bakes[b];
+			if (!bake.error.empty()) continue;
+			if (info.blockWidth == 1)
+			{
+				bake.encoded = bake.levels;
+				continue;
+			}
+
+			bake.encoded.resize(bake.levels.size());
+			for (uint32_t level = 0; level < bake.levels.size(); level++)
+			{
+				uint32_t width = std::max(bake.width >> level, 1u), height = std::max(bake.height >> level, 1u);
+				bake.encoded[level].resize(ktx2::LevelBytes(info, width, height));
+				uint32_t rows = (height + info.blockHeight - 1) / info.blockHeight;
+				for (uint32_t row = 0; row < rows; row += BAND_ROWS)
+					jobs.push_back({ b, level, row, std::min(row + BAND_ROWS, rows) });
+			}
+		}
+		// Large levels first so the small ones fill in at the end
+		std::stable_sort(jobs.begin(), jobs.end(), [](const EncodeJob& a, const EncodeJob& b) { return a.level < b.level; });
+
+		texbake::ParallelFor(jobs.size(), [&](size_t j) {
+			const EncodeJob& job = jobs[j];
+			Bake& bake = bakes[job.bake];
+			uint32_t width = std::max(bake.width >> job.level, 1u), height = std::max(bake.height >> job.level, 1u);
+			AssetLoadProfiler::Scope scope(g_AssetProfiler, bake.path, AssetStage::Compress,
+				static_cast<uint64_t>(job.lastRow - job.firstRow) * ((width + 3) / 4) * info.blockBytes);
+			texbake::EncodeBlockRows(format, bake.levels[job.level].data(), width, height, job.firstRow, job.lastRow, bake.encoded[job.level].data());
+		});
+
+		bool failed = false;
+		for (const Bake& bake : bakes)
+		{
+			if (!bake.error.empty())
+			{
+				std::cerr << "Could not bake " << bake.path << ": " << bake.error << std::endl;
+				failed = true;
+				continue;
+			}
+
+			std::string outputPath = std::filesystem::path(bake.path).replace_extension(".ktx2").generic_string();
+			std::vector<uint8_t> file = ktx2::Write(format, bake.width, bake.height, bake.encoded);
+			{
+				AssetLoadProfiler::Scope scope(g_AssetProfiler, bake.path, AssetStage::FileIO, file.size());
+				std::ofstream output(outputPath, std::ios::binary);
+				output.write(reinterpret_cast<const char*>(file.data()), file.size());
+				if (!output)
+				{
+					std::cerr << "Could not write " << outputPath << std::endl;
+					failed = true;
+					continue;
+				}
+			}
+
+			// Quality of the top level as the GPU will sample it
+			std::vector<uint8_t> decoded = bake.encoded[0];
+			if (info.blockWidth > 1)
+			{
+				decoded.resize(bake.levels[0].size());
+				bcn::DecodeImage(format, bake.encoded[0].data(), bake.width, bake.height, decoded.data());
+			}
+			uint64_t uncompressed = 0;
+			for (const auto& level : bake.levels) uncompressed += level.size();
+			if (g_LaunchOptions.verbose)
+				std::cout << bake.path << " -> " << outputPath << ": " << bake.width << "x" << bake.height << ", " << bake.levels.size() << " levels, "
+					<< std::fixed << std::setprecision(2) << file.size() / (1024.0 * 1024.0) << " MiB (" << uncompressed / (1024.0 * 1024.0) << " MiB as RGBA8), "
+					<< std::setprecision(1) << texbake::Psnr(bake.levels[0], decoded) << " dB" << std::defaultfloat << std::endl;
+		}
+
+		std::cout << "Baked " << bakes.size() << " textures as " << formatFound->name << " with the " << g_LaunchOptions.bakeFilter << " filter in "
+			<< std::fixed << std::setprecision(1) << ElapsedMs(start) << " ms" << std::defaultfloat << std::endl;
+		g_AssetProfiler.PrintTable(std::cout);
+		if (!g_LaunchOptions.assetReport.empty())
+			g_AssetProfiler.WriteJson(g_LaunchOptions.assetReport);
+		return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	void ReportAssetLoads()
+	{
+		if (g_LaunchOptions.verbose || g_LaunchOptions.headless || g_LaunchOptions.benchmark)
+			g_AssetProfiler.PrintTable(std::cout);
+		if (!g_LaunchOptions.assetReport.empty())
+			g_AssetProfiler.WriteJson(g_LaunchOptions.assetReport);
+
+		for (const auto& asset : g_AssetProfiler.Assets())
+		{
+			for (size_t stage = 0; stage < asset.stages.size(); stage++)
+			{
+				if (asset.stages[stage].ms > 0.0)
+					m_Benchmark.assetLoads.emplace_back(asset.name + " " + ASSET_STAGE_NAMES[stage], asset.stages[stage].ms);
+			}
+		}
+
+		m_Benchmark.meshStatistics = {
+			{ "acmr", m_MeshStatistics.acmr },
+			{ "atvr", m_MeshStatistics.atvr },
+			{ "overfetch", m_MeshStatistics.overfetch },
+			{ "vertex_bytes", static_cast<double>(Vertex::GetStride(m_VertexLayout)) }
+		};
+		m_Benchmark.meshTimings.clear();
+		if (!m_Mesh.lods.empty())
+		{
+			m_Benchmark.meshStatistics.emplace_back("lods", static_cast<double>(m_Mesh.lods.size()));
+			m_Benchmark.meshStatistics.emplace_back("materials", static_cast<double>(m_Mesh.materials.size()));
+		}
+		// Only known once the index buffer was created, which a headless run skips
+		if (!m_IndexRanges.empty())
+		{
+			m_Benchmark.meshStatistics.emplace_back("index_bytes", m_IndexType == VK_INDEX_TYPE_UINT16 ? 2.0 : 4.0);
+			m_Benchmark.meshStatistics.emplace_back("index_draws", static_cast<double>(m_IndexRanges.size()));
+		}
+		if (m_MeshletCullingAvailable)
+			m_Benchmark.meshStatistics.emplace_back("meshlets", static_cast<double>(m_Meshlets.size()));
+		if (!m_Textures.empty())
+		{
+			VkDeviceSize textureBytes = 0;
+			for (const Texture& texture : m_Textures) textureBytes += texture.size;
+			m_Benchmark.meshStatistics.emplace_back("texture_bytes", static_cast<double>(textureBytes));
+		}
+		if (m_MipGenerationGpuMs > 0.0)
+			m_Benchmark.meshTimings.emplace_back("mip_generation_gpu_ms", m_MipGenerationGpuMs);
+	}
+
+	void InitWindow()
+	{
+		glfwInit();
+		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+		//glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+			
+		m_Window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", NULL, NULL);
+		glfwSetInputMode(m_Window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+		
+		glfwSetWindowUserPointer(m_Window, this);
+		glfwSetCursorPosCallback(m_Window, MouseCallback);
+		glfwSetFramebufferSizeCallback(m_Window, FramebufferResizeCallback);
+	}
+
+	static void MouseCallback(GLFWwindow* window, double x, double y)
+	{
+		auto app = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
+		app->ProcessMouseMovement(x, y);
+	}
+
+	static void FramebufferResizeCallback(GLFWwindow* window, int width, int height)
+	{
+		auto app = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
+		app->m_FramebufferResized = true;
+	}
+
+	void InitVulkan()
+	{
+		RunStage("CreateInstance", &Application::CreateInstance);
+		RunStage("SetupDebugMessenger", &Application::SetupDebugMessenger);
+		RunStage("CreateSurface", &Application::CreateSurface);
+		RunStage("PickPhysicalDevice", &Application::PickPhysicalDevice);
+		RunStage("CreateLogicalDevice", &Application::CreateLogicalDevice);
+		RunStage("PrefetchCachedTextures", &Application::PrefetchCachedTextures);
+		RunStage("CreateSwapchain", &Application::CreateSwapchain);
+		RunStage("CreateImageViews", &Application::CreateImageViews);
+		RunStage("CreateRenderPass", &Application::CreateRenderPass);
+		RunStage("SelectFragmentShader", &Application::SelectFragmentShader);
+		RunStage("CreateDescriptiorSetLayout", &Application::CreateDescriptiorSetLayout);
+		RunStage("CreateGraphicsPipeline", &Application::CreateGraphicsPipeline);
+		RunStage("CreateCommandPool", &Application::CreateCommandPool);
+		RunStage("CreateMipGeneration", &Application::CreateMipGeneration);
+		RunStage("CreateTimestampQueryPool", &Application::CreateTimestampQueryPool);
+		RunStage("CreatePipelineStatisticsQueryPool", &Application::CreatePipelineStatisticsQueryPool);
+		RunStage("CreateColorResources", &Application::CreateColorResources);
+		RunStage("CreateDepthResources", &Application::CreateDepthResources);
+		RunStage("CreateFrameBuffers", &Application::CreateFrameBuffers);
+		RunStage("CreateOverlay", &Application::CreateOverlay);
+		RunStage("CreateTextureFeedback", &Application::CreateTextureFeedback);
+		RunStage("CreateModelProxy", &Application::CreateModelProxy);
+		RunStage("CreateBindlessTextures", &Application::CreateBindlessTextures);
+		RunStage("CreateUniformBuffers", &Application::CreateUniformBuffers);
+		RunStage("CreateDescriptorPool", &Application::CreateDescriptorPool);
+		RunStage("CreateDescriptorSets", &Application::CreateDescriptorSets);
+		//CreateCommandBuffers();
+		RunStage("AllocateCommandBuffers", &Application::AllocateCommandBuffers);
+		RunStage("CreateSemaphores", &Application::CreateSemaphores);
+
+		// The render thread recreates m_TimestampQueryPool with the swapchain, the loader only needs to know
+		// whether it can create timestamp queries of its own
+		m_LoaderTimestamps = SupportsTimestamps();
+		m_ModelLoad = std::async(std::launch::async, &Application::LoadModelAsync, this);
+		if (g_LaunchOptions.syncLoad)
+		{
+			m_ModelLoad.wait();
+			PollModelLoad();
+		}
+	}
+
+	// Model stages, run on a loader thread while the render thread draws the proxy. Nothing they write
+	// is read by the render thread before PollModelLoad finds the load finished.
+	void LoadModelAsync()
+	{
+		t_LoaderThread = true;
+		const std::pair<const char*, void (Application::*)()> stages[] = {
+			{ "LoadModel", &Application::LoadModel },
+			{ "CreateTextureImage", &Application::CreateTextureImage },
+			{ "CreateTextureImageView", &Application::CreateTextureImageView },
+			{ "CreateMaterialDescriptorSets", &Application::CreateMaterialDescriptorSets },
+			{ "CreateVertexBuffer", &Application::CreateVertexBuffer },
+			{ "CreateIndexBuffer", &Application::CreateIndexBuffer },
+			{ "CreateMeshletCulling", &Application::CreateMeshletCulling }
+		};
+		m_PendingUploads = static_cast<uint32_t>(std::size(stages));
+		for (const auto& [name, stage] : stages)
+		{
+			HostAllocationTracker::Tag tag(g_HostAllocations, name);
+			ScopedTimer timer(m_ModelLoadStages, name);
+			(this->*stage)();
+			m_PendingUploads--;
+		}
+	}
+
+	// Swaps the model in once the loader thread is done. Every upload it made has completed by then, so
+	// the switch is a flag the next command buffer picks up, not a stall.
+	void PollModelLoad()
+	{
+		if (m_ModelResident || !m_ModelLoad.valid() || m_ModelLoad.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return;
+
+		m_ModelLoad.get();	// rethrows what the loader thread threw
+		m_ModelResident				= true;
+		m_ResidentFrame				= m_FrameIndex;
+		m_Benchmark.timeToModelMs	= ElapsedMs(m_StartTime);
+		m_Benchmark.initStages.insert(m_Benchmark.initStages.end(), m_ModelLoadStages.begin(), m_ModelLoadStages.end());
+		if (g_LaunchOptions.verbose)
+			std::cout << "Model resident after " << m_Benchmark.timeToModelMs << " ms, the proxy was drawn for " << m_FrameIndex << " frames" << std::endl;
+		ReportAssetLoads();
+	}
+
+	// Run one initialization stage and record how long it took for the benchmark report
+	void RunStage(const char* name, void (Application::*stage)())
+	{
+		HostAllocationTracker::Tag tag(g_HostAllocations, name);
+		ScopedTimer timer(m_Benchmark.initStages, name);
+		(this->*stage)();
+	}
+
+	// Fill VkDebugUtilsMessengerCreateInfoEXT struct
+	void PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo)
+	{
+		createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+		createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+		createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+		createInfo.pfnUserCallback = DebugCallbak;
+		createInfo.pUserData = nullptr;
+	}
+
+	// Create VKInstance
+	void CreateInstance()
+	{
+		if (g_EnableValidationLayers && !CheckValidationLayerSupport())
+		{
+			throw std::runtime_error("validation layer requested, but not available!");
+		}
+
+		VkApplicationInfo appInfo{};
+		appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+		appInfo.pApplicationName = "Hello Triangle";
+		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+		appInfo.pEngineName = "NONE";
+		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+		appInfo.apiVersion = VK_API_VERSION_1_0;
+
+		VkInstanceCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+		createInfo.pApplicationInfo = &appInfo;
+		auto extensions = GetRequiredExtensions();
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+		createInfo.ppEnabledExtensionNames = extensions.data();
+
+		VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
+		if (g_EnableValidationLayers)
+		{
+			createInfo.enabledLayerCount = static_cast<uint32_t>(g_ValidationLayers.size());
+			createInfo.ppEnabledLayerNames = g_ValidationLayers.data();
+			PopulateDebugMessengerCreateInfo(debugCreateInfo);
+			createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*)&debugCreateInfo;
+		}
+		else
+		{
+			createInfo.enabledLayerCount = 0;
+			createInfo.pNext = nullptr;
+		}
+
+		if (vkCreateInstance(&createInfo, m_Allocator, &m_Instance) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create instance!");
+		}
+	}
+
+	// Create windows surface
+	void CreateSurface()
+	{
+		if (glfwCreateWindowSurface(m_Instance, m_Window, m_Allocator, &m_Surface) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create window surface!");
+		}
+	}
+
+	// Setup callback for debug layers
+	void SetupDebugMessenger()
+	{
+		if (!g_EnableValidationLayers) return;
+		VkDebugUtilsMessengerCreateInfoEXT createInfo{};
+		PopulateDebugMessengerCreateInfo(createInfo);
+		
+		if (CreateDebugUtilsMessengerEXT(m_Instance, &createInfo, m_Allocator, &m_DebugMessenger) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to set up debug messenger!");
+		}
+	}
+
+	// Check validation layers against requireed g_ValidationLayers list
+	bool CheckValidationLayerSupport()
+	{
+		uint32_t layerCount;
+		vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+
+		std::vector<VkLayerProperties> availableLayers(layerCount);
+		vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
+
+		for (auto& layerName : g_ValidationLayers)
+		{
+			bool layerFound = false;
+
+			for (const auto& layerProperties : availableLayers )
+				if (strcmp(layerProperties.layerName, layerName) == 0)
+				{
+					layerFound = true;
+					break;
+				}
+			
+			if (!layerFound) return false;
+		}
+		return true;
+	}
+
+	// Set member variable m_Device to preferred device, based on IsDeviceSuitable
+	void PickPhysicalDevice()
+	{
+		uint32_t physicalDeviceCount;
+		vkEnumeratePhysicalDevices(m_Instance, &physicalDeviceCount, nullptr);
+
+		if (physicalDeviceCount == 0)
+		{
+			throw std::runtime_error("No device with Vulkan support found");
+		}
+
+		std::vector<VkPhysicalDevice> physicalDevices(physicalDeviceCount);
+		vkEnumeratePhysicalDevices(m_Instance, &physicalDeviceCount, physicalDevices.data());
+
+		for (const auto& device : physicalDevices)
+		{
+			if (IsDeviceSuitable(device))
+			{
+				m_PhysicalDevice = device;
+				m_MsaaSamples = GetMaximumSamples();
+
+				VkPhysicalDeviceProperties properties;
+				vkGetPhysicalDeviceProperties(device, &properties);
+				m_Benchmark.deviceName	= properties.deviceName;
+				m_TimestampPeriod		= properties.limits.timestampPeriod;
+				m_MaxDrawIndirectCount	= properties.limits.maxDrawIndirectCount;
+
+				vkGetPhysicalDeviceMemoryProperties(device, &m_MemoryProperties);
+				m_HeapUsage.assign(m_MemoryProperties.memoryHeapCount, 0);
+				break;
+			}
+		}
+
+		if (m_PhysicalDevice == VK_NULL_HANDLE)
+		{
+			throw std::runtime_error("No suitatble device found");
+		}
+	}
+
+	// Return Queue families supported by device
+	QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device)
+	{
+		QueueFamilyIndices indices;
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+		int i = 0;
+		for (const auto& queueFamily : queueFamilies)
+		{
+			if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+				indices.graphicsFamily = i;
+
+			VkBool32 presentSupport = false;
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_Surface, &presentSupport);
+
+			if (presentSupport) {
+				indices.presentFamily = i;
+			}
+
+			if (indices.IsComplete())
+			{
+				break;
+			}
+			i++;
+		}
+
+		return indices;
+	}
+
+	// Return capabilities, surface formats, present modes for device
+	SwapchainSupportDetails QuerySwapchainSupport(VkPhysicalDevice device) {
+		SwapchainSupportDetails details;
+
+		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, m_Surface, &details.capabilities);
+		uint32_t formatCount;
+		vkGetPhysicalDeviceSurfaceFormatsKHR(device, m_Surface, &formatCount, nullptr);
+
+		if (formatCount != 0) {
+			details.formats.resize(formatCount);
+			vkGetPhysicalDeviceSurfaceFormatsKHR(device, m_Surface, &formatCount, details.formats.data());
+		}
+
+		uint32_t presentModeCount;
+		vkGetPhysicalDeviceSurfacePresentModesKHR(device, m_Surface, &presentModeCount, nullptr);
+
+		if (presentModeCount != 0) {
+			details.presentModes.resize(presentModeCount);
+			vkGetPhysicalDeviceSurfacePresentModesKHR(device, m_Surface, &presentModeCount, details.presentModes.data());
+		}
+
+		return details;
+	}
+
+	/*
+	Choose properties for creating swap chains
+	*/
+
+	VkSurfaceFormatKHR ChooseSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
+	{
+		for (const auto& format : availableFormats)
+		{
+			if (format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR && format.format == VK_FORMAT_B8G8R8A8_SRGB)
+			{
+				return format;
+			}
+		}
+		
+		return availableFormats[0];
+	}
+
+	VkPresentModeKHR ChoosePresentMode(const std::vector<VkPresentModeKHR>& availableModes)
+	{
+		for (const auto& mode : availableModes)
+		{
+			if (mode == VK_PRESENT_MODE_MAILBOX_KHR)
+				return mode;
+		}
+		return VK_PRESENT_MODE_FIFO_KHR;
+	}
+
+	VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capability)
+	{
+		if (capability.currentExtent.width != UINT32_MAX)
+		{
+			return capability.currentExtent;
+		}
+		int width, height;
+		glfwGetWindowSize(m_Window, &width, &height);
+		VkExtent2D actualExtent = { 
+			static_cast<uint32_t>(width),
+			static_cast<uint32_t>(height)
+		};
+
+		actualExtent.width = std::max(capability.minImageExtent.width, std::min(capability.maxImageExtent.width, actualExtent.width));
+		actualExtent.width = std::max(capability.minImageExtent.height, std::min(capability.maxImageExtent.width, actualExtent.width));
+
+		return actualExtent;
+	}
+
+	// Report suitability of device
+	bool IsDeviceSuitable(VkPhysicalDevice device) {
+		VkPhysicalDeviceProperties prop;
+		vkGetPhysicalDeviceProperties(device, &prop);
+		VkPhysicalDeviceFeatures feat;
+		vkGetPhysicalDeviceFeatures(device, &feat);
+		QueueFamilyIndices indices = FindQueueFamilies(device);
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
+
+		bool extensionsSupported = CheckDeviceExtensionSupport(device);
+
+		bool swapChainAdequate = false;
+		if (extensionsSupported) {
+			SwapchainSupportDetails swapChainSupport = QuerySwapchainSupport(device);
+			swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+		}
+
+		return indices.IsComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+	}
+
+	// Check for required device extension support
+	bool CheckDeviceExtensionSupport(VkPhysicalDevice device) {
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+		std::set<std::string> requiredExtensions(g_DeviceExtensions.begin(), g_DeviceExtensions.end());
+
+		for (const auto& extension : availableExtensions) {
+			requiredExtensions.erase(extension.extensionName);
+		}
+
+		return requiredExtensions.empty();
+	}
+
+	bool DeviceExtensionSupported(VkPhysicalDevice device, const char* name)
+	{
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+		for (const auto& extension : availableExtensions)
+		{
+			if (strcmp(extension.extensionName, name) == 0) return true;
+		}
+		return false;
+	}
+
+	// Bindless textures need VK_EXT_descriptor_indexing for a partially bound array of sampled images
+	// that is written while in use, and first instances in indirect draws to pass the material. Fills
+	// the descriptor indexing features to enable, or says what is missing and returns false.
+	bool QueryBindlessSupport(const VkPhysicalDeviceFeatures& supportedFeatures, VkPhysicalDeviceDescriptorIndexingFeaturesEXT& enabled)
+	{
+		auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(m_Instance, "vkGetPhysicalDeviceFeatures2KHR");
+		auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(m_Instance, "vkGetPhysicalDeviceProperties2KHR");
+		if (!m_Properties2Supported || getFeatures2 == nullptr || getProperties2 == nullptr ||
+			!DeviceExtensionSupported(m_PhysicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) || !DeviceExtensionSupported(m_PhysicalDevice, VK_KHR_MAINTENANCE3_EXTENSION_NAME))
+		{
+			std::cerr << "VK_EXT_descriptor_indexing is not supported, bindless textures disabled" << std::endl;
+			return false;
+		}
+
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing{};
+		indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		VkPhysicalDeviceFeatures2KHR features{};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features.pNext = &indexing;
+		getFeatures2(m_PhysicalDevice, &features);
+		if (!indexing.runtimeDescriptorArray || !indexing.descriptorBindingPartiallyBound || !indexing.descriptorBindingSampledImageUpdateAfterBind ||
+			!indexing.descriptorBindingUpdateUnusedWhilePending || !supportedFeatures.shaderSampledImageArrayDynamicIndexing || !supportedFeatures.drawIndirectFirstInstance)
+		{
+			std::cerr << "Descriptor indexing features are missing, bindless textures disabled" << std::endl;
+			return false;
+		}
+
+		VkPhysicalDeviceDescriptorIndexingPropertiesEXT limits{};
+		limits.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+		VkPhysicalDeviceProperties2KHR properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+		properties.pNext = &limits;
+		getProperties2(m_PhysicalDevice, &properties);
+		// Combined image samplers count as both sampled images and samplers
+		m_BindlessTextureCapacity = std::min({ BINDLESS_TEXTURE_CAPACITY,
+			limits.maxPerStageDescriptorUpdateAfterBindSampledImages, limits.maxDescriptorSetUpdateAfterBindSampledImages,
+			limits.maxPerStageDescriptorUpdateAfterBindSamplers, limits.maxDescriptorSetUpdateAfterBindSamplers });
+
+		enabled.sType										= VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		enabled.runtimeDescriptorArray						= VK_TRUE;
+		enabled.descriptorBindingPartiallyBound				= VK_TRUE;
+		enabled.descriptorBindingSampledImageUpdateAfterBind	= VK_TRUE;
+		enabled.descriptorBindingUpdateUnusedWhilePending	= VK_TRUE;
+		return true;
+	}
+
+	// Get required instance extensions from glfw, add debug extension if in debug mode
+	std::vector<const char*> GetRequiredExtensions()
+	{
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
+
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+		std::vector<const char*> extensions = std::vector(glfwExtensions, glfwExtensions + glfwExtensionCount);
+
+		if (g_EnableValidationLayers)
+		{
+			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+		}
+
+		// Optional, the instance is Vulkan 1.0 and needs this to query descriptor indexing support
+		uint32_t availableCount = 0;
+		vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, nullptr);
+		std::vector<VkExtensionProperties> available(availableCount);
+		vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, available.data());
+		for (const auto& extension : available)
+		{
+			if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0)
+			{
+				extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+				m_Properties2Supported = true;
+			}
+		}
+
+		return extensions;
+	}
+
+	// Logical Device Creation
+	void CreateLogicalDevice()
+	{
+		QueueFamilyIndices indices = FindQueueFamilies(m_PhysicalDevice);
+
+		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+
+		float queuePriority = 1.0f;
+		for (uint32_t queueFamily : uniqueQueueFamilies) {
+			VkDeviceQueueCreateInfo queueCreateInfo{};
+			queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+			queueCreateInfo.queueFamilyIndex = queueFamily;
+			queueCreateInfo.queueCount = 1;
+			queueCreateInfo.pQueuePriorities = &queuePriority;
+			queueCreateInfos.push_back(queueCreateInfo);
+		}
+
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(m_PhysicalDevice, &supportedFeatures);
+
+		VkPhysicalDeviceFeatures deviceFeatures{};
+		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		deviceFeatures.sampleRateShading = VK_TRUE;
+		// Optional, measures vertex shader invocations per triangle to check the mesh optimizer on the GPU
+		deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+		m_PipelineStatisticsSupported = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+		// Optional, meshlet culling draws every meshlet with one indirect draw
+		deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+		m_MultiDrawIndirectSupported = supportedFeatures.multiDrawIndirect == VK_TRUE;
+		// Optional, KTX2 textures in formats the device cannot sample are decoded on the CPU
+		deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+		deviceFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
+		// Optional, texture streaming reports the mip levels sampled from the fragment shader
+		deviceFeatures.fragmentStoresAndAtomics = supportedFeatures.fragmentStoresAndAtomics;
+		m_TextureStreamingEnabled = g_LaunchOptions.textureStreaming && supportedFeatures.fragmentStoresAndAtomics == VK_TRUE;
+		if (g_LaunchOptions.textureStreaming && !m_TextureStreamingEnabled)
+			std::cerr << "fragmentStoresAndAtomics is not supported, texture streaming disabled" << std::endl;
+		std::vector<const char*> extensions = g_DeviceExtensions;
+		// Optional, compute mip generation writes through UNORM storage views of images sampled as sRGB,
+		// which needs views restricted to sampling, see CreateImageView
+		m_Maintenance2Enabled = DeviceExtensionSupported(m_PhysicalDevice, VK_KHR_MAINTENANCE2_EXTENSION_NAME);
+		if (m_Maintenance2Enabled)
+			extensions.push_back(VK_KHR_MAINTENANCE2_EXTENSION_NAME);
+		// Optional, bindless textures
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+		m_BindlessEnabled = g_LaunchOptions.bindless && QueryBindlessSupport(supportedFeatures, indexingFeatures);
+		if (m_BindlessEnabled)
+		{
+			extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+			extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+			deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+			deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+		}
+
+		VkDeviceCreateInfo deviceCreateInfo{};
+		deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		deviceCreateInfo.pNext = m_BindlessEnabled ? &indexingFeatures : nullptr;
+
+		deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
+		deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
+
+		deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+		deviceCreateInfo.ppEnabledExtensionNames = extensions.data();
+
+		deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
+		if (g_EnableValidationLayers) {
+			deviceCreateInfo.enabledLayerCount = static_cast<uint32_t>(g_ValidationLayers.size());
+			deviceCreateInfo.ppEnabledLayerNames = g_ValidationLayers.data();
+		}
+		else {
+			deviceCreateInfo.enabledLayerCount = 0;
+		}
+
+		if (vkCreateDevice(m_PhysicalDevice, &deviceCreateInfo, m_Allocator, &m_Device) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create logical device!");
+		}
+
+		vkGetDeviceQueue(m_Device, indices.graphicsFamily.value(), 0, &m_GraphicsQueue);
+		vkGetDeviceQueue(m_Device, indices.presentFamily.value(), 0, &m_PresentQueue);
+	}
+
+	void RecreateSwapchain()
+	{
+		HostAllocationTracker::Tag tag(g_HostAllocations, "RecreateSwapchain");
+		int width = 0, height = 0;
+		glfwGetFramebufferSize(m_Window, &width, &height);
+		while (width == 0 || height == 0) {
+			glfwGetFramebufferSize(m_Window, &width, &height);
+			glfwWaitEvents();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_QueueMutex);
+			vkDeviceWaitIdle(m_Device);
+		}
+
+		CleanupSwapchain();
+
+		CreateSwapchain();
+		CreateImageViews();
+		CreateRenderPass();
+		CreateGraphicsPipeline();
+		CreateColorResources();
+		CreateDepthResources();
+		CreateFrameBuffers();
+		CreateOverlay();
+		CreateTimestampQueryPool();
+		CreatePipelineStatisticsQueryPool();
+		CreateUniformBuffers();
+		CreateDescriptorPool();
+		CreateDescriptorSets();
+		//CreateCommandBuffers();
+		AllocateCommandBuffers();
+	}
+
+	void CreateSwapchain()
+	{
+		SwapchainSupportDetails swapChainDetails = QuerySwapchainSupport(m_PhysicalDevice);
+
+		m_SurfaceFormat = ChooseSurfaceFormat(swapChainDetails.formats);
+		m_SwapchainFormat = m_SurfaceFormat.format;
+		VkPresentModeKHR presentMode = ChoosePresentMode(swapChainDetails.presentModes);
+		m_Extent = ChooseSwapExtent(swapChainDetails.capabilities);
+
+		uint32_t imageCount = swapChainDetails.capabilities.minImageCount + 1;
+
+		if (swapChainDetails.capabilities.maxImageCount > 0 and swapChainDetails.capabilities.maxImageCount < imageCount)
+			imageCount = swapChainDetails.capabilities.maxImageCount;
+
+		VkSwapchainCreateInfoKHR swapchainCreateInfo{};
+		swapchainCreateInfo.sType			= VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+		swapchainCreateInfo.surface			= m_Surface;
+		swapchainCreateInfo.minImageCount	= imageCount;
+		swapchainCreateInfo.imageFormat		= m_SurfaceFormat.format;
+		swapchainCreateInfo.imageColorSpace = m_SurfaceFormat.colorSpace;
+		swapchainCreateInfo.presentMode		= presentMode;
+		swapchainCreateInfo.imageExtent		= m_Extent;
+
+		swapchainCreateInfo.imageArrayLayers = 1;
+		swapchainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+		QueueFamilyIndices indices = FindQueueFamilies(m_PhysicalDevice);
+		uint32_t qFamilyIndices[] = { indices.graphicsFamily.value() , indices.presentFamily.value() };
+
+		if (indices.presentFamily != indices.graphicsFamily)
+		{
+			swapchainCreateInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT ;
+			swapchainCreateInfo.queueFamilyIndexCount = 2;
+			swapchainCreateInfo.pQueueFamilyIndices = qFamilyIndices;
+		}
+		else
+		{
+			swapchainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		}
+
+		swapchainCreateInfo.preTransform = swapChainDetails.capabilities.currentTransform;
+		swapchainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+
+		swapchainCreateInfo.clipped = VK_TRUE;
+
+		swapchainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+
+		if (vkCreateSwapchainKHR(m_Device, &swapchainCreateInfo, m_Allocator, &m_Swapchain) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Swapchain Creation failed");
+		}
+
+		vkGetSwapchainImagesKHR(m_Device, m_Swapchain, &imageCount, nullptr);
+		m_SwapchainImages.resize(imageCount);
+		vkGetSwapchainImagesKHR(m_Device, m_Swapchain, &imageCount, m_SwapchainImages.data());
+	}
+
+	void CreateImageViews()
+	{
+		m_SwapchainImageViews.resize(m_SwapchainImages.size());
+
+		for (size_t i = 0; i < m_SwapchainImageViews.size(); i++)
+		{
+			m_SwapchainImageViews[i] = CreateImageView(m_SwapchainImages[i], VK_FORMAT_B8G8R8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+		}
+	}
+
+	void CreateRenderPass()
+	{
+		VkAttachmentDescription colorAttachment{};
+		colorAttachment.format			= m_SwapchainFormat;
+		colorAttachment.samples			= m_MsaaSamples;
+
+		colorAttachment.loadOp			= VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp			= VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.stencilLoadOp	= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp	= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+		colorAttachment.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
+		colorAttachment.finalLayout		= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentDescription depthAttachment{};
+		depthAttachment.format	= findDepthFormat();
+		depthAttachment.samples = m_MsaaSamples;
+
+		depthAttachment.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
+		depthAttachment.finalLayout		= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		depthAttachment.loadOp			= VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp			= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.stencilLoadOp	= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depthAttachment.stencilStoreOp	= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+		VkAttachmentDescription colorAttachmentResolve{};
+		colorAttachmentResolve.format = m_SwapchainFormat;
+		colorAttachmentResolve.samples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachmentResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+
+		VkAttachmentReference colorAttachmentRef{};
+		colorAttachmentRef.attachment	= 0;
+		colorAttachmentRef.layout		= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		
+		VkAttachmentReference depthAttachmentRef{};
+		depthAttachmentRef.attachment	= 1;
+		depthAttachmentRef.layout		= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorAttachmentResolveRef{};
+		colorAttachmentResolveRef.attachment = 2;
+		colorAttachmentResolveRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint		= VK_PIPELINE_BIND_POINT_GRAPHICS;
+		
+		subpass.colorAttachmentCount	= 1;
+		subpass.pColorAttachments		= &colorAttachmentRef;
+		subpass.pDepthStencilAttachment = &depthAttachmentRef;
+		subpass.pResolveAttachments		= &colorAttachmentResolveRef;
+
+		VkSubpassDependency dependency{};
+		dependency.srcSubpass		= VK_SUBPASS_EXTERNAL;
+		dependency.dstSubpass		= 0;
+		dependency.srcStageMask		= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.srcAccessMask	= 0;
+		dependency.dstStageMask		= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.dstAccessMask	= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		
+		std::array<VkAttachmentDescription, 3> attachments = { colorAttachment, depthAttachment, colorAttachmentResolve };
+		VkRenderPassCreateInfo renderPass{};
+		renderPass.sType			= VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPass.attachmentCount	= static_cast<uint32_t>(attachments.size());
+		renderPass.pAttachments		= attachments.data();
+		renderPass.subpassCount		= 1;
+		renderPass.pSubpasses		= &subpass;
+		renderPass.dependencyCount	= 1;
+		renderPass.pDependencies	= &dependency;
+
+		std::array<VkClearValue, 2> clearValues{};
+		clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+
+		if (vkCreateRenderPass(m_Device, &renderPass, m_Allocator, &m_RenderPass) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create renderpass");
+		}
+	}
+
+	// Picks the variant of basic.frag for the texture features in use. A missing variant turns its
+	// feature off, before the set layouts that depend on it are created.
+	void SelectFragmentShader()
+	{
+		if (m_BindlessEnabled && !std::filesystem::exists("shaders/frag_bindless.spv"))
+		{
+			std::cerr << "Bindless fragment shader not found, build the project or run shaders/complie.bat to enable bindless textures" << std::endl;
+			m_BindlessEnabled = false;
+		}
+
+		// Every material loads at most two textures. The last material and texture are the proxy's.
+		size_t materials = MaxModelMaterials(MODEL_PATH);
+		if (m_BindlessEnabled && (materials >= BINDLESS_PROXY_MATERIAL || 2 * materials >= m_BindlessTextureCapacity))
+		{
+			std::cerr << "The model may have " << materials << " materials, more than bindless textures hold, using a descriptor set per material" << std::endl;
+			m_BindlessEnabled = false;
+		}
+
+		// Texture streaming needs the variant that reports the mip levels it samples
+		std::string base = m_BindlessEnabled ? "shaders/frag_bindless" : "shaders/frag";
+		if (m_TextureStreamingEnabled && !std::filesystem::exists(base + "_feedback.spv"))
+		{
+			std::cerr << "Texture feedback shader not found, build the project or run shaders/complie.bat to enable texture streaming" << std::endl;
+			m_TextureStreamingEnabled = false;
+		}
+		m_FragmentShaderPath = base + (m_TextureStreamingEnabled ? "_feedback.spv" : ".spv");
+	}
+
+	void CreateDescriptiorSetLayout()
+	{
+		VkDescriptorSetLayoutBinding uboLayoutBinding{};
+		uboLayoutBinding.binding			= 0;
+		uboLayoutBinding.descriptorType		= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		uboLayoutBinding.descriptorCount	= 1;
+		uboLayoutBinding.stageFlags			= VK_SHADER_STAGE_VERTEX_BIT;
+		uboLayoutBinding.pImmutableSamplers = nullptr;
+
+		VkDescriptorSetLayoutBinding lightLayoutBinding{};
+		lightLayoutBinding.binding				= 2;
+		lightLayoutBinding.descriptorType		= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		lightLayoutBinding.descriptorCount		= 1;
+		lightLayoutBinding.stageFlags			= VK_SHADER_STAGE_FRAGMENT_BIT;
+		lightLayoutBinding.pImmutableSamplers	= nullptr;
+
+		VkDescriptorSetLayoutBinding cameraLayoutBinding{};
+		cameraLayoutBinding.binding				= 3;
+		cameraLayoutBinding.descriptorType		= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		cameraLayoutBinding.descriptorCount		= 1;
+		cameraLayoutBinding.stageFlags			= VK_SHADER_STAGE_FRAGMENT_BIT;
+		cameraLayoutBinding.pImmutableSamplers	= nullptr;
+
+		std::array<VkDescriptorSetLayoutBinding, 3> bindings = { uboLayoutBinding, lightLayoutBinding, cameraLayoutBinding };
+
+		VkDescriptorSetLayoutCreateInfo layoutCreateInfo{};
+		layoutCreateInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutCreateInfo.bindingCount	= static_cast<uint32_t>(bindings.size());
+		layoutCreateInfo.pBindings		= bindings.data();
+		
+		if (vkCreateDescriptorSetLayout(m_Device, &layoutCreateInfo, m_Allocator, &m_DescriptorSetLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create descriptor set layout.");
+		}
+
+		// Set 1 holds the textures of one material, bound once per material batch, and the texture
+		// feedback buffer of the frame
+		std::array<VkDescriptorSetLayoutBinding, 3> materialBindings{};
+		for (uint32_t i = 0; i < materialBindings.size(); i++)
+		{
+			materialBindings[i].binding				= i;	// diffuse, specular, feedback
+			materialBindings[i].descriptorCount		= 1;
+			materialBindings[i].descriptorType		= i < 2 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			materialBindings[i].stageFlags			= VK_SHADER_STAGE_FRAGMENT_BIT;
+			materialBindings[i].pImmutableSamplers	= nullptr;
+		}
+
+		// With bindless textures it holds every texture, the material table and the feedback buffer,
+		// bound once per frame. Only the texture array is written while in use, see CreateBindlessTextures.
+		std::array<VkDescriptorBindingFlagsEXT, 3> bindingFlags{};
+		VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{};
+		if (m_BindlessEnabled)
+		{
+			materialBindings[0].descriptorCount	= m_BindlessTextureCapacity;
+			materialBindings[1].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindingFlags[0] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+
+			bindingFlagsInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+			bindingFlagsInfo.bindingCount	= static_cast<uint32_t>(bindingFlags.size());
+			bindingFlagsInfo.pBindingFlags	= bindingFlags.data();
+			layoutCreateInfo.pNext			= &bindingFlagsInfo;
+			layoutCreateInfo.flags			= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+		}
+
+		layoutCreateInfo.bindingCount	= static_cast<uint32_t>(materialBindings.size());
+		layoutCreateInfo.pBindings		= materialBindings.data();
+
+		if (vkCreateDescriptorSetLayout(m_Device, &layoutCreateInfo, m_Allocator, &m_MaterialSetLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create material descriptor set layout.");
+		}
+	}
+
+	void CreateGraphicsPipeline()
+	{
+		auto vertShaderCode = ReadFile("shaders/vert.spv");
+		auto fragShaderCode = ReadFile(m_FragmentShaderPath);
+		
+		VkShaderModule vertShaderModule = CreateShaderModule(vertShaderCode);
+		VkShaderModule fragShaderModule = CreateShaderModule(fragShaderCode);
+
+		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+		vertShaderStageInfo.sType	= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		vertShaderStageInfo.stage	= VK_SHADER_STAGE_VERTEX_BIT;
+		vertShaderStageInfo.module	= vertShaderModule;
+		vertShaderStageInfo.pName	= "main";
+
+		// constant_id 0 in basic.vert: normals are stored octahedral encoded in every layout but Full
+		VkBool32 octahedralNormals = m_VertexLayout != VertexLayout::Full;
+		VkSpecializationMapEntry specializationEntry{};
+		specializationEntry.constantID	= 0;
+		specializationEntry.offset		= 0;
+		specializationEntry.size		= sizeof(octahedralNormals);
+		VkSpecializationInfo specializationInfo{};
+		specializationInfo.mapEntryCount	= 1;
+		specializationInfo.pMapEntries		= &specializationEntry;
+		specializationInfo.dataSize			= sizeof(octahedralNormals);
+		specializationInfo.pData			= &octahedralNormals;
+		vertShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
+		VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+		fragShaderStageInfo.sType	= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		fragShaderStageInfo.stage	= VK_SHADER_STAGE_FRAGMENT_BIT;
+		fragShaderStageInfo.module	= fragShaderModule;
+		fragShaderStageInfo.pName	= "main";
+
+		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+
+		auto bindingInfo	= Vertex::GetBindingDescription(m_VertexLayout);
+		auto attributeInfo	= Vertex::GetAttributeDescription(m_VertexLayout);
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInputInfo.vertexBindingDescriptionCount	= 1;
+		vertexInputInfo.pVertexBindingDescriptions		= &bindingInfo;
+		vertexInputInfo.vertexAttributeDescriptionCount = attributeInfo.size();
+		vertexInputInfo.pVertexAttributeDescriptions	= attributeInfo.data(); 
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+		VkViewport viewport{};
+		viewport.x			= 0.0f;
+		viewport.y			= 0.0f;
+		viewport.width		= (float)m_Extent.width;
+		viewport.height		= (float)m_Extent.height;
+		viewport.minDepth	= 0.0f;
+		viewport.maxDepth	= 1.0f;
+
+		VkRect2D scissor{};
+		scissor.offset = { 0, 0 };
+		scissor.extent = m_Extent;
+		
+		VkPipelineViewportStateCreateInfo viewportState{};
+		viewportState.sType			= VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = 1;
+		viewportState.pViewports	= &viewport;
+		viewportState.scissorCount	= 1;
+		viewportState.pScissors		= &scissor;
+
+		VkPipelineRasterizationStateCreateInfo rasterizer{};
+		rasterizer.sType =						VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizer.depthClampEnable =			VK_FALSE; 
+		rasterizer.rasterizerDiscardEnable =	VK_FALSE;
+		rasterizer.polygonMode =				VK_POLYGON_MODE_FILL;
+		rasterizer.lineWidth =					1.0f;
+		rasterizer.cullMode =					VK_CULL_MODE_BACK_BIT;
+		rasterizer.frontFace =					VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+		rasterizer.depthBiasEnable =			VK_FALSE;
+		rasterizer.depthBiasConstantFactor =	0.0f; // Optional
+		rasterizer.depthBiasClamp =				0.0f; // Optional
+		rasterizer.depthBiasSlopeFactor =		0.0f; // Optional
+
+
+		VkPipelineMultisampleStateCreateInfo multisampling{};
+		multisampling.sType =					VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.sampleShadingEnable =		VK_TRUE;
+		multisampling.rasterizationSamples =	m_MsaaSamples;
+		multisampling.minSampleShading =		1.0f; // Optional
+		multisampling.pSampleMask =				nullptr; // Optional
+		multisampling.alphaToCoverageEnable =	VK_FALSE; // Optional
+		multisampling.alphaToOneEnable =		VK_FALSE; // Optional
+
+		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+		colorBlendAttachment.colorWriteMask =		VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		colorBlendAttachment.blendEnable =			VK_FALSE;
+		colorBlendAttachment.srcColorBlendFactor =	VK_BLEND_FACTOR_ONE; // Optional
+		colorBlendAttachment.dstColorBlendFactor =	VK_BLEND_FACTOR_ZERO; // Optional
+		colorBlendAttachment.colorBlendOp =			VK_BLEND_OP_ADD; // Optional
+		colorBlendAttachment.srcAlphaBlendFactor =	VK_BLEND_FACTOR_ONE; // Optional
+		colorBlendAttachment.dstAlphaBlendFactor =	VK_BLEND_FACTOR_ZERO; // Optional
+		colorBlendAttachment.alphaBlendOp =			VK_BLEND_OP_ADD; // Optional
+
+		colorBlendAttachment.blendEnable =			VK_TRUE;
+		colorBlendAttachment.srcColorBlendFactor =	VK_BLEND_FACTOR_SRC_ALPHA;
+		colorBlendAttachment.dstColorBlendFactor =	VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		colorBlendAttachment.colorBlendOp =			VK_BLEND_OP_ADD;
+		colorBlendAttachment.srcAlphaBlendFactor =	VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.dstAlphaBlendFactor =	VK_BLEND_FACTOR_ZERO;
+		colorBlendAttachment.alphaBlendOp =			VK_BLEND_OP_ADD;
+
+		VkPipelineColorBlendStateCreateInfo colorBlending{};
+		colorBlending.sType =				VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlending.logicOpEnable =		VK_FALSE;
+		colorBlending.logicOp =				VK_LOGIC_OP_COPY; // Optional
+		colorBlending.attachmentCount =		1;
+		colorBlending.pAttachments =		&colorBlendAttachment;
+		colorBlending.blendConstants[0] =	0.0f; // Optional
+		colorBlending.blendConstants[1] =	0.0f; // Optional
+		colorBlending.blendConstants[2] =	0.0f; // Optional
+		colorBlending.blendConstants[3] =	0.0f; // Optional
+
+		VkDynamicState dynamicStates[] = {
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_LINE_WIDTH
+		};
+
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		dynamicState.sType =				VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount =	2;
+		dynamicState.pDynamicStates =		dynamicStates;
+
+		VkPipelineDepthStencilStateCreateInfo depthStencil{};
+		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthStencil.depthTestEnable = VK_TRUE;
+		depthStencil.depthWriteEnable = VK_TRUE;
+		depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+		depthStencil.depthBoundsTestEnable = VK_FALSE;
+		depthStencil.minDepthBounds = 0.0f; // Optional
+		depthStencil.maxDepthBounds = 1.0f; // Optional
+		depthStencil.stencilTestEnable = VK_FALSE;
+		depthStencil.front = {}; // Optional
+		depthStencil.back= {}; // Optional
+
+		std::array<VkPushConstantRange, 2> vpcr{};
+		vpcr[0].offset		= 0;
+		vpcr[0].size		= sizeof(MeshPushConstants);
+		vpcr[0].stageFlags	= VK_SHADER_STAGE_VERTEX_BIT;
+		vpcr[1].offset		= sizeof(MeshPushConstants);
+		vpcr[1].size		= sizeof(MaterialPushConstants);
+		vpcr[1].stageFlags	= VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType					= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		VkDescriptorSetLayout setLayouts[]			= { m_DescriptorSetLayout, m_MaterialSetLayout };
+		pipelineLayoutInfo.setLayoutCount			= 2;
+		pipelineLayoutInfo.pSetLayouts				= setLayouts;
+		pipelineLayoutInfo.pushConstantRangeCount	= static_cast<uint32_t>(vpcr.size());
+		pipelineLayoutInfo.pPushConstantRanges		= vpcr.data();
+
+		if (vkCreatePipelineLayout(m_Device, &pipelineLayoutInfo, m_Allocator, &m_PipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.stageCount = 2;
+		pipelineInfo.pStages = shaderStages;
+
+		pipelineInfo.pVertexInputState =	&vertexInputInfo;
+		pipelineInfo.pInputAssemblyState =	&inputAssembly;
+		pipelineInfo.pViewportState =		&viewportState;
+		pipelineInfo.pRasterizationState =	&rasterizer;
+		pipelineInfo.pMultisampleState =	&multisampling;
+		pipelineInfo.pDepthStencilState =	&depthStencil; // Optional
+		pipelineInfo.pColorBlendState =		&colorBlending;
+		pipelineInfo.pDynamicState =		nullptr; // Optional
+
+		pipelineInfo.layout =				m_PipelineLayout;
+
+		pipelineInfo.renderPass =			m_RenderPass;
+		pipelineInfo.subpass =				0;
+
+		// Used for derived pipelines
+		pipelineInfo.basePipelineHandle =	VK_NULL_HANDLE; // Optional
+		pipelineInfo.basePipelineIndex =	-1; // Optional
+
+		if (vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE, 1, &pipelineInfo, m_Allocator, &m_Pipeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create Graphics Pipeline");
+		}
+	}
+
+	void CreateFrameBuffers()
+	{
+		m_SwapchainFramebuffers.resize(m_SwapchainImageViews.size());
+		
+		for (size_t i = 0; i < m_SwapchainImageViews.size(); i++) {
+			std::array<VkImageView, 3> attachments = {
+				m_ColorImageView,
+				m_DepthImageView,
+				m_SwapchainImageViews[i]
+			};
+
+			VkFramebufferCreateInfo framebufferInfo{};
+			framebufferInfo.sType =				VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferInfo.renderPass =		m_RenderPass;
+			framebufferInfo.attachmentCount =	static_cast<uint32_t>(attachments.size());
+			framebufferInfo.pAttachments =		attachments.data();
+			framebufferInfo.width =				m_Extent.width;
+			framebufferInfo.height =			m_Extent.height;
+			framebufferInfo.layers =			1;
+
+			if (vkCreateFramebuffer(m_Device, &framebufferInfo, m_Allocator, &m_SwapchainFramebuffers[i]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create framebuffer!");
+			}
+		}
+	}
+
+	// The HUD is drawn in its own single sample pass on top of the resolved swapchain image,
+	// so it never touches the MSAA targets or the depth buffer of the scene pass
+	void CreateOverlay()
+	{
+		m_OverlayAvailable = false;
+
+		std::vector<char> vertShaderCode, fragShaderCode;
+		try
+		{
+			vertShaderCode = ReadFile("shaders/hud_vert.spv");
+			fragShaderCode = ReadFile("shaders/hud_frag.spv");
+		}
+		catch (const std::runtime_error&)
+		{
+			static bool warned = false;
+			if (!warned)
+				std::cerr << "HUD shaders not found, build the project or run shaders/complie.bat to enable the performance overlay" << std::endl;
+			warned = true;
+			return;
+		}
+
+		CreateOverlayRenderPass();
+		CreateOverlayPipeline(vertShaderCode, fragShaderCode);
+
+		m_OverlayFramebuffers.resize(m_SwapchainImageViews.size());
+		for (size_t i = 0; i < m_SwapchainImageViews.size(); i++)
+		{
+			VkFramebufferCreateInfo framebufferInfo{};
+			framebufferInfo.sType =				VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferInfo.renderPass =		m_OverlayRenderPass;
+			framebufferInfo.attachmentCount =	1;
+			framebufferInfo.pAttachments =		&m_SwapchainImageViews[i];
+			framebufferInfo.width =				m_Extent.width;
+			framebufferInfo.height =			m_Extent.height;
+			framebufferInfo.layers =			1;
+
+			if (vkCreateFramebuffer(m_Device, &framebufferInfo, m_Allocator, &m_OverlayFramebuffers[i]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create overlay framebuffer!");
+			}
+		}
+
+		// One persistently mapped vertex buffer per swapchain image, rewritten every frame the HUD is visible
+		VkDeviceSize bufferSize = sizeof(HudVertex) * OVERLAY_MAX_VERTICES;
+		m_OverlayVertexBuffers.resize(m_SwapchainImages.size());
+		m_OverlayVertexBufferMemories.resize(m_SwapchainImages.size());
+		m_OverlayVertices.resize(m_SwapchainImages.size());
+		for (size_t i = 0; i < m_SwapchainImages.size(); i++)
+		{
+			CreateBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				m_OverlayVertexBuffers[i], m_OverlayVertexBufferMemories[i]);
+
+			void* data;
+			vkMapMemory(m_Device, m_OverlayVertexBufferMemories[i], 0, bufferSize, 0, &data);
+			m_OverlayVertices[i] = static_cast<HudVertex*>(data);
+		}
+
+		m_OverlayAvailable = true;
+	}
+
+	void CreateOverlayRenderPass()
+	{
+		VkAttachmentDescription colorAttachment{};
+		colorAttachment.format			= m_SwapchainFormat;
+		colorAttachment.samples			= VK_SAMPLE_COUNT_1_BIT;
+		colorAttachment.loadOp			= VK_ATTACHMENT_LOAD_OP_LOAD;
+		colorAttachment.storeOp			= VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.stencilLoadOp	= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp	= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		colorAttachment.initialLayout	= VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		colorAttachment.finalLayout		= VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+		VkAttachmentReference colorAttachmentRef{};
+		colorAttachmentRef.attachment	= 0;
+		colorAttachmentRef.layout		= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint		= VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount	= 1;
+		subpass.pColorAttachments		= &colorAttachmentRef;
+
+		// Wait for the scene pass to finish writing the resolved image before blending on top of it
+		VkSubpassDependency dependency{};
+		dependency.srcSubpass		= VK_SUBPASS_EXTERNAL;
+		dependency.dstSubpass		= 0;
+		dependency.srcStageMask		= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.srcAccessMask	= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependency.dstStageMask		= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.dstAccessMask	= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+		VkRenderPassCreateInfo renderPass{};
+		renderPass.sType			= VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPass.attachmentCount	= 1;
+		renderPass.pAttachments		= &colorAttachment;
+		renderPass.subpassCount		= 1;
+		renderPass.pSubpasses		= &subpass;
+		renderPass.dependencyCount	= 1;
+		renderPass.pDependencies	= &dependency;
+
+		if (vkCreateRenderPass(m_Device, &renderPass, m_Allocator, &m_OverlayRenderPass) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create overlay renderpass");
+		}
+	}
+
+	void CreateOverlayPipeline(const std::vector<char>& vertShaderCode, const std::vector<char>& fragShaderCode)
+	{
+		VkShaderModule vertShaderModule = CreateShaderModule(vertShaderCode);
+		VkShaderModule fragShaderModule = CreateShaderModule(fragShaderCode);
+
+		VkPipelineShaderStageCreateInfo shaderStages[2]{};
+		shaderStages[0].sType	= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[0].stage	= VK_SHADER_STAGE_VERTEX_BIT;
+		shaderStages[0].module	= vertShaderModule;
+		shaderStages[0].pName	= "main";
+		shaderStages[1].sType	= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[1].stage	= VK_SHADER_STAGE_FRAGMENT_BIT;
+		shaderStages[1].module	= fragShaderModule;
+		shaderStages[1].pName	= "main";
+
+		VkVertexInputBindingDescription bindingInfo{};
+		bindingInfo.binding		= 0;
+		bindingInfo.stride		= sizeof(HudVertex);
+		bindingInfo.inputRate	= VK_VERTEX_INPUT_RATE_VERTEX;
+
+		std::array<VkVertexInputAttributeDescription, 2> attributeInfo{};
+		attributeInfo[0].binding	= 0;
+		attributeInfo[0].location	= 0;
+		attributeInfo[0].format		= VK_FORMAT_R32G32_SFLOAT;
+		attributeInfo[0].offset		= offsetof(HudVertex, position);
+		attributeInfo[1].binding	= 0;
+		attributeInfo[1].location	= 1;
+		attributeInfo[1].format		= VK_FORMAT_R8G8B8A8_UNORM;
+		attributeInfo[1].offset		= offsetof(HudVertex, color);
+
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInputInfo.vertexBindingDescriptionCount	= 1;
+		vertexInputInfo.pVertexBindingDescriptions		= &bindingInfo;
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeInfo.size());
+		vertexInputInfo.pVertexAttributeDescriptions	= attributeInfo.data();
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+		VkPipelineViewportStateCreateInfo viewportState{};
+		viewportState.sType			= VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = 1;
+		viewportState.scissorCount	= 1;
+
+		VkPipelineRasterizationStateCreateInfo rasterizer{};
+		rasterizer.sType =			VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizer.polygonMode =	VK_POLYGON_MODE_FILL;
+		rasterizer.lineWidth =		1.0f;
+		rasterizer.cullMode =		VK_CULL_MODE_NONE;
+		rasterizer.frontFace =		VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+		VkPipelineMultisampleStateCreateInfo multisampling{};
+		multisampling.sType =					VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.rasterizationSamples =	VK_SAMPLE_COUNT_1_BIT;
+
+		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+		colorBlendAttachment.colorWriteMask =		VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		colorBlendAttachment.blendEnable =			VK_TRUE;
+		colorBlendAttachment.srcColorBlendFactor =	VK_BLEND_FACTOR_SRC_ALPHA;
+		colorBlendAttachment.dstColorBlendFactor =	VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		colorBlendAttachment.colorBlendOp =			VK_BLEND_OP_ADD;
+		colorBlendAttachment.srcAlphaBlendFactor =	VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.dstAlphaBlendFactor =	VK_BLEND_FACTOR_ZERO;
+		colorBlendAttachment.alphaBlendOp =			VK_BLEND_OP_ADD;
+
+		VkPipelineColorBlendStateCreateInfo colorBlending{};
+		colorBlending.sType =				VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlending.attachmentCount =		1;
+		colorBlending.pAttachments =		&colorBlendAttachment;
+
+		VkDynamicState dynamicStates[] = {
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR
+		};
+
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		dynamicState.sType =				VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount =	2;
+		dynamicState.pDynamicStates =		dynamicStates;
+
+		VkPipelineDepthStencilStateCreateInfo depthStencil{};
+		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+
+		VkPushConstantRange screenSize{};
+		screenSize.offset		= 0;
+		screenSize.size			= sizeof(glm::vec2);
+		screenSize.stageFlags	= VK_SHADER_STAGE_VERTEX_BIT;
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType					= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.pushConstantRangeCount	= 1;
+		pipelineLayoutInfo.pPushConstantRanges		= &screenSize;
+
+		if (vkCreatePipelineLayout(m_Device, &pipelineLayoutInfo, m_Allocator, &m_OverlayPipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create overlay pipeline layout!");
+		}
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.stageCount = 2;
+		pipelineInfo.pStages = shaderStages;
+
+		pipelineInfo.pVertexInputState =	&vertexInputInfo;
+		pipelineInfo.pInputAssemblyState =	&inputAssembly;
+		pipelineInfo.pViewportState =		&viewportState;
+		pipelineInfo.pRasterizationState =	&rasterizer;
+		pipelineInfo.pMultisampleState =	&multisampling;
+		pipelineInfo.pDepthStencilState =	&depthStencil;
+		pipelineInfo.pColorBlendState =		&colorBlending;
+		pipelineInfo.pDynamicState =		&dynamicState;
+		pipelineInfo.layout =				m_OverlayPipelineLayout;
+		pipelineInfo.renderPass =			m_OverlayRenderPass;
+		pipelineInfo.subpass =				0;
+
+		VkResult result = vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE, 1, &pipelineInfo, m_Allocator, &m_OverlayPipeline);
+
+		vkDestroyShaderModule(m_Device, vertShaderModule, m_Allocator);
+		vkDestroyShaderModule(m_Device, fragShaderModule, m_Allocator);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create overlay pipeline");
+		}
+	}
+
+	void CleanupOverlay()
+	{
+		if (!m_OverlayAvailable) return;
+
+		for (size_t i = 0; i < m_OverlayVertexBuffers.size(); i++)
+		{
+			vkUnmapMemory(m_Device, m_OverlayVertexBufferMemories[i]);
+			vkDestroyBuffer(m_Device, m_OverlayVertexBuffers[i], m_Allocator);
+			FreeDeviceMemory(m_OverlayVertexBufferMemories[i]);
+		}
+		for (auto framebuffer : m_OverlayFramebuffers)
+			vkDestroyFramebuffer(m_Device, framebuffer, m_Allocator);
+
+		vkDestroyPipeline(m_Device, m_OverlayPipeline, m_Allocator);
+		vkDestroyPipelineLayout(m_Device, m_OverlayPipelineLayout, m_Allocator);
+		vkDestroyRenderPass(m_Device, m_OverlayRenderPass, m_Allocator);
+
+		m_OverlayVertexBuffers.clear();
+		m_OverlayVertexBufferMemories.clear();
+		m_OverlayVertices.clear();
+		m_OverlayFramebuffers.clear();
+		m_OverlayAvailable = false;
+	}
+
+	void RecordOverlay(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+	{
+		if (!m_OverlayAvailable || !m_OverlayVisible) return;
+
+		auto buildStart = Clock::now();
+		HudBuilder hud(m_OverlayVertices[imageIndex], OVERLAY_MAX_VERTICES);
+		BuildOverlay(hud);
+		m_OverlayBuildMs = ElapsedMs(buildStart);
+
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType				= VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass			= m_OverlayRenderPass;
+		renderPassInfo.framebuffer			= m_OverlayFramebuffers[imageIndex];
+		renderPassInfo.renderArea.offset	= { 0, 0 };
+		renderPassInfo.renderArea.extent	= m_Extent;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport{ 0.0f, 0.0f, (float)m_Extent.width, (float)m_Extent.height, 0.0f, 1.0f };
+		VkRect2D scissor{ { 0, 0 }, m_Extent };
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		glm::vec2 screenSize = { (float)m_Extent.width, (float)m_Extent.height };
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_OverlayPipeline);
+		vkCmdPushConstants(commandBuffer, m_OverlayPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(screenSize), &screenSize);
+
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_OverlayVertexBuffers[imageIndex], &offset);
+		vkCmdDraw(commandBuffer, hud.VertexCount(), 1, 0, 0);
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	// Text block with the latest numbers followed by a bar graph of the recent frame intervals.
+	// Bars turn yellow past the 60 Hz budget and red past twice that.
+	void BuildOverlay(HudBuilder& hud)
+	{
+		const float scale = 2.0f, margin = 8.0f, lineHeight = HudBuilder::LINE_HEIGHT * scale;
+		const float graphBarWidth = 3.0f, graphHeight = 80.0f, graphRangeMs = 50.0f, targetMs = 1000.0f / 60.0f;
+		const uint32_t textColor = HudColor(230, 230, 230), dimColor = HudColor(150, 150, 150);
+
+		std::vector<std::string> lines;
+		char line[128];
+
+		const FramePhaseTimings* last = m_FrameMonitor.RecentCount() > 0 ? &m_FrameMonitor.Recent(0) : nullptr;
+		double intervalMs = last ? last->intervalMs : 0.0;
+		snprintf(line, sizeof(line), "FRAME %6.2f MS  %5.0f FPS", intervalMs, intervalMs > 0.0 ? 1000.0 / intervalMs : 0.0);
+		lines.push_back(line);
+		snprintf(line, sizeof(line), "P50 %6.2f  P99 %6.2f MS", m_FrameMonitor.FrameIntervals().Percentile(0.50), m_FrameMonitor.FrameIntervals().Percentile(0.99));
+		lines.push_back(line);
+		snprintf(line, sizeof(line), "CPU %6.2f MS", last ? last->CpuMs() : 0.0);
+		lines.push_back(line);
+		if (last && last->gpuMs >= 0.0)
+			snprintf(line, sizeof(line), "GPU %6.2f MS (SCENE %.2f, HUD %.2f)", last->gpuMs, m_GpuSceneMs, m_GpuOverlayMs);
+		else
+			snprintf(line, sizeof(line), "GPU    N/A");
+		lines.push_back(line);
+		if (m_ModelResident)
+		{
+			snprintf(line, sizeof(line), "DRAWS %u  MATERIALS %u  TRIS %llu  LOD %zu/%zu", m_DrawStats.draws, m_DrawStats.materialBinds,
+				static_cast<unsigned long long>(m_DrawStats.triangles), m_CurrentLod, m_Mesh.lods.size());
+			lines.push_back(line);
+			if (m_GpuShadedPerTriangle > 0.0 && m_GpuSceneFragments > 0)
+				snprintf(line, sizeof(line), "ACMR %.3f  GPU VS/TRI %.3f  NS/FRAG %.3f", m_MeshStatistics.acmr, m_GpuShadedPerTriangle, m_GpuSceneMs * 1e6 / m_GpuSceneFragments);
+			else if (m_GpuShadedPerTriangle > 0.0)
+				snprintf(line, sizeof(line), "ACMR %.3f  GPU VS/TRI %.3f", m_MeshStatistics.acmr, m_GpuShadedPerTriangle);
+			else
+				snprintf(line, sizeof(line), "ACMR %.3f", m_MeshStatistics.acmr);
+			lines.push_back(line);
+			if (m_TextureStreamingEnabled && !m_TextureStreams.empty())
+			{
+				snprintf(line, sizeof(line), "STREAMED %zu  %.1f/%u MIB", m_TextureStreams.size(), m_StreamedBytes / 1048576.0, g_LaunchOptions.textureBudgetMiB);
+				lines.push_back(line);
+			}
+		}
+		else
+		{
+			snprintf(line, sizeof(line), "DRAWS %u  TRIS %llu  LOADING MODEL", m_DrawStats.draws, static_cast<unsigned long long>(m_DrawStats.triangles));
+			lines.push_back(line);
+		}
+		std::vector<VkDeviceSize> heapUsage;
+		{
+			std::lock_guard<std::mutex> lock(m_DeviceMemoryMutex);
+			heapUsage = m_HeapUsage;
+		}
+		for (uint32_t heap = 0; heap < heapUsage.size(); heap++)
+		{
+			bool deviceLocal = m_MemoryProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+			snprintf(line, sizeof(line), "HEAP %u %s %7.1f / %.0f MB", heap, deviceLocal ? "VRAM" : "SYS ",
+				heapUsage[heap] / (1024.0 * 1024.0), m_MemoryProperties.memoryHeaps[heap].size / (1024.0 * 1024.0));
+			lines.push_back(line);
+		}
+		snprintf(line, sizeof(line), "UPLOADS %u  HUD %.3f MS", m_PendingUploads.load(), m_OverlayBuildMs);
+		lines.push_back(line);
+
+		size_t longest = 0;
+		for (const auto& text : lines) longest = std::max(longest, text.size());
+
+		float graphWidth = graphBarWidth * FrameTimingMonitor::HISTORY_SIZE;
+		float panelWidth = std::max(longest * HudBuilder::GLYPH_ADVANCE * scale, graphWidth) + margin * 2.0f;
+		float panelHeight = lines.size() * lineHeight + graphHeight + margin * 3.0f;
+		hud.AddRect(margin, margin, panelWidth, panelHeight, HudColor(0, 0, 0, 160));
+
+		float y = margin * 2.0f;
+		for (const auto& text : lines)
+		{
+			hud.AddText(margin * 2.0f, y, text.c_str(), scale, textColor);
+			y += lineHeight;
+		}
+
+		float graphTop = y + margin, graphBottom = graphTop + graphHeight, graphLeft = margin * 2.0f;
+		hud.AddRect(graphLeft, graphTop, graphWidth, graphHeight, HudColor(40, 40, 40, 160));
+
+		// Newest frame on the right
+		size_t count = m_FrameMonitor.RecentCount();
+		for (size_t age = 0; age < count; age++)
+		{
+			const FramePhaseTimings& frame = m_FrameMonitor.Recent(age);
+			float x = graphLeft + graphWidth - (age + 1) * graphBarWidth;
+
+			float height = static_cast<float>(std::min(frame.intervalMs, (double)graphRangeMs) / graphRangeMs) * graphHeight;
+			uint32_t color = frame.intervalMs > targetMs * 2.0 ? HudColor(230, 60, 50) : frame.intervalMs > targetMs ? HudColor(230, 200, 50) : HudColor(80, 200, 90);
+			hud.AddRect(x, graphBottom - height, graphBarWidth - 1.0f, height, color);
+
+			if (frame.gpuMs >= 0.0)
+			{
+				float gpuHeight = static_cast<float>(std::min(frame.gpuMs, (double)graphRangeMs) / graphRangeMs) * graphHeight;
+				hud.AddRect(x, graphBottom - gpuHeight, graphBarWidth - 1.0f, 1.0f, HudColor(90, 160, 255));
+			}
+		}
+
+		float targetY = graphBottom - static_cast<float>(targetMs / graphRangeMs) * graphHeight;
+		hud.AddRect(graphLeft, targetY, graphWidth, 1.0f, HudColor(255, 255, 255, 200));
+		hud.AddText(graphLeft + 2.0f, targetY - HudBuilder::LINE_HEIGHT, "16.6", 1.0f, dimColor);
+	}
+
+	void CreateCommandPool()
+	{
+		QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(m_PhysicalDevice);
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+		if (vkCreateCommandPool(m_Device, &poolInfo, m_Allocator, &m_CommandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create command pool!");
+		}
+
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		if (vkCreateCommandPool(m_Device, &poolInfo, m_Allocator, &m_LoaderCommandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create loader command pool!");
+		}
+
+	}
+
+	// Whether the graphics queue writes timestamps
+	bool SupportsTimestamps()
+	{
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(m_PhysicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(m_PhysicalDevice, &queueFamilyCount, queueFamilies.data());
+
+		QueueFamilyIndices indices = FindQueueFamilies(m_PhysicalDevice);
+		return queueFamilies[indices.graphicsFamily.value()].timestampValidBits != 0;
+	}
+
+	// TIMESTAMPS_PER_FRAME timestamps per swapchain image bracketing the passes of the frame's command buffer
+	void CreateTimestampQueryPool()
+	{
+		if (!SupportsTimestamps())
+		{
+			m_TimestampQueryPool = VK_NULL_HANDLE;
+			return;
+		}
+
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType			= VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType		= VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount	= static_cast<uint32_t>(m_SwapchainImages.size()) * TIMESTAMPS_PER_FRAME;
+
+		if (vkCreateQueryPool(m_Device, &queryPoolInfo, m_Allocator, &m_TimestampQueryPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create timestamp query pool!");
+		}
+		m_TimestampsWritten.assign(m_SwapchainImages.size(), false);
+	}
+
+	// GPU time of the last command buffer submitted for this image, negative if not available yet.
+	// Also updates the per pass timings shown in the HUD.
+	double ReadGpuFrameTime(uint32_t imageIndex)
+	{
+		if (m_TimestampQueryPool == VK_NULL_HANDLE || !m_TimestampsWritten[imageIndex]) return -1.0;
+
+		uint64_t timestamps[TIMESTAMPS_PER_FRAME];
+		VkResult result = vkGetQueryPoolResults(m_Device, m_TimestampQueryPool, imageIndex * TIMESTAMPS_PER_FRAME, TIMESTAMPS_PER_FRAME,
+			sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if (result != VK_SUCCESS) return -1.0;
+
+		auto toMs = [&](uint64_t start, uint64_t end) { return static_cast<double>(end - start) * m_TimestampPeriod / 1e6; };
+		m_GpuSceneMs	= toMs(timestamps[0], timestamps[1]);
+		m_GpuOverlayMs	= toMs(timestamps[1], timestamps[2]);
+		return toMs(timestamps[0], timestamps[2]);
+	}
+
+	// One query per swapchain image counting the primitives, vertex and fragment shader invocations of the scene draw
+	void CreatePipelineStatisticsQueryPool()
+	{
+		if (!m_PipelineStatisticsSupported) return;
+
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType					= VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType				= VK_QUERY_TYPE_PIPELINE_STATISTICS;
+		queryPoolInfo.queryCount			= static_cast<uint32_t>(m_SwapchainImages.size());
+		queryPoolInfo.pipelineStatistics	= VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+		if (vkCreateQueryPool(m_Device, &queryPoolInfo, m_Allocator, &m_PipelineStatisticsQueryPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create pipeline statistics query pool!");
+		}
+		m_PipelineStatisticsWritten.assign(m_SwapchainImages.size(), false);
+	}
+
+	// Vertex shader invocations per triangle of the last scene draw for this image, the ACMR the GPU actually
+	// achieved, and the fragments it shaded. Texture cache misses show up as scene GPU time per fragment.
+	void ReadPipelineStatistics(uint32_t imageIndex)
+	{
+		m_GpuSceneFragments = 0;
+		if (m_PipelineStatisticsQueryPool == VK_NULL_HANDLE || !m_PipelineStatisticsWritten[imageIndex]) return;
+
+		// Results come in the order of the bits: input assembly primitives, vertex then fragment shader invocations
+		uint64_t statistics[3];
+		VkResult result = vkGetQueryPoolResults(m_Device, m_PipelineStatisticsQueryPool, imageIndex, 1,
+			sizeof(statistics), statistics, sizeof(statistics), VK_QUERY_RESULT_64_BIT);
+		if (result != VK_SUCCESS || statistics[0] == 0) return;
+
+		m_GpuShadedPerTriangle	= static_cast<double>(statistics[1]) / statistics[0];
+		m_GpuSceneFragments		= statistics[2];
+	}
+
+	void CreateColorResources()
+	{
+		VkFormat colorFormat = m_SwapchainFormat;
+		CreateImage(m_Extent.width, m_Extent.height, 1, m_MsaaSamples, colorFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_ColorImage, m_ColorImageMemory);
+		m_ColorImageView = CreateImageView(m_ColorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+	}
+
+	void CreateDepthResources()
+	{
+		VkFormat depthFormat = findDepthFormat();
+		CreateImage(m_Extent.width, m_Extent.height, 1, m_MsaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_DepthImage, m_DepthImageMemory);
+		m_DepthImageView = CreateImageView(m_DepthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+		TransitionImageLayout(m_DepthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
+	}
+
+	bool HasStencilComponent(VkFormat format) {
+		return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+	}
+
+	VkFormat findDepthFormat() {
+		return FindSupportedFormat(
+			{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+		);
+	}
+
+	bool IsFormatSupported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features) {
+		VkFormatProperties props;
+		vkGetPhysicalDeviceFormatProperties(m_PhysicalDevice, format, &props);
+
+		if (tiling == VK_IMAGE_TILING_LINEAR) {
+			return (props.linearTilingFeatures & features) == features;
+		}
+		return tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features;
+	}
+
+	VkFormat FindSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
+		for (VkFormat format : candidates) {
+			if (IsFormatSupported(format, tiling, features)) {
+				return format;
+			}
+		}
+
+		throw std::runtime_error("failed to find supported format!");
+	}
+
+	// Maps and decodes an image file into RGBA8. If staged, the image ends up in a persistently mapped
+	// staging buffer that the upload then reads. Where that buffer is host cached the decoder writes
+	// straight into it, see StbiOutput, so there is no heap copy of the image to make and free. Free the result with FreeDecodedImage. Decodes go through the texture
+	// cache, so a file whose contents were decoded before, under any path, is only copied.
+	DecodedImage DecodeTexture(const std::string& path, bool staged)
+	{
+		MappedFile file;
+		{
+			AssetLoadProfiler::Scope scope(g_AssetProfiler, path, AssetStage::FileIO);
+			if (!file.Open(path)) throw std::runtime_error("failed to open file " + path);
+			scope.bytes = file.Size();
+		}
+
+		DecodedImage image{};
+		{
+			AssetLoadProfiler::Scope scope(g_AssetProfiler, path, AssetStage::Dedup, file.Size());
+			image.contentHash = HashBytes(file.Data(), file.Size());
+		}
+		if (ReadTextureCache(path, staged, image))
+		{
+			// Marks the entry as recently used for PruneTextureCache, now that it is no longer mapped
+			std::error_code error;
+			std::filesystem::last_write_time(TextureCachePath(image.contentHash), std::filesystem::file_time_type::clock::now(), error);
+			return image;
+		}
+
+		DecodeTextureFile(path, file, staged, image);
+		WriteTextureCache(path, image);
+		return image;
+	}
+
+	// Decodes the mapped image file with stb_image, see DecodeTexture
+	void DecodeTextureFile(const std::string& path, const MappedFile& file, bool staged, DecodedImage& image)
+	{
+		AssetLoadProfiler::Scope scope(g_AssetProfiler, path, AssetStage::Decode);
+		int texChannels;
+		void* mapped = nullptr;
+		if (staged && stbi_info_from_memory(file.Data(), static_cast<int>(file.Size()), &image.width, &image.height, &texChannels))
+		{
+			image.staging.size = static_cast<uint64_t>(image.width) * static_cast<uint64_t>(image.height) * 4 + STBI_OUTPUT_SLACK;
+			CreateBuffer(image.staging.size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, StagingMemoryProperties(), image.staging.buffer, image.staging.memory);
+			vkMapMemory(m_Device, image.staging.memory, 0, image.staging.size, 0, &mapped);
+		}
+
+		// Uncached memory is write combined, and the decoder's reads from it would cost more than the copy
+		const bool direct = (StagingMemoryProperties() & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0;
+		t_StbiOutput = { direct ? mapped : nullptr, static_cast<size_t>(image.staging.size), false };
+		image.pixels = stbi_load_from_memory(file.Data(), static_cast<int>(file.Size()), &image.width, &image.height, &texChannels, STBI_rgb_alpha);
+		t_StbiOutput = {};
+
+		if (!image.pixels) {
+			FreeDecodedImage(image);
+			std::cerr << stbi_failure_reason() << std::endl;
+			throw std::runtime_error("failed to load image " + path);
+		}
+
+		image.size = static_cast<uint64_t>(image.width) * static_cast<uint64_t>(image.height) * 4; // casting to uint64_t to make sure there's no loss of data during multiplication
+		if (mapped && image.pixels != mapped)
+		{
+			memcpy(mapped, image.pixels, static_cast<size_t>(image.size));
+			stbi_image_free(image.pixels);
+			image.pixels = static_cast<stbi_uc*>(mapped);
+		}
+		scope.bytes = image.size;
+	}
+
+	// Entry of the texture cache for an image file's contents: its decode as a single level RGBA8 KTX2 file
+	static std::string TextureCachePath(uint64_t contentHash)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.ktx2", static_cast<unsigned long long>(contentHash));
+		return (std::filesystem::path(g_LaunchOptions.textureCache) / name).string();
+	}
+
+	// Fills image with the cached decode of image.contentHash. Returns false if there is none or the
+	// entry is not a width x height RGBA8 image, the caller decodes the file then and replaces it.
+	bool ReadTextureCache(const std::string& path, bool staged, DecodedImage& image)
+	{
+		if (g_LaunchOptions.textureCache.empty()) return false;
+
+		MappedFile file;
+		{
+			AssetLoadProfiler::Scope scope(g_AssetProfiler, path, AssetStage::FileIO);
+			if (!file.Open(TextureCachePath(image.contentHash))) return false;
+			scope.bytes = file.Size();
+		}
+
+		ktx2::Image cached;
+		std::string error;
+		if (!ktx2::Parse(file.Data(), file.Size(), cached, error) || cached.format != VK_FORMAT_R8G8B8A8_SRGB ||
+			cached.levels[0].size != static_cast<uint64_t>(cached.width) * cached.height * 4)
+			return false;
+
+		image.width		= static_cast<int>(cached.width);
+		image.height	= static_cast<int>(cached.height);
+		image.size		= cached.levels[0].size;
+
+		// Heap pixels are freed by stbi_image_free like a decode's
+		AssetLoadProfiler::Scope scope(g_AssetProfiler, path, AssetStage::StagingCopy, image.size);
+		void* pixels;
+		if (staged)
+		{
+			image.staging.size = image.size;
+			CreateBuffer(image.staging.size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, StagingMemoryProperties(), image.staging.buffer, image.staging.memory);
+			vkMapMemory(m_Device, image.staging.memory, 0, image.staging.size, 0, &pixels);
+		}
+		else
+			pixels = malloc(static_cast<size_t>(image.size));
+		memcpy(pixels, file.Data() + cached.levels[0].offset, static_cast<size_t>(image.size));
+		image.pixels = static_cast<stbi_uc*>(pixels);
+		return true;
+	}
+
+	// Adds a decode to the texture cache, written to a temporary file first so a crash never leaves a torn
+	// entry. Files with the same contents may be decoded on several workers at once, each writes its own
+	// temporary file and the last rename wins.
+	void WriteTextureCache(const std::string& path, const DecodedImage& image)
+	{
+		if (g_LaunchOptions.textureCache.empty()) return;
+
+		std::vector<uint8_t> entry = ktx2::Write(VK_FORMAT_R8G8B8A8_SRGB, static_cast<uint32_t>(image.width), static_cast<uint32_t>(image.height),
+			{ std::vector<uint8_t>(image.pixels, image.pixels + image.size) });
+		AssetLoadProfiler::Scope scope(g_AssetProfiler, path, AssetStage::FileIO, entry.size());
+
+		std::error_code error;
+		std::filesystem::create_directories(g_LaunchOptions.textureCache, error);
+		std::string cachePath = TextureCachePath(image.contentHash);
+		std::string tempPath = cachePath + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(entry.data()), entry.size());
+		file.close();
+
+		if (file.fail())
+			std::cerr << "Could not write texture cache " << tempPath << std::endl;
+		else
+			std::filesystem::rename(tempPath, cachePath, error);
+
+		if (file.fail() || error)
+			std::filesystem::remove(tempPath, error);
+	}
+
+	// Deletes the least recently used texture cache entries until the cache fits in its budget. Reads
+	// and writes set an entry's write time, so the oldest entries are the ones no recent run needed.
+	static void PruneTextureCache()
+	{
+		if (g_LaunchOptions.textureCache.empty()) return;
+
+		struct Entry
+		{
+			std::filesystem::file_time_type	used;
+			uintmax_t						size;
+			std::filesystem::path			path;
+		};
+		std::vector<Entry> entries;
+		uintmax_t total = 0;
+		std::error_code error;
+		for (std::filesystem::directory_iterator it(g_LaunchOptions.textureCache, error), end; !error && it != end; it.increment(error))
+		{
+			if (it->path().extension() != ".ktx2") continue;
+			std::error_code entryError;
+			Entry entry{ it->last_write_time(entryError), it->file_size(entryError), it->path() };
+			if (entryError) continue;
+			total += entry.size;
+			entries.push_back(std::move(entry));
+		}
+
+		const uintmax_t budget = static_cast<uintmax_t>(g_LaunchOptions.textureCacheBudgetMiB) * 1024 * 1024;
+		if (total <= budget) return;
+
+		std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+		size_t removed = 0;
+		for (const Entry& entry : entries)
+		{
+			if (total <= budget) break;
+			if (std::filesystem::remove(entry.path, error))
+			{
+				total -= entry.size;
+				removed++;
+			}
+		}
+		if (g_LaunchOptions.verbose)
+			std::cout << "Pruned " << removed << " texture cache entries to stay within " << g_LaunchOptions.textureCacheBudgetMiB << " MiB" << std::endl;
+	}
+
+	void FreeDecodedImage(const DecodedImage& image)
+	{
+		if (image.staging.buffer == VK_NULL_HANDLE)
+		{
+			stbi_image_free(image.pixels);
+			return;
+		}
+		vkUnmapMemory(m_Device, image.staging.memory);
+		vkDestroyBuffer(m_Device, image.staging.buffer, m_Allocator);
+		FreeDeviceMemory(image.staging.memory);
+	}
+
+	// Staging memory the CPU also reads, as the PNG decoder does with the previous row while it
+	// unfilters. Reads from uncached, write combined memory are very slow, so cached memory is used
+	// where the device has it.
+	VkMemoryPropertyFlags StagingMemoryProperties() const
+	{
+		const VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++)
+		{
+			if ((m_MemoryProperties.memoryTypes[i].propertyFlags & cached) == cached)
+				return cached;
+		}
+		return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	}
+
+	// Creates a host visible buffer holding a copy of data, the copy is accounted to asset
+	void CreateStagingBuffer(const std::string& asset, const void* source, VkDeviceSize size, VkBuffer& buffer, VkDeviceMemory& memory)
+	{
+		CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, memory);
 
+		AssetLoadProfiler::Scope scope(g_AssetProfiler, asset, AssetStage::StagingCopy, size);
+		void* data;
+		vkMapMemory(m_Device, memory, 0, size, 0, &data);
+		memcpy(data, source, static_cast<size_t>(size));
+		vkUnmapMemory(m_Device, memory);
+	}
 
-		VkPipelineMultisampleStateCreateInfo multisampling{};
-		multisampling.sType =					VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		multisampling.sampleShadingEnable =		VK_TRUE;
-		multisampling.rasterizationSamples =	m_MsaaSamples;
-		multisampling.minSampleShading =		1.0f; // Optional
-		multisampling.pSampleMask =				nullptr; // Optional
-		multisampling.alphaToCoverageEnable =	VK_FALSE; // Optional
-		multisampling.alphaToOneEnable =		VK_FALSE; // Optional
+	// Falls back to the default texture when a material names none or names a file that is missing
+	static std::string ResolveTexturePath(const std::string& path, const std::string& fallback)
+	{
+		if (path.empty()) return fallback;
+		if (std::filesystem::exists(path)) return path;
+		std::cerr << "Texture " << path << " not found, using " << fallback << std::endl;
+		return fallback;
+	}
 
-		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-		colorBlendAttachment.colorWriteMask =		VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-		colorBlendAttachment.blendEnable =			VK_FALSE;
-		colorBlendAttachment.srcColorBlendFactor =	VK_BLEND_FACTOR_ONE; // Optional
-		colorBlendAttachment.dstColorBlendFactor =	VK_BLEND_FACTOR_ZERO; // Optional
-		colorBlendAttachment.colorBlendOp =			VK_BLEND_OP_ADD; // Optional
-		colorBlendAttachment.srcAlphaBlendFactor =	VK_BLEND_FACTOR_ONE; // Optional
-		colorBlendAttachment.dstAlphaBlendFactor =	VK_BLEND_FACTOR_ZERO; // Optional
-		colorBlendAttachment.alphaBlendOp =			VK_BLEND_OP_ADD; // Optional
+	// Loads the diffuse and specular texture of every material, each file once. Every decode the model
+	// needs is in flight before the first upload waits on one, and all uploads go in a single submit.
+	void CreateTextureImage()
+	{
+		PrefetchTextures(m_Mesh.materials);
 
-		colorBlendAttachment.blendEnable =			VK_TRUE;
-		colorBlendAttachment.srcColorBlendFactor =	VK_BLEND_FACTOR_SRC_ALPHA;
-		colorBlendAttachment.dstColorBlendFactor =	VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-		colorBlendAttachment.colorBlendOp =			VK_BLEND_OP_ADD;
-		colorBlendAttachment.srcAlphaBlendFactor =	VK_BLEND_FACTOR_ONE;
-		colorBlendAttachment.dstAlphaBlendFactor =	VK_BLEND_FACTOR_ZERO;
-		colorBlendAttachment.alphaBlendOp =			VK_BLEND_OP_ADD;
+		m_TextureUpload.commands = BeginSingleTimeCommand();
+		if (m_LoaderTimestamps && !m_Mesh.materials.empty())
+		{
+			// A pair around the mip generation of each texture, at most two textures per material
+			m_TextureUpload.timestampCapacity = 2 * 2 * static_cast<uint32_t>(m_Mesh.materials.size());
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType			= VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType		= VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount	= m_TextureUpload.timestampCapacity;
+			if (vkCreateQueryPool(m_Device, &queryPoolInfo, m_Allocator, &m_TextureUpload.timestamps) != VK_SUCCESS)
+				throw std::runtime_error("failed to create texture upload query pool!");
+			vkCmdResetQueryPool(m_TextureUpload.commands, m_TextureUpload.timestamps, 0, m_TextureUpload.timestampCapacity);
+		}
+		m_MaterialTextures.clear();
+		for (const MeshMaterial& material : m_Mesh.materials)
+		{
+			MaterialTextures textures;
+			textures.diffuse	= LoadTexture(ResolveTexturePath(material.diffuseTexture, TEXTURE_PATH), true);
+			textures.specular	= LoadTexture(ResolveTexturePath(material.specularTexture, SPEC_TEXTURE_PATH), true);
+			m_MaterialTextures.push_back(textures);
+		}
 
-		VkPipelineColorBlendStateCreateInfo colorBlending{};
-		colorBlending.sType =				VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		colorBlending.logicOpEnable =		VK_FALSE;
-		colorBlending.logicOp =				VK_LOGIC_OP_COPY; // Optional
-		colorBlending.attachmentCount =		1;
-		colorBlending.pAttachments =		&colorBlendAttachment;
-		colorBlending.blendConstants[0] =	0.0f; // Optional
-		colorBlending.blendConstants[1] =	0.0f; // Optional
-		colorBlending.blendConstants[2] =	0.0f; // Optional
-		colorBlending.blendConstants[3] =	0.0f; // Optional
+		VkDeviceSize bytes = 0, uncompressedBytes = 0;
+		for (const Texture& texture : m_Textures)
+		{
+			bytes				+= texture.size;
+			uncompressedBytes	+= static_cast<VkDeviceSize>(texture.width) * texture.height * 4 + MipChainBytes(texture.width, texture.height, texture.mipLevels);
+		}
+		{
+			AssetLoadProfiler::Scope scope(g_AssetProfiler, "texture uploads", AssetStage::GpuUpload, bytes);
+			EndSingleTimeCommand(m_TextureUpload.commands);
+		}
+		m_TextureUpload.commands = VK_NULL_HANDLE;
+		ReadMipGenerationTimestamps();
+		ReleaseTextureUploadBatch();
+		ReleaseTextureDecodes();	// the decoded images are the staging buffers of the uploads above
 
-		VkDynamicState dynamicStates[] = {
-			VK_DYNAMIC_STATE_VIEWPORT,
-			VK_DYNAMIC_STATE_LINE_WIDTH
-		};
+		if (g_LaunchOptions.verbose)
+		{
+			std::cout << "Loaded " << m_Textures.size() << " textures from " << m_Mesh.materials.size() << " materials ("
+				<< m_TextureIndices.size() - m_Textures.size() << " files shared a texture with identical contents), "
+				<< std::fixed << std::setprecision(1) << bytes / (1024.0 * 1024.0) << " MiB of texels (" << uncompressedBytes / (1024.0 * 1024.0) << " MiB as RGBA8)"
+				<< std::defaultfloat << std::endl;
+		}
 
-		VkPipelineDynamicStateCreateInfo dynamicState{};
-		dynamicState.sType =				VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-		dynamicState.dynamicStateCount =	2;
-		dynamicState.pDynamicStates =		dynamicStates;
+		PruneTextureCache();
+	}
 
-		VkPipelineDepthStencilStateCreateInfo depthStencil{};
-		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-		depthStencil.depthTestEnable = VK_TRUE;
-		depthStencil.depthWriteEnable = VK_TRUE;
-		depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-		depthStencil.depthBoundsTestEnable = VK_FALSE;
-		depthStencil.minDepthBounds = 0.0f; // Optional
-		depthStencil.maxDepthBounds = 1.0f; // Optional
-		depthStencil.stencilTestEnable = VK_FALSE;
-		depthStencil.front = {}; // Optional
-		depthStencil.back= {}; // Optional
+	// Adds up the GPU time of every GenerateMipmaps in the completed texture upload batch
+	void ReadMipGenerationTimestamps()
+	{
+		uint32_t count = m_TextureUpload.timestampCount;
+		if (count == 0) return;
 
-		VkPushConstantRange vpcr{};
-		vpcr.offset = 0;
-		vpcr.size = sizeof(glm::vec4);
-		vpcr.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		std::vector<uint64_t> timestamps(count);
+		if (vkGetQueryPoolResults(m_Device, m_TextureUpload.timestamps, 0, count, timestamps.size() * sizeof(uint64_t), timestamps.data(),
+			sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+			return;
 
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType					= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount			= 1; // Optional
-		pipelineLayoutInfo.pSetLayouts				= &m_DescriptorSetLayout; // Optional
-		pipelineLayoutInfo.pushConstantRangeCount	= 0; // Optional
-		pipelineLayoutInfo.pPushConstantRanges		= nullptr; // Optional
+		m_MipGenerationGpuMs = 0.0;
+		for (uint32_t i = 0; i + 1 < count; i += 2)
+			m_MipGenerationGpuMs += static_cast<double>(timestamps[i + 1] - timestamps[i]) * m_TimestampPeriod / 1e6;
+		if (g_LaunchOptions.verbose)
+		{
+			std::cout << "Generated the mips of " << count / 2 << " textures in " << m_MipGenerationGpuMs << " ms of GPU time ("
+				<< (UseComputeMipGeneration(VK_FORMAT_R8G8B8A8_SRGB) ? "compute" : "blit") << ")" << std::endl;
+		}
+	}
 
-		if (vkCreatePipelineLayout(m_Device, &pipelineLayoutInfo, nullptr, &m_PipelineLayout) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create pipeline layout!");
+	// Frees what the texture upload batch needed until it completed
+	void ReleaseTextureUploadBatch()
+	{
+		for (const StagingBuffer& staging : m_TextureUpload.stagingBuffers)
+		{
+			vkDestroyBuffer(m_Device, staging.buffer, m_Allocator);
+			FreeDeviceMemory(staging.memory);
 		}
+		for (VkImageView view : m_TextureUpload.views)
+			vkDestroyImageView(m_Device, view, m_Allocator);
+		for (VkDescriptorPool pool : m_TextureUpload.descriptorPools)
+			vkDestroyDescriptorPool(m_Device, pool, m_Allocator);
+		if (m_TextureUpload.timestamps != VK_NULL_HANDLE)
+			vkDestroyQueryPool(m_Device, m_TextureUpload.timestamps, m_Allocator);
+		m_TextureUpload = {};
+	}
 
-		VkGraphicsPipelineCreateInfo pipelineInfo{};
-		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount = 2;
-		pipelineInfo.pStages = shaderStages;
+	// Timestamp in the texture upload batch once everything recorded before it has finished
+	void WriteUploadTimestamp()
+	{
+		if (m_TextureUpload.timestamps != VK_NULL_HANDLE && m_TextureUpload.timestampCount < m_TextureUpload.timestampCapacity)
+			vkCmdWriteTimestamp(m_TextureUpload.commands, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_TextureUpload.timestamps, m_TextureUpload.timestampCount++);
+	}
 
-		pipelineInfo.pVertexInputState =	&vertexInputInfo;
-		pipelineInfo.pInputAssemblyState =	&inputAssembly;
-		pipelineInfo.pViewportState =		&viewportState;
-		pipelineInfo.pRasterizationState =	&rasterizer;
-		pipelineInfo.pMultisampleState =	&multisampling;
-		pipelineInfo.pDepthStencilState =	&depthStencil; // Optional
-		pipelineInfo.pColorBlendState =		&colorBlending;
-		pipelineInfo.pDynamicState =		nullptr; // Optional
+	// KTX2 file next to an image, uploaded in its place when there is one
+	static std::string CompressedTexturePath(const std::string& path)
+	{
+		return std::filesystem::path(path).replace_extension(".ktx2").string();
+	}
 
-		pipelineInfo.layout =				m_PipelineLayout;
+	// Starts decoding the textures of every material on m_DecodePool, along with the fallback textures.
+	// Textures that are missing or have a KTX2 file are left out, LoadTexture decodes those itself if
+	// it has to.
+	void PrefetchTextures(const std::vector<MeshMaterial>& materials)
+	{
+		std::vector<std::string> paths = { TEXTURE_PATH, SPEC_TEXTURE_PATH };
+		for (const MeshMaterial& material : materials)
+		{
+			paths.push_back(material.diffuseTexture);
+			paths.push_back(material.specularTexture);
+		}
+		for (const std::string& path : paths)
+		{
+			if (!path.empty() && std::filesystem::exists(path) && !std::filesystem::exists(CompressedTexturePath(path)))
+				DecodeTextureAsync(path);
+		}
+	}
 
-		pipelineInfo.renderPass =			m_RenderPass;
-		pipelineInfo.subpass =				0;
+	// Prefetches the textures named by the material table of the mesh cache, so they decode while the
+	// swapchain and pipelines are created and the model is loaded. It runs once there is a device for
+	// the decodes to stage into. Before the first bake only the fallbacks are known.
+	void PrefetchCachedTextures()
+	{
+		std::vector<MeshMaterial> materials;
+		PeekMeshCacheMaterials(MODEL_PATH, materials);
+		PrefetchTextures(materials);
+	}
 
-		// Used for derived pipelines
-		pipelineInfo.basePipelineHandle =	VK_NULL_HANDLE; // Optional
-		pipelineInfo.basePipelineIndex =	-1; // Optional
+	// Decode of path on m_DecodePool, started by the first call
+	const std::shared_future<DecodedImage>& DecodeTextureAsync(const std::string& path)
+	{
+		auto found = m_TextureDecodes.find(path);
+		if (found == m_TextureDecodes.end())
+		{
+			bool staged = m_Device != VK_NULL_HANDLE;
+			std::shared_future<DecodedImage> decode = m_DecodePool.Submit([this, path, staged]() {
+				HostAllocationTracker::Tag tag(g_HostAllocations, "DecodeTexture");
+				return DecodeTexture(path, staged);
+			});
+			found = m_TextureDecodes.emplace(path, std::move(decode)).first;
+		}
+		return found->second;
+	}
 
-		if (vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_Pipeline) != VK_SUCCESS)
+	// Waits for the decodes still running and frees every decoded image. Errors were already thrown to
+	// the loads that used the image, prefetched images nothing used are dropped quietly.
+	void ReleaseTextureDecodes()
+	{
+		for (auto& [path, decode] : m_TextureDecodes)
 		{
-			throw std::runtime_error("Failed to create Graphics Pipeline");
+			try
+			{
+				FreeDecodedImage(decode.get());
+			}
+			catch (const std::exception&) {}
 		}
+		m_TextureDecodes.clear();
 	}
 
-	void CreateFrameBuffers()
+	// Index into m_Textures of path, recorded into m_TextureUpload.commands on first use with a full mip
+	// chain if mipmapped. A KTX2 file next to the image with the same name is uploaded instead of
+	// decoding the image. Textures are loaded once and live as long as the model, so sharing needs no
+	// reference counts.
+	uint32_t LoadTexture(const std::string& path, bool mipmapped)
 	{
-		m_SwapchainFramebuffers.resize(m_SwapchainImageViews.size());
-		
-		for (size_t i = 0; i < m_SwapchainImageViews.size(); i++) {
-			std::array<VkImageView, 3> attachments = {
-				m_ColorImageView,
-				m_DepthImageView,
-				m_SwapchainImageViews[i]
-			};
+		auto found = m_TextureIndices.find({ path, mipmapped });
+		if (found == m_TextureIndices.end())
+			found = m_TextureIndices.emplace(std::make_pair(path, mipmapped), LoadTextureContents(path, mipmapped)).first;
+		return found->second;
+	}
 
-			VkFramebufferCreateInfo framebufferInfo{};
-			framebufferInfo.sType =				VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			framebufferInfo.renderPass =		m_RenderPass;
-			framebufferInfo.attachmentCount =	static_cast<uint32_t>(attachments.size());
-			framebufferInfo.pAttachments =		attachments.data();
-			framebufferInfo.width =				m_Extent.width;
-			framebufferInfo.height =			m_Extent.height;
-			framebufferInfo.layers =			1;
+	// Index into m_Textures of the contents of path, files with the same bytes share one texture whatever
+	// their path. The bytes hashed are the KTX2 file's when it is used, the image's otherwise.
+	uint32_t LoadTextureContents(const std::string& path, bool mipmapped)
+	{
+		std::string compressedPath = CompressedTexturePath(path);
+		if (std::filesystem::exists(compressedPath))
+		{
+			uint64_t contentHash = HashFile(compressedPath);
+			auto shared = m_TextureContents.find({ contentHash, mipmapped });
+			if (shared != m_TextureContents.end()) return shared->second;
 
-			if (vkCreateFramebuffer(m_Device, &framebufferInfo, nullptr, &m_SwapchainFramebuffers[i]) != VK_SUCCESS) {
-				throw std::runtime_error("failed to create framebuffer!");
-			}
+			Texture texture;
+			if (LoadCompressedTexture(compressedPath, mipmapped, texture))
+				return AddTexture(texture, contentHash, mipmapped);
 		}
+
+		uint64_t contentHash = DecodeTextureAsync(path).get().contentHash;
+		auto shared = m_TextureContents.find({ contentHash, mipmapped });
+		if (shared != m_TextureContents.end()) return shared->second;
+
+		Texture texture;
+		LoadDecodedTexture(path, mipmapped, texture);
+		return AddTexture(texture, contentHash, mipmapped);
 	}
 
-	void CreateCommandPool()
+	uint32_t AddTexture(const Texture& texture, uint64_t contentHash, bool mipmapped)
 	{
-		QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(m_PhysicalDevice);
+		m_Textures.push_back(texture);
+		uint32_t index = static_cast<uint32_t>(m_Textures.size() - 1);
+		m_TextureContents[{ contentHash, mipmapped }] = index;
+		return index;
+	}
 
-		VkCommandPoolCreateInfo poolInfo{};
-		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+	// HashBytes of a whole file, 0 if it cannot be read
+	static uint64_t HashFile(const std::string& path)
+	{
+		MappedFile file;
+		AssetLoadProfiler::Scope scope(g_AssetProfiler, path, AssetStage::Dedup);
+		if (!file.Open(path)) return 0;
+		scope.bytes = file.Size();
+		return HashBytes(file.Data(), file.Size());
+	}
 
-		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	// Decodes an image file to RGBA8, or takes the prefetched decode, and generates its mips on the GPU.
+	// The decode already is the staging buffer.
+	void LoadDecodedTexture(const std::string& path, bool mipmapped, Texture& texture)
+	{
+		const DecodedImage& decoded = DecodeTextureAsync(path).get();
+		uint32_t texWidth = static_cast<uint32_t>(decoded.width), texHeight = static_cast<uint32_t>(decoded.height);
+
+		texture.width	= texWidth;
+		texture.height	= texHeight;
+		if (mipmapped)
+			texture.mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texHeight, texWidth)))) + 1;	// down to 1x1
+		texture.size	= decoded.size + MipChainBytes(texWidth, texHeight, texture.mipLevels);
+
+		// Images decoded without a device are on the heap and still need a copy
+		StagingBuffer staging = decoded.staging;
+		if (staging.buffer == VK_NULL_HANDLE)
+		{
+			staging.size = decoded.size;
+			CreateStagingBuffer(path, decoded.pixels, decoded.size, staging.buffer, staging.memory);
+			m_TextureUpload.stagingBuffers.push_back(staging);
+		}
 
-		if (vkCreateCommandPool(m_Device, &poolInfo, nullptr, &m_CommandPool) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create command pool!");
+		// Mips written by mipgen.comp need an image with storage support, which sRGB formats lack, so the
+		// image is UNORM and only viewed as sRGB
+		if (mipmapped && UseComputeMipGeneration(VK_FORMAT_R8G8B8A8_SRGB))
+			CreateImage(texWidth, texHeight, texture.mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.memory, VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT);
+		else
+			CreateImage(texWidth, texHeight, texture.mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT| VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.memory);
+
+		TransitionImageLayout(m_TextureUpload.commands, texture.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.mipLevels);
+		CopyBufferToImage(m_TextureUpload.commands, staging.buffer, texture.image, { FullImageCopy(texWidth, texHeight) });
+		if (mipmapped)
+		{
+			WriteUploadTimestamp();
+			GenerateMipmaps(m_TextureUpload.commands, texture.image, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, texture.mipLevels);
+			WriteUploadTimestamp();
+		}
+		else
+			TransitionImageLayout(m_TextureUpload.commands, texture.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1);
+	}
+
+	// Uploads the levels of a KTX2 file as they are stored, only the first unless mipmapped. Block
+	// formats the device cannot sample are decoded to RGBA8 first. With texture streaming a mip chain
+	// the device samples as stored starts with its tail and keeps the file mapped for the rest. Returns
+	// false, after saying why, if the file cannot be used at all so the caller decodes the source image instead.
+	bool LoadCompressedTexture(const std::string& path, bool mipmapped, Texture& texture)
+	{
+		auto file = std::make_unique<MappedFile>();
+		{
+			AssetLoadProfiler::Scope scope(g_AssetProfiler, path, AssetStage::FileIO);
+			if (!file->Open(path)) return false;
+			scope.bytes = file->Size();
+		}
+
+		ktx2::Image image;
+		std::string error;
+		if (!ktx2::Parse(file->Data(), file->Size(), image, error))
+		{
+			std::cerr << path << ": " << error << ", decoding the source image instead" << std::endl;
+			return false;
+		}
+
+		const VkFormatFeatureFlags features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		if (!bcn::CanDecode(image.format) && !IsFormatSupported(image.format, VK_IMAGE_TILING_OPTIMAL, features))
+		{
+			std::cerr << path << ": vkFormat " << image.format << " is not supported by the device, decoding the source image instead" << std::endl;
+			return false;
+		}
+		const ktx2::FormatInfo& info = *ktx2::FindFormat(image.format);
+		std::vector<VkFormat> candidates = { image.format };
+		if (info.decodedFormat != VK_FORMAT_UNDEFINED) candidates.push_back(info.decodedFormat);
+		VkFormat format = FindSupportedFormat(candidates, VK_IMAGE_TILING_OPTIMAL, features);
+
+		uint32_t levelCount = mipmapped ? static_cast<uint32_t>(image.levels.size()) : 1;
+		texture.format		= format;
+		texture.width		= image.width;
+		texture.height		= image.height;
+		texture.mipLevels	= levelCount;
+
+		// LoadTexture gives the texture the next index, which is its feedback slot
+		uint32_t index = static_cast<uint32_t>(m_Textures.size());
+		bool streamed = m_TextureStreamingEnabled && format == image.format && levelCount > 1 && index < STREAMING_FEEDBACK_SLOTS;
+		uint32_t firstLevel = streamed ? StreamingTailLevel(image) : 0;
+		texture.residentLevel = firstLevel;
+
+		// Level offsets in the staging buffer, which holds either the file's levels as they are or the decoded texels
+		std::vector<VkBufferImageCopy> regions(levelCount - firstLevel);
+		StagingBuffer staging;
+		if (format == image.format)
+		{
+			// Levels are stored smallest first, so the ones used are the end of the file
+			uint64_t begin = image.levels[levelCount - 1].offset;
+			uint64_t end = image.levels[firstLevel].offset + image.levels[firstLevel].size;
+			for (uint32_t level = firstLevel; level < levelCount; level++)
+				regions[level - firstLevel].bufferOffset = image.levels[level].offset - begin;
+			texture.size = end - begin;
+			CreateStagingBuffer(path, file->Data() + begin, texture.size, staging.buffer, staging.memory);
+		}
+		else
+		{
+			std::vector<uint8_t> pixels;
+			{
+				AssetLoadProfiler::Scope scope(g_AssetProfiler, path, AssetStage::Decode);
+				for (uint32_t level = 0; level < levelCount; level++)
+				{
+					const ktx2::Level& source = image.levels[level];
+					regions[level].bufferOffset = pixels.size();
+					pixels.resize(pixels.size() + static_cast<size_t>(source.width) * source.height * 4);
+					bcn::DecodeImage(image.format, file->Data() + source.offset, source.width, source.height, pixels.data() + regions[level].bufferOffset);
+				}
+				scope.bytes = pixels.size();
+			}
+			std::cerr << path << ": vkFormat " << image.format << " is not supported by the device, decoded to RGBA8" << std::endl;
+			texture.size = pixels.size();
+			CreateStagingBuffer(path, pixels.data(), texture.size, staging.buffer, staging.memory);
 		}
+		staging.size = texture.size;
+		m_TextureUpload.stagingBuffers.push_back(staging);
 
+		for (uint32_t level = firstLevel; level < levelCount; level++)
+			SetLevelCopy(regions[level - firstLevel], image.levels[level], level - firstLevel);
+
+		// Streamed images also are the source of the copy into their replacement
+		VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | (streamed ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+		CreateImage(image.levels[firstLevel].width, image.levels[firstLevel].height, levelCount - firstLevel, VK_SAMPLE_COUNT_1_BIT, format, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.memory);
+		TransitionImageLayout(m_TextureUpload.commands, texture.image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount - firstLevel);
+		CopyBufferToImage(m_TextureUpload.commands, staging.buffer, texture.image, regions);
+		TransitionImageLayout(m_TextureUpload.commands, texture.image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, levelCount - firstLevel);
+
+		if (streamed && firstLevel > 0)
+		{
+			TextureStream& stream = m_TextureStreams[index];
+			stream.path			= path;
+			stream.file			= std::move(file);
+			stream.image		= image;
+			stream.tailLevel	= firstLevel;
+		}
+		return true;
 	}
 
-	void CreateColorResources()
+	// Copy of the KTX2 level source into mipLevel of an image, the buffer offset is left to the caller
+	static void SetLevelCopy(VkBufferImageCopy& region, const ktx2::Level& source, uint32_t mipLevel)
 	{
-		VkFormat colorFormat = m_SwapchainFormat;
-		CreateImage(m_Extent.width, m_Extent.height, 1, m_MsaaSamples, colorFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_ColorImage, m_ColorImageMemory);
-		m_ColorImageView = CreateImageView(m_ColorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+		region.imageSubresource.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel		= mipLevel;
+		region.imageSubresource.baseArrayLayer	= 0;
+		region.imageSubresource.layerCount		= 1;
+		region.imageExtent						= { source.width, source.height, 1 };
 	}
 
-	void CreateDepthResources()
+	// First level of the mip tail a streamed texture always keeps, the largest no bigger than STREAMING_TAIL_EXTENT
+	static uint32_t StreamingTailLevel(const ktx2::Image& image)
 	{
-		VkFormat depthFormat = findDepthFormat();
-		CreateImage(m_Extent.width, m_Extent.height, 1, m_MsaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_DepthImage, m_DepthImageMemory);
-		m_DepthImageView = CreateImageView(m_DepthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
-		TransitionImageLayout(m_DepthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
+		uint32_t level = 0;
+		while (level + 1 < image.levels.size() && std::max(image.levels[level].width, image.levels[level].height) > STREAMING_TAIL_EXTENT)
+			level++;
+		return level;
 	}
 
-	bool HasStencilComponent(VkFormat format) {
-		return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+	// Bytes of the levels first to end - 1 of a KTX2 image
+	static uint64_t StreamedBytes(const ktx2::Image& image, uint32_t first, uint32_t end)
+	{
+		uint64_t bytes = 0;
+		for (uint32_t level = first; level < end; level++)
+			bytes += image.levels[level].size;
+		return bytes;
 	}
 
-	VkFormat findDepthFormat() {
-		return FindSupportedFormat(
-			{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
-			VK_IMAGE_TILING_OPTIMAL,
-			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
-		);
+	// One buffer per frame in flight in which streamed textures report the finest mip level the
+	// fragment shader sampled, indexed by texture. Bound to every material set even without streaming.
+	void CreateTextureFeedback()
+	{
+		VkDeviceSize size = STREAMING_FEEDBACK_SLOTS * sizeof(uint32_t);
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			CreateBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, StagingMemoryProperties(), m_FeedbackBuffers[i], m_FeedbackMemories[i]);
+			void* data;
+			vkMapMemory(m_Device, m_FeedbackMemories[i], 0, size, 0, &data);
+			m_FeedbackData[i] = static_cast<const uint32_t*>(data);
+		}
 	}
 
-	VkFormat FindSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
-		for (VkFormat format : candidates) {
-			VkFormatProperties props;
-			vkGetPhysicalDeviceFormatProperties(m_PhysicalDevice, format, &props);
+	// Push constants of a material batch, pointing its streamed textures at their feedback slots. The
+	// reporting pixel of each 8x8 block moves every frame so all pixels are covered over 64 frames.
+	// Bindless textures find the rest in the material table and only use the pixel.
+	MaterialPushConstants MaterialFeedback(size_t materialIndex) const
+	{
+		MaterialPushConstants material;
+		material.feedbackPixel[0]	= m_FrameIndex & 7;
+		material.feedbackPixel[1]	= (m_FrameIndex >> 3) & 7;
+		if (m_BindlessEnabled) return material;
 
-			if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
-				return format;
-			}
-			else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features) {
-				return format;
+		const uint32_t indices[2] = { m_MaterialTextures[materialIndex].diffuse, m_MaterialTextures[materialIndex].specular };
+		for (int i = 0; i < 2; i++)
+		{
+			material.residentLevels[i] = m_Textures[indices[i]].residentLevel;
+			if (m_TextureStreams.count(indices[i]) != 0)
+				material.feedbackSlots[i] = indices[i];
+		}
+		return material;
+	}
+
+	// Reads what the fragment shader sampled the last time this frame's feedback buffer was used and
+	// plans which textures RecordTextureStreaming rebuilds with more or fewer levels. Textures stream in
+	// up to the level they were sampled at, the largest shortfall first and at most STREAMING_UPLOAD_BYTES
+	// per frame. Room in the budget is made by evicting the least recently needed levels.
+	void UpdateTextureStreaming()
+	{
+		ReleaseRetiredTextures(false);
+		if (!m_TextureStreamingEnabled || m_TextureStreams.empty() || !m_FeedbackWritten[currentFrame]) return;
+
+		const uint32_t* requested = m_FeedbackData[currentFrame];
+		m_FeedbackRound++;
+		uint64_t resident = 0;
+		std::vector<uint32_t> wanted;
+		for (auto& [index, stream] : m_TextureStreams)
+		{
+			const Texture& texture = m_Textures[index];
+			resident += texture.size;
+			if (requested[index] == NO_FEEDBACK) continue;
+
+			stream.requestedLevel	= std::min(requested[index], texture.mipLevels - 1);
+			stream.requestedRound	= m_FeedbackRound;
+			stream.usedRound		= m_FeedbackRound;
+			if (stream.requestedLevel < texture.residentLevel)
+				wanted.push_back(index);
+		}
+		std::sort(wanted.begin(), wanted.end(), [this](uint32_t a, uint32_t b) {
+			return m_Textures[a].residentLevel - m_TextureStreams.at(a).requestedLevel > m_Textures[b].residentLevel - m_TextureStreams.at(b).requestedLevel;
+		});
+
+		uint64_t budget = static_cast<uint64_t>(g_LaunchOptions.textureBudgetMiB) << 20;
+		uint64_t uploaded = 0;
+		for (uint32_t index : wanted)
+		{
+			// The finest level that fits, coarser ones are still an improvement
+			uint32_t current = m_Textures[index].residentLevel;
+			for (uint32_t level = m_TextureStreams.at(index).requestedLevel; level < current; level++)
+			{
+				uint64_t bytes = StreamedBytes(m_TextureStreams.at(index).image, level, current);
+				if (uploaded > 0 && uploaded + bytes > STREAMING_UPLOAD_BYTES) continue;
+				if (resident + bytes > budget)
+				{
+					uint64_t needed = resident + bytes - budget;
+					if (EvictTextures(needed, index, false) < needed) continue;
+					resident -= EvictTextures(needed, index, true);
+				}
+				m_StreamingRebuilds[index] = level;
+				resident += bytes;
+				uploaded += bytes;
+				break;
 			}
 		}
+		m_StreamedBytes = resident;
+	}
 
-		throw std::runtime_error("failed to find supported format!");
+	// Level a streamed texture drops to when evicted: what it still samples, or its tail if it was not sampled
+	uint32_t EvictedLevel(uint32_t index) const
+	{
+		const TextureStream& stream = m_TextureStreams.at(index);
+		return stream.requestedRound == m_FeedbackRound ? std::min(stream.requestedLevel, stream.tailLevel) : stream.tailLevel;
 	}
 
-	void CreateTextureImage()
+	// Plans evicting the levels of other textures that were sampled least recently until bytes are free.
+	// Levels sampled in the last feedback are never evicted. Returns the bytes freed, or that would be
+	// freed if apply is false.
+	uint64_t EvictTextures(uint64_t bytes, uint32_t keep, bool apply)
 	{
-		int texWidth, texHeight, texChannels;
-		stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-		VkDeviceSize imageSize = static_cast<uint64_t>(texWidth) * static_cast<uint64_t>(texHeight) * 4; // casting to uint64_t to make sure there's no loss of data during multiplication
+		std::vector<uint32_t> victims;
+		for (const auto& [index, stream] : m_TextureStreams)
+		{
+			if (index != keep && m_StreamingRebuilds.count(index) == 0 && EvictedLevel(index) > m_Textures[index].residentLevel)
+				victims.push_back(index);
+		}
+		std::sort(victims.begin(), victims.end(), [this](uint32_t a, uint32_t b) { return m_TextureStreams.at(a).usedRound < m_TextureStreams.at(b).usedRound; });
+
+		uint64_t freed = 0;
+		for (uint32_t index : victims)
+		{
+			if (freed >= bytes) break;
+			const TextureStream& stream = m_TextureStreams.at(index);
+			uint32_t level = EvictedLevel(index);
+			freed += StreamedBytes(stream.image, m_Textures[index].residentLevel, level);
+			if (apply) m_StreamingRebuilds[index] = level;
+		}
+		return freed;
+	}
 
-		m_MipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texHeight, texWidth))));
+	// Rebuilds the textures UpdateTextureStreaming planned, rewrites this frame's material sets if any
+	// texture changed since they were written and clears this frame's feedback buffer. Outside of a render pass.
+	void RecordTextureStreaming(VkCommandBuffer commandBuffer)
+	{
+		for (const auto& [index, level] : m_StreamingRebuilds)
+			RebuildStreamedTexture(commandBuffer, index, level);
+		if (!m_StreamingRebuilds.empty())
+			m_StreamingGeneration++;
+		m_StreamingRebuilds.clear();
+		if (m_MaterialSetGenerations[currentFrame] != m_StreamingGeneration)
+			WriteMaterialSets(currentFrame);
+
+		if (!m_TextureStreamingEnabled) return;
+		vkCmdFillBuffer(commandBuffer, m_FeedbackBuffers[currentFrame], 0, VK_WHOLE_SIZE, NO_FEEDBACK);
+
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType				= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask		= VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask		= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer				= m_FeedbackBuffers[currentFrame];
+		barrier.offset				= 0;
+		barrier.size				= VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
 
-		if (!pixels) {
-			std::cerr << stbi_failure_reason() << std::endl;
-			throw std::runtime_error("failed to load texture image!");
+	// Makes the scene's feedback writes visible to UpdateTextureStreaming once the frame's fence signals
+	void RecordTextureFeedbackRead(VkCommandBuffer commandBuffer)
+	{
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType				= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask		= VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask		= VK_ACCESS_HOST_READ_BIT;
+		barrier.srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer				= m_FeedbackBuffers[currentFrame];
+		barrier.offset				= 0;
+		barrier.size				= VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+		m_FeedbackWritten[currentFrame] = true;
+	}
+
+	// Replaces the image of a streamed texture with one starting at level. The levels both images hold
+	// are copied on the GPU, finer ones come from the mapped KTX2 file. Frames recorded before may still
+	// sample the old image, so it is released by ReleaseRetiredTextures once they have completed.
+	void RebuildStreamedTexture(VkCommandBuffer commandBuffer, uint32_t index, uint32_t level)
+	{
+		Texture& texture = m_Textures[index];
+		const TextureStream& stream = m_TextureStreams.at(index);
+		const ktx2::Image& image = stream.image;
+		uint32_t oldLevel = texture.residentLevel;
+
+		RetiredTexture retired;
+		retired.image	= texture.image;
+		retired.view	= texture.view;
+		retired.memory	= texture.memory;
+		retired.frame	= m_FrameIndex;
+
+		CreateImage(image.levels[level].width, image.levels[level].height, texture.mipLevels - level, VK_SAMPLE_COUNT_1_BIT, texture.format, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.memory);
+		TransitionImageLayout(commandBuffer, texture.image, texture.format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.mipLevels - level);
+		TransitionImageLayout(commandBuffer, retired.image, texture.format, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.mipLevels - oldLevel);
+
+		std::vector<VkImageCopy> copies;
+		for (uint32_t shared = std::max(level, oldLevel); shared < texture.mipLevels; shared++)
+		{
+			VkImageCopy copy{};
+			copy.srcSubresource	= { VK_IMAGE_ASPECT_COLOR_BIT, shared - oldLevel, 0, 1 };
+			copy.dstSubresource	= { VK_IMAGE_ASPECT_COLOR_BIT, shared - level, 0, 1 };
+			copy.extent			= { image.levels[shared].width, image.levels[shared].height, 1 };
+			copies.push_back(copy);
 		}
+		vkCmdCopyImage(commandBuffer, retired.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(copies.size()), copies.data());
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+		if (level < oldLevel)
+		{
+			// Levels are stored smallest first, so the new ones are one range of the file
+			uint64_t begin = image.levels[oldLevel - 1].offset;
+			uint64_t end = image.levels[level].offset + image.levels[level].size;
+			std::vector<VkBufferImageCopy> regions(oldLevel - level);
+			for (uint32_t streamed = level; streamed < oldLevel; streamed++)
+			{
+				regions[streamed - level].bufferOffset = image.levels[streamed].offset - begin;
+				SetLevelCopy(regions[streamed - level], image.levels[streamed], streamed - level);
+			}
+			CreateStagingBuffer(stream.path, stream.file->Data() + begin, end - begin, retired.staging.buffer, retired.staging.memory);
+			CopyBufferToImage(commandBuffer, retired.staging.buffer, texture.image, regions);
+		}
+		TransitionImageLayout(commandBuffer, texture.image, texture.format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture.mipLevels - level);
 
-		void* data;
-		vkMapMemory(m_Device, stagingBufferMemory, 0, imageSize, 0, &data);
-		memcpy(data, pixels, static_cast<size_t>(imageSize));
-		vkUnmapMemory(m_Device, stagingBufferMemory);
+		texture.residentLevel	= level;
+		texture.size			= StreamedBytes(image, level, texture.mipLevels);
+		texture.view			= CreateImageView(texture.image, texture.format, VK_IMAGE_ASPECT_COLOR_BIT, texture.mipLevels - level, 0, true);
+		texture.sampler			= GetTextureSampler(texture.mipLevels - level);
+		m_RetiredTextures.push_back(retired);
+	}
+
+	// Destroys the images streaming replaced once no frame in flight can use them, or all of them
+	void ReleaseRetiredTextures(bool all)
+	{
+		auto released = std::remove_if(m_RetiredTextures.begin(), m_RetiredTextures.end(), [&](const RetiredTexture& retired) {
+			// The fence of this frame slot was waited on, so every frame up to MAX_FRAMES_IN_FLIGHT ago has completed
+			if (!all && m_FrameIndex < retired.frame + MAX_FRAMES_IN_FLIGHT) return false;
+			vkDestroyImageView(m_Device, retired.view, m_Allocator);
+			vkDestroyImage(m_Device, retired.image, m_Allocator);
+			FreeDeviceMemory(retired.memory);
+			if (retired.staging.buffer != VK_NULL_HANDLE)
+			{
+				vkDestroyBuffer(m_Device, retired.staging.buffer, m_Allocator);
+				FreeDeviceMemory(retired.staging.memory);
+			}
+			return true;
+		});
+		m_RetiredTextures.erase(released, m_RetiredTextures.end());
+	}
+
+	// Bytes written by GenerateMipmaps, every level after the first
+	static uint64_t MipChainBytes(uint32_t width, uint32_t height, uint32_t mipLevels)
+	{
+		uint64_t bytes = 0;
+		for (uint32_t level = 1; level < mipLevels; level++)
+		{
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+			bytes += static_cast<uint64_t>(width) * height * 4;
+		}
+		return bytes;
+	}
 
-		stbi_image_free(pixels);
+	// Whether GenerateMipmaps runs mipgen.comp for images viewed as format, which they then have to be
+	// created for. Blits are used when asked for with --mip-generator blit, unless the format cannot be
+	// filtered linearly.
+	bool UseComputeMipGeneration(VkFormat format)
+	{
+		if (!m_MipGenerationAvailable || (format != VK_FORMAT_R8G8B8A8_SRGB && format != VK_FORMAT_R8G8B8A8_UNORM))
+			return false;
+		return g_LaunchOptions.mipGenerator == "compute" ||
+			!IsFormatSupported(format, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+	}
 
-		CreateImage(texWidth, texHeight, m_MipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT| VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_TextureImage, m_TextureImageMemory);
+	// Fills every level below the first from it. All levels start in TRANSFER_DST_OPTIMAL and end in
+	// SHADER_READ_ONLY_OPTIMAL. Views and descriptors used live until the texture upload batch completes.
+	void GenerateMipmaps(VkCommandBuffer buffer, VkImage image, VkFormat imageFormat, uint32_t texWidth, uint32_t texHeight, uint32_t mipLevels)
+	{
+		if (UseComputeMipGeneration(imageFormat))
+			GenerateMipmapsCompute(buffer, image, imageFormat, texWidth, texHeight, mipLevels);
+		else
+			GenerateMipmapsBlit(buffer, image, imageFormat, texWidth, texHeight, mipLevels);
+	}
 
-		TransitionImageLayout(m_TextureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_MipLevels);
-		CopyBufferToImage(stagingBuffer, m_TextureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-		GenerateMipmaps(m_TextureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, m_MipLevels);
+	// mipgen.comp writes MIP_LEVELS_PER_PASS levels per dispatch, so two dispatches cover up to 4096x4096.
+	// The image is read and written through UNORM views, the shader filters sRGB texels in linear space.
+	void GenerateMipmapsCompute(VkCommandBuffer buffer, VkImage image, VkFormat imageFormat, uint32_t texWidth, uint32_t texHeight, uint32_t mipLevels)
+	{
+		VkImageMemoryBarrier barrier{};
+		barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.image							= image;
+		barrier.srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel	= 0;
+		barrier.subresourceRange.levelCount		= mipLevels;
+		barrier.subresourceRange.baseArrayLayer	= 0;
+		barrier.subresourceRange.layerCount		= 1;
+		barrier.oldLayout						= VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout						= VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcAccessMask					= VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask					= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		uint32_t passCount = (mipLevels - 1 + MIP_LEVELS_PER_PASS - 1) / MIP_LEVELS_PER_PASS;
+		if (passCount > 0)
+		{
+			std::vector<VkImageView> views(mipLevels);
+			for (uint32_t level = 0; level < mipLevels; level++)
+			{
+				views[level] = CreateImageView(image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, 1, level);
+				m_TextureUpload.views.push_back(views[level]);
+			}
 
-		vkDestroyBuffer(m_Device, stagingBuffer, nullptr);
-		vkFreeMemory(m_Device, stagingBufferMemory, nullptr);
+			VkDescriptorPoolSize poolSize{};
+			poolSize.type				= VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			poolSize.descriptorCount	= passCount * (1 + MIP_LEVELS_PER_PASS);
+
+			VkDescriptorPoolCreateInfo poolInfo{};
+			poolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+			poolInfo.poolSizeCount	= 1;
+			poolInfo.pPoolSizes		= &poolSize;
+			poolInfo.maxSets		= passCount;
+			VkDescriptorPool pool;
+			if (vkCreateDescriptorPool(m_Device, &poolInfo, m_Allocator, &pool) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create mip generation descriptor pool");
+			m_TextureUpload.descriptorPools.push_back(pool);
+
+			std::vector<VkDescriptorSetLayout> layouts(passCount, m_MipGenerationSetLayout);
+			std::vector<VkDescriptorSet> sets(passCount);
+			VkDescriptorSetAllocateInfo allocInfo{};
+			allocInfo.sType					= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			allocInfo.descriptorPool		= pool;
+			allocInfo.descriptorSetCount	= passCount;
+			allocInfo.pSetLayouts			= layouts.data();
+			if (vkAllocateDescriptorSets(m_Device, &allocInfo, sets.data()) != VK_SUCCESS)
+				throw std::runtime_error("Failed to allocate mip generation descriptor sets");
+
+			vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_MipGenerationPipeline);
+			for (uint32_t pass = 0; pass < passCount; pass++)
+			{
+				uint32_t sourceLevel = pass * MIP_LEVELS_PER_PASS;
+				MipGenerationConstants constants;
+				constants.sourceSize	= glm::ivec2(std::max(texWidth >> sourceLevel, 1u), std::max(texHeight >> sourceLevel, 1u));
+				constants.levelCount	= std::min(MIP_LEVELS_PER_PASS, mipLevels - 1 - sourceLevel);
+				constants.srgb			= imageFormat == VK_FORMAT_R8G8B8A8_SRGB ? 1 : 0;
+
+				// Levels past the last are bound to it but never written
+				std::array<VkDescriptorImageInfo, 1 + MIP_LEVELS_PER_PASS> imageInfos{};
+				for (uint32_t i = 0; i < imageInfos.size(); i++)
+				{
+					imageInfos[i].imageView		= views[std::min(sourceLevel + i, mipLevels - 1)];
+					imageInfos[i].imageLayout	= VK_IMAGE_LAYOUT_GENERAL;
+				}
+				std::array<VkWriteDescriptorSet, 2> writes{};
+				for (uint32_t i = 0; i < writes.size(); i++)
+				{
+					writes[i].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+					writes[i].dstSet			= sets[pass];
+					writes[i].dstBinding		= i;
+					writes[i].descriptorCount	= i == 0 ? 1 : MIP_LEVELS_PER_PASS;
+					writes[i].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+					writes[i].pImageInfo		= &imageInfos[i];
+				}
+				vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 
-		pixels = stbi_load(SPEC_TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-		imageSize = static_cast<uint64_t>(texWidth) * static_cast<uint64_t>(texHeight) * 4;
+				// The source of this pass is the last level the previous one wrote
+				if (pass > 0)
+				{
+					VkMemoryBarrier memoryBarrier{};
+					memoryBarrier.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+					memoryBarrier.srcAccessMask	= VK_ACCESS_SHADER_WRITE_BIT;
+					memoryBarrier.dstAccessMask	= VK_ACCESS_SHADER_READ_BIT;
+					vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+				}
 
-		if (!pixels) {
-			std::cerr << stbi_failure_reason() << std::endl;
-			throw std::runtime_error("failed to load specular image!");
+				vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_MipGenerationPipelineLayout, 0, 1, &sets[pass], 0, nullptr);
+				vkCmdPushConstants(buffer, m_MipGenerationPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+				vkCmdDispatch(buffer, (constants.sourceSize.x + MIP_GENERATION_TILE - 1) / MIP_GENERATION_TILE, (constants.sourceSize.y + MIP_GENERATION_TILE - 1) / MIP_GENERATION_TILE, 1);
+			}
 		}
 
-		CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-		
-		vkMapMemory(m_Device, stagingBufferMemory, 0, imageSize, 0, &data);
-		memcpy(data, pixels, static_cast<size_t>(imageSize));
-		vkUnmapMemory(m_Device, stagingBufferMemory);
-
-		stbi_image_free(pixels);
-		CreateImage(texWidth, texHeight, 1, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_SpecularImage, m_SpecularImageMemory);
-		TransitionImageLayout(m_SpecularImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1);
-		CopyBufferToImage(stagingBuffer, m_SpecularImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-		TransitionImageLayout(m_SpecularImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1);
-
+		barrier.oldLayout		= VK_IMAGE_LAYOUT_GENERAL;
+		barrier.newLayout		= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask	= VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask	= VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 	}
 
-	void GenerateMipmaps(VkImage image,VkFormat imageFormat, uint32_t texWidth, uint32_t texHeight, uint32_t mipLevels)
+	// One blit and two barriers per level, each level filtered from the one above by the sampler hardware
+	void GenerateMipmapsBlit(VkCommandBuffer buffer, VkImage image, VkFormat imageFormat, uint32_t texWidth, uint32_t texHeight, uint32_t mipLevels)
 	{
-		VkFormatProperties formatProperties;
-		vkGetPhysicalDeviceFormatProperties(m_PhysicalDevice, imageFormat, &formatProperties);
-		if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+		if (!IsFormatSupported(imageFormat, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
 			throw std::runtime_error("texture image format does not support linear blitting!");
 		}
 
-		VkCommandBuffer buffer = BeginSingleTimeCommand();
-
 		VkImageMemoryBarrier barrier{};
 		barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 		barrier.image							= image;
@@ -1202,42 +4803,27 @@ private:
 			0, nullptr,
 			0, nullptr,
 			1, &barrier);
-
-		EndSingleTimeCommand(buffer);
 	}
 
 
 	void CreateTextureImageView()
 	{
-		m_TextureImageView = CreateImageView(m_TextureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, m_MipLevels);
-		m_SpecularImageView = CreateImageView(m_SpecularImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+		for (Texture& texture : m_Textures)
+		{
+			texture.view	= CreateImageView(texture.image, texture.format, VK_IMAGE_ASPECT_COLOR_BIT, texture.mipLevels - texture.residentLevel, 0, true);
+			texture.sampler	= GetTextureSampler(texture.mipLevels - texture.residentLevel);
+		}
 	}
 
-	void CreateTextureSampler()
+	// Sampler for textures with mipLevels levels, created on first use. The LOD range ends at the last
+	// level the texture has rather than being left open, so minification past it clamps in the sampler.
+	VkSampler GetTextureSampler(uint32_t mipLevels)
 	{
-		VkSamplerCreateInfo samplerInfo{};
-		samplerInfo.sType					= VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-		samplerInfo.magFilter				= VK_FILTER_LINEAR;
-		samplerInfo.minFilter				= VK_FILTER_LINEAR;
-		samplerInfo.addressModeU			= VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.addressModeV			= VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.addressModeW			= VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.borderColor				= VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
-		samplerInfo.anisotropyEnable		= VK_TRUE;
-		samplerInfo.maxAnisotropy			= 16.0f;
-		samplerInfo.unnormalizedCoordinates = VK_FALSE;
-		samplerInfo.compareEnable			= VK_FALSE;
-		samplerInfo.compareOp				= VK_COMPARE_OP_ALWAYS;
-		samplerInfo.mipmapMode				= VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		samplerInfo.mipLodBias				= 0.0f;
-		samplerInfo.minLod					= 0.0f;
-		samplerInfo.maxLod					= static_cast<float>(m_MipLevels);
-
-		if (vkCreateSampler(m_Device, &samplerInfo, nullptr, &m_TextureSampler) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Could not create texture sampler");
-		}
+		std::lock_guard<std::mutex> lock(m_SamplerMutex);
+		auto found = m_TextureSamplers.find(mipLevels);
+		if (found != m_TextureSamplers.end()) return found->second;
 
+		VkSamplerCreateInfo samplerInfo{};
 		samplerInfo.sType					= VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 		samplerInfo.magFilter				= VK_FILTER_LINEAR;
 		samplerInfo.minFilter				= VK_FILTER_LINEAR;
@@ -1253,37 +4839,47 @@ private:
 		samplerInfo.mipmapMode				= VK_SAMPLER_MIPMAP_MODE_LINEAR;
 		samplerInfo.mipLodBias				= 0.0f;
 		samplerInfo.minLod					= 0.0f;
-		samplerInfo.maxLod					= 0.0f;
+		samplerInfo.maxLod					= static_cast<float>(mipLevels - 1);
 
-		if (vkCreateSampler(m_Device, &samplerInfo, nullptr, &m_SpecularSampler) != VK_SUCCESS)
+		VkSampler sampler;
+		if (vkCreateSampler(m_Device, &samplerInfo, m_Allocator, &sampler) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Could not create texture sampler");
 		}
-
+		m_TextureSamplers[mipLevels] = sampler;
+		return sampler;
 	}
 
-	VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect, uint32_t mipLevels)
+	// A view inherits every usage of its image. Textures whose mips were written by mipgen.comp have
+	// storage usage, which their sRGB format does not support, so their views are restricted to sampling.
+	VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect, uint32_t mipLevels, uint32_t baseMipLevel = 0, bool sampledOnly = false)
 	{
+		VkImageViewUsageCreateInfoKHR usageInfo{};
+		usageInfo.sType	= VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO_KHR;
+		usageInfo.usage	= VK_IMAGE_USAGE_SAMPLED_BIT;
+
 		VkImageViewCreateInfo imageViewCreateInfo{};
 		imageViewCreateInfo.sType							= VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		imageViewCreateInfo.pNext							= sampledOnly && m_Maintenance2Enabled ? &usageInfo : nullptr;
 		imageViewCreateInfo.image							= image;
 		imageViewCreateInfo.viewType						= VK_IMAGE_VIEW_TYPE_2D;
 		imageViewCreateInfo.format							= format;
 		imageViewCreateInfo.subresourceRange.aspectMask		= aspect;
-		imageViewCreateInfo.subresourceRange.baseMipLevel	= 0;
+		imageViewCreateInfo.subresourceRange.baseMipLevel	= baseMipLevel;
 		imageViewCreateInfo.subresourceRange.levelCount		= mipLevels;
 		imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
 		imageViewCreateInfo.subresourceRange.layerCount		= 1;
 
+		HostAllocationTracker::Tag tag(g_HostAllocations, "VkImageView");
 		VkImageView imageView;
-		if (vkCreateImageView(m_Device, &imageViewCreateInfo, nullptr, &imageView) != VK_SUCCESS) {
+		if (vkCreateImageView(m_Device, &imageViewCreateInfo, m_Allocator, &imageView) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create texture image view!");
 		}
 
 		return imageView;
 	}
 
-	void CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
+	void CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, VkImageCreateFlags flags = 0)
 	{
 		VkImageCreateInfo imageInfo{};
 		imageInfo.sType			= VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1298,9 +4894,10 @@ private:
 		imageInfo.sharingMode	= VK_SHARING_MODE_EXCLUSIVE;
 		imageInfo.usage			= usage;
 		imageInfo.samples		= numSamples;
-		imageInfo.flags			= 0;
+		imageInfo.flags			= flags;
 
-		if (vkCreateImage(m_Device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+		HostAllocationTracker::Tag tag(g_HostAllocations, "VkImage");
+		if (vkCreateImage(m_Device, &imageInfo, m_Allocator, &image) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create image!");
 		}
 
@@ -1312,7 +4909,7 @@ private:
 		allocInfo.allocationSize = memReq.size;
 		allocInfo.memoryTypeIndex = FindMemoryType(memReq.memoryTypeBits, properties);
 
-		if (vkAllocateMemory(m_Device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
+		if (AllocateDeviceMemory(allocInfo, imageMemory) != VK_SUCCESS) {
 			throw std::runtime_error("failed to allocate image memory!");
 		}
 
@@ -1321,17 +4918,90 @@ private:
 
 	void LoadModel()
 	{
+		if (LoadMeshCache(MODEL_PATH))
+		{
+			m_MeshStatistics = meshopt::Analyze(m_Mesh.indices, m_Mesh.lods[0].indexCount, m_Mesh.vertexCount, sizeof(Vertex));
+			return;
+		}
+
+		// Pages of the mapping are read while parsing, so most of the I/O shows up under decode
+		MappedFile objFile;
+		{
+			AssetLoadProfiler::Scope scope(g_AssetProfiler, MODEL_PATH, AssetStage::FileIO);
+			if (!objFile.Open(MODEL_PATH)) throw std::runtime_error("failed to open " + MODEL_PATH);
+			scope.bytes = objFile.Size();
+		}
+		const char* objData = reinterpret_cast<const char*>(objFile.Data());
+
 		tinyobj::attrib_t attrib;
 		std::vector<tinyobj::shape_t> shapes;
 		std::vector<tinyobj::material_t> materials;
 		std::string warn, err;
 
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, MODEL_PATH.c_str())) {
-			throw std::runtime_error(warn + err);
+		// MTL files and the textures they name are relative to the model
+		std::string modelDirectory = std::filesystem::path(MODEL_PATH).parent_path().generic_string();
+		if (!modelDirectory.empty()) modelDirectory += "/";
+
+		{
+			AssetLoadProfiler::Scope scope(g_AssetProfiler, MODEL_PATH, AssetStage::Decode);
+			tinyobj::MaterialFileReader materialReader(modelDirectory);
+			if (!objparallel::LoadObj(&attrib, &shapes, &materials, &warn, &err, objData, objFile.Size(), &materialReader)) {
+				throw std::runtime_error(warn + err);
+			}
+
+			scope.bytes = (attrib.vertices.size() + attrib.normals.size() + attrib.texcoords.size()) * sizeof(tinyobj::real_t);
+			for (const auto& shape : shapes)
+				scope.bytes += shape.mesh.indices.size() * sizeof(tinyobj::index_t);
 		}
 
+		std::vector<uint32_t> triangleMaterials;
+		DeduplicateVertices(attrib, shapes, triangleMaterials);
+		LoadMaterials(shapes, materials, modelDirectory, triangleMaterials);
+		OptimizeMesh(triangleMaterials);
+
+		m_Mesh.vertices		= g_Vertices.data();
+		m_Mesh.vertexCount	= g_Vertices.size();
+		m_Mesh.indices		= g_Indices.data();
+		m_Mesh.indexCount	= g_Indices.size();
+
+		WriteMeshCache(MODEL_PATH, objFile.Size(), HashBytes(objData, objFile.Size()));
+	}
+
+	// Fills g_Vertices and g_Indices with the unique vertices of the OBJ faces, and triangleMaterials
+	// with the material id of every face
+	void DeduplicateVertices(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, std::vector<uint32_t>& triangleMaterials)
+	{
+		AssetLoadProfiler::Scope scope(g_AssetProfiler, MODEL_PATH, AssetStage::Dedup);
+		size_t cornerCount = 0;
+		for (const auto& shape : shapes)
+			cornerCount += shape.mesh.indices.size();
+
+		// Corners sharing an index tuple are the same vertex, so only the first sight of each tuple
+		// builds a Vertex and checks it against the others by value. Both tables are freed on return.
+		// A closed triangle mesh has about half as many vertices as faces, UV seams and hard edges
+		// add more, so they start sized for one vertex per face.
+		size_t faceCount = cornerCount / 3;
+		FlatIndexMap<CornerKey, CornerKeyHash> cornerVertices(faceCount);
+		FlatIndexMap<Vertex, VertexHash> uniqueVertices(faceCount);
+		g_Vertices.reserve(faceCount);
+		g_Indices.reserve(cornerCount);
+		triangleMaterials.reserve(faceCount);
+
+		m_BoundsMin = glm::vec3(std::numeric_limits<float>::max());
+		m_BoundsMax = glm::vec3(std::numeric_limits<float>::lowest());
 		for (const auto& shape : shapes) {
+			// Faces without a material have id -1, which becomes the largest uint32_t
+			for (int material : shape.mesh.material_ids)
+				triangleMaterials.push_back(static_cast<uint32_t>(material));
+
 			for (const auto& index : shape.mesh.indices) {
+				auto [cornerVertex, newCorner] = cornerVertices.Insert({ index.vertex_index, index.normal_index, index.texcoord_index },
+					static_cast<uint32_t>(g_Vertices.size()));
+				if (!newCorner) {
+					g_Indices.push_back(cornerVertex);
+					continue;
+				}
+
 				Vertex vertex{};
 
 				vertex.position = {
@@ -1345,62 +5015,869 @@ private:
 					attrib.texcoords[2 * index.texcoord_index + 1]
 				};
 
-				vertex.normal = { 
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2],
-				};
+				vertex.normal = { 
+					attrib.normals[3 * index.normal_index + 0],
+					attrib.normals[3 * index.normal_index + 1],
+					attrib.normals[3 * index.normal_index + 2],
+				};
+
+				// A different tuple can still describe a vertex that already exists, the tuple then points at that vertex
+				auto [uniqueVertex, newVertex] = uniqueVertices.Insert(vertex, cornerVertex);
+				if (newVertex) {
+					g_Vertices.push_back(vertex);
+					m_BoundsMin = glm::min(m_BoundsMin, vertex.position);
+					m_BoundsMax = glm::max(m_BoundsMax, vertex.position);
+				}
+				cornerVertex = uniqueVertex;
+
+				g_Indices.push_back(uniqueVertex);
+			}
+		}
+		scope.bytes = g_Vertices.size() * sizeof(Vertex) + g_Indices.size() * sizeof(uint32_t);
+	}
+
+	// Keeps the materials the faces use, in order of first use, and renumbers triangleMaterials to match.
+	// Faces without a material get one without textures.
+	void LoadMaterials(const std::vector<tinyobj::shape_t>& shapes, const std::vector<tinyobj::material_t>& materials, const std::string& directory, std::vector<uint32_t>& triangleMaterials)
+	{
+		auto texturePath = [&](std::string name) {
+			if (name.empty()) return name;
+			std::replace(name.begin(), name.end(), '\\', '/');
+			return directory + name;
+		};
+
+		m_Mesh.materials.clear();
+		std::unordered_map<uint32_t, uint32_t> remap;
+		for (uint32_t& material : triangleMaterials)
+		{
+			auto [found, added] = remap.emplace(material, static_cast<uint32_t>(m_Mesh.materials.size()));
+			if (added)
+			{
+				MeshMaterial used;
+				used.name = "default";
+				if (material < materials.size())
+				{
+					used.name				= materials[material].name;
+					used.diffuseTexture		= texturePath(materials[material].diffuse_texname);
+					used.specularTexture	= texturePath(materials[material].specular_texname);
+				}
+				m_Mesh.materials.push_back(used);
+			}
+			material = found->second;
+		}
+		if (m_Mesh.materials.empty())
+			m_Mesh.materials.push_back({ "default", "", "" });
+
+		// A submesh is the faces of one shape that share a material
+		size_t submeshes = 0;
+		for (const auto& shape : shapes)
+			submeshes += std::set<int>(shape.mesh.material_ids.begin(), shape.mesh.material_ids.end()).size();
+		if (g_LaunchOptions.verbose)
+			std::cout << "Loaded " << shapes.size() << " shapes with " << submeshes << " submeshes using " << m_Mesh.materials.size() << " materials" << std::endl;
+	}
+
+	static uint32_t MeshOptimizations()
+	{
+		return MESH_OPTIMIZE_VERTEX_CACHE | MESH_OPTIMIZE_VERTEX_FETCH | MESH_OPTIMIZE_LODS | (g_LaunchOptions.optimizeOverdraw ? MESH_OPTIMIZE_OVERDRAW : 0);
+	}
+
+	// Groups g_Indices by material and reorders every group for the post transform cache, and for overdraw
+	// with --optimize-overdraw, appends the simplified LODs after it, then reorders g_Vertices for fetch
+	void OptimizeMesh(const std::vector<uint32_t>& triangleMaterials)
+	{
+		AssetLoadProfiler::Scope scope(g_AssetProfiler, MODEL_PATH, AssetStage::Optimize,
+			g_Vertices.size() * sizeof(Vertex) + g_Indices.size() * sizeof(uint32_t));
+		meshopt::CacheStatistics before = meshopt::Analyze(g_Indices.data(), g_Indices.size(), g_Vertices.size(), sizeof(Vertex));
+
+		// Stable counting sort of the triangles by material, so each material is one run in every LOD
+		std::vector<uint32_t> source(g_Indices.size()), sourceMaterials(triangleMaterials.size());
+		{
+			std::vector<size_t> offsets(m_Mesh.materials.size() + 1, 0);
+			for (uint32_t material : triangleMaterials) offsets[material + 1]++;
+			for (size_t m = 0; m < m_Mesh.materials.size(); m++) offsets[m + 1] += offsets[m];
+			for (size_t t = 0; t < triangleMaterials.size(); t++)
+			{
+				size_t target = offsets[triangleMaterials[t]]++;
+				sourceMaterials[target] = triangleMaterials[t];
+				std::copy(g_Indices.begin() + t * 3, g_Indices.begin() + t * 3 + 3, source.begin() + target * 3);
+			}
+		}
+		g_Indices.clear();
+		m_Mesh.lods.clear();
+		m_Mesh.batches.clear();
+		AppendLod(source, sourceMaterials, 0.0f, (MeshOptimizations() & MESH_OPTIMIZE_OVERDRAW) != 0);
+
+		// Each LOD halves the one before it, errors add up since every level is simplified from the last
+		float maxError = glm::length(m_BoundsMax - m_BoundsMin) * LOD_MAX_ERROR;
+		std::vector<uint32_t> lodIndices(g_Indices), lodMaterials(sourceMaterials);
+		while (m_Mesh.lods.size() < MAX_MESH_LODS && lodIndices.size() / 3 > LOD_MIN_TRIANGLES)
+		{
+			float error = 0.0f;
+			std::vector<uint32_t> simplified = meshopt::Simplify(g_Vertices, lodIndices, lodIndices.size() / 6 * 3, maxError - m_Mesh.lods.back().error, error, lodMaterials);
+			if (simplified.empty() || simplified.size() > lodIndices.size() * LOD_MIN_REDUCTION) break;
+
+			AppendLod(simplified, lodMaterials, m_Mesh.lods.back().error + error, false);
+			lodIndices.assign(g_Indices.end() - simplified.size(), g_Indices.end());
+		}
+		meshopt::OptimizeVertexFetch(g_Vertices, g_Indices);
+
+		m_MeshStatistics = meshopt::Analyze(g_Indices.data(), m_Mesh.lods[0].indexCount, g_Vertices.size(), sizeof(Vertex));
+		if (!g_LaunchOptions.verbose) return;
+
+		char line[256];
+		snprintf(line, sizeof(line), "Optimized %s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, overfetch %.3f -> %.3f",
+			MODEL_PATH.c_str(), before.acmr, m_MeshStatistics.acmr, before.atvr, m_MeshStatistics.atvr, before.overfetch, m_MeshStatistics.overfetch);
+		std::cout << line << std::endl;
+
+		std::cout << "LODs:";
+		for (const MeshLod& lod : m_Mesh.lods)
+			std::cout << " " << lod.indexCount / 3 << " (error " << lod.error << ")";
+		std::cout << ", " << m_Mesh.lods[0].batchCount << " material batches each" << std::endl;
+	}
+
+	// Appends a LOD to g_Indices, one batch per run of a material in materials, each reordered for the vertex cache
+	void AppendLod(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& materials, float error, bool optimizeOverdraw)
+	{
+		MeshLod lod;
+		lod.firstIndex	= static_cast<uint32_t>(g_Indices.size());
+		lod.error		= error;
+		lod.firstBatch	= static_cast<uint32_t>(m_Mesh.batches.size());
+
+		std::vector<uint32_t> batch, clusters;
+		size_t first = 0;
+		while (first < materials.size())
+		{
+			size_t last = first + 1;
+			while (last < materials.size() && materials[last] == materials[first]) last++;
+
+			batch.assign(indices.begin() + first * 3, indices.begin() + last * 3);
+			meshopt::OptimizeVertexCache(batch, g_Vertices.size(), clusters);
+			if (optimizeOverdraw)
+				meshopt::OptimizeOverdraw(batch, g_Vertices, clusters);
+			m_Mesh.batches.push_back({ static_cast<uint32_t>(g_Indices.size()), static_cast<uint32_t>(batch.size()), materials[first] });
+			g_Indices.insert(g_Indices.end(), batch.begin(), batch.end());
+			first = last;
+		}
+
+		lod.indexCount	= static_cast<uint32_t>(g_Indices.size()) - lod.firstIndex;
+		lod.batchCount	= static_cast<uint32_t>(m_Mesh.batches.size()) - lod.firstBatch;
+		m_Mesh.lods.push_back(lod);
+	}
+
+	static std::string MeshCachePath(const std::string& sourcePath) { return sourcePath + ".meshcache"; }
+
+	static int64_t SourceWriteTime(const std::string& path)
+	{
+		std::error_code error;
+		auto time = std::filesystem::last_write_time(path, error);
+		return error ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+	}
+
+	// Maps the baked mesh of sourcePath if it is up to date, the mapping stays open until the buffers are uploaded
+	bool LoadMeshCache(const std::string& sourcePath)
+	{
+		std::string cachePath = MeshCachePath(sourcePath);
+		{
+			AssetLoadProfiler::Scope scope(g_AssetProfiler, sourcePath, AssetStage::FileIO);
+			if (!m_MeshCacheFile.Open(cachePath)) return false;
+			scope.bytes = m_MeshCacheFile.Size();
+		}
+
+		MeshCacheHeader header{};
+		bool valid = m_MeshCacheFile.Size() >= sizeof(header);
+		if (valid)
+		{
+			memcpy(&header, m_MeshCacheFile.Data(), sizeof(header));
+			valid = memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) == 0 &&
+				header.version == MESH_CACHE_VERSION &&
+				header.vertexLayoutVersion == VERTEX_LAYOUT_VERSION &&
+				header.vertexStride == sizeof(Vertex) &&
+				header.optimizations == MeshOptimizations() &&
+				header.lodCount >= 1 && header.lodCount <= MAX_MESH_LODS &&
+				m_MeshCacheFile.Size() == sizeof(header) + header.vertexCount * sizeof(Vertex) + header.indexCount * sizeof(uint32_t) +
+					header.batchCount * sizeof(MeshBatch) + header.materialBytes;
+		}
+
+		// A cache shipped without its source is used as is
+		std::error_code error;
+		uint64_t sourceSize = std::filesystem::file_size(sourcePath, error);
+		if (valid && !error)
+		{
+			int64_t sourceWriteTime = SourceWriteTime(sourcePath);
+			valid = header.sourceSize == sourceSize;
+			if (valid && header.sourceWriteTime != sourceWriteTime)
+			{
+				// Only the time changed (checkout, copy), compare content before throwing the cache away
+				std::vector<char> source = ReadFile(sourcePath);
+				valid = HashBytes(source.data(), source.size()) == header.sourceHash;
+				if (valid)
+				{
+					m_MeshCacheFile.Close();
+					header.sourceWriteTime = sourceWriteTime;
+					std::fstream file(cachePath, std::ios::in | std::ios::out | std::ios::binary);
+					file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+					file.close();
+					return LoadMeshCache(sourcePath);
+				}
+			}
+		}
+
+		const uint8_t* data = m_MeshCacheFile.Data() + sizeof(header);
+		const uint8_t* batchData = data + header.vertexCount * sizeof(Vertex) + header.indexCount * sizeof(uint32_t);
+		if (valid)
+		{
+			m_Mesh.batches.resize(header.batchCount);
+			memcpy(m_Mesh.batches.data(), batchData, header.batchCount * sizeof(MeshBatch));
+			valid = DeserializeMaterials(batchData + header.batchCount * sizeof(MeshBatch), header.materialBytes, header.materialCount, m_Mesh.materials);
+		}
+		for (uint32_t i = 0; valid && i < header.lodCount; i++)
+		{
+			valid = static_cast<uint64_t>(header.lods[i].firstIndex) + header.lods[i].indexCount <= header.indexCount &&
+				static_cast<uint64_t>(header.lods[i].firstBatch) + header.lods[i].batchCount <= header.batchCount;
+		}
+		for (const MeshBatch& batch : m_Mesh.batches)
+		{
+			if (valid)
+				valid = static_cast<uint64_t>(batch.firstIndex) + batch.indexCount <= header.indexCount && batch.material < header.materialCount;
+		}
+
+		if (!valid)
+		{
+			m_MeshCacheFile.Close();
+			if (g_LaunchOptions.verbose)
+				std::cout << "Mesh cache " << cachePath << " is out of date, rebuilding" << std::endl;
+			return false;
+		}
+
+		m_Mesh.vertices		= reinterpret_cast<const Vertex*>(data);
+		m_Mesh.vertexCount	= header.vertexCount;
+		m_Mesh.indices		= reinterpret_cast<const uint32_t*>(data + header.vertexCount * sizeof(Vertex));
+		m_Mesh.indexCount	= header.indexCount;
+		m_Mesh.lods.assign(header.lods, header.lods + header.lodCount);
+		m_BoundsMin			= header.boundsMin;
+		m_BoundsMax			= header.boundsMax;
+		return true;
+	}
+
+	// Header of an existing mesh cache of this version, the rest of the file is not validated
+	static bool PeekMeshCacheHeader(std::ifstream& file, MeshCacheHeader& header)
+	{
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+		return memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) == 0 && header.version == MESH_CACHE_VERSION;
+	}
+
+	static bool PeekMeshCacheBounds(const std::string& sourcePath, glm::vec3& boundsMin, glm::vec3& boundsMax)
+	{
+		MeshCacheHeader header{};
+		std::ifstream file(MeshCachePath(sourcePath), std::ios::binary);
+		if (!PeekMeshCacheHeader(file, header)) return false;
+
+		boundsMin = header.boundsMin;
+		boundsMax = header.boundsMax;
+		return true;
+	}
+
+	// Most materials the model can draw with, known before it is loaded: the material table of a mesh
+	// cache baked from the current source, or else every material its libraries define plus the default.
+	static size_t MaxModelMaterials(const std::string& sourcePath)
+	{
+		MeshCacheHeader header{};
+		std::vector<MeshMaterial> materials;
+		std::ifstream cache(MeshCachePath(sourcePath), std::ios::binary);
+		std::error_code error;
+		if (PeekMeshCacheHeader(cache, header) && header.sourceSize == std::filesystem::file_size(sourcePath, error) && !error &&
+			header.sourceWriteTime == SourceWriteTime(sourcePath) && PeekMeshCacheMaterials(sourcePath, materials))
+			return materials.size();
+
+		MappedFile obj;
+		if (!obj.Open(sourcePath)) return 0;	// LoadModel says why
+
+		std::string directory = std::filesystem::path(sourcePath).parent_path().generic_string();
+		if (!directory.empty()) directory += "/";
+		size_t count = 1;
+		const char* line = reinterpret_cast<const char*>(obj.Data());
+		const char* end = line + obj.Size();
+		while (line < end)
+		{
+			const char* next = static_cast<const char*>(memchr(line, '\n', static_cast<size_t>(end - line)));
+			next = next ? next + 1 : end;
+			while (line < next && IS_SPACE(line[0])) line++;
+			if (next - line > 7 && strncmp(line, "mtllib", 6) == 0 && IS_SPACE(line[6]))
+			{
+				std::istringstream names(std::string(line + 7, next));
+				std::string name;
+				while (names >> name)
+				{
+					std::ifstream library(directory + name);
+					for (std::string definition; std::getline(library, definition);)
+					{
+						size_t first = definition.find_first_not_of(" \t");
+						if (first != std::string::npos && definition.compare(first, 6, "newmtl") == 0) count++;
+					}
+				}
+			}
+			line = next;
+		}
+		return count;
+	}
+
+	// Material table of an existing mesh cache, read past the geometry without loading it
+	static bool PeekMeshCacheMaterials(const std::string& sourcePath, std::vector<MeshMaterial>& materials)
+	{
+		MeshCacheHeader header{};
+		std::string cachePath = MeshCachePath(sourcePath);
+		std::ifstream file(cachePath, std::ios::binary);
+		if (!PeekMeshCacheHeader(file, header)) return false;
+
+		std::error_code error;
+		uint64_t tableOffset = sizeof(header) + header.vertexCount * sizeof(Vertex) + header.indexCount * sizeof(uint32_t) + header.batchCount * sizeof(MeshBatch);
+		if (std::filesystem::file_size(cachePath, error) != tableOffset + header.materialBytes || error) return false;
+
+		std::vector<uint8_t> table(static_cast<size_t>(header.materialBytes));
+		file.seekg(static_cast<std::streamoff>(tableOffset));
+		if (!file.read(reinterpret_cast<char*>(table.data()), table.size())) return false;
+		return DeserializeMaterials(table.data(), table.size(), header.materialCount, materials);
+	}
+
+	// Bakes m_Mesh next to the source, written to a temporary file first so a crash never leaves a torn cache
+	void WriteMeshCache(const std::string& sourcePath, uint64_t sourceSize, uint64_t sourceHash)
+	{
+		MeshCacheHeader header{};
+		memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+		header.version				= MESH_CACHE_VERSION;
+		header.vertexLayoutVersion	= VERTEX_LAYOUT_VERSION;
+		header.vertexStride			= sizeof(Vertex);
+		header.sourceSize			= sourceSize;
+		header.sourceWriteTime		= SourceWriteTime(sourcePath);
+		header.sourceHash			= sourceHash;
+		header.vertexCount			= m_Mesh.vertexCount;
+		header.indexCount			= m_Mesh.indexCount;
+		header.boundsMin			= m_BoundsMin;
+		header.boundsMax			= m_BoundsMax;
+		header.optimizations		= MeshOptimizations();
+		header.lodCount				= static_cast<uint32_t>(m_Mesh.lods.size());
+		std::copy(m_Mesh.lods.begin(), m_Mesh.lods.end(), header.lods);
+		header.batchCount			= static_cast<uint32_t>(m_Mesh.batches.size());
+		header.materialCount		= static_cast<uint32_t>(m_Mesh.materials.size());
+		std::string materialBytes	= SerializeMaterials(m_Mesh.materials);
+		header.materialBytes		= materialBytes.size();
+
+		std::string cachePath = MeshCachePath(sourcePath), tempPath = cachePath + ".tmp";
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(m_Mesh.vertices), m_Mesh.vertexCount * sizeof(Vertex));
+		file.write(reinterpret_cast<const char*>(m_Mesh.indices), m_Mesh.indexCount * sizeof(uint32_t));
+		file.write(reinterpret_cast<const char*>(m_Mesh.batches.data()), m_Mesh.batches.size() * sizeof(MeshBatch));
+		file.write(materialBytes.data(), materialBytes.size());
+		file.close();
+
+		std::error_code error;
+		if (file.fail())
+			std::cerr << "Could not write mesh cache " << tempPath << std::endl;
+		else
+			std::filesystem::rename(tempPath, cachePath, error);
+
+		if (file.fail() || error)
+			std::filesystem::remove(tempPath, error);
+	}
+
+	// A box over the model bounds in a flat grey material, drawn until the loader thread has the model
+	// resident. The bounds come from the mesh cache when there is one, before the first bake a unit box
+	// stands in. Nothing here depends on the size of the model, so neither does the first frame.
+	void CreateModelProxy()
+	{
+		const std::string asset = "model proxy";
+		glm::vec3 boundsMin(-1.0f), boundsMax(1.0f);
+		PeekMeshCacheBounds(MODEL_PATH, boundsMin, boundsMax);
+
+		std::vector<Vertex> vertices;
+		std::vector<uint16_t> indices;
+		BuildBoundsBox(boundsMin, boundsMax, vertices, indices);
+		PackedVertices packed = PackVertices(m_VertexLayout, vertices.data(), vertices.size(), boundsMin, boundsMax);
+		m_ProxyDecode		= packed.decode;
+		m_ProxyIndexCount	= static_cast<uint32_t>(indices.size());
+		CreateDeviceLocalBuffer(asset, packed.data.data(), packed.data.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, m_ProxyVertexBuffer, m_ProxyVertexBufferMemory);
+		CreateDeviceLocalBuffer(asset, indices.data(), indices.size() * sizeof(uint16_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, m_ProxyIndexBuffer, m_ProxyIndexBufferMemory);
+
+		// One grey texel serves as diffuse and specular map
+		const uint8_t grey[4] = { 128, 128, 128, 255 };
+		VkBuffer		stagingBuffer;
+		VkDeviceMemory	stagingBufferMemory;
+		CreateStagingBuffer(asset, grey, sizeof(grey), stagingBuffer, stagingBufferMemory);
+		CreateImage(1, 1, 1, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_ProxyTexture.image, m_ProxyTexture.memory);
+		TransitionImageLayout(m_ProxyTexture.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1);
+		CopyBufferToImage(stagingBuffer, m_ProxyTexture.image, 1, 1);
+		TransitionImageLayout(m_ProxyTexture.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1);
+		vkDestroyBuffer(m_Device, stagingBuffer, m_Allocator);
+		FreeDeviceMemory(stagingBufferMemory);
+		m_ProxyTexture.view		= CreateImageView(m_ProxyTexture.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+		m_ProxyTexture.sampler	= GetTextureSampler(1);
+
+		// With bindless textures the proxy's material is in the material table, see CreateBindlessTextures
+		if (m_BindlessEnabled) return;
+
+		std::array<VkDescriptorPoolSize, 2> poolSizes{};
+		poolSizes[0].type				= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[0].descriptorCount	= 2;
+		poolSizes[1].type				= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[1].descriptorCount	= 1;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount	= static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes		= poolSizes.data();
+		poolInfo.maxSets		= 1;
+		if (vkCreateDescriptorPool(m_Device, &poolInfo, m_Allocator, &m_ProxyDescriptorPool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create proxy descriptor pool");
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType					= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool		= m_ProxyDescriptorPool;
+		allocInfo.descriptorSetCount	= 1;
+		allocInfo.pSetLayouts			= &m_MaterialSetLayout;
+		if (vkAllocateDescriptorSets(m_Device, &allocInfo, &m_ProxyMaterialSet) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate proxy descriptor set");
+		WriteMaterialSet(m_ProxyMaterialSet, m_ProxyTexture, m_ProxyTexture, m_FeedbackBuffers[0]);	// the proxy reports nothing
+	}
+
+	// Bindless textures put every texture in one array and every material in a table of texture
+	// indices, so all materials share one descriptor set and draws pass their material as first
+	// instance. Each frame in flight has its own set for its feedback buffer; a set is never rewritten
+	// while the frame using it is in flight, except for array elements that frame does not use, which
+	// is how the loader thread adds the model's textures while the proxy is drawn. The proxy takes the
+	// last texture and material, the model's fill both from the start.
+	void CreateBindlessTextures()
+	{
+		if (!m_BindlessEnabled) return;
+
+		std::array<VkDescriptorPoolSize, 2> poolSizes{};
+		poolSizes[0].type				= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[0].descriptorCount	= m_BindlessTextureCapacity * MAX_FRAMES_IN_FLIGHT;
+		poolSizes[1].type				= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[1].descriptorCount	= 2 * MAX_FRAMES_IN_FLIGHT;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags			= VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+		poolInfo.poolSizeCount	= static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes		= poolSizes.data();
+		poolInfo.maxSets		= MAX_FRAMES_IN_FLIGHT;
+		if (vkCreateDescriptorPool(m_Device, &poolInfo, m_Allocator, &m_BindlessDescriptorPool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create bindless descriptor pool");
+
+		std::array<VkDescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> layouts;
+		layouts.fill(m_MaterialSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType					= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool		= m_BindlessDescriptorPool;
+		allocInfo.descriptorSetCount	= static_cast<uint32_t>(layouts.size());
+		allocInfo.pSetLayouts			= layouts.data();
+		if (vkAllocateDescriptorSets(m_Device, &allocInfo, m_BindlessSets.data()) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate bindless descriptor sets");
+
+		// Host visible so the loader thread fills in the model's materials without an upload
+		VkDeviceSize tableSize = BINDLESS_MATERIAL_CAPACITY * sizeof(BindlessMaterial);
+		CreateBuffer(tableSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, StagingMemoryProperties(), m_BindlessMaterialBuffer, m_BindlessMaterialMemory);
+		void* data;
+		vkMapMemory(m_Device, m_BindlessMaterialMemory, 0, tableSize, 0, &data);
+		m_BindlessMaterials = static_cast<BindlessMaterial*>(data);
+		uint32_t proxyTexture = m_BindlessTextureCapacity - 1;
+		m_BindlessMaterials[BINDLESS_PROXY_MATERIAL] = BindlessMaterial{ { proxyTexture, proxyTexture } };
+
+		for (size_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+		{
+			WriteBindlessTextures(m_BindlessSets[frame], proxyTexture, &m_ProxyTexture, 1);
+
+			std::array<VkDescriptorBufferInfo, 2> bufferInfos{};
+			bufferInfos[0].buffer	= m_BindlessMaterialBuffer;
+			bufferInfos[0].range	= VK_WHOLE_SIZE;
+			bufferInfos[1].buffer	= m_FeedbackBuffers[frame];
+			bufferInfos[1].range	= VK_WHOLE_SIZE;
+
+			std::array<VkWriteDescriptorSet, 2> writes{};
+			for (uint32_t i = 0; i < writes.size(); i++)
+			{
+				writes[i].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				writes[i].dstSet			= m_BindlessSets[frame];
+				writes[i].dstBinding		= i + 1;	// materials, feedback
+				writes[i].descriptorCount	= 1;
+				writes[i].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				writes[i].pBufferInfo		= &bufferInfos[i];
+			}
+			vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+		}
+	}
+
+	// Writes count textures into the bindless texture array of set, starting at element first
+	void WriteBindlessTextures(VkDescriptorSet set, uint32_t first, const Texture* textures, uint32_t count)
+	{
+		if (count == 0) return;
+		std::vector<VkDescriptorImageInfo> imageInfos(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			imageInfos[i].imageLayout	= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageInfos[i].imageView		= textures[i].view;
+			imageInfos[i].sampler		= textures[i].sampler;
+		}
+
+		VkWriteDescriptorSet write{};
+		write.sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet			= set;
+		write.dstBinding		= 0;
+		write.dstArrayElement	= first;
+		write.descriptorCount	= count;
+		write.descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo		= imageInfos.data();
+		vkUpdateDescriptorSets(m_Device, 1, &write, 0, nullptr);
+	}
+
+	// Uploads data into a new device local buffer through a staging buffer
+	void CreateDeviceLocalBuffer(const std::string& asset, const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& memory)
+	{
+		VkBuffer		stagingBuffer;
+		VkDeviceMemory	stagingBufferMemory;
+		CreateStagingBuffer(asset, data, size, stagingBuffer, stagingBufferMemory);
+		CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+		{
+			AssetLoadProfiler::Scope scope(g_AssetProfiler, asset, AssetStage::GpuUpload, size);
+			CopyBuffer(stagingBuffer, buffer, size);
+		}
+		vkDestroyBuffer(m_Device, stagingBuffer, m_Allocator);
+		FreeDeviceMemory(stagingBufferMemory);
+	}
+
+	void CreateVertexBuffer()
+	{
+		// Splitting the indices for 16 bits may duplicate vertices, so the indices are packed first
+		// and uploaded by CreateIndexBuffer
+		PackedVertices packed;
+		{
+			AssetLoadProfiler::Scope scope(g_AssetProfiler, MODEL_PATH, AssetStage::Optimize, m_Mesh.vertexCount * Vertex::GetStride(m_VertexLayout));
+			m_PackedIndices = PackIndices(m_Mesh.indices, static_cast<size_t>(m_Mesh.indexCount), static_cast<size_t>(m_Mesh.vertexCount), Vertex::GetStride(m_VertexLayout), m_Mesh.batches);
+
+			std::vector<Vertex> remapped(m_PackedIndices.vertexRemap.size());
+			for (size_t i = 0; i < remapped.size(); i++)
+				remapped[i] = m_Mesh.vertices[m_PackedIndices.vertexRemap[i]];
+			if (remapped.empty())
+				packed = PackVertices(m_VertexLayout, m_Mesh.vertices, static_cast<size_t>(m_Mesh.vertexCount), m_BoundsMin, m_BoundsMax);
+			else
+				packed = PackVertices(m_VertexLayout, remapped.data(), remapped.size(), m_BoundsMin, m_BoundsMax);
+		}
+		m_MeshDecode = packed.decode;
+		if (m_VertexLayout != VertexLayout::Full && g_LaunchOptions.verbose)
+		{
+			std::cout << "Vertex layout " << VERTEX_LAYOUT_NAMES[static_cast<size_t>(m_VertexLayout)] << ": "
+				<< Vertex::GetStride(m_VertexLayout) << " bytes per vertex instead of " << sizeof(Vertex)
+				<< ", max error position " << packed.maxPositionError
+				<< " normal " << packed.maxNormalErrorDegrees << " deg"
+				<< " texture coordinates " << packed.maxTextureCoordError << std::endl;
+		}
+
+		VkDeviceSize bufferSize = packed.data.size();
+
+		VkBuffer		stagingBuffer;
+		VkDeviceMemory	stagingBufferMemory;
+
+		CreateStagingBuffer(MODEL_PATH, packed.data.data(), bufferSize, stagingBuffer, stagingBufferMemory);
+
+		CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_VertexBuffer, m_VertexBufferMemory);
+
+		{
+			AssetLoadProfiler::Scope scope(g_AssetProfiler, MODEL_PATH, AssetStage::GpuUpload, bufferSize);
+			CopyBuffer(stagingBuffer, m_VertexBuffer, bufferSize);
+		}
+
+		vkDestroyBuffer(m_Device, stagingBuffer, m_Allocator);
+		FreeDeviceMemory(stagingBufferMemory);
+	}
+
+	void CreateIndexBuffer()
+	{
+		m_IndexType		= m_PackedIndices.type;
+		m_IndexRanges	= std::move(m_PackedIndices.ranges);
+		if (g_LaunchOptions.verbose)
+		{
+			std::cout << "Index buffer: " << (m_IndexType == VK_INDEX_TYPE_UINT16 ? 16 : 32) << " bit indices in " << m_IndexRanges.size() << " draw(s)";
+			if (!m_PackedIndices.vertexRemap.empty())
+				std::cout << ", " << m_PackedIndices.vertexRemap.size() - m_Mesh.vertexCount << " vertices duplicated across the splits";
+			std::cout << std::endl;
+		}
+
+		VkDeviceSize bufferSize = m_PackedIndices.data.size();
+
+		VkBuffer		stagingBuffer;
+		VkDeviceMemory	stagingBufferMemory;
 
-				if (g_UniqueVertices.count(vertex) == 0) {
-					g_UniqueVertices[vertex] = static_cast<uint32_t>(g_Vertices.size());
-					g_Vertices.push_back(vertex);
-				}
+		CreateStagingBuffer(MODEL_PATH, m_PackedIndices.data.data(), bufferSize, stagingBuffer, stagingBufferMemory);
+		m_PackedIndices = PackedIndices{};
+
+		if (g_LaunchOptions.meshletCulling)
+		{
+			AssetLoadProfiler::Scope scope(g_AssetProfiler, MODEL_PATH, AssetStage::Optimize);
+			m_Meshlets = meshopt::BuildMeshlets(m_Mesh.indices, m_Mesh.vertices, static_cast<size_t>(m_Mesh.vertexCount), m_IndexRanges);
+			size_t cullable = std::count_if(m_Meshlets.begin(), m_Meshlets.end(), [](const meshopt::Meshlet& meshlet) { return meshlet.cone.w < 1.0f; });
+			if (g_LaunchOptions.verbose)
+				std::cout << "Built " << m_Meshlets.size() << " meshlets, " << cullable << " of them can be backface culled" << std::endl;
+		}
 
-				g_Indices.push_back(g_UniqueVertices[vertex]);
+		// Ranges and meshlets never span two batches and are in index order, as are the batches, so
+		// each batch owns a run of both and one sweep assigns them
+		m_BatchDraws.assign(m_Mesh.batches.size(), BatchDraws{});
+		size_t range = 0, meshlet = 0;
+		for (size_t b = 0; b < m_Mesh.batches.size(); b++)
+		{
+			uint32_t end = m_Mesh.batches[b].firstIndex + m_Mesh.batches[b].indexCount;
+			BatchDraws& draws = m_BatchDraws[b];
+			draws.firstRange	= static_cast<uint32_t>(range);
+			draws.firstMeshlet	= static_cast<uint32_t>(meshlet);
+			while (range < m_IndexRanges.size() && m_IndexRanges[range].firstIndex < end) range++;
+			while (meshlet < m_Meshlets.size() && m_Meshlets[meshlet].firstIndex < end) meshlet++;
+			draws.rangeCount	= static_cast<uint32_t>(range) - draws.firstRange;
+			draws.meshletCount	= static_cast<uint32_t>(meshlet) - draws.firstMeshlet;
+			// cull.comp passes the material on as first instance, which needs drawIndirectFirstInstance
+			if (m_BindlessEnabled)
+			{
+				for (size_t m = draws.firstMeshlet; m < meshlet; m++)
+					m_Meshlets[m].material = m_Mesh.batches[b].material;
 			}
 		}
+		m_CurrentLod = 0;
+		
+		CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_IndexBuffer, m_IndexBufferMemory);
+		{
+			AssetLoadProfiler::Scope scope(g_AssetProfiler, MODEL_PATH, AssetStage::GpuUpload, bufferSize);
+			CopyBuffer(stagingBuffer, m_IndexBuffer, bufferSize);
+		}
+		vkDestroyBuffer(m_Device, stagingBuffer, m_Allocator);
+		FreeDeviceMemory(stagingBufferMemory);
+
+		// Both buffers are on the GPU now, the mesh cache mapping is no longer needed
+		m_MeshCacheFile.Close();
+		m_Mesh.vertices = nullptr;
+		m_Mesh.indices	= nullptr;
 	}
 
-	void CreateVertexBuffer()
+	// Uploads the meshlets and creates the compute pipeline of cull.comp, which rewrites one indexed
+	// indirect draw per meshlet every frame with an instance count of 0 for the ones it culls.
+	// Without the shader or the multiDrawIndirect feature the mesh is drawn whole as before.
+	void CreateMeshletCulling()
 	{
-		VkDeviceSize bufferSize = sizeof(g_Vertices[0]) * g_Vertices.size();
+		m_MeshletCullingAvailable = false;
+		if (m_Meshlets.empty()) return;
+		if (!m_MultiDrawIndirectSupported)
+		{
+			std::cerr << "multiDrawIndirect is not supported, meshlet culling disabled" << std::endl;
+			return;
+		}
+
+		std::vector<char> shaderCode;
+		try
+		{
+			shaderCode = ReadFile("shaders/cull_comp.spv");
+		}
+		catch (const std::runtime_error&)
+		{
+			std::cerr << "Culling shader not found, build the project or run shaders/complie.bat to enable meshlet culling" << std::endl;
+			return;
+		}
 
+		VkDeviceSize meshletBytes = sizeof(meshopt::Meshlet) * m_Meshlets.size();
 		VkBuffer		stagingBuffer;
 		VkDeviceMemory	stagingBufferMemory;
+		CreateStagingBuffer(MODEL_PATH, m_Meshlets.data(), meshletBytes, stagingBuffer, stagingBufferMemory);
+		CreateBuffer(meshletBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_MeshletBuffer, m_MeshletBufferMemory);
+		{
+			AssetLoadProfiler::Scope scope(g_AssetProfiler, MODEL_PATH, AssetStage::GpuUpload, meshletBytes);
+			CopyBuffer(stagingBuffer, m_MeshletBuffer, meshletBytes);
+		}
+		vkDestroyBuffer(m_Device, stagingBuffer, m_Allocator);
+		FreeDeviceMemory(stagingBufferMemory);
 
-		CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+		// One buffer for all swapchain images, RecordCommandBuffers orders the rewrite after the previous frame's draws
+		VkDeviceSize drawBytes = sizeof(VkDrawIndexedIndirectCommand) * m_Meshlets.size();
+		CreateBuffer(drawBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_MeshletDrawBuffer, m_MeshletDrawBufferMemory);
 
-		void* data;
-		vkMapMemory(m_Device, stagingBufferMemory, 0, bufferSize, 0, &data);
-			memcpy(data, g_Vertices.data(), (size_t)bufferSize);
-		vkUnmapMemory(m_Device, stagingBufferMemory);
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+		for (uint32_t i = 0; i < bindings.size(); i++)
+		{
+			bindings[i].binding			= i;
+			bindings[i].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount	= 1;
+			bindings[i].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+		}
 
-		CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_VertexBuffer, m_VertexBufferMemory);
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount	= static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings	= bindings.data();
+		if (vkCreateDescriptorSetLayout(m_Device, &layoutInfo, m_Allocator, &m_CullingSetLayout) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create culling descriptor set layout");
+
+		VkDescriptorPoolSize poolSize{};
+		poolSize.type				= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSize.descriptorCount	= static_cast<uint32_t>(bindings.size());
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount	= 1;
+		poolInfo.pPoolSizes		= &poolSize;
+		poolInfo.maxSets		= 1;
+		if (vkCreateDescriptorPool(m_Device, &poolInfo, m_Allocator, &m_CullingDescriptorPool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create culling descriptor pool");
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType					= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool		= m_CullingDescriptorPool;
+		allocInfo.descriptorSetCount	= 1;
+		allocInfo.pSetLayouts			= &m_CullingSetLayout;
+		if (vkAllocateDescriptorSets(m_Device, &allocInfo, &m_CullingDescriptorSet) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate culling descriptor set");
+
+		std::array<VkDescriptorBufferInfo, 2> bufferInfos{};
+		bufferInfos[0].buffer	= m_MeshletBuffer;
+		bufferInfos[0].range	= VK_WHOLE_SIZE;
+		bufferInfos[1].buffer	= m_MeshletDrawBuffer;
+		bufferInfos[1].range	= VK_WHOLE_SIZE;
+
+		std::array<VkWriteDescriptorSet, 2> writes{};
+		for (uint32_t i = 0; i < writes.size(); i++)
+		{
+			writes[i].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet			= m_CullingDescriptorSet;
+			writes[i].dstBinding		= i;
+			writes[i].descriptorCount	= 1;
+			writes[i].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[i].pBufferInfo		= &bufferInfos[i];
+		}
+		vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 
-		CopyBuffer(stagingBuffer, m_VertexBuffer, bufferSize);
+		VkPushConstantRange pushConstants{};
+		pushConstants.stageFlags	= VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstants.offset		= 0;
+		pushConstants.size			= sizeof(MeshletCullingConstants);
 
-		vkDestroyBuffer(m_Device, stagingBuffer, nullptr);
-		vkFreeMemory(m_Device, stagingBufferMemory, nullptr);
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType					= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount			= 1;
+		pipelineLayoutInfo.pSetLayouts				= &m_CullingSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount	= 1;
+		pipelineLayoutInfo.pPushConstantRanges		= &pushConstants;
+		if (vkCreatePipelineLayout(m_Device, &pipelineLayoutInfo, m_Allocator, &m_CullingPipelineLayout) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create culling pipeline layout");
+
+		VkShaderModule shaderModule = CreateShaderModule(shaderCode);
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType			= VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType	= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage	= VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module	= shaderModule;
+		pipelineInfo.stage.pName	= "main";
+		pipelineInfo.layout			= m_CullingPipelineLayout;
+
+		VkResult result = vkCreateComputePipelines(m_Device, VK_NULL_HANDLE, 1, &pipelineInfo, m_Allocator, &m_CullingPipeline);
+		vkDestroyShaderModule(m_Device, shaderModule, m_Allocator);
+		if (result != VK_SUCCESS)
+			throw std::runtime_error("Failed to create culling pipeline");
+
+		m_MeshletCullingAvailable = true;
 	}
 
-	void CreateIndexBuffer()
+	// Creates the compute pipeline of mipgen.comp. Without the shader, storage support for R8G8B8A8_UNORM
+	// or VK_KHR_maintenance2 for the sRGB views of those images, GenerateMipmaps blits as before.
+	void CreateMipGeneration()
 	{
-		VkDeviceSize bufferSize = sizeof(g_Indices[0]) * g_Indices.size();
+		m_MipGenerationAvailable = false;
+		if (!IsFormatSupported(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT))
+		{
+			std::cerr << "R8G8B8A8_UNORM storage images are not supported, mips are generated with blits" << std::endl;
+			return;
+		}
+		if (!m_Maintenance2Enabled)
+		{
+			std::cerr << "VK_KHR_maintenance2 is not supported, mips are generated with blits" << std::endl;
+			return;
+		}
 
-		VkBuffer		stagingBuffer;
-		VkDeviceMemory	stagingBufferMemory;
+		std::vector<char> shaderCode;
+		try
+		{
+			shaderCode = ReadFile("shaders/mipgen_comp.spv");
+		}
+		catch (const std::runtime_error&)
+		{
+			std::cerr << "Mip generation shader not found, build the project or run shaders/complie.bat to generate mips with compute" << std::endl;
+			return;
+		}
 
-		CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+		// The source level and the levels written
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+		for (uint32_t i = 0; i < bindings.size(); i++)
+		{
+			bindings[i].binding			= i;
+			bindings[i].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			bindings[i].descriptorCount	= i == 0 ? 1 : MIP_LEVELS_PER_PASS;
+			bindings[i].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+		}
 
-		void* data;
-		vkMapMemory(m_Device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, g_Indices.data(), (size_t)bufferSize);
-		vkUnmapMemory(m_Device, stagingBufferMemory);
-		
-		CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_IndexBuffer, m_IndexBufferMemory);
-		CopyBuffer(stagingBuffer, m_IndexBuffer, bufferSize);
-		vkDestroyBuffer(m_Device, stagingBuffer, nullptr);
-		vkFreeMemory(m_Device, stagingBufferMemory, nullptr);
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount	= static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings	= bindings.data();
+		if (vkCreateDescriptorSetLayout(m_Device, &layoutInfo, m_Allocator, &m_MipGenerationSetLayout) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create mip generation descriptor set layout");
+
+		VkPushConstantRange pushConstants{};
+		pushConstants.stageFlags	= VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstants.offset		= 0;
+		pushConstants.size			= sizeof(MipGenerationConstants);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType					= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount			= 1;
+		pipelineLayoutInfo.pSetLayouts				= &m_MipGenerationSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount	= 1;
+		pipelineLayoutInfo.pPushConstantRanges		= &pushConstants;
+		if (vkCreatePipelineLayout(m_Device, &pipelineLayoutInfo, m_Allocator, &m_MipGenerationPipelineLayout) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create mip generation pipeline layout");
+
+		VkShaderModule shaderModule = CreateShaderModule(shaderCode);
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType			= VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType	= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage	= VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module	= shaderModule;
+		pipelineInfo.stage.pName	= "main";
+		pipelineInfo.layout			= m_MipGenerationPipelineLayout;
+
+		VkResult result = vkCreateComputePipelines(m_Device, VK_NULL_HANDLE, 1, &pipelineInfo, m_Allocator, &m_MipGenerationPipeline);
+		vkDestroyShaderModule(m_Device, shaderModule, m_Allocator);
+		if (result != VK_SUCCESS)
+			throw std::runtime_error("Failed to create mip generation pipeline");
+
+		m_MipGenerationAvailable = true;
+	}
+
+	// Runs cull.comp over the meshlets, outside of a render pass
+	void RecordMeshletCulling(VkCommandBuffer commandBuffer)
+	{
+		// The previous frame's draws read the same buffer, only an execution dependency is needed before overwriting it
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullingPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullingPipelineLayout, 0, 1, &m_CullingDescriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, m_CullingPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_MeshletCulling), &m_MeshletCulling);
+		vkCmdDispatch(commandBuffer, (m_MeshletCulling.meshletCount + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType				= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask		= VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask		= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		barrier.srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer				= m_MeshletDrawBuffer;
+		barrier.offset				= 0;
+		barrier.size				= VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
 	}
 
 	void CreateUniformBuffers()
@@ -1429,17 +5906,13 @@ private:
 
 	void CreateDescriptorPool()
 	{
-		std::array<VkDescriptorPoolSize, 5> poolSizes{};
+		std::array<VkDescriptorPoolSize, 3> poolSizes{};
 		poolSizes[0].descriptorCount	= static_cast<uint32_t>(m_SwapchainImages.size());
 		poolSizes[0].type				= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		poolSizes[1].descriptorCount	= static_cast<uint32_t>(m_SwapchainImages.size());
-		poolSizes[1].type				= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[1].type				= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		poolSizes[2].descriptorCount	= static_cast<uint32_t>(m_SwapchainImages.size());
 		poolSizes[2].type				= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSizes[3].descriptorCount	= static_cast<uint32_t>(m_SwapchainImages.size());
-		poolSizes[3].type				= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSizes[4].descriptorCount	= static_cast<uint32_t>(m_SwapchainImages.size());
-		poolSizes[4].type				= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 
 		VkDescriptorPoolCreateInfo poolInfo{};
 		poolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -1447,7 +5920,7 @@ private:
 		poolInfo.pPoolSizes		= poolSizes.data();
 		poolInfo.maxSets		= static_cast<uint32_t>(m_SwapchainImages.size());
 
-		if (vkCreateDescriptorPool(m_Device, &poolInfo, nullptr, &m_DescriptorPool))
+		if (vkCreateDescriptorPool(m_Device, &poolInfo, m_Allocator, &m_DescriptorPool))
 		{
 			throw std::runtime_error("Failed to create descriptor pool");
 		}
@@ -1474,11 +5947,6 @@ private:
 			MVPBufferInfo.offset	= 0;
 			MVPBufferInfo.range		= sizeof(UniformBufferObject);
 
-			VkDescriptorImageInfo imageInfo{};
-			imageInfo.imageLayout	= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView		= m_TextureImageView;
-			imageInfo.sampler		= m_TextureSampler;
-
 			VkDescriptorBufferInfo lightBufferInfo{};
 			lightBufferInfo.buffer	= m_LightUniformBuffers[i];
 			lightBufferInfo.offset	= 0;
@@ -1489,12 +5957,7 @@ private:
 			cameraBufferInfo.offset	= 0;
 			cameraBufferInfo.range	= sizeof(glm::vec3);
 
-			VkDescriptorImageInfo specularInfo{};
-			specularInfo.imageLayout	= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			specularInfo.imageView		= m_SpecularImageView;
-			specularInfo.sampler		= m_SpecularSampler;
-
-			std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
+			std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
 			descriptorWrites[0].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 			descriptorWrites[0].dstSet				= m_DescriptorSets[i];
 			descriptorWrites[0].dstBinding			= 0;
@@ -1505,39 +5968,137 @@ private:
 
 			descriptorWrites[1].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 			descriptorWrites[1].dstSet				= m_DescriptorSets[i];
-			descriptorWrites[1].dstBinding			= 1;
+			descriptorWrites[1].dstBinding			= 2;
 			descriptorWrites[1].dstArrayElement		= 0;
-			descriptorWrites[1].descriptorType		= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			descriptorWrites[1].descriptorType		= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 			descriptorWrites[1].descriptorCount		= 1;
-			descriptorWrites[1].pImageInfo			= &imageInfo;
+			descriptorWrites[1].pBufferInfo			= &lightBufferInfo;
 
 			descriptorWrites[2].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 			descriptorWrites[2].dstSet				= m_DescriptorSets[i];
-			descriptorWrites[2].dstBinding			= 2;
+			descriptorWrites[2].dstBinding			= 3;
 			descriptorWrites[2].dstArrayElement		= 0;
 			descriptorWrites[2].descriptorType		= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 			descriptorWrites[2].descriptorCount		= 1;
-			descriptorWrites[2].pBufferInfo			= &lightBufferInfo;
+			descriptorWrites[2].pBufferInfo			= &cameraBufferInfo;
+
+			vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+		}
+	}
+
+	// One descriptor set per material and frame in flight with its diffuse and specular texture and the
+	// frame's feedback buffer. They survive swapchain recreation. Streaming replaces texture images, so
+	// RecordTextureStreaming rewrites a frame's sets before recording it, when the frame's previous
+	// submission has completed.
+	void CreateMaterialDescriptorSets()
+	{
+		uint32_t materialCount = static_cast<uint32_t>(m_MaterialTextures.size());
+		if (m_BindlessEnabled)
+		{
+			// SelectFragmentShader turned bindless off for models that could get here, unless the files
+			// changed since. The last texture and material are the proxy's.
+			if (m_Textures.size() >= m_BindlessTextureCapacity || materialCount >= BINDLESS_PROXY_MATERIAL)
+				throw std::runtime_error("The model changed while loading and has more textures or materials than bindless textures hold");
 
-			descriptorWrites[3].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[3].dstSet				= m_DescriptorSets[i];
-			descriptorWrites[3].dstBinding			= 3;
-			descriptorWrites[3].dstArrayElement		= 0;
-			descriptorWrites[3].descriptorType		= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[3].descriptorCount		= 1;
-			descriptorWrites[3].pBufferInfo			= &cameraBufferInfo;
+			for (uint32_t i = 0; i < materialCount; i++)
+			{
+				const uint32_t indices[2] = { m_MaterialTextures[i].diffuse, m_MaterialTextures[i].specular };
+				BindlessMaterial& material = m_BindlessMaterials[i];
+				for (int k = 0; k < 2; k++)
+				{
+					material.textures[k]		= indices[k];
+					material.feedbackSlots[k]	= m_TextureStreams.count(indices[k]) != 0 ? indices[k] : NO_FEEDBACK;
+					material.mipLevels[k]		= m_Textures[indices[k]].mipLevels;
+				}
+			}
+			for (size_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+				WriteMaterialSets(frame);
+			return;
+		}
+
+		std::array<VkDescriptorPoolSize, 2> poolSizes{};
+		poolSizes[0].type				= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[0].descriptorCount	= materialCount * 2 * MAX_FRAMES_IN_FLIGHT;
+		poolSizes[1].type				= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[1].descriptorCount	= materialCount * MAX_FRAMES_IN_FLIGHT;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount	= static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes		= poolSizes.data();
+		poolInfo.maxSets		= materialCount * MAX_FRAMES_IN_FLIGHT;
 
-			descriptorWrites[4].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[4].dstSet				= m_DescriptorSets[i];
-			descriptorWrites[4].dstBinding			= 4;
-			descriptorWrites[4].dstArrayElement		= 0;
-			descriptorWrites[4].descriptorType		= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			descriptorWrites[4].descriptorCount		= 1;
-			descriptorWrites[4].pImageInfo			= &specularInfo;
+		if (vkCreateDescriptorPool(m_Device, &poolInfo, m_Allocator, &m_MaterialDescriptorPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create material descriptor pool");
+		}
 
+		std::vector<VkDescriptorSetLayout> layouts(materialCount, m_MaterialSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType					= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool		= m_MaterialDescriptorPool;
+		allocInfo.descriptorSetCount	= materialCount;
+		allocInfo.pSetLayouts			= layouts.data();
 
-			vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+		for (size_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+		{
+			m_MaterialSets[frame].resize(materialCount);
+			if (vkAllocateDescriptorSets(m_Device, &allocInfo, m_MaterialSets[frame].data()) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate material descriptor sets!");
+			}
+			WriteMaterialSets(frame);
+		}
+	}
+
+	void WriteMaterialSets(size_t frame)
+	{
+		if (m_BindlessEnabled)
+			WriteBindlessTextures(m_BindlessSets[frame], 0, m_Textures.data(), static_cast<uint32_t>(m_Textures.size()));
+		for (uint32_t i = 0; i < m_MaterialSets[frame].size(); i++)
+			WriteMaterialSet(m_MaterialSets[frame][i], m_Textures[m_MaterialTextures[i].diffuse], m_Textures[m_MaterialTextures[i].specular], m_FeedbackBuffers[frame]);
+		m_MaterialSetGenerations[frame] = m_StreamingGeneration;
+	}
+
+	void WriteMaterialSet(VkDescriptorSet set, const Texture& diffuse, const Texture& specular, VkBuffer feedback)
+	{
+		std::array<VkDescriptorImageInfo, 2> imageInfos{};
+		imageInfos[0].imageLayout	= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfos[0].imageView		= diffuse.view;
+		imageInfos[0].sampler		= diffuse.sampler;
+		imageInfos[1].imageLayout	= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfos[1].imageView		= specular.view;
+		imageInfos[1].sampler		= specular.sampler;
+
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer	= feedback;
+		bufferInfo.range	= VK_WHOLE_SIZE;
+
+		std::array<VkWriteDescriptorSet, 3> writes{};
+		for (uint32_t binding = 0; binding < writes.size(); binding++)
+		{
+			writes[binding].sType			= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[binding].dstSet			= set;
+			writes[binding].dstBinding		= binding;
+			writes[binding].dstArrayElement	= 0;
+			writes[binding].descriptorCount	= 1;
+			if (binding < imageInfos.size())
+			{
+				writes[binding].descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				writes[binding].pImageInfo		= &imageInfos[binding];
+			}
+			else
+			{
+				writes[binding].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				writes[binding].pBufferInfo		= &bufferInfo;
+			}
 		}
+		vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+
+	// Command pools are not thread safe, the loader thread records into its own
+	VkCommandPool SingleTimeCommandPool() const
+	{
+		return t_LoaderThread ? m_LoaderCommandPool : m_CommandPool;
 	}
 
 	VkCommandBuffer BeginSingleTimeCommand()
@@ -1545,7 +6106,7 @@ private:
 		VkCommandBufferAllocateInfo commandInfo{};
 		commandInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 		commandInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		commandInfo.commandPool = m_CommandPool;
+		commandInfo.commandPool = SingleTimeCommandPool();
 		commandInfo.commandBufferCount = 1;
 
 		VkCommandBuffer copyCommandBuffer;
@@ -1570,13 +6131,27 @@ private:
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &buffer;
 
-		vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(m_GraphicsQueue);
-		vkFreeCommandBuffers(m_Device, m_CommandPool, 1, &buffer);
+		// Waits for this submission only, vkQueueWaitIdle would also wait for the frames in flight
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VkFence fence;
+		if (vkCreateFence(m_Device, &fenceInfo, m_Allocator, &fence) != VK_SUCCESS) throw std::runtime_error("Upload fence could not be created");
+		{
+			std::lock_guard<std::mutex> lock(m_QueueMutex);
+			vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, fence);
+		}
+		vkWaitForFences(m_Device, 1, &fence, VK_TRUE, UINT64_MAX);
+		vkDestroyFence(m_Device, fence, m_Allocator);
+		vkFreeCommandBuffers(m_Device, SingleTimeCommandPool(), 1, &buffer);
 	}
 
 	void TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) {
 		VkCommandBuffer commandBuffer = BeginSingleTimeCommand();
+		TransitionImageLayout(commandBuffer, image, format, oldLayout, newLayout, mipLevels);
+		EndSingleTimeCommand(commandBuffer);
+	}
+
+	void TransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) {
 		VkImageMemoryBarrier barrier{};
 
 		VkPipelineStageFlags sourceStage;
@@ -1612,6 +6187,15 @@ private:
 			sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
 			destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 		}
+		else if (oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+		{
+			// Earlier frames only read the image, waiting for them is enough
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+			sourceStage			= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			destinationStage	= VK_PIPELINE_STAGE_TRANSFER_BIT;
+		}
 		else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) 
 		{
 			barrier.srcAccessMask = 0;
@@ -1643,15 +6227,18 @@ private:
 			0, nullptr,
 			1, &barrier
 		);
-
-
-		EndSingleTimeCommand(commandBuffer);
 	}
 
 	void CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
 	{
 		VkCommandBuffer commandBuffer = BeginSingleTimeCommand();
+		CopyBufferToImage(commandBuffer, buffer, image, { FullImageCopy(width, height) });
+		EndSingleTimeCommand(commandBuffer);
+	}
 
+	// Copy of tightly packed texels into the first level of a colour image
+	static VkBufferImageCopy FullImageCopy(uint32_t width, uint32_t height)
+	{
 		VkBufferImageCopy region{};
 		region.bufferOffset = 0;
 		region.bufferRowLength = 0;
@@ -1669,9 +6256,12 @@ private:
 			1
 		};
 
-		vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		return region;
+	}
 
-		EndSingleTimeCommand(commandBuffer);
+	void CopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image, const std::vector<VkBufferImageCopy>& regions)
+	{
+		vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
 	}
 
 	void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) 
@@ -1695,7 +6285,8 @@ private:
 		bufferInfo.usage		= usage;
 		bufferInfo.sharingMode	= VK_SHARING_MODE_EXCLUSIVE;
 
-		if (vkCreateBuffer(m_Device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+		HostAllocationTracker::Tag tag(g_HostAllocations, "VkBuffer");
+		if (vkCreateBuffer(m_Device, &bufferInfo, m_Allocator, &buffer) != VK_SUCCESS)
 		{
 			throw std::exception("failed to create vertex buffer");
 		}
@@ -1706,15 +6297,46 @@ private:
 		VkMemoryAllocateInfo allocInfo{};
 		allocInfo.sType				= VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 		allocInfo.allocationSize	= memRequirements.size;
-		allocInfo.memoryTypeIndex	= FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		allocInfo.memoryTypeIndex	= FindMemoryType(memRequirements.memoryTypeBits, properties);
 
-		if (vkAllocateMemory(m_Device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+		if (AllocateDeviceMemory(allocInfo, memory) != VK_SUCCESS) {
 			throw std::runtime_error("failed to allocate vertex buffer memory!");
 		}
 
 		vkBindBufferMemory(m_Device, buffer, memory, 0);
 	}
 
+	// vkAllocateMemory wrapper that keeps track of how much device memory is in use
+	VkResult AllocateDeviceMemory(const VkMemoryAllocateInfo& allocInfo, VkDeviceMemory& memory)
+	{
+		HostAllocationTracker::Tag tag(g_HostAllocations, "VkDeviceMemory");
+		VkResult result = vkAllocateMemory(m_Device, &allocInfo, m_Allocator, &memory);
+		if (result == VK_SUCCESS)
+		{
+			std::lock_guard<std::mutex> lock(m_DeviceMemoryMutex);
+			uint32_t heap = m_MemoryProperties.memoryTypes[allocInfo.memoryTypeIndex].heapIndex;
+			m_DeviceMemoryAllocations[memory] = { allocInfo.allocationSize, heap };
+			m_HeapUsage[heap] += allocInfo.allocationSize;
+			m_DeviceMemoryInUse += allocInfo.allocationSize;
+			m_PeakDeviceMemory = std::max(m_PeakDeviceMemory, m_DeviceMemoryInUse);
+		}
+		return result;
+	}
+
+	void FreeDeviceMemory(VkDeviceMemory memory)
+	{
+		std::unique_lock<std::mutex> lock(m_DeviceMemoryMutex);
+		auto it = m_DeviceMemoryAllocations.find(memory);
+		if (it != m_DeviceMemoryAllocations.end())
+		{
+			m_DeviceMemoryInUse -= it->second.size;
+			m_HeapUsage[it->second.heap] -= it->second.size;
+			m_DeviceMemoryAllocations.erase(it);
+		}
+		lock.unlock();
+		vkFreeMemory(m_Device, memory, m_Allocator);
+	}
+
 	uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags flags)
 	{
 		VkPhysicalDeviceMemoryProperties memProp;
@@ -1747,6 +6369,7 @@ private:
 
 	void RecordCommandBuffers(int currentImage)
 	{
+			HostAllocationTracker::Tag tag(g_HostAllocations, "RecordCommandBuffers");
 			VkCommandBufferBeginInfo beginInfo{};
 			beginInfo.sType				= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 			beginInfo.flags				= 0; // Optional
@@ -1771,25 +6394,130 @@ private:
 			renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 			renderPassInfo.pClearValues = clearValues.data();
 
+			if (m_TimestampQueryPool != VK_NULL_HANDLE)
+			{
+				vkCmdResetQueryPool(m_CommandBuffers[currentImage], m_TimestampQueryPool, currentImage * TIMESTAMPS_PER_FRAME, TIMESTAMPS_PER_FRAME);
+				vkCmdWriteTimestamp(m_CommandBuffers[currentImage], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_TimestampQueryPool, currentImage * TIMESTAMPS_PER_FRAME);
+			}
+			if (m_PipelineStatisticsQueryPool != VK_NULL_HANDLE)
+				vkCmdResetQueryPool(m_CommandBuffers[currentImage], m_PipelineStatisticsQueryPool, currentImage, 1);
+			if (m_ModelResident)
+				RecordTextureStreaming(m_CommandBuffers[currentImage]);
+			if (m_ModelResident && m_MeshletCullingAvailable)
+				RecordMeshletCulling(m_CommandBuffers[currentImage]);
+
 			vkCmdBeginRenderPass(m_CommandBuffers[currentImage], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 			vkCmdBindPipeline(m_CommandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline);
 
-			VkBuffer buffers[]		= { m_VertexBuffer };
-			VkDeviceSize offsets[]	= { 0 };
-			vkCmdBindVertexBuffers(m_CommandBuffers[currentImage], 0, 1, buffers, offsets);
-
-			vkCmdBindIndexBuffer(m_CommandBuffers[currentImage], m_IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-
 			vkCmdBindDescriptorSets(m_CommandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &m_DescriptorSets[currentImage], 0, nullptr);
 
-			vkCmdDrawIndexed(m_CommandBuffers[currentImage], static_cast<uint32_t>(g_Indices.size()), 1, 0, 0, 0);
+			if (m_PipelineStatisticsQueryPool != VK_NULL_HANDLE)
+				vkCmdBeginQuery(m_CommandBuffers[currentImage], m_PipelineStatisticsQueryPool, currentImage, 0);
+			m_DrawStats = DrawStatistics{};
+			if (m_ModelResident)
+				RecordModelDraws(m_CommandBuffers[currentImage]);
+			else
+				RecordModelProxy(m_CommandBuffers[currentImage]);
+			if (m_PipelineStatisticsQueryPool != VK_NULL_HANDLE)
+			{
+				vkCmdEndQuery(m_CommandBuffers[currentImage], m_PipelineStatisticsQueryPool, currentImage);
+				m_PipelineStatisticsWritten[currentImage] = true;
+			}
 
 			vkCmdEndRenderPass(m_CommandBuffers[currentImage]);
+			if (m_ModelResident && m_TextureStreamingEnabled)
+				RecordTextureFeedbackRead(m_CommandBuffers[currentImage]);
+
+			if (m_TimestampQueryPool != VK_NULL_HANDLE)
+				vkCmdWriteTimestamp(m_CommandBuffers[currentImage], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_TimestampQueryPool, currentImage * TIMESTAMPS_PER_FRAME + 1);
+
+			RecordOverlay(m_CommandBuffers[currentImage], currentImage);
+
+			if (m_TimestampQueryPool != VK_NULL_HANDLE)
+			{
+				vkCmdWriteTimestamp(m_CommandBuffers[currentImage], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_TimestampQueryPool, currentImage * TIMESTAMPS_PER_FRAME + 2);
+				m_TimestampsWritten[currentImage] = true;
+			}
+
 			if (vkEndCommandBuffer(m_CommandBuffers[currentImage]) != VK_SUCCESS) {
 				throw std::runtime_error("failed to record command buffer!");
 			}
 	}
 
+	// The batches of the current LOD, sorted by material so each material's textures are bound once
+	void RecordModelDraws(VkCommandBuffer commandBuffer)
+	{
+		VkBuffer buffers[]		= { m_VertexBuffer };
+		VkDeviceSize offsets[]	= { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer, 0, m_IndexType);
+		vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(m_MeshDecode), &m_MeshDecode);
+
+		const MeshLod& lod = m_Mesh.lods[m_CurrentLod];
+		m_DrawStats.triangles = lod.indexCount / 3;
+		if (m_BindlessEnabled)
+		{
+			// One set for all materials, each draw passes its own as first instance. The meshlet draws
+			// still go out per batch: the shader indexes the texture array with the material, which has
+			// to be the same across a multi draw since it does not use nonuniformEXT.
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 1, 1, &m_BindlessSets[currentFrame], 0, nullptr);
+			MaterialPushConstants material = MaterialFeedback(0);
+			vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(MeshPushConstants), sizeof(material), &material);
+			m_DrawStats.materialBinds++;
+		}
+
+		uint32_t boundMaterial = std::numeric_limits<uint32_t>::max();
+		for (uint32_t b = lod.firstBatch; b < lod.firstBatch + lod.batchCount; b++)
+		{
+			const BatchDraws& draws = m_BatchDraws[b];
+			if (!m_BindlessEnabled && m_Mesh.batches[b].material != boundMaterial)
+			{
+				boundMaterial = m_Mesh.batches[b].material;
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 1, 1, &m_MaterialSets[currentFrame][boundMaterial], 0, nullptr);
+				MaterialPushConstants material = MaterialFeedback(boundMaterial);
+				vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(MeshPushConstants), sizeof(material), &material);
+				m_DrawStats.materialBinds++;
+			}
+
+			if (m_MeshletCullingAvailable)
+				RecordMeshletDraws(commandBuffer, draws.firstMeshlet, draws.firstMeshlet + draws.meshletCount);
+			else
+			{
+				uint32_t firstInstance = m_BindlessEnabled ? m_Mesh.batches[b].material : 0;
+				for (uint32_t i = draws.firstRange; i < draws.firstRange + draws.rangeCount; i++)
+					vkCmdDrawIndexed(commandBuffer, m_IndexRanges[i].indexCount, 1, m_IndexRanges[i].firstIndex, m_IndexRanges[i].vertexOffset, firstInstance);
+				m_DrawStats.draws += draws.rangeCount;
+			}
+		}
+	}
+
+	// The indirect draws cull.comp wrote for meshlets first to end - 1
+	void RecordMeshletDraws(VkCommandBuffer commandBuffer, uint32_t firstMeshlet, uint32_t endMeshlet)
+	{
+		// maxDrawIndirectCount is at least 65535 with multiDrawIndirect, very large meshes need a few calls
+		for (uint32_t first = firstMeshlet; first < endMeshlet; first += m_MaxDrawIndirectCount)
+		{
+			uint32_t count = std::min(m_MaxDrawIndirectCount, endMeshlet - first);
+			vkCmdDrawIndexedIndirect(commandBuffer, m_MeshletDrawBuffer, first * sizeof(VkDrawIndexedIndirectCommand), count, sizeof(VkDrawIndexedIndirectCommand));
+		}
+		m_DrawStats.draws += endMeshlet - firstMeshlet;
+	}
+
+	// Stands in for the model while the loader thread works on it, see CreateModelProxy
+	void RecordModelProxy(VkCommandBuffer commandBuffer)
+	{
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_ProxyVertexBuffer, &offset);
+		vkCmdBindIndexBuffer(commandBuffer, m_ProxyIndexBuffer, 0, VK_INDEX_TYPE_UINT16);
+		vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(m_ProxyDecode), &m_ProxyDecode);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 1, 1, m_BindlessEnabled ? &m_BindlessSets[currentFrame] : &m_ProxyMaterialSet, 0, nullptr);
+		MaterialPushConstants material;
+		vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(MeshPushConstants), sizeof(material), &material);
+		vkCmdDrawIndexed(commandBuffer, m_ProxyIndexCount, 1, 0, 0, m_BindlessEnabled ? BINDLESS_PROXY_MATERIAL : 0);
+		m_DrawStats.draws		= 1;
+		m_DrawStats.triangles	= m_ProxyIndexCount / 3;
+	}
+
 	void CreateSemaphores()
 	{
 		m_ImageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
@@ -1805,9 +6533,9 @@ private:
 		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-			if (vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &m_ImageAvailableSemaphores[i]) != VK_SUCCESS ||
-				vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &m_RenderFinishedSemaphores[i]) != VK_SUCCESS ||
-				vkCreateFence(m_Device, &fenceInfo, nullptr, &m_InFlightFences[i]) != VK_SUCCESS) {
+			if (vkCreateSemaphore(m_Device, &semaphoreInfo, m_Allocator, &m_ImageAvailableSemaphores[i]) != VK_SUCCESS ||
+				vkCreateSemaphore(m_Device, &semaphoreInfo, m_Allocator, &m_RenderFinishedSemaphores[i]) != VK_SUCCESS ||
+				vkCreateFence(m_Device, &fenceInfo, m_Allocator, &m_InFlightFences[i]) != VK_SUCCESS) {
 
 				throw std::runtime_error("failed to create semaphores for a frame!");
 			}
@@ -1820,8 +6548,9 @@ private:
 		createInfo.codeSize = code.size();
 		createInfo.pCode	= reinterpret_cast<const uint32_t*>(code.data());
 
+		HostAllocationTracker::Tag tag(g_HostAllocations, "VkShaderModule");
 		VkShaderModule shaderModule;
-		if (vkCreateShaderModule(m_Device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+		if (vkCreateShaderModule(m_Device, &createInfo, m_Allocator, &shaderModule) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create shader module!");
 		}
 
@@ -1852,11 +6581,72 @@ private:
 		while (!glfwWindowShouldClose(m_Window))
 		{
 			glfwPollEvents();
-			ProcessInput();
+			PollModelLoad();
+			if (g_LaunchOptions.benchmark)
+			{
+				if (BenchmarkFrame() >= g_LaunchOptions.benchmarkWarmupFrames + g_LaunchOptions.benchmarkFrames)
+					break;
+				UpdateBenchmarkCamera();
+			}
+			else
+			{
+				ProcessInput();
+			}
 			DrawFrame();
 		}
+
+		// Closed before the model arrived, its resources are cleaned up with the rest
+		if (m_ModelLoad.valid())
+		{
+			m_ModelLoad.wait();
+			PollModelLoad();
+		}
+		std::lock_guard<std::mutex> lock(m_QueueMutex);
 		vkDeviceWaitIdle(m_Device);
 	}
+
+	// Frames drawn since the model became resident. Benchmarks replay and measure only those, so how
+	// long the proxy was up does not change what they compare.
+	uint64_t BenchmarkFrame() const
+	{
+		return m_ModelResident ? m_FrameIndex - m_ResidentFrame : 0;
+	}
+
+	// Benchmark replay: orbit the origin at a fixed step per frame so every run renders the same frames
+	void UpdateBenchmarkCamera()
+	{
+		float angle = static_cast<float>(BenchmarkFrame()) * glm::radians(0.5f);
+		m_Camera.position	= glm::vec3(3.0f * cos(angle), 1.5f, 3.0f * sin(angle));
+		m_Camera.front		= glm::normalize(-m_Camera.position);
+	}
+
+	bool FinishBenchmark()
+	{
+		m_Benchmark.peakHostMemoryBytes		= GetPeakHostMemoryBytes();
+		m_Benchmark.peakDeviceMemoryBytes	= m_PeakDeviceMemory;
+		m_Benchmark.stutterCount			= m_FrameMonitor.StutterCount();
+		if (m_GpuShadedPerTriangle > 0.0)
+			m_Benchmark.meshStatistics.emplace_back("gpu_vs_invocations_per_triangle", m_GpuShadedPerTriangle);
+		if (m_BenchmarkSceneFragments > 0)
+			m_Benchmark.meshTimings.emplace_back("gpu_scene_ns_per_fragment", m_BenchmarkSceneGpuMs * 1e6 / m_BenchmarkSceneFragments);
+		m_Benchmark.WriteJson(g_LaunchOptions.benchmarkOutput);
+
+		FrameStatistics frameStats	= ComputeFrameStatistics(m_Benchmark.frameIntervalsMs);
+		FrameStatistics cpuStats	= ComputeFrameStatistics(m_Benchmark.cpuFrameMs);
+		FrameStatistics gpuStats	= ComputeFrameStatistics(m_Benchmark.gpuFrameMs);
+
+		std::cout << std::fixed << std::setprecision(3);
+		std::cout << "Benchmark on " << m_Benchmark.deviceName << ", " << m_Benchmark.frameIntervalsMs.size() << " frames" << std::endl;
+		std::cout << "  time to first frame " << m_Benchmark.timeToFirstFrameMs << " ms, to model " << m_Benchmark.timeToModelMs << " ms" << std::endl;
+		std::cout << "  frame time  p50 " << frameStats.p50 << "  p95 " << frameStats.p95 << "  p99 " << frameStats.p99 << "  max " << frameStats.max << " ms" << std::endl;
+		std::cout << "  cpu time    p50 " << cpuStats.p50 << "  p95 " << cpuStats.p95 << "  p99 " << cpuStats.p99 << "  max " << cpuStats.max << " ms" << std::endl;
+		std::cout << "  gpu time    p50 " << gpuStats.p50 << "  p95 " << gpuStats.p95 << "  p99 " << gpuStats.p99 << "  max " << gpuStats.max << " ms" << std::endl;
+		std::cout << "  peak memory host " << m_Benchmark.peakHostMemoryBytes / (1024 * 1024) << " MiB, device " << m_Benchmark.peakDeviceMemoryBytes / (1024 * 1024) << " MiB" << std::endl;
+		std::cout << "Results written to " << g_LaunchOptions.benchmarkOutput << std::endl;
+
+		if (g_LaunchOptions.benchmarkBaseline.empty()) return true;
+		return m_Benchmark.CompareWithBaseline(g_LaunchOptions.benchmarkBaseline, g_LaunchOptions.regressionThreshold);
+	}
 	
 	void ProcessInput()
 	{
@@ -1873,6 +6663,11 @@ private:
 			m_Camera.position += m_DeltaTime * m_Camera.speed * glm::normalize(glm::cross(m_Camera.front, m_Camera.up));
 		if (glfwGetKey(m_Window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 			m_Paused = !m_Paused;
+
+		bool hudKeyDown = glfwGetKey(m_Window, GLFW_KEY_F1) == GLFW_PRESS;
+		if (hudKeyDown && !m_HudKeyWasDown)
+			m_OverlayVisible = !m_OverlayVisible;
+		m_HudKeyWasDown = hudKeyDown;
 	}
 
 	void ProcessMouseMovement(double xpos, double ypos)
@@ -1915,10 +6710,25 @@ private:
 
 	void DrawFrame()
 	{
+		HostAllocationTracker::Tag frameTag(g_HostAllocations, "DrawFrame");
+		FramePhaseTimings phases{};
+		auto frameStart = Clock::now(), phaseStart = frameStart;
+		auto endPhase = [&](double& phaseMs) {
+			auto now = Clock::now();
+			phaseMs = ElapsedMs(phaseStart, now);
+			phaseStart = now;
+		};
+
 		vkWaitForFences(m_Device, 1, &m_InFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+		endPhase(phases.fenceWaitMs);
 		uint32_t imageIndex;
 
-		VkResult result = vkAcquireNextImageKHR(m_Device, m_Swapchain, UINT64_MAX, m_ImageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+		VkResult result;
+		{
+			HostAllocationTracker::Tag tag(g_HostAllocations, "vkAcquireNextImageKHR");
+			result = vkAcquireNextImageKHR(m_Device, m_Swapchain, UINT64_MAX, m_ImageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+		}
+		endPhase(phases.acquireMs);
 		if (result == VK_ERROR_OUT_OF_DATE_KHR)
 		{
 			RecreateSwapchain();
@@ -1935,13 +6745,21 @@ private:
 		// Mark the image as now being in use by this frame
 		m_ImagesInFlight[imageIndex] = m_InFlightFences[currentFrame];
 
+		phases.gpuMs = ReadGpuFrameTime(imageIndex);
+		ReadPipelineStatistics(imageIndex);
+		endPhase(phases.imageWaitMs);
+
+		if (m_ModelResident)
+			UpdateTextureStreaming();
 		UpdateUniformBuffers(imageIndex);
+		endPhase(phases.updateMs);
 		VkSubmitInfo submitInfo{};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
 		VkSemaphore waitSemaphores[]	= { m_ImageAvailableSemaphores[currentFrame] };
 		VkSemaphore signalSemaphores[]	= { m_RenderFinishedSemaphores[currentFrame] };
 		RecordCommandBuffers(imageIndex);
+		endPhase(phases.recordMs);
 		VkPipelineStageFlags waitStages[]	= { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 		submitInfo.waitSemaphoreCount		= 1;
 		submitInfo.pWaitSemaphores			= waitSemaphores;
@@ -1952,9 +6770,14 @@ private:
 		submitInfo.pSignalSemaphores		= signalSemaphores;
 
 		vkResetFences(m_Device, 1, &m_InFlightFences[currentFrame]);
-		if (vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, m_InFlightFences[currentFrame]) != VK_SUCCESS) {
-			throw std::runtime_error("failed to submit draw command buffer!");
+		{
+			HostAllocationTracker::Tag tag(g_HostAllocations, "vkQueueSubmit");
+			std::lock_guard<std::mutex> lock(m_QueueMutex);
+			if (vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, m_InFlightFences[currentFrame]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to submit draw command buffer!");
+			}
 		}
+		endPhase(phases.submitMs);
 
 		VkSwapchainKHR swapChains[] = { m_Swapchain };
 		VkPresentInfoKHR presentInfo{};
@@ -1967,7 +6790,12 @@ private:
 		presentInfo.pImageIndices		= &imageIndex;
 		presentInfo.pResults			= nullptr; 
 
-		result = vkQueuePresentKHR(m_PresentQueue, &presentInfo);
+		{
+			HostAllocationTracker::Tag tag(g_HostAllocations, "vkQueuePresentKHR");
+			std::lock_guard<std::mutex> lock(m_QueueMutex);
+			result = vkQueuePresentKHR(m_PresentQueue, &presentInfo);
+		}
+		endPhase(phases.presentMs);
 
 		if (result == VK_ERROR_OUT_OF_DATE_KHR ||
 			result == VK_SUBOPTIMAL_KHR ||
@@ -1981,20 +6809,54 @@ private:
 			throw std::runtime_error("failed to present swap chain image!");
 		}
 		currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+
+		RecordFrameTimings(frameStart, phases);
+		g_HostAllocations.EndFrame();
+	}
+
+	void RecordFrameTimings(Clock::time_point frameStart, FramePhaseTimings& phases)
+	{
+		auto frameEnd = Clock::now();
+		if (m_FrameIndex == 0)
+			m_Benchmark.timeToFirstFrameMs = ElapsedMs(m_StartTime, frameEnd);
+
+		phases.frame		= m_FrameIndex;
+		phases.totalMs		= ElapsedMs(frameStart, frameEnd);
+		phases.intervalMs	= m_FrameIndex > 0 ? ElapsedMs(m_LastFrameStart, frameStart) : 0.0;
+		m_FrameMonitor.Record(phases);
+
+		bool measuring = g_LaunchOptions.benchmark && m_ModelResident && BenchmarkFrame() >= g_LaunchOptions.benchmarkWarmupFrames;
+		if (measuring && m_FrameIndex > 0)
+		{
+			m_Benchmark.frameIntervalsMs.push_back(phases.intervalMs);
+			m_Benchmark.cpuFrameMs.push_back(phases.CpuMs());
+			if (phases.gpuMs >= 0.0) m_Benchmark.gpuFrameMs.push_back(phases.gpuMs);
+			if (phases.gpuMs >= 0.0 && m_GpuSceneFragments > 0)
+			{
+				m_BenchmarkSceneGpuMs		+= m_GpuSceneMs;
+				m_BenchmarkSceneFragments	+= m_GpuSceneFragments;
+			}
+		}
+
+		m_LastFrameStart = frameStart;
+		m_FrameIndex++;
 	}
 	
 	void UpdateUniformBuffers(uint32_t currentImage)
 	{
+		HostAllocationTracker::Tag tag(g_HostAllocations, "UpdateUniformBuffers");
 		static auto startTime = std::chrono::high_resolution_clock::now();
 
 		auto currentTime = std::chrono::high_resolution_clock::now();
 		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+		if (g_LaunchOptions.benchmark)
+			time = static_cast<float>(BenchmarkFrame()) / 60.0f;
 
 		UniformBufferObject ubo{};
 		ubo.model = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f));
 		glm::vec3 lookAt = m_Camera.front + m_Camera.position;
 		ubo.view = glm::lookAt(m_Camera.position,  lookAt, m_Camera.up);
-		ubo.projection = glm::perspective(glm::radians(45.0f), m_Extent.width / (float) m_Extent.height, 0.1f, 100.0f);
+		ubo.projection = glm::perspective(glm::radians(CAMERA_FOV_DEGREES), m_Extent.width / (float) m_Extent.height, CAMERA_NEAR, CAMERA_FAR);
 		ubo.projection[1][1] *= -1;
 
 		void* data;
@@ -2002,6 +6864,22 @@ private:
 		memcpy(data, &ubo, sizeof(ubo));
 		vkUnmapMemory(m_Device, m_MVPUniformBufferMemories[currentImage]);
 
+		if (m_ModelResident)
+		{
+			// Pixels one object space unit covers at the nearest point of the bounding sphere
+			glm::vec3 centre = (m_BoundsMin + m_BoundsMax) * 0.5f;
+			float radius = glm::length(m_BoundsMax - m_BoundsMin) * 0.5f;
+			float distance = std::max(glm::length(centre - m_Camera.position) - radius, CAMERA_NEAR);
+			float pixelsPerUnit = m_Extent.height / (2.0f * std::tan(glm::radians(CAMERA_FOV_DEGREES) * 0.5f) * distance);
+			m_CurrentLod = SelectLod(m_Mesh.lods, m_CurrentLod, pixelsPerUnit, g_LaunchOptions.lodThresholdPixels);
+
+			// The meshlets of a LOD's batches follow one another
+			const MeshLod& lod = m_Mesh.lods[m_CurrentLod];
+			const BatchDraws& firstDraws = m_BatchDraws[lod.firstBatch];
+			const BatchDraws& lastDraws = m_BatchDraws[lod.firstBatch + lod.batchCount - 1];
+			m_MeshletCulling = MakeMeshletCulling(ubo, m_Camera.position, firstDraws.firstMeshlet, lastDraws.firstMeshlet + lastDraws.meshletCount - firstDraws.firstMeshlet);
+		}
+
 		m_Light.position = { sin(time), cos(time), sin(time) };
 		vkMapMemory(m_Device, m_LightUniformBufferMemories[currentImage], 0, sizeof(Light), 0, &data);
 		memcpy(data, &m_Light, sizeof(Light));
@@ -2015,83 +6893,130 @@ private:
 	void CleanupSwapchain()
 	{
 
-		vkDestroyImageView(m_Device, m_ColorImageView, nullptr);
-		vkDestroyImage(m_Device, m_ColorImage, nullptr);
-		vkFreeMemory(m_Device, m_ColorImageMemory, nullptr);
+		CleanupOverlay();
 
-		vkDestroyImageView(m_Device, m_DepthImageView, nullptr);
-		vkDestroyImage(m_Device, m_DepthImage, nullptr);
-		vkFreeMemory(m_Device, m_DepthImageMemory, nullptr);
+		vkDestroyImageView(m_Device, m_ColorImageView, m_Allocator);
+		vkDestroyImage(m_Device, m_ColorImage, m_Allocator);
+		FreeDeviceMemory(m_ColorImageMemory);
+
+		vkDestroyImageView(m_Device, m_DepthImageView, m_Allocator);
+		vkDestroyImage(m_Device, m_DepthImage, m_Allocator);
+		FreeDeviceMemory(m_DepthImageMemory);
 
 		for (auto framebuffer : m_SwapchainFramebuffers) 
 		{
-			vkDestroyFramebuffer(m_Device, framebuffer, nullptr);
+			vkDestroyFramebuffer(m_Device, framebuffer, m_Allocator);
 		}
 
 		vkFreeCommandBuffers(m_Device, m_CommandPool, static_cast<uint32_t>(m_CommandBuffers.size()), m_CommandBuffers.data());
 
-		vkDestroyPipeline(m_Device, m_Pipeline, nullptr);
-		vkDestroyPipelineLayout(m_Device, m_PipelineLayout, nullptr);
-		vkDestroyRenderPass(m_Device, m_RenderPass, nullptr);
+		vkDestroyPipeline(m_Device, m_Pipeline, m_Allocator);
+		vkDestroyPipelineLayout(m_Device, m_PipelineLayout, m_Allocator);
+		vkDestroyRenderPass(m_Device, m_RenderPass, m_Allocator);
 
 		for (auto imageView : m_SwapchainImageViews) {
-			vkDestroyImageView(m_Device, imageView, nullptr);
+			vkDestroyImageView(m_Device, imageView, m_Allocator);
 		}
 
-		vkDestroySwapchainKHR(m_Device, m_Swapchain, nullptr);
+		vkDestroySwapchainKHR(m_Device, m_Swapchain, m_Allocator);
 
 		for (size_t i = 0; i < m_SwapchainImages.size(); i++) {
-			vkDestroyBuffer(m_Device, m_LightUniformBuffers[i], nullptr);
-			vkFreeMemory(m_Device, m_LightUniformBufferMemories[i], nullptr);
-			vkDestroyBuffer(m_Device, m_MVPUniformBuffers[i], nullptr);
-			vkFreeMemory(m_Device, m_MVPUniformBufferMemories[i], nullptr);
+			vkDestroyBuffer(m_Device, m_LightUniformBuffers[i], m_Allocator);
+			FreeDeviceMemory(m_LightUniformBufferMemories[i]);
+			vkDestroyBuffer(m_Device, m_MVPUniformBuffers[i], m_Allocator);
+			FreeDeviceMemory(m_MVPUniformBufferMemories[i]);
 		}
 		
-		vkDestroyDescriptorPool(m_Device, m_DescriptorPool, nullptr);
+		vkDestroyDescriptorPool(m_Device, m_DescriptorPool, m_Allocator);
+
+		if (m_TimestampQueryPool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(m_Device, m_TimestampQueryPool, m_Allocator);
+			m_TimestampQueryPool = VK_NULL_HANDLE;
+		}
+		if (m_PipelineStatisticsQueryPool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(m_Device, m_PipelineStatisticsQueryPool, m_Allocator);
+			m_PipelineStatisticsQueryPool = VK_NULL_HANDLE;
+		}
 	}
 
 
 	void Cleanup()
 	{
+		ReleaseTextureDecodes();
 		CleanupSwapchain();
 
-		vkDestroySampler(m_Device, m_TextureSampler, nullptr);
-		vkDestroySampler(m_Device, m_SpecularSampler, nullptr);
-
-		vkDestroyImageView(m_Device, m_TextureImageView, nullptr);
-		vkDestroyImageView(m_Device, m_SpecularImageView, nullptr);
-
-		vkDestroyImage(m_Device, m_TextureImage, nullptr);
-		vkDestroyImage(m_Device, m_SpecularImage, nullptr);
+		for (const auto& sampler : m_TextureSamplers)
+			vkDestroySampler(m_Device, sampler.second, m_Allocator);
 
-		vkFreeMemory(m_Device, m_TextureImageMemory, nullptr);
-		vkFreeMemory(m_Device, m_SpecularImageMemory, nullptr);
+		ReleaseRetiredTextures(true);
+		m_TextureStreams.clear();
+		for (const Texture& texture : m_Textures)
+		{
+			vkDestroyImageView(m_Device, texture.view, m_Allocator);
+			vkDestroyImage(m_Device, texture.image, m_Allocator);
+			FreeDeviceMemory(texture.memory);
+		}
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			vkDestroyBuffer(m_Device, m_FeedbackBuffers[i], m_Allocator);
+			FreeDeviceMemory(m_FeedbackMemories[i]);
+		}
 
-		vkDestroyDescriptorSetLayout(m_Device, m_DescriptorSetLayout, nullptr);
-		vkDestroyBuffer(m_Device, m_VertexBuffer, nullptr);
-		vkFreeMemory(m_Device, m_VertexBufferMemory, nullptr);
-		vkDestroyBuffer(m_Device, m_IndexBuffer, nullptr);
-		vkFreeMemory(m_Device, m_IndexBufferMemory, nullptr);
+		vkDestroyDescriptorPool(m_Device, m_MaterialDescriptorPool, m_Allocator);
+		vkDestroyDescriptorPool(m_Device, m_ProxyDescriptorPool, m_Allocator);
+		vkDestroyDescriptorPool(m_Device, m_BindlessDescriptorPool, m_Allocator);
+		vkDestroyBuffer(m_Device, m_BindlessMaterialBuffer, m_Allocator);
+		FreeDeviceMemory(m_BindlessMaterialMemory);
+		vkDestroyImageView(m_Device, m_ProxyTexture.view, m_Allocator);
+		vkDestroyImage(m_Device, m_ProxyTexture.image, m_Allocator);
+		FreeDeviceMemory(m_ProxyTexture.memory);
+		vkDestroyBuffer(m_Device, m_ProxyVertexBuffer, m_Allocator);
+		FreeDeviceMemory(m_ProxyVertexBufferMemory);
+		vkDestroyBuffer(m_Device, m_ProxyIndexBuffer, m_Allocator);
+		FreeDeviceMemory(m_ProxyIndexBufferMemory);
+		vkDestroyDescriptorSetLayout(m_Device, m_MaterialSetLayout, m_Allocator);
+		vkDestroyDescriptorSetLayout(m_Device, m_DescriptorSetLayout, m_Allocator);
+		vkDestroyBuffer(m_Device, m_VertexBuffer, m_Allocator);
+		FreeDeviceMemory(m_VertexBufferMemory);
+		vkDestroyBuffer(m_Device, m_IndexBuffer, m_Allocator);
+		FreeDeviceMemory(m_IndexBufferMemory);
+		if (m_MeshletCullingAvailable)
+		{
+			vkDestroyPipeline(m_Device, m_CullingPipeline, m_Allocator);
+			vkDestroyPipelineLayout(m_Device, m_CullingPipelineLayout, m_Allocator);
+			vkDestroyDescriptorPool(m_Device, m_CullingDescriptorPool, m_Allocator);
+			vkDestroyDescriptorSetLayout(m_Device, m_CullingSetLayout, m_Allocator);
+			vkDestroyBuffer(m_Device, m_MeshletBuffer, m_Allocator);
+			FreeDeviceMemory(m_MeshletBufferMemory);
+			vkDestroyBuffer(m_Device, m_MeshletDrawBuffer, m_Allocator);
+			FreeDeviceMemory(m_MeshletDrawBufferMemory);
+		}
+		vkDestroyPipeline(m_Device, m_MipGenerationPipeline, m_Allocator);
+		vkDestroyPipelineLayout(m_Device, m_MipGenerationPipelineLayout, m_Allocator);
+		vkDestroyDescriptorSetLayout(m_Device, m_MipGenerationSetLayout, m_Allocator);
 
 
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) 
 		{
-			vkDestroySemaphore(m_Device, m_RenderFinishedSemaphores[i], nullptr);
-			vkDestroySemaphore(m_Device, m_ImageAvailableSemaphores[i], nullptr);
-			vkDestroyFence(m_Device, m_InFlightFences[i], nullptr);
+			vkDestroySemaphore(m_Device, m_RenderFinishedSemaphores[i], m_Allocator);
+			vkDestroySemaphore(m_Device, m_ImageAvailableSemaphores[i], m_Allocator);
+			vkDestroyFence(m_Device, m_InFlightFences[i], m_Allocator);
 		}
 
-		vkDestroyCommandPool(m_Device, m_CommandPool, nullptr);
+		vkDestroyCommandPool(m_Device, m_CommandPool, m_Allocator);
+		vkDestroyCommandPool(m_Device, m_LoaderCommandPool, m_Allocator);
 
-		vkDestroyDevice(m_Device, NULL);
+		vkDestroyDevice(m_Device, m_Allocator);
 
 		if (g_EnableValidationLayers)
 		{
-			DestroyDebugUtilsMessengerEXT(m_Instance, m_DebugMessenger, nullptr);
+			DestroyDebugUtilsMessengerEXT(m_Instance, m_DebugMessenger, m_Allocator);
 		}
 
-		vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
-		vkDestroyInstance(m_Instance, NULL);
+		vkDestroySurfaceKHR(m_Instance, m_Surface, m_Allocator);
+		vkDestroyInstance(m_Instance, m_Allocator);
 
 		glfwDestroyWindow(m_Window);
 		glfwTerminate();
@@ -2127,6 +7052,7 @@ private:
 
 private:
 	GLFWwindow*						m_Window;
+	const VkAllocationCallbacks*	m_Allocator = nullptr;
 	
 	VkInstance						m_Instance;
 	
@@ -2147,11 +7073,11 @@ private:
 	VkFormat						m_SwapchainFormat;
 
 	VkRenderPass					m_RenderPass;
-	VkDescriptorSetLayout			m_DescriptorSetLayout;
+	VkDescriptorSetLayout			m_DescriptorSetLayout, m_MaterialSetLayout;
 	VkPipelineLayout				m_PipelineLayout;
 	VkPipeline						m_Pipeline;
 
-	VkCommandPool					m_CommandPool;
+	VkCommandPool					m_CommandPool, m_LoaderCommandPool = VK_NULL_HANDLE;
 	std::vector<VkCommandBuffer>	m_CommandBuffers;
 	VkDescriptorPool				m_DescriptorPool;
 	std::vector<VkDescriptorSet>	m_DescriptorSets;
@@ -2161,17 +7087,191 @@ private:
 
 	VkDebugUtilsMessengerEXT		m_DebugMessenger;
 
-	VkBuffer						m_VertexBuffer, m_IndexBuffer;
-	uint32_t						m_MipLevels;
-	VkImage							m_TextureImage, m_DepthImage, m_ColorImage, m_SpecularImage;
-	VkImageView						m_TextureImageView, m_DepthImageView, m_ColorImageView, m_SpecularImageView;
-	VkSampler						m_TextureSampler, m_SpecularSampler;
-	VkDeviceMemory					m_VertexBufferMemory, m_IndexBufferMemory, m_TextureImageMemory, m_DepthImageMemory, m_ColorImageMemory, m_SpecularImageMemory;
+	VkBuffer						m_VertexBuffer = VK_NULL_HANDLE, m_IndexBuffer = VK_NULL_HANDLE;
+	VkImage							m_DepthImage, m_ColorImage;
+	VkImageView						m_DepthImageView, m_ColorImageView;
+	std::map<uint32_t, VkSampler>	m_TextureSamplers;	// by mip level count, see GetTextureSampler
+	std::mutex						m_SamplerMutex;
+	VkDeviceMemory					m_VertexBufferMemory = VK_NULL_HANDLE, m_IndexBufferMemory = VK_NULL_HANDLE, m_DepthImageMemory, m_ColorImageMemory;
 	std::vector<VkBuffer>			m_MVPUniformBuffers, m_LightUniformBuffers, m_CameraBuffers;
 	std::vector<VkDeviceMemory>		m_MVPUniformBufferMemories, m_LightUniformBufferMemories, m_CameraBufferMemories;
 
+	struct MaterialTextures
+	{
+		uint32_t	diffuse		= 0;	// into m_Textures
+		uint32_t	specular	= 0;
+	};
+
+	std::vector<Texture>			m_Textures;
+	std::map<std::pair<std::string, bool>, uint32_t>	m_TextureIndices;	// by path and whether it has mips
+	std::map<std::pair<uint64_t, bool>, uint32_t>		m_TextureContents;	// by HashBytes of the file and whether it has mips
+
+	// Texture streaming, see UpdateTextureStreaming. The fragment shader reports the finest level it
+	// sampled of every streamed texture into the feedback buffer of its frame slot.
+	struct TextureStream
+	{
+		std::string					path;
+		std::unique_ptr<MappedFile>	file;
+		ktx2::Image					image;
+		uint32_t					tailLevel		= 0;	// first level that is always resident
+		uint32_t					requestedLevel	= 0;	// finest level sampled in requestedRound
+		uint64_t					requestedRound	= 0;
+		uint64_t					usedRound		= 0;	// last feedback round it was sampled in
+	};
+
+	// Image a rebuild replaced, with the staging buffer of the new levels, destroyed once frame has completed
+	struct RetiredTexture
+	{
+		VkImage			image	= VK_NULL_HANDLE;
+		VkImageView		view	= VK_NULL_HANDLE;
+		VkDeviceMemory	memory	= VK_NULL_HANDLE;
+		StagingBuffer	staging;
+		uint64_t		frame	= 0;	// m_FrameIndex of the frame that replaced it
+	};
+
+	bool												m_TextureStreamingEnabled = false;
+	std::map<uint32_t, TextureStream>					m_TextureStreams;		// by texture index
+	std::map<uint32_t, uint32_t>						m_StreamingRebuilds;	// new first level by texture index
+	std::vector<RetiredTexture>							m_RetiredTextures;
+	std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT>			m_FeedbackBuffers{};
+	std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT>	m_FeedbackMemories{};
+	std::array<const uint32_t*, MAX_FRAMES_IN_FLIGHT>	m_FeedbackData{};
+	std::array<bool, MAX_FRAMES_IN_FLIGHT>				m_FeedbackWritten{};	// a frame has reported into the slot's buffer
+	uint64_t											m_FeedbackRound = 0;
+	uint64_t											m_StreamingGeneration = 0;	// bumped whenever a streamed texture is rebuilt
+	uint64_t											m_StreamedBytes = 0;
+
+	// Texture decodes run here, one per core. m_TextureDecodes is filled by the render thread before the
+	// loader thread starts and by the loader thread after, never by both at once.
+	WorkerPool											m_DecodePool{ std::thread::hardware_concurrency() };
+	std::map<std::string, std::shared_future<DecodedImage>>	m_TextureDecodes;
+
+	// Texture uploads recorded by LoadTexture and submitted at once by CreateTextureImage, with what has
+	// to live until that submit has completed
+	struct TextureUploadBatch
+	{
+		VkCommandBuffer					commands			= VK_NULL_HANDLE;
+		std::vector<StagingBuffer>		stagingBuffers;
+		std::vector<VkImageView>		views;
+		std::vector<VkDescriptorPool>	descriptorPools;
+		VkQueryPool						timestamps			= VK_NULL_HANDLE;	// around each GenerateMipmaps
+		uint32_t						timestampCount		= 0;
+		uint32_t						timestampCapacity	= 0;
+	};
+	TextureUploadBatch					m_TextureUpload;
+
+	VkDescriptorSetLayout				m_MipGenerationSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout					m_MipGenerationPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline							m_MipGenerationPipeline = VK_NULL_HANDLE;
+	bool								m_MipGenerationAvailable = false;
+	bool								m_Maintenance2Enabled = false;	// VK_KHR_maintenance2 on the device
+	double								m_MipGenerationGpuMs = 0.0;
+	std::vector<MaterialTextures>	m_MaterialTextures;
+	VkDescriptorPool				m_MaterialDescriptorPool = VK_NULL_HANDLE;
+	std::array<std::vector<VkDescriptorSet>, MAX_FRAMES_IN_FLIGHT>	m_MaterialSets;	// by frame in flight, then material
+	std::array<uint64_t, MAX_FRAMES_IN_FLIGHT>						m_MaterialSetGenerations{};	// m_StreamingGeneration when written
+
 	bool							m_FramebufferResized = false;
 
+	VkQueryPool						m_TimestampQueryPool = VK_NULL_HANDLE;
+	VkQueryPool						m_PipelineStatisticsQueryPool = VK_NULL_HANDLE;
+	std::vector<bool>				m_PipelineStatisticsWritten;
+	bool							m_PipelineStatisticsSupported = false;
+	double							m_GpuShadedPerTriangle = 0.0;
+	uint64_t						m_GpuSceneFragments = 0;	// of the last frame read, 0 if unknown
+	double							m_BenchmarkSceneGpuMs = 0.0;
+	uint64_t						m_BenchmarkSceneFragments = 0;
+	float							m_TimestampPeriod = 1.0f;
+	bool							m_LoaderTimestamps = false;	// written before the loader thread starts
+	std::vector<bool>				m_TimestampsWritten;
+
+	struct DeviceAllocation
+	{
+		VkDeviceSize	size;
+		uint32_t		heap;
+	};
+
+	VkPhysicalDeviceMemoryProperties					m_MemoryProperties{};
+	std::unordered_map<VkDeviceMemory, DeviceAllocation>	m_DeviceMemoryAllocations;
+	std::vector<VkDeviceSize>		m_HeapUsage;
+	VkDeviceSize					m_DeviceMemoryInUse = 0, m_PeakDeviceMemory = 0;
+
+	struct DrawStatistics
+	{
+		uint32_t	draws			= 0;
+		uint32_t	materialBinds	= 0;
+		uint64_t	triangles		= 0;
+	};
+
+	VkRenderPass					m_OverlayRenderPass = VK_NULL_HANDLE;
+	VkPipelineLayout				m_OverlayPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline						m_OverlayPipeline = VK_NULL_HANDLE;
+	std::vector<VkFramebuffer>		m_OverlayFramebuffers;
+	std::vector<VkBuffer>			m_OverlayVertexBuffers;
+	std::vector<VkDeviceMemory>		m_OverlayVertexBufferMemories;
+	std::vector<HudVertex*>			m_OverlayVertices;
+	bool							m_OverlayAvailable = false, m_OverlayVisible = false, m_HudKeyWasDown = false;
+	double							m_OverlayBuildMs = 0.0, m_GpuSceneMs = 0.0, m_GpuOverlayMs = 0.0;
+	DrawStatistics					m_DrawStats;
+	meshopt::CacheStatistics		m_MeshStatistics;
+
+	MeshView						m_Mesh;
+	MappedFile						m_MeshCacheFile;
+	glm::vec3						m_BoundsMin{}, m_BoundsMax{};
+	VertexLayout					m_VertexLayout = VertexLayout::Full;
+	MeshPushConstants				m_MeshDecode{};
+	PackedIndices					m_PackedIndices;
+	VkIndexType						m_IndexType = VK_INDEX_TYPE_UINT32;
+	std::vector<IndexRange>			m_IndexRanges;
+	std::vector<BatchDraws>			m_BatchDraws;
+	size_t							m_CurrentLod = 0;
+
+	std::vector<meshopt::Meshlet>	m_Meshlets;
+	MeshletCullingConstants			m_MeshletCulling{};
+	bool							m_MultiDrawIndirectSupported = false, m_MeshletCullingAvailable = false;
+	uint32_t						m_MaxDrawIndirectCount = 1;
+	VkBuffer						m_MeshletBuffer = VK_NULL_HANDLE, m_MeshletDrawBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory					m_MeshletBufferMemory = VK_NULL_HANDLE, m_MeshletDrawBufferMemory = VK_NULL_HANDLE;
+	VkDescriptorSetLayout			m_CullingSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool				m_CullingDescriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet					m_CullingDescriptorSet = VK_NULL_HANDLE;
+	VkPipelineLayout				m_CullingPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline						m_CullingPipeline = VK_NULL_HANDLE;
+	std::atomic<uint32_t>			m_PendingUploads{ 0 };	// model stages the loader thread has left
+
+	// The loader thread owns the model members above until PollModelLoad sets m_ModelResident
+	std::future<void>				m_ModelLoad;
+	std::vector<std::pair<std::string, double>>	m_ModelLoadStages;
+	bool							m_ModelResident = false;
+	uint64_t						m_ResidentFrame = 0;
+	std::mutex						m_QueueMutex;	// graphics and present queue, shared with the loader thread
+	std::mutex						m_DeviceMemoryMutex;
+	inline static thread_local bool	t_LoaderThread = false;
+
+	VkBuffer						m_ProxyVertexBuffer = VK_NULL_HANDLE, m_ProxyIndexBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory					m_ProxyVertexBufferMemory = VK_NULL_HANDLE, m_ProxyIndexBufferMemory = VK_NULL_HANDLE;
+	uint32_t						m_ProxyIndexCount = 0;
+	MeshPushConstants				m_ProxyDecode{};
+	Texture							m_ProxyTexture;
+	VkDescriptorPool				m_ProxyDescriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet					m_ProxyMaterialSet = VK_NULL_HANDLE;
+
+	// Bindless textures, see CreateBindlessTextures
+	bool												m_Properties2Supported = false;	// VK_KHR_get_physical_device_properties2 on the instance
+	bool												m_BindlessEnabled = false;
+	uint32_t											m_BindlessTextureCapacity = 0;
+	VkDescriptorPool									m_BindlessDescriptorPool = VK_NULL_HANDLE;
+	std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT>	m_BindlessSets{};
+	VkBuffer											m_BindlessMaterialBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory										m_BindlessMaterialMemory = VK_NULL_HANDLE;
+	BindlessMaterial*									m_BindlessMaterials = nullptr;	// mapped, by material
+	std::string											m_FragmentShaderPath;	// see SelectFragmentShader
+
+	BenchmarkReport					m_Benchmark;
+	FrameTimingMonitor				m_FrameMonitor;
+	Clock::time_point				m_StartTime, m_LastFrameStart;
+	uint64_t						m_FrameIndex = 0;
+
 	VkSampleCountFlagBits			m_MsaaSamples;
 
 	glm::vec4						m_TintColor = glm::vec4(1.0, 1.0, 1.0, 1.0);
@@ -2183,18 +7283,17 @@ private:
 	float							m_LastX, m_LastY;
 
 };
-int main() {
+int main(int argc, char** argv) {
 
 	Application app;
 	try
 	{
-		app.Run();
+		ParseLaunchOptions(argc, argv);
+		return app.Run();
 	}
 	catch (std::exception& e)
 	{
 		std::cerr << e.what() << std::endl;
 		return EXIT_FAILURE;
 	}
-
-	return EXIT_SUCCESS;
 }
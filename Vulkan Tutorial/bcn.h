@@ -0,0 +1,351 @@
+// CPU decoders for the BCn block formats, for KTX2 files whose format the device cannot sample
+#pragma once
+
+#include "ktx2.h"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+/*
+CPU decoders for the BCn block formats, used when a KTX2 file holds a format the device cannot sample
+so it can still be uploaded as RGBA8. They follow the decoding rules of the D3D11 functional spec: BC1
+switches to three colours and transparent black when its first endpoint is not the larger, BC3 always
+decodes its colour block with four colours, BC5 decodes to red and green with blue 0, and BC7
+implements all eight modes, with reserved mode bytes decoding to transparent black.
+*/
+namespace bcn {
+	// Decodes a 565 colour with the bits replicated into the low bits
+	inline void Unpack565(uint16_t color, uint8_t rgb[3])
+	{
+		uint32_t r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+		rgb[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+		rgb[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+		rgb[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+	}
+
+	// Colours a BC1 or BC3 colour block picks from, the three colour mode only exists in BC1
+	inline void ColorPalette(uint16_t endpoint0, uint16_t endpoint1, bool allowTransparent, uint8_t palette[4][4])
+	{
+		Unpack565(endpoint0, palette[0]);
+		Unpack565(endpoint1, palette[1]);
+		palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+
+		bool threeColors = allowTransparent && endpoint0 <= endpoint1;
+		for (int c = 0; c < 3; c++)
+		{
+			if (threeColors)
+			{
+				palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c]) / 2);
+				palette[3][c] = 0;
+			}
+			else
+			{
+				palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+				palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+			}
+		}
+		if (threeColors) palette[3][3] = 0;
+	}
+
+	// Colour block of BC1 and BC3, writes rgba for 16 texels in row order
+	inline void DecodeColorBlock(const uint8_t* block, uint8_t rgba[64], bool allowTransparent)
+	{
+		uint8_t palette[4][4];
+		ColorPalette(static_cast<uint16_t>(block[0] | (block[1] << 8)), static_cast<uint16_t>(block[2] | (block[3] << 8)), allowTransparent, palette);
+
+		uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+		for (int texel = 0; texel < 16; texel++)
+			memcpy(rgba + texel * 4, palette[(indices >> (texel * 2)) & 3], 4);
+	}
+
+	// Values a BC4 style block picks from
+	inline void ChannelPalette(uint8_t endpoint0, uint8_t endpoint1, uint8_t palette[8])
+	{
+		palette[0] = endpoint0;
+		palette[1] = endpoint1;
+		if (endpoint0 > endpoint1)
+		{
+			for (uint32_t i = 1; i < 7; i++)
+				palette[i + 1] = static_cast<uint8_t>(((7 - i) * endpoint0 + i * endpoint1) / 7);
+		}
+		else
+		{
+			for (uint32_t i = 1; i < 5; i++)
+				palette[i + 1] = static_cast<uint8_t>(((5 - i) * endpoint0 + i * endpoint1) / 5);
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	// Single channel block of BC3 alpha and BC4/BC5, writes every stride bytes from out
+	inline void DecodeChannelBlock(const uint8_t* block, uint8_t* out, size_t stride)
+	{
+		uint8_t palette[8];
+		ChannelPalette(block[0], block[1], palette);
+
+		uint64_t indices = 0;
+		for (int i = 0; i < 6; i++) indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+		for (int texel = 0; texel < 16; texel++)
+			out[texel * stride] = palette[(indices >> (texel * 3)) & 7];
+	}
+
+	// Subset of each texel in the BC7 two subset partitions, one bit per texel
+	constexpr uint16_t PARTITIONS_2[64] = {
+		0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80, 0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+		0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce, 0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+		0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a, 0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+		0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c, 0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22,
+	};
+
+	// Subset of each texel in the BC7 three subset partitions, in row order
+	constexpr uint8_t PARTITIONS_3[64][16] = {
+		{ 0,0,1,1,0,0,1,1,0,2,2,1,2,2,2,2 }, { 0,0,0,1,0,0,1,1,2,2,1,1,2,2,2,1 }, { 0,0,0,0,2,0,0,1,2,2,1,1,2,2,1,1 }, { 0,2,2,2,0,0,2,2,0,0,1,1,0,1,1,1 },
+		{ 0,0,0,0,0,0,0,0,1,1,2,2,1,1,2,2 }, { 0,0,1,1,0,0,1,1,0,0,2,2,0,0,2,2 }, { 0,0,2,2,0,0,2,2,1,1,1,1,1,1,1,1 }, { 0,0,1,1,0,0,1,1,2,2,1,1,2,2,1,1 },
+		{ 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2 }, { 0,0,0,0,1,1,1,1,1,1,1,1,2,2,2,2 }, { 0,0,0,0,1,1,1,1,2,2,2,2,2,2,2,2 }, { 0,0,1,2,0,0,1,2,0,0,1,2,0,0,1,2 },
+		{ 0,1,1,2,0,1,1,2,0,1,1,2,0,1,1,2 }, { 0,1,2,2,0,1,2,2,0,1,2,2,0,1,2,2 }, { 0,0,1,1,0,1,1,2,1,1,2,2,1,2,2,2 }, { 0,0,1,1,2,0,0,1,2,2,0,0,2,2,2,0 },
+		{ 0,0,0,1,0,0,1,1,0,1,1,2,1,1,2,2 }, { 0,1,1,1,0,0,1,1,2,0,0,1,2,2,0,0 }, { 0,0,0,0,1,1,2,2,1,1,2,2,1,1,2,2 }, { 0,0,2,2,0,0,2,2,0,0,2,2,1,1,1,1 },
+		{ 0,1,1,1,0,1,1,1,0,2,2,2,0,2,2,2 }, { 0,0,0,1,0,0,0,1,2,2,2,1,2,2,2,1 }, { 0,0,0,0,0,0,1,1,0,1,2,2,0,1,2,2 }, { 0,0,0,0,1,1,0,0,2,2,1,0,2,2,1,0 },
+		{ 0,1,2,2,0,1,2,2,0,0,1,1,0,0,0,0 }, { 0,0,1,2,0,0,1,2,1,1,2,2,2,2,2,2 }, { 0,1,1,0,1,2,2,1,1,2,2,1,0,1,1,0 }, { 0,0,0,0,0,1,1,0,1,2,2,1,1,2,2,1 },
+		{ 0,0,2,2,1,1,0,2,1,1,0,2,0,0,2,2 }, { 0,1,1,0,0,1,1,0,2,0,0,2,2,2,2,2 }, { 0,0,1,1,0,1,2,2,0,1,2,2,0,0,1,1 }, { 0,0,0,0,2,0,0,0,2,2,1,1,2,2,2,1 },
+		{ 0,0,0,0,0,0,0,2,1,1,2,2,1,2,2,2 }, { 0,2,2,2,0,0,2,2,0,0,1,2,0,0,1,1 }, { 0,0,1,1,0,0,1,2,0,0,2,2,0,2,2,2 }, { 0,1,2,0,0,1,2,0,0,1,2,0,0,1,2,0 },
+		{ 0,0,0,0,1,1,1,1,2,2,2,2,0,0,0,0 }, { 0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0 }, { 0,1,2,0,2,0,1,2,1,2,0,1,0,1,2,0 }, { 0,0,1,1,2,2,0,0,1,1,2,2,0,0,1,1 },
+		{ 0,0,1,1,1,1,2,2,2,2,0,0,0,0,1,1 }, { 0,1,0,1,0,1,0,1,2,2,2,2,2,2,2,2 }, { 0,0,0,0,0,0,0,0,2,1,2,1,2,1,2,1 }, { 0,0,2,2,1,1,2,2,0,0,2,2,1,1,2,2 },
+		{ 0,0,2,2,0,0,1,1,0,0,2,2,0,0,1,1 }, { 0,2,2,0,1,2,2,1,0,2,2,0,1,2,2,1 }, { 0,1,0,1,2,2,2,2,2,2,2,2,0,1,0,1 }, { 0,0,0,0,2,1,2,1,2,1,2,1,2,1,2,1 },
+		{ 0,1,0,1,0,1,0,1,0,1,0,1,2,2,2,2 }, { 0,2,2,2,0,1,1,1,0,2,2,2,0,1,1,1 }, { 0,0,0,2,1,1,1,2,0,0,0,2,1,1,1,2 }, { 0,0,0,0,2,1,1,2,2,1,1,2,2,1,1,2 },
+		{ 0,2,2,2,0,1,1,1,0,1,1,1,0,2,2,2 }, { 0,0,0,2,1,1,1,2,1,1,1,2,0,0,0,2 }, { 0,1,1,0,0,1,1,0,0,1,1,0,2,2,2,2 }, { 0,0,0,0,0,0,0,0,2,1,1,2,2,1,1,2 },
+		{ 0,1,1,0,0,1,1,0,2,2,2,2,2,2,2,2 }, { 0,0,2,2,0,0,1,1,0,0,1,1,0,0,2,2 }, { 0,0,2,2,1,1,2,2,1,1,2,2,0,0,2,2 }, { 0,0,0,0,0,0,0,0,0,0,0,0,2,1,1,2 },
+		{ 0,0,0,2,0,0,0,1,0,0,0,2,0,0,0,1 }, { 0,2,2,2,1,2,2,2,0,2,2,2,1,2,2,2 }, { 0,1,0,1,2,2,2,2,2,2,2,2,2,2,2,2 }, { 0,1,1,1,2,0,1,1,2,2,0,1,2,2,2,0 },
+	};
+
+	// Texel whose index drops its top bit for the second subset of two, and the second and third of three
+	constexpr uint8_t ANCHORS_2[64] = {
+		15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15, 15, 2, 8, 2, 2, 8, 8,15, 2, 8, 2, 2, 8, 8, 2, 2,
+		15,15, 6, 8, 2, 8,15,15, 2, 8, 2, 2, 2,15,15, 6,  6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15,
+	};
+	constexpr uint8_t ANCHORS_3_SECOND[64] = {
+		 3, 3,15,15, 8, 3,15,15,  8, 8, 6, 6, 6, 5, 3, 3,  3, 3, 8,15, 3, 3, 6,10,  5, 8, 8, 6, 8, 5,15,15,
+		 8,15, 3, 5, 6,10, 8,15, 15, 3,15, 5,15,15,15,15,  3,15, 5, 5, 5, 8, 5,10,  5,10, 8,13,15,12, 3, 3,
+	};
+	constexpr uint8_t ANCHORS_3_THIRD[64] = {
+		15, 8, 8, 3,15,15, 3, 8, 15,15,15,15,15,15,15, 8, 15, 8,15, 3,15, 8,15, 8,  3,15, 6,10,15,15,10, 8,
+		15, 3,15,10,10, 8, 9,10,  6,15, 8,15, 3, 6, 6, 8, 15, 3,15,15,15,15,15,15, 15,15,15,15, 3,15,15, 8,
+	};
+
+	constexpr uint8_t WEIGHTS_2[4] = { 0, 21, 43, 64 };
+	constexpr uint8_t WEIGHTS_3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	constexpr uint8_t WEIGHTS_4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct Bc7Mode
+	{
+		uint8_t	subsets;
+		uint8_t	partitionBits;
+		uint8_t	rotationBits;
+		uint8_t	indexSelectionBits;
+		uint8_t	colorBits;
+		uint8_t	alphaBits;
+		uint8_t	endpointPBits;	// one per endpoint
+		uint8_t	sharedPBits;	// one per subset
+		uint8_t	indexBits;
+		uint8_t	secondaryIndexBits;
+	};
+
+	constexpr Bc7Mode BC7_MODES[8] = {
+		{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+		{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+		{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+		{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+		{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+		{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+		{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+		{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+	};
+
+	// Reads fields of a 128 bit block from the lowest bit up
+	class BitReader
+	{
+	public:
+		explicit BitReader(const uint8_t* block) : m_Block(block) {}
+
+		uint32_t Read(uint32_t count)
+		{
+			uint32_t value = 0;
+			for (uint32_t i = 0; i < count; i++, m_Position++)
+				value |= static_cast<uint32_t>((m_Block[m_Position >> 3] >> (m_Position & 7)) & 1) << i;
+			return value;
+		}
+
+	private:
+		const uint8_t*	m_Block;
+		uint32_t		m_Position = 0;
+	};
+
+	inline uint8_t Interpolate(uint32_t e0, uint32_t e1, uint32_t weight)
+	{
+		return static_cast<uint8_t>(((64 - weight) * e0 + weight * e1 + 32) >> 6);
+	}
+
+	inline const uint8_t* Bc7Weights(uint32_t bits)
+	{
+		return bits == 2 ? WEIGHTS_2 : bits == 3 ? WEIGHTS_3 : WEIGHTS_4;
+	}
+
+	inline void DecodeBc7Block(const uint8_t* block, uint8_t rgba[64])
+	{
+		uint32_t modeIndex = 0;
+		while (modeIndex < 8 && !(block[0] & (1 << modeIndex))) modeIndex++;
+		if (modeIndex == 8)
+		{
+			memset(rgba, 0, 64);
+			return;
+		}
+
+		const Bc7Mode& mode = BC7_MODES[modeIndex];
+		BitReader bits(block);
+		bits.Read(modeIndex + 1);
+		uint32_t partition = bits.Read(mode.partitionBits);
+		uint32_t rotation = bits.Read(mode.rotationBits);
+		uint32_t indexSelection = bits.Read(mode.indexSelectionBits);
+
+		// Endpoints in subset order, two per subset, all reds first then greens, blues and alphas
+		uint32_t endpoints[6][4] = {};
+		uint32_t endpointCount = mode.subsets * 2u;
+		for (uint32_t channel = 0; channel < 3; channel++)
+			for (uint32_t e = 0; e < endpointCount; e++)
+				endpoints[e][channel] = bits.Read(mode.colorBits);
+		for (uint32_t e = 0; e < endpointCount; e++)
+			endpoints[e][3] = mode.alphaBits ? bits.Read(mode.alphaBits) : 255;
+
+		uint32_t pBits[6] = {};
+		if (mode.endpointPBits)
+			for (uint32_t e = 0; e < endpointCount; e++) pBits[e] = bits.Read(1);
+		if (mode.sharedPBits)
+			for (uint32_t s = 0; s < mode.subsets; s++) pBits[s * 2] = pBits[s * 2 + 1] = bits.Read(1);
+
+		// Expand to 8 bits with the p-bit below the stored bits and the top bits replicated into the rest
+		bool hasPBits = mode.endpointPBits || mode.sharedPBits;
+		for (uint32_t e = 0; e < endpointCount; e++)
+		{
+			for (uint32_t channel = 0; channel < 4; channel++)
+			{
+				uint32_t stored = channel < 3 ? mode.colorBits : mode.alphaBits;
+				if (stored == 0) continue;
+				uint32_t value = endpoints[e][channel];
+				uint32_t precision = stored;
+				if (hasPBits)
+				{
+					value = (value << 1) | pBits[e];
+					precision++;
+				}
+				value <<= 8 - precision;
+				endpoints[e][channel] = value | (value >> precision);
+			}
+		}
+
+		auto subsetOf = [&](uint32_t texel) -> uint32_t {
+			if (mode.subsets == 2) return (PARTITIONS_2[partition] >> texel) & 1;
+			if (mode.subsets == 3) return PARTITIONS_3[partition][texel];
+			return 0;
+		};
+		auto isAnchor = [&](uint32_t texel) {
+			if (texel == 0) return true;
+			if (mode.subsets == 2) return texel == ANCHORS_2[partition];
+			if (mode.subsets == 3) return texel == ANCHORS_3_SECOND[partition] || texel == ANCHORS_3_THIRD[partition];
+			return false;
+		};
+
+		uint32_t indices[16], secondaryIndices[16] = {};
+		for (uint32_t texel = 0; texel < 16; texel++)
+			indices[texel] = bits.Read(isAnchor(texel) ? mode.indexBits - 1u : mode.indexBits);
+		if (mode.secondaryIndexBits)
+			for (uint32_t texel = 0; texel < 16; texel++)
+				secondaryIndices[texel] = bits.Read(texel == 0 ? mode.secondaryIndexBits - 1u : mode.secondaryIndexBits);
+
+		for (uint32_t texel = 0; texel < 16; texel++)
+		{
+			uint32_t subset = subsetOf(texel);
+			const uint32_t* e0 = endpoints[subset * 2];
+			const uint32_t* e1 = endpoints[subset * 2 + 1];
+			uint8_t* out = rgba + texel * 4;
+
+			uint32_t colorIndex = indices[texel], colorBits = mode.indexBits;
+			uint32_t alphaIndex = indices[texel], alphaBits = mode.indexBits;
+			if (mode.secondaryIndexBits)
+			{
+				// The secondary indices are alpha's unless the index selection bit swaps them
+				alphaIndex	= secondaryIndices[texel];
+				alphaBits	= mode.secondaryIndexBits;
+				if (indexSelection)
+				{
+					std::swap(colorIndex, alphaIndex);
+					std::swap(colorBits, alphaBits);
+				}
+			}
+
+			for (uint32_t channel = 0; channel < 3; channel++)
+				out[channel] = Interpolate(e0[channel], e1[channel], Bc7Weights(colorBits)[colorIndex]);
+			out[3] = mode.alphaBits ? Interpolate(e0[3], e1[3], Bc7Weights(alphaBits)[alphaIndex]) : 255;
+			if (rotation) std::swap(out[3], out[rotation - 1]);
+		}
+	}
+
+	inline bool CanDecode(VkFormat format)
+	{
+		const ktx2::FormatInfo* info = ktx2::FindFormat(format);
+		return info && info->decodedFormat != VK_FORMAT_UNDEFINED;
+	}
+
+	// Decodes a width x height level of a format CanDecode accepts into tightly packed RGBA8
+	inline void DecodeImage(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba)
+	{
+		const ktx2::FormatInfo& info = *ktx2::FindFormat(format);
+		uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+		uint8_t texels[64];
+		for (uint32_t by = 0; by < blocksY; by++)
+		{
+			for (uint32_t bx = 0; bx < blocksX; bx++)
+			{
+				const uint8_t* block = blocks + (static_cast<size_t>(by) * blocksX + bx) * info.blockBytes;
+				switch (format)
+				{
+				case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+				case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+					DecodeColorBlock(block, texels, true);
+					for (int texel = 0; texel < 16; texel++) texels[texel * 4 + 3] = 255;	// the RGB variant has no alpha, not even the transparent black
+					break;
+				case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+				case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+					DecodeColorBlock(block, texels, true);
+					break;
+				case VK_FORMAT_BC3_SRGB_BLOCK:
+				case VK_FORMAT_BC3_UNORM_BLOCK:
+					DecodeColorBlock(block + 8, texels, false);
+					DecodeChannelBlock(block, texels + 3, 4);
+					break;
+				case VK_FORMAT_BC5_UNORM_BLOCK:
+					DecodeChannelBlock(block, texels, 4);
+					DecodeChannelBlock(block + 8, texels + 1, 4);
+					for (int texel = 0; texel < 16; texel++)
+					{
+						texels[texel * 4 + 2] = 0;
+						texels[texel * 4 + 3] = 255;
+					}
+					break;
+				default:
+					DecodeBc7Block(block, texels);
+					break;
+				}
+
+				// Blocks on the right and bottom edge may hang over the level
+				for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++)
+				{
+					uint32_t columns = std::min(4u, width - bx * 4);
+					memcpy(rgba + ((static_cast<size_t>(by) * 4 + y) * width + bx * 4) * 4, texels + y * 16, columns * 4);
+				}
+			}
+		}
+	}
+}
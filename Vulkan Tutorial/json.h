@@ -0,0 +1,152 @@
+// Reader for the numbers in benchmark baselines, and escaping for the strings the reports write
+#pragma once
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+/*
+Minimal JSON reader for benchmark baselines. Only numbers are kept, nested objects
+are flattened into dotted keys ("frame_time_ms.p95") so metrics can be looked up directly.
+*/
+namespace json {
+	[[noreturn]] inline void Invalid(size_t pos)
+	{
+		throw std::runtime_error("invalid json at " + std::to_string(pos));
+	}
+
+	// text as the contents of a JSON string: quotes and backslashes escaped, control characters dropped
+	inline std::string Escape(const std::string& text)
+	{
+		std::string escaped;
+		escaped.reserve(text.size());
+		for (char c : text)
+		{
+			if (static_cast<unsigned char>(c) < 0x20) continue;
+			if (c == '"' || c == '\\') escaped += '\\';
+			escaped += c;
+		}
+		return escaped;
+	}
+
+	inline void SkipWhitespace(const std::string& text, size_t& pos)
+	{
+		while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) pos++;
+	}
+
+	// Whether the next character is c, without moving past it
+	inline bool At(const std::string& text, size_t pos, char c)
+	{
+		return pos < text.size() && text[pos] == c;
+	}
+
+	inline std::string ParseString(const std::string& text, size_t& pos)
+	{
+		if (!At(text, pos, '"')) Invalid(pos);
+		std::string result;
+		pos++; // opening quote
+		while (pos < text.size() && text[pos] != '"')
+		{
+			if (text[pos] == '\\' && pos + 1 < text.size()) pos++;
+			result += text[pos++];
+		}
+		if (pos >= text.size()) Invalid(pos);
+		pos++; // closing quote
+		return result;
+	}
+
+	inline void ParseValue(const std::string& text, size_t& pos, const std::string& key, std::map<std::string, double>& out)
+	{
+		SkipWhitespace(text, pos);
+		if (pos >= text.size()) throw std::runtime_error("unexpected end of json");
+
+		char c = text[pos];
+		if (c == '{')
+		{
+			pos++;
+			SkipWhitespace(text, pos);
+			if (At(text, pos, '}'))
+			{
+				pos++;
+				return;
+			}
+			while (true)
+			{
+				std::string name = ParseString(text, pos);
+				SkipWhitespace(text, pos);
+				if (!At(text, pos, ':')) Invalid(pos);
+				pos++;
+				ParseValue(text, pos, key.empty() ? name : key + "." + name, out);
+				SkipWhitespace(text, pos);
+				if (At(text, pos, '}')) break;
+				if (!At(text, pos, ',')) Invalid(pos);
+				pos++;
+				SkipWhitespace(text, pos);
+			}
+			pos++;
+		}
+		else if (c == '[')
+		{
+			pos++;
+			SkipWhitespace(text, pos);
+			if (At(text, pos, ']'))
+			{
+				pos++;
+				return;
+			}
+			for (size_t index = 0;; index++)
+			{
+				ParseValue(text, pos, key + "[" + std::to_string(index) + "]", out);
+				SkipWhitespace(text, pos);
+				if (At(text, pos, ']')) break;
+				if (!At(text, pos, ',')) Invalid(pos);
+				pos++;
+			}
+			pos++;
+		}
+		else if (c == '"')
+		{
+			ParseString(text, pos);
+		}
+		else if (std::isalpha(static_cast<unsigned char>(c)))
+		{
+			size_t start = pos;
+			while (pos < text.size() && std::isalpha(static_cast<unsigned char>(text[pos]))) pos++;
+			std::string word = text.substr(start, pos - start);
+			if (word != "true" && word != "false" && word != "null") Invalid(start);
+		}
+		else
+		{
+			char* end = nullptr;
+			double value = std::strtod(text.c_str() + pos, &end);
+			if (end == text.c_str() + pos) Invalid(pos);
+			out[key] = value;
+			pos = static_cast<size_t>(end - text.c_str());
+		}
+	}
+
+	// Every number in text by its flattened key. Throws on anything that is not a single JSON value.
+	inline std::map<std::string, double> ParseNumbers(const std::string& text)
+	{
+		std::map<std::string, double> numbers;
+		size_t pos = 0;
+		ParseValue(text, pos, "", numbers);
+		SkipWhitespace(text, pos);
+		if (pos != text.size()) Invalid(pos);
+		return numbers;
+	}
+
+	inline std::map<std::string, double> ReadNumbers(const std::string& path)
+	{
+		std::ifstream file(path);
+		if (!file.is_open()) throw std::runtime_error("failed to open " + path);
+
+		std::stringstream contents;
+		contents << file.rdbuf();
+		return ParseNumbers(contents.str());
+	}
+}
@@ -0,0 +1,239 @@
+// Reader and writer for the KTX2 texture containers the texture baker writes and LoadTexture uploads
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+/*
+Reader for KTX2 containers (https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html) holding a
+single 2D image in a Vulkan format, stored without supercompression. The level index gives the
+offset of every mip level in the file; levels are aligned to their block size, so a mapped file can
+be staged as it is and copied to the image level by level.
+*/
+namespace ktx2 {
+	constexpr uint8_t IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	constexpr size_t HEADER_BYTES = 80;			// identifier, header and index
+	constexpr size_t LEVEL_INDEX_BYTES = 24;	// per level
+
+	// Layout of a format the loader accepts. decodedFormat is what bcn::DecodeImage turns it into,
+	// VK_FORMAT_UNDEFINED if the blocks can only be sampled by a GPU that supports the format.
+	struct FormatInfo
+	{
+		VkFormat	format;
+		uint32_t	blockWidth;
+		uint32_t	blockHeight;
+		uint32_t	blockBytes;
+		VkFormat	decodedFormat;
+	};
+
+	constexpr FormatInfo FORMATS[] = {
+		{ VK_FORMAT_R8G8B8A8_SRGB,				1, 1, 4,	VK_FORMAT_UNDEFINED },
+		{ VK_FORMAT_R8G8B8A8_UNORM,				1, 1, 4,	VK_FORMAT_UNDEFINED },
+		{ VK_FORMAT_BC1_RGB_SRGB_BLOCK,			4, 4, 8,	VK_FORMAT_R8G8B8A8_SRGB },
+		{ VK_FORMAT_BC1_RGB_UNORM_BLOCK,		4, 4, 8,	VK_FORMAT_R8G8B8A8_UNORM },
+		{ VK_FORMAT_BC1_RGBA_SRGB_BLOCK,		4, 4, 8,	VK_FORMAT_R8G8B8A8_SRGB },
+		{ VK_FORMAT_BC1_RGBA_UNORM_BLOCK,		4, 4, 8,	VK_FORMAT_R8G8B8A8_UNORM },
+		{ VK_FORMAT_BC3_SRGB_BLOCK,				4, 4, 16,	VK_FORMAT_R8G8B8A8_SRGB },
+		{ VK_FORMAT_BC3_UNORM_BLOCK,			4, 4, 16,	VK_FORMAT_R8G8B8A8_UNORM },
+		{ VK_FORMAT_BC5_UNORM_BLOCK,			4, 4, 16,	VK_FORMAT_R8G8B8A8_UNORM },
+		{ VK_FORMAT_BC7_SRGB_BLOCK,				4, 4, 16,	VK_FORMAT_R8G8B8A8_SRGB },
+		{ VK_FORMAT_BC7_UNORM_BLOCK,			4, 4, 16,	VK_FORMAT_R8G8B8A8_UNORM },
+		{ VK_FORMAT_ASTC_4x4_SRGB_BLOCK,		4, 4, 16,	VK_FORMAT_UNDEFINED },
+		{ VK_FORMAT_ASTC_4x4_UNORM_BLOCK,		4, 4, 16,	VK_FORMAT_UNDEFINED },
+	};
+
+	inline const FormatInfo* FindFormat(VkFormat format)
+	{
+		for (const FormatInfo& info : FORMATS)
+			if (info.format == format) return &info;
+		return nullptr;
+	}
+
+	inline bool IsBlockCompressed(VkFormat format)
+	{
+		const FormatInfo* info = FindFormat(format);
+		return info && info->blockWidth > 1;
+	}
+
+	// Bytes of one level of a width x height image
+	inline uint64_t LevelBytes(const FormatInfo& info, uint32_t width, uint32_t height)
+	{
+		uint64_t blocksX = (width + info.blockWidth - 1) / info.blockWidth;
+		uint64_t blocksY = (height + info.blockHeight - 1) / info.blockHeight;
+		return blocksX * blocksY * info.blockBytes;
+	}
+
+	struct Level
+	{
+		uint64_t	offset	= 0;	// from the start of the file
+		uint64_t	size	= 0;
+		uint32_t	width	= 0;
+		uint32_t	height	= 0;
+	};
+
+	struct Image
+	{
+		VkFormat			format	= VK_FORMAT_UNDEFINED;
+		uint32_t			width	= 0;
+		uint32_t			height	= 0;
+		std::vector<Level>	levels;	// largest first
+	};
+
+	// Fills image from the size bytes at data. Returns false with the reason in error for anything
+	// the loader cannot upload as it is: arrays, cube maps, 3D images, supercompressed or unknown formats.
+	inline bool Parse(const uint8_t* data, uint64_t size, Image& image, std::string& error)
+	{
+		auto read32 = [&](size_t offset) { uint32_t value; memcpy(&value, data + offset, sizeof(value)); return value; };
+		auto read64 = [&](size_t offset) { uint64_t value; memcpy(&value, data + offset, sizeof(value)); return value; };
+
+		if (size < HEADER_BYTES || memcmp(data, IDENTIFIER, sizeof(IDENTIFIER)) != 0)
+		{
+			error = "not a KTX2 file";
+			return false;
+		}
+
+		image.format = static_cast<VkFormat>(read32(12));
+		image.width = read32(20);
+		image.height = read32(24);
+		uint32_t depth = read32(28), layerCount = read32(32), faceCount = read32(36);
+		uint32_t levelCount = std::max(read32(40), 1u);	// 0 asks the loader to generate the mips
+		uint32_t supercompression = read32(44);
+
+		const FormatInfo* info = FindFormat(image.format);
+		if (!info) error = "unsupported vkFormat " + std::to_string(image.format);
+		else if (supercompression != 0) error = "supercompression scheme " + std::to_string(supercompression) + " is not supported";
+		else if (image.width == 0 || image.height == 0 || depth > 1 || layerCount > 1 || faceCount != 1) error = "only single 2D images are supported";
+		else if (levelCount > 32 || ((image.width >> (levelCount - 1)) == 0 && (image.height >> (levelCount - 1)) == 0)) error = "too many levels";
+		else if (HEADER_BYTES + static_cast<uint64_t>(levelCount) * LEVEL_INDEX_BYTES > size) error = "truncated level index";
+		if (!error.empty()) return false;
+
+		image.levels.resize(levelCount);
+		for (uint32_t i = 0; i < levelCount; i++)
+		{
+			Level& level = image.levels[i];
+			size_t entry = HEADER_BYTES + i * LEVEL_INDEX_BYTES;
+			level.offset	= read64(entry);
+			level.size		= read64(entry + 8);
+			level.width		= std::max(image.width >> i, 1u);
+			level.height	= std::max(image.height >> i, 1u);
+
+			if (level.size < LevelBytes(*info, level.width, level.height) || level.offset > size || level.size > size - level.offset)
+			{
+				error = "level " + std::to_string(i) + " is truncated";
+				return false;
+			}
+			if (level.offset % info->blockBytes != 0 || level.offset % 4 != 0)
+			{
+				error = "level " + std::to_string(i) + " is misaligned";
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Basic data format descriptor of one of FORMATS, which the KTX2 spec requires in every file
+	inline std::vector<uint32_t> DataFormatDescriptor(VkFormat format)
+	{
+		// Khronos data format spec values, channel 15 is alpha and 0x10 marks a sample as linear
+		enum : uint32_t { MODEL_RGBSDA = 1, MODEL_BC1A = 128, MODEL_BC3 = 130, MODEL_BC5 = 132, MODEL_BC7 = 134, MODEL_ASTC = 162 };
+		enum : uint32_t { TRANSFER_LINEAR = 1, TRANSFER_SRGB = 2, PRIMARIES_BT709 = 1, CHANNEL_ALPHA = 15, QUALIFIER_LINEAR = 0x10 };
+		struct Sample
+		{
+			uint32_t	bitOffset;
+			uint32_t	bitLength;
+			uint32_t	channel;
+		};
+
+		bool srgb = false;
+		uint32_t model = MODEL_RGBSDA;
+		std::vector<Sample> samples;
+		switch (format)
+		{
+		case VK_FORMAT_R8G8B8A8_SRGB:			srgb = true; [[fallthrough]];
+		case VK_FORMAT_R8G8B8A8_UNORM:			samples = { { 0, 8, 0 }, { 8, 8, 1 }, { 16, 8, 2 }, { 24, 8, CHANNEL_ALPHA } }; break;
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:		srgb = true; [[fallthrough]];
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:		model = MODEL_BC1A; samples = { { 0, 64, 0 } }; break;
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:		srgb = true; [[fallthrough]];
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:	model = MODEL_BC1A; samples = { { 0, 64, 1 } }; break;
+		case VK_FORMAT_BC3_SRGB_BLOCK:			srgb = true; [[fallthrough]];
+		case VK_FORMAT_BC3_UNORM_BLOCK:			model = MODEL_BC3; samples = { { 0, 64, CHANNEL_ALPHA }, { 64, 64, 0 } }; break;
+		case VK_FORMAT_BC5_UNORM_BLOCK:			model = MODEL_BC5; samples = { { 0, 64, 0 }, { 64, 64, 1 } }; break;
+		case VK_FORMAT_BC7_SRGB_BLOCK:			srgb = true; [[fallthrough]];
+		case VK_FORMAT_BC7_UNORM_BLOCK:			model = MODEL_BC7; samples = { { 0, 128, 0 } }; break;
+		case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:		srgb = true; [[fallthrough]];
+		default:								model = MODEL_ASTC; samples = { { 0, 128, 0 } }; break;
+		}
+
+		const FormatInfo& info = *FindFormat(format);
+		uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+		std::vector<uint32_t> words = {
+			4 + blockSize,
+			0,	// Khronos vendor, basic descriptor type
+			2 | (blockSize << 16),
+			model | (PRIMARIES_BT709 << 8) | ((srgb ? TRANSFER_SRGB : TRANSFER_LINEAR) << 16),
+			(info.blockWidth - 1) | ((info.blockHeight - 1) << 8),
+			info.blockBytes,
+			0,
+		};
+		for (const Sample& sample : samples)
+		{
+			uint32_t qualifiers = srgb && sample.channel == CHANNEL_ALPHA ? static_cast<uint32_t>(QUALIFIER_LINEAR) : 0u;
+			words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | ((sample.channel | qualifiers) << 24));
+			words.push_back(0);	// sample position
+			words.push_back(0);	// lower
+			words.push_back(sample.bitLength < 32 ? (1u << sample.bitLength) - 1 : std::numeric_limits<uint32_t>::max());	// upper
+		}
+		return words;
+	}
+
+	// KTX2 file of a width x height image in one of FORMATS, levels largest first and each as large as LevelBytes says
+	inline std::vector<uint8_t> Write(VkFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>>& levels)
+	{
+		const FormatInfo& info = *FindFormat(format);
+		std::vector<uint32_t> descriptor = DataFormatDescriptor(format);
+		const char KEY[] = "KTXwriter", VALUE[] = "Vulkan Tutorial texture baker";
+		uint32_t keyValueBytes = sizeof(KEY) + sizeof(VALUE);
+
+		std::vector<uint8_t> file(HEADER_BYTES + levels.size() * LEVEL_INDEX_BYTES);
+		auto write32 = [&](size_t offset, uint32_t value) { memcpy(file.data() + offset, &value, sizeof(value)); };
+		auto write64 = [&](size_t offset, uint64_t value) { memcpy(file.data() + offset, &value, sizeof(value)); };
+		auto append = [&](const void* data, size_t size) { file.insert(file.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size); };
+		auto align = [&](size_t alignment) { file.resize((file.size() + alignment - 1) / alignment * alignment); };
+
+		memcpy(file.data(), IDENTIFIER, sizeof(IDENTIFIER));
+		write32(12, format);
+		write32(16, 1);	// typeSize, 1 for block formats and 8 bit channels
+		write32(20, width);
+		write32(24, height);
+		write32(36, 1);	// faceCount
+		write32(40, static_cast<uint32_t>(levels.size()));
+
+		write32(48, static_cast<uint32_t>(file.size()));
+		write32(52, static_cast<uint32_t>(descriptor.size() * sizeof(uint32_t)));
+		append(descriptor.data(), descriptor.size() * sizeof(uint32_t));
+
+		write32(56, static_cast<uint32_t>(file.size()));
+		write32(60, ((4 + keyValueBytes + 3) & ~3u));
+		append(&keyValueBytes, sizeof(keyValueBytes));
+		append(KEY, sizeof(KEY));
+		append(VALUE, sizeof(VALUE));
+		align(4);
+
+		// Smallest level first, each aligned to its block size
+		for (size_t level = levels.size(); level-- > 0;)
+		{
+			align(info.blockBytes);
+			write64(HEADER_BYTES + level * LEVEL_INDEX_BYTES, file.size());
+			write64(HEADER_BYTES + level * LEVEL_INDEX_BYTES + 8, levels[level].size());
+			write64(HEADER_BYTES + level * LEVEL_INDEX_BYTES + 16, levels[level].size());
+			append(levels[level].data(), levels[level].size());
+		}
+		return file;
+	}
+}
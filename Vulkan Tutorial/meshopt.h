@@ -0,0 +1,698 @@
+// Index and vertex reordering, LOD simplification and meshlet building for a loaded mesh
+#pragma once
+
+#include "Vertex.h"
+#include "FlatIndexMap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// One vkCmdDrawIndexed over a run of the index buffer, vertexOffset is added to every index in it
+struct IndexRange
+{
+	uint32_t	firstIndex		= 0;
+	uint32_t	indexCount		= 0;
+	int32_t		vertexOffset	= 0;
+};
+
+/*
+Index and vertex reordering run on a freshly loaded mesh before it is baked into the mesh cache.
+
+OptimizeVertexCache reorders triangles with Tipsify (Sander, Nehab and Barczak, "Fast Triangle
+Reordering for Vertex Locality and Reduced Overdraw", 2007) so that recently shaded vertices are
+reused by the post transform cache. It also returns the clusters of its output: runs that start
+after a dead end, where the cache is cold anyway, split further wherever the run so far already
+reaches the vertex cache efficiency of the whole mesh. OptimizeOverdraw sorts those clusters so the
+ones facing away from the mesh centre, which tend to occlude the rest, are drawn first. Reordering
+clusters keeps most of the cache efficiency since each cluster was good on its own.
+
+OptimizeVertexFetch then renumbers the vertices in the order the indices first use them, so the
+vertex fetch walks the vertex buffer mostly forwards.
+
+Simplify builds the lower LODs from LOD 0 with quadric error metrics before the vertex fetch pass.
+
+BuildMeshlets runs at upload time and cuts the final triangle order into small meshlets with a
+bounding sphere and a normal cone each, which cull.comp tests against the frustum and the camera.
+*/
+namespace meshopt {
+	// FIFO size assumed for the post transform cache, in vertices
+	constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+	// Size of the lines vertex fetch is simulated with, and how many of them the simulated cache holds
+	constexpr uint32_t FETCH_LINE_BYTES = 64;
+	constexpr uint32_t FETCH_CACHE_LINES = 64;
+	// A cluster is split once its ACMR so far drops to this fraction of the whole mesh's
+	constexpr float CLUSTER_ACMR_THRESHOLD = 0.85f;
+
+	struct CacheStatistics
+	{
+		double	acmr		= 0.0;	// vertices shaded per triangle, 0.5 is the ideal for a regular grid
+		double	atvr		= 0.0;	// vertices shaded per vertex, 1.0 is ideal
+		double	overfetch	= 0.0;	// bytes fetched per vertex buffer byte, 1.0 is ideal
+	};
+
+	// Simulates a FIFO post transform cache of cacheSize vertices and a FIFO cache of fetched lines
+	inline CacheStatistics Analyze(const uint32_t* indices, size_t indexCount, size_t vertexCount, size_t vertexSize, uint32_t cacheSize = VERTEX_CACHE_SIZE)
+	{
+		CacheStatistics statistics;
+		if (indexCount == 0 || vertexCount == 0) return statistics;
+
+		// An entry is in a FIFO cache if fewer than cacheSize misses happened since it was added
+		std::vector<uint64_t> cachedAt(vertexCount, 0);
+		uint64_t misses = 0;
+		size_t lineCount = (vertexCount * vertexSize + FETCH_LINE_BYTES - 1) / FETCH_LINE_BYTES;
+		std::vector<uint64_t> lineFetchedAt(lineCount, 0);
+		uint64_t lineMisses = 0;
+
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			uint32_t index = indices[i];
+			if (cachedAt[index] != 0 && misses - cachedAt[index] < cacheSize) continue;
+			cachedAt[index] = ++misses;
+
+			size_t firstLine = index * vertexSize / FETCH_LINE_BYTES;
+			size_t lastLine = ((index + 1) * vertexSize - 1) / FETCH_LINE_BYTES;
+			for (size_t line = firstLine; line <= lastLine; line++)
+			{
+				if (lineFetchedAt[line] != 0 && lineMisses - lineFetchedAt[line] < FETCH_CACHE_LINES) continue;
+				lineFetchedAt[line] = ++lineMisses;
+			}
+		}
+
+		statistics.acmr			= static_cast<double>(misses) / static_cast<double>(indexCount / 3);
+		statistics.atvr			= static_cast<double>(misses) / static_cast<double>(vertexCount);
+		statistics.overfetch	= static_cast<double>(lineMisses * FETCH_LINE_BYTES) / static_cast<double>(vertexCount * vertexSize);
+		return statistics;
+	}
+
+	// Reorders the triangles of indices in place. clusters receives the index of the first triangle of each cluster.
+	inline void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& clusters, uint32_t cacheSize = VERTEX_CACHE_SIZE)
+	{
+		size_t triangleCount = indices.size() / 3;
+		clusters.clear();
+		if (triangleCount == 0) return;
+
+		// Triangles around each vertex, as offsets into one flat array
+		std::vector<uint32_t> liveTriangles(vertexCount, 0);
+		for (uint32_t index : indices) liveTriangles[index]++;
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; v++) adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+		std::vector<uint32_t> adjacency(indices.size());
+		{
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++)
+				adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> deadEnd;
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> output;
+		output.reserve(indices.size());
+
+		uint32_t time = cacheSize + 1;
+		size_t cursor = 0;
+		int64_t fanning = 0;
+		bool coldStart = true;
+
+		// Next vertex with live triangles, from the dead end stack first and then in input order
+		auto skipDeadEnd = [&]() -> int64_t {
+			while (!deadEnd.empty())
+			{
+				uint32_t vertex = deadEnd.back();
+				deadEnd.pop_back();
+				if (liveTriangles[vertex] > 0) return vertex;
+			}
+			for (; cursor < vertexCount; cursor++)
+				if (liveTriangles[cursor] > 0) return static_cast<int64_t>(cursor);
+			return -1;
+		};
+
+		while (fanning >= 0)
+		{
+			uint32_t emittedTriangles = static_cast<uint32_t>(output.size() / 3);
+			if (coldStart && (clusters.empty() || clusters.back() != emittedTriangles)) clusters.push_back(emittedTriangles);
+			coldStart = false;
+
+			candidates.clear();
+			for (uint32_t a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++)
+			{
+				uint32_t triangle = adjacency[a];
+				if (emitted[triangle]) continue;
+				emitted[triangle] = true;
+
+				for (size_t k = 0; k < 3; k++)
+				{
+					uint32_t vertex = indices[triangle * 3 + k];
+					output.push_back(vertex);
+					deadEnd.push_back(vertex);
+					candidates.push_back(vertex);
+					liveTriangles[vertex]--;
+					if (time - cacheTime[vertex] > cacheSize) cacheTime[vertex] = time++;
+				}
+			}
+
+			// Fan next around the candidate that will still be in the cache after its remaining triangles, oldest first
+			int64_t next = -1;
+			int64_t bestPriority = -1;
+			for (uint32_t vertex : candidates)
+			{
+				if (liveTriangles[vertex] == 0) continue;
+				int64_t priority = 0;
+				if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+					priority = time - cacheTime[vertex];
+				if (priority > bestPriority)
+				{
+					bestPriority	= priority;
+					next			= vertex;
+				}
+			}
+
+			if (next == -1)
+			{
+				next = skipDeadEnd();
+				coldStart = true;
+			}
+			fanning = next;
+		}
+
+		indices.swap(output);
+
+		// Split the dead end runs where the run so far is already as cache friendly as the whole mesh
+		double targetAcmr = Analyze(indices.data(), indices.size(), vertexCount, 1, cacheSize).acmr * CLUSTER_ACMR_THRESHOLD;
+		std::vector<uint32_t> splitClusters;
+		std::fill(cacheTime.begin(), cacheTime.end(), 0);
+		time = cacheSize + 1;
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : static_cast<uint32_t>(triangleCount);
+			uint32_t start = clusters[c];
+			uint32_t misses = 0;
+			time += cacheSize + 1; // everything cached by the previous cluster is stale
+			splitClusters.push_back(start);
+			for (uint32_t triangle = clusters[c]; triangle < end; triangle++)
+			{
+				for (size_t k = 0; k < 3; k++)
+				{
+					uint32_t vertex = indices[triangle * 3 + k];
+					if (time - cacheTime[vertex] > cacheSize)
+					{
+						cacheTime[vertex] = time++;
+						misses++;
+					}
+				}
+
+				if (triangle + 1 < end && static_cast<double>(misses) / (triangle + 1 - start) <= targetAcmr)
+				{
+					start = triangle + 1;
+					misses = 0;
+					time += cacheSize + 1;
+					splitClusters.push_back(start);
+				}
+			}
+		}
+		clusters.swap(splitClusters);
+	}
+
+	// Draws the clusters found by OptimizeVertexCache that face away from the mesh centre first
+	inline void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusters)
+	{
+		size_t triangleCount = indices.size() / 3;
+		if (clusters.size() < 2) return;
+
+		struct ClusterSort
+		{
+			glm::vec3	centroid	= glm::vec3(0.0f);
+			glm::vec3	normal		= glm::vec3(0.0f);
+			float		area		= 0.0f;
+			float		score		= 0.0f;
+			uint32_t	cluster		= 0;
+		};
+		std::vector<ClusterSort> sorts(clusters.size());
+
+		glm::vec3 meshCentroid(0.0f);
+		float meshArea = 0.0f;
+		for (size_t i = 0; i < clusters.size(); i++)
+		{
+			ClusterSort& sort = sorts[i];
+			sort.cluster = static_cast<uint32_t>(i);
+			size_t end = i + 1 < clusters.size() ? clusters[i + 1] : triangleCount;
+			for (size_t triangle = clusters[i]; triangle < end; triangle++)
+			{
+				const glm::vec3& a = vertices[indices[triangle * 3 + 0]].position;
+				const glm::vec3& b = vertices[indices[triangle * 3 + 1]].position;
+				const glm::vec3& c = vertices[indices[triangle * 3 + 2]].position;
+				glm::vec3 normal = glm::cross(b - a, c - a);	// length is twice the area
+				float area = glm::length(normal) * 0.5f;
+
+				sort.centroid	+= (a + b + c) * (area / 3.0f);
+				sort.normal		+= normal;
+				sort.area		+= area;
+			}
+			meshCentroid	+= sort.centroid;
+			meshArea		+= sort.area;
+		}
+		if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+		for (ClusterSort& sort : sorts)
+		{
+			if (sort.area <= 0.0f) continue;
+			float normalLength = glm::length(sort.normal);
+			if (normalLength > 0.0f)
+				sort.score = glm::dot(sort.centroid / sort.area - meshCentroid, sort.normal / normalLength);
+		}
+		std::stable_sort(sorts.begin(), sorts.end(), [](const ClusterSort& a, const ClusterSort& b) { return a.score > b.score; });
+
+		std::vector<uint32_t> output;
+		output.reserve(indices.size());
+		for (const ClusterSort& sort : sorts)
+		{
+			size_t end = sort.cluster + 1 < clusters.size() ? clusters[sort.cluster + 1] : triangleCount;
+			output.insert(output.end(), indices.begin() + clusters[sort.cluster] * 3, indices.begin() + end * 3);
+		}
+		indices.swap(output);
+	}
+
+	// Renumbers vertices in order of first use and drops any that no triangle references
+	inline void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		const uint32_t unused = std::numeric_limits<uint32_t>::max();
+		std::vector<uint32_t> remap(vertices.size(), unused);
+		std::vector<Vertex> output;
+		output.reserve(vertices.size());
+
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == unused)
+			{
+				remap[index] = static_cast<uint32_t>(output.size());
+				output.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		vertices.swap(output);
+	}
+
+	// Garland and Heckbert's error quadric: the weighted sum of squared distances to a set of planes
+	struct Quadric
+	{
+		double	a00 = 0.0, a11 = 0.0, a22 = 0.0, a01 = 0.0, a02 = 0.0, a12 = 0.0;
+		double	b0 = 0.0, b1 = 0.0, b2 = 0.0, c = 0.0;
+		double	weight = 0.0;
+
+		// Plane through point with unit normal
+		void AddPlane(glm::vec3 normal, glm::vec3 point, double planeWeight)
+		{
+			double x = normal.x, y = normal.y, z = normal.z, d = -glm::dot(normal, point);
+			a00 += planeWeight * x * x;	a11 += planeWeight * y * y;	a22 += planeWeight * z * z;
+			a01 += planeWeight * x * y;	a02 += planeWeight * x * z;	a12 += planeWeight * y * z;
+			b0 += planeWeight * x * d;	b1 += planeWeight * y * d;	b2 += planeWeight * z * d;
+			c += planeWeight * d * d;
+			weight += planeWeight;
+		}
+
+		void Add(const Quadric& other)
+		{
+			a00 += other.a00;	a11 += other.a11;	a22 += other.a22;
+			a01 += other.a01;	a02 += other.a02;	a12 += other.a12;
+			b0 += other.b0;		b1 += other.b1;		b2 += other.b2;
+			c += other.c;
+			weight += other.weight;
+		}
+
+		// Weighted mean squared distance of point to the planes
+		double Error(glm::vec3 point) const
+		{
+			double x = point.x, y = point.y, z = point.z;
+			double error = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+				+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+			return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+		}
+	};
+
+	// Weight of the planes that hold open borders in place, relative to the surface planes
+	constexpr double SIMPLIFY_BORDER_WEIGHT = 10.0;
+	// Cost of turning a vertex's normal into its collapse target's, per squared edge length and unit of 1 - cos
+	constexpr double SIMPLIFY_NORMAL_WEIGHT = 1.0;
+
+	/*
+	Simplifies the triangles in indices down to about targetIndexCount indices by collapsing vertices
+	into a neighbour, cheapest first by the quadric error of the collapse, stopping early rather than
+	make a collapse whose error exceeds maxError. The result indexes the same vertices, so a chain of
+	LODs shares one vertex buffer. error receives the square root of the largest collapse cost, about
+	how far the simplified surface moved in object space. Surviving triangles keep their order, and
+	triangleGroups, one entry per source triangle (its material), is compacted along with them.
+
+	Attributes are kept by collapsing positions rather than vertices. All vertices at a position
+	(the wedges of a UV seam or hard edge) collapse together, each into the wedge of the target position
+	it shares an edge with; a collapse where some wedge has no such partner would drag attributes
+	across the seam and is skipped, so seams only ever shorten along themselves. Bending normals adds
+	to the cost, open borders only collapse along the border, and collapses that would flip a triangle
+	are skipped. Each pass collapses the cheapest candidates that do not touch one another.
+	*/
+	inline std::vector<uint32_t> Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& source, size_t targetIndexCount, float maxError, float& error,
+		std::vector<uint32_t>& triangleGroups)
+	{
+		const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+		const uint32_t none = std::numeric_limits<uint32_t>::max();
+
+		// positionOf maps every vertex to the first vertex at its position, which stands for the position
+		std::vector<uint32_t> positionOf(vertexCount);
+		{
+			FlatIndexMap<glm::vec3, PositionHash> positions(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; v++)
+				positionOf[v] = positions.Insert(vertices[v].position, v).first;
+		}
+		std::vector<uint32_t> wedgeOffsets(vertexCount + 1, 0), wedges(vertexCount);
+		for (uint32_t v = 0; v < vertexCount; v++) wedgeOffsets[positionOf[v] + 1]++;
+		for (uint32_t p = 0; p < vertexCount; p++) wedgeOffsets[p + 1] += wedgeOffsets[p];
+		{
+			std::vector<uint32_t> fill(wedgeOffsets.begin(), wedgeOffsets.end() - 1);
+			for (uint32_t v = 0; v < vertexCount; v++) wedges[fill[positionOf[v]]++] = v;
+		}
+
+		auto positionKey = [&](uint32_t a, uint32_t b) {
+			a = positionOf[a];
+			b = positionOf[b];
+			return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+		};
+
+		std::vector<uint32_t> indices = source;
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			const glm::vec3& a = vertices[indices[i]].position;
+			glm::vec3 normal = glm::cross(vertices[indices[i + 1]].position - a, vertices[indices[i + 2]].position - a);
+			float length = glm::length(normal);
+			if (length <= 0.0f) continue;
+			for (size_t k = 0; k < 3; k++)
+				quadrics[positionOf[indices[i + k]]].AddPlane(normal / length, a, length * 0.5);
+		}
+
+		// Edges by position with the triangle they came from, an edge seen once is on a border
+		struct Edge
+		{
+			uint64_t	key;
+			uint32_t	triangle;
+			bool operator<(const Edge& other) const { return key < other.key; }
+		};
+		std::vector<Edge> edges;
+		auto collectEdges = [&]() {
+			edges.clear();
+			for (uint32_t i = 0; i + 2 < indices.size(); i += 3)
+				for (uint32_t k = 0; k < 3; k++)
+					edges.push_back({ positionKey(indices[i + k], indices[i + (k + 1) % 3]), i / 3 });
+			std::sort(edges.begin(), edges.end());
+		};
+		auto edgeUses = [&](uint64_t key) {
+			auto range = std::equal_range(edges.begin(), edges.end(), Edge{ key, 0 });
+			return static_cast<size_t>(range.second - range.first);
+		};
+
+		// Border planes run through the edge, perpendicular to its triangle
+		collectEdges();
+		for (size_t e = 0; e < edges.size(); e++)
+		{
+			if ((e > 0 && edges[e - 1].key == edges[e].key) || (e + 1 < edges.size() && edges[e + 1].key == edges[e].key)) continue;
+			uint32_t a = static_cast<uint32_t>(edges[e].key >> 32), b = static_cast<uint32_t>(edges[e].key);
+			const uint32_t* triangle = &indices[edges[e].triangle * 3];
+			glm::vec3 faceNormal = glm::cross(vertices[triangle[1]].position - vertices[triangle[0]].position, vertices[triangle[2]].position - vertices[triangle[0]].position);
+			glm::vec3 edgeVector = vertices[b].position - vertices[a].position;
+			glm::vec3 planeNormal = glm::cross(edgeVector, faceNormal);
+			float length = glm::length(planeNormal);
+			if (length <= 0.0f) continue;
+			double planeWeight = SIMPLIFY_BORDER_WEIGHT * glm::dot(edgeVector, edgeVector);
+			quadrics[a].AddPlane(planeNormal / length, vertices[a].position, planeWeight);
+			quadrics[b].AddPlane(planeNormal / length, vertices[b].position, planeWeight);
+		}
+
+		struct Collapse
+		{
+			uint32_t	from, to;	// positions
+			double		cost;
+		};
+		std::vector<uint32_t> triangleOffsets(vertexCount + 1), triangles, collapseTo(vertexCount);
+		std::vector<uint8_t> border(vertexCount), touched(vertexCount);
+		std::vector<Collapse> collapses;
+		double maxCost = 0.0;
+
+		// Cost of collapsing position from into position to, infinite if not allowed. Fills collapseTo
+		// for the wedges of from when apply is set.
+		auto evaluate = [&](uint32_t from, uint32_t to, bool apply) {
+			const double forbidden = std::numeric_limits<double>::infinity();
+			glm::vec3 target = vertices[to].position;
+			double bend = 0.0;
+			uint32_t wedgeCount = 0;
+
+			for (uint32_t w = wedgeOffsets[from]; w < wedgeOffsets[from + 1]; w++)
+			{
+				uint32_t wedge = wedges[w], partner = none;
+				bool used = false;
+				for (uint32_t t = triangleOffsets[from]; t < triangleOffsets[from + 1] && partner == none; t++)
+				{
+					const uint32_t* corners = &indices[triangles[t] * 3];
+					if (corners[0] != wedge && corners[1] != wedge && corners[2] != wedge) continue;
+					used = true;
+					for (uint32_t k = 0; k < 3; k++)
+						if (positionOf[corners[k]] == to) partner = corners[k];
+				}
+				if (!used) continue;
+				if (partner == none) return forbidden;
+
+				bend += 1.0 - glm::dot(vertices[wedge].normal, vertices[partner].normal);
+				wedgeCount++;
+				if (apply) collapseTo[wedge] = partner;
+			}
+
+			for (uint32_t t = triangleOffsets[from]; t < triangleOffsets[from + 1]; t++)
+			{
+				const uint32_t* corners = &indices[triangles[t] * 3];
+				glm::vec3 before[3], after[3];
+				bool degenerate = false;
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					before[k] = after[k] = vertices[corners[k]].position;
+					if (positionOf[corners[k]] == from) after[k] = target;
+					degenerate |= positionOf[corners[k]] == to;
+				}
+				if (degenerate) continue;
+				glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+				glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+				if (glm::dot(normalBefore, normalAfter) <= 0.0f) return forbidden;
+			}
+
+			Quadric combined = quadrics[from];
+			combined.Add(quadrics[to]);
+			glm::vec3 edgeVector = target - vertices[from].position;
+			return combined.Error(target) + SIMPLIFY_NORMAL_WEIGHT * glm::dot(edgeVector, edgeVector) * (wedgeCount > 0 ? bend / wedgeCount : 0.0);
+		};
+
+		while (indices.size() > targetIndexCount)
+		{
+			uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+			// Triangles around each position, a triangle with two corners at one position is listed once
+			std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+			for (uint32_t t = 0; t < triangleCount; t++)
+				for (uint32_t k = 0; k < 3; k++)
+					triangleOffsets[positionOf[indices[t * 3 + k]] + 1]++;
+			for (uint32_t p = 0; p < vertexCount; p++) triangleOffsets[p + 1] += triangleOffsets[p];
+			triangles.resize(triangleOffsets[vertexCount]);
+			{
+				std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+				for (uint32_t t = 0; t < triangleCount; t++)
+					for (uint32_t k = 0; k < 3; k++)
+						triangles[fill[positionOf[indices[t * 3 + k]]]++] = t;
+			}
+
+			// Positions on an open border only collapse along it, on a non manifold edge not at all
+			collectEdges();
+			std::fill(border.begin(), border.end(), 0);
+			for (size_t e = 0; e < edges.size();)
+			{
+				size_t end = e;
+				while (end < edges.size() && edges[end].key == edges[e].key) end++;
+				uint8_t kind = end - e == 1 ? 1 : end - e > 2 ? 2 : 0;
+				border[edges[e].key >> 32]				= std::max(border[edges[e].key >> 32], kind);
+				border[static_cast<uint32_t>(edges[e].key)]	= std::max(border[static_cast<uint32_t>(edges[e].key)], kind);
+				e = end;
+			}
+
+			collapses.clear();
+			for (uint32_t from = 0; from < vertexCount; from++)
+			{
+				if (positionOf[from] != from || triangleOffsets[from] == triangleOffsets[from + 1] || border[from] == 2) continue;
+				Collapse best{ from, none, std::numeric_limits<double>::infinity() };
+				for (uint32_t t = triangleOffsets[from]; t < triangleOffsets[from + 1]; t++)
+				{
+					for (uint32_t k = 0; k < 3; k++)
+					{
+						uint32_t to = positionOf[indices[triangles[t] * 3 + k]];
+						if (to == from || to == best.to) continue;
+						if (border[from] == 1 && edgeUses(positionKey(from, to)) != 1) continue;
+						double cost = evaluate(from, to, false);
+						if (cost < best.cost) best = { from, to, cost };
+					}
+				}
+				if (best.to != none) collapses.push_back(best);
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+			for (uint32_t v = 0; v < vertexCount; v++) collapseTo[v] = v;
+			std::fill(touched.begin(), touched.end(), 0);
+			size_t removed = 0, removeTarget = (indices.size() - targetIndexCount) / 3 + 1, applied = 0;
+			for (const Collapse& collapse : collapses)
+			{
+				if (removed >= removeTarget || collapse.cost > static_cast<double>(maxError) * maxError) break;
+				if (touched[collapse.from] || touched[collapse.to]) continue;
+
+				evaluate(collapse.from, collapse.to, true);
+				quadrics[collapse.to].Add(quadrics[collapse.from]);
+				maxCost = std::max(maxCost, collapse.cost);
+				applied++;
+
+				// Neighbours are left alone for the rest of the pass, their triangles just changed
+				for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; t++)
+				{
+					bool containsTarget = false;
+					for (uint32_t k = 0; k < 3; k++)
+					{
+						uint32_t position = positionOf[indices[triangles[t] * 3 + k]];
+						touched[position] = 1;
+						containsTarget |= position == collapse.to;
+					}
+					removed += containsTarget;
+				}
+			}
+			if (applied == 0) break;
+
+			size_t kept = 0;
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				uint32_t a = collapseTo[indices[i]], b = collapseTo[indices[i + 1]], c = collapseTo[indices[i + 2]];
+				if (positionOf[a] == positionOf[b] || positionOf[b] == positionOf[c] || positionOf[a] == positionOf[c]) continue;
+				triangleGroups[kept / 3] = triangleGroups[i / 3];
+				indices[kept++] = a;
+				indices[kept++] = b;
+				indices[kept++] = c;
+			}
+			indices.resize(kept);
+			triangleGroups.resize(kept / 3);
+		}
+
+		error = static_cast<float>(std::sqrt(maxCost));
+		return indices;
+	}
+
+	// Limits per meshlet. These are the sizes recommended for mesh shaders, which keeps the meshlets
+	// small enough that the cone of a curved surface still culls.
+	constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+	constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+	// A run of triangles culled as a whole, laid out like struct Meshlet in cull.comp (std430)
+	struct Meshlet
+	{
+		glm::vec4	sphere			= glm::vec4(0.0f);	// object space centre, radius in w
+		glm::vec4	cone			= glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);	// average normal, sin of the cone's half angle in w, 1 never culls
+		uint32_t	firstIndex		= 0;
+		uint32_t	indexCount		= 0;
+		int32_t		vertexOffset	= 0;
+		uint32_t	material		= 0;	// first instance of its draw, set only for bindless textures
+	};
+
+	// Cuts each range into runs of consecutive triangles with at most MESHLET_MAX_VERTICES distinct
+	// vertices and MESHLET_MAX_TRIANGLES triangles, so meshlets are draws over the existing index
+	// buffer. After OptimizeVertexCache consecutive triangles are neighbours, so the runs are compact.
+	inline std::vector<Meshlet> BuildMeshlets(const uint32_t* indices, const Vertex* vertices, size_t vertexCount, const std::vector<IndexRange>& ranges)
+	{
+		std::vector<Meshlet> meshlets;
+		std::vector<uint32_t> seenIn(vertexCount, std::numeric_limits<uint32_t>::max());
+		std::vector<uint32_t> meshletVertices;
+		std::vector<glm::vec3> normals;
+		meshletVertices.reserve(MESHLET_MAX_VERTICES);
+		normals.reserve(MESHLET_MAX_TRIANGLES);
+
+		auto finish = [&](Meshlet& meshlet) {
+			glm::vec3 low(std::numeric_limits<float>::max()), high(std::numeric_limits<float>::lowest());
+			for (uint32_t vertex : meshletVertices)
+			{
+				low		= glm::min(low, vertices[vertex].position);
+				high	= glm::max(high, vertices[vertex].position);
+			}
+			glm::vec3 centre = (low + high) * 0.5f;
+			float radius = 0.0f;
+			for (uint32_t vertex : meshletVertices)
+				radius = std::max(radius, glm::length(vertices[vertex].position - centre));
+			meshlet.sphere = glm::vec4(centre, radius);
+
+			// The cone test in cull.comp culls when every triangle faces away from the camera, which
+			// only works if all normals are within 90 degrees of the axis; a margin keeps it stable
+			glm::vec3 axis(0.0f);
+			normals.clear();
+			for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3)
+			{
+				const glm::vec3& a = vertices[indices[i + 0]].position;
+				const glm::vec3& b = vertices[indices[i + 1]].position;
+				const glm::vec3& c = vertices[indices[i + 2]].position;
+				glm::vec3 normal = glm::cross(b - a, c - a);
+				float length = glm::length(normal);
+				if (length <= 0.0f) continue;
+				normals.push_back(normal / length);
+				axis += normals.back();
+			}
+			float axisLength = glm::length(axis);
+			if (axisLength <= 0.0f) return;
+			axis /= axisLength;
+			float minimumDot = 1.0f;
+			for (const glm::vec3& normal : normals)
+				minimumDot = std::min(minimumDot, glm::dot(normal, axis));
+			meshlet.cone = glm::vec4(axis, minimumDot <= 0.1f ? 1.0f : std::sqrt(1.0f - minimumDot * minimumDot));
+		};
+
+		for (const IndexRange& range : ranges)
+		{
+			Meshlet meshlet;
+			meshlet.firstIndex		= range.firstIndex;
+			meshlet.vertexOffset	= range.vertexOffset;
+			meshletVertices.clear();
+
+			for (uint32_t i = range.firstIndex; i + 2 < range.firstIndex + range.indexCount; i += 3)
+			{
+				uint32_t newVertices = 0;
+				for (uint32_t k = 0; k < 3; k++)
+					newVertices += seenIn[indices[i + k]] != meshlets.size();
+				if (meshletVertices.size() + newVertices > MESHLET_MAX_VERTICES || meshlet.indexCount / 3 == MESHLET_MAX_TRIANGLES)
+				{
+					finish(meshlet);
+					meshlets.push_back(meshlet);
+					meshlet.firstIndex	= i;
+					meshlet.indexCount	= 0;
+					meshlet.sphere		= glm::vec4(0.0f);
+					meshlet.cone		= glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+					meshletVertices.clear();
+				}
+
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					uint32_t vertex = indices[i + k];
+					if (seenIn[vertex] != meshlets.size())
+					{
+						seenIn[vertex] = static_cast<uint32_t>(meshlets.size());
+						meshletVertices.push_back(vertex);
+					}
+				}
+				meshlet.indexCount += 3;
+			}
+
+			if (meshlet.indexCount > 0)
+			{
+				finish(meshlet);
+				meshlets.push_back(meshlet);
+			}
+		}
+		return meshlets;
+	}
+}
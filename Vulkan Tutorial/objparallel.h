@@ -0,0 +1,480 @@
+// Parallel OBJ parser, see namespace objparallel. It calls tinyobj's internal parsers, so include it
+// after tol/tiny_obj_loader.h in the translation unit that defines TINYOBJLOADER_IMPLEMENTATION.
+#pragma once
+
+#if !defined(TINY_OBJ_LOADER_H_) || !defined(TINYOBJLOADER_IMPLEMENTATION)
+#error "objparallel.h needs tol/tiny_obj_loader.h included with TINYOBJLOADER_IMPLEMENTATION first"
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+Parallel OBJ loader producing the same attrib_t / shape_t / material_t as tinyobj::LoadObj.
+
+The file is split at line boundaries into one chunk per core. Each worker parses the v, vn, vt
+and f records of its chunk into local arrays, using tinyobj's own number parsing so values are
+bit identical. Negative (relative) face indices are kept relative to the chunk and fixed up once
+a prefix sum over the chunks gives each chunk's base vertex, normal and texcoord index. Records
+that change state (usemtl, mtllib, g, o, s) are recorded as events and replayed in file order
+while faces are assembled into shapes, so materials and shapes come out exactly as tinyobj does.
+Polygons with more than three corners are triangulated through tinyobj as well.
+
+Files using lines, points or tags fall back to tinyobj::LoadObj.
+*/
+namespace objparallel {
+	constexpr size_t MIN_CHUNK_BYTES = 1 << 20;
+
+	// Bits of Chunk::relative, set when an index is relative to the chunk rather than absolute
+	constexpr uint8_t RELATIVE_VERTEX	= 1;
+	constexpr uint8_t RELATIVE_TEXCOORD	= 2;
+	constexpr uint8_t RELATIVE_NORMAL	= 4;
+
+	struct Event
+	{
+		enum Type { UseMaterial, MaterialLibrary, Group, Object, Smoothing } type;
+		size_t			face;		// index of the first face of the chunk the event applies to
+		size_t			line;		// line within the chunk, for warnings
+		std::string		text;
+		unsigned int	smoothingId = 0;
+	};
+
+	struct Chunk
+	{
+		const char*						begin = nullptr;
+		const char*						end = nullptr;
+		std::vector<tinyobj::real_t>	vertices, normals, texcoords, colors;
+		std::vector<tinyobj::index_t>	corners;
+		std::vector<uint8_t>			relative;
+		std::vector<uint32_t>			faceSizes;
+		std::vector<Event>				events;
+		size_t							lines = 0;
+		size_t							errorLine = 0;
+		bool							failed = false, unsupported = false;
+		int								greatestVertex = -1, greatestNormal = -1, greatestTexcoord = -1;
+	};
+
+	template<typename Function>
+	void ParallelFor(size_t count, Function function)
+	{
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < count; i++)
+			workers.emplace_back(function, i);
+		if (count > 0) function(0);
+		for (auto& worker : workers) worker.join();
+	}
+
+	// One corner of an f record, same rules as tinyobj's parseTriple except that negative indices stay chunk relative
+	inline bool ParseCorner(const char** token, const Chunk& chunk, tinyobj::index_t& corner, uint8_t& relative)
+	{
+		corner.vertex_index = corner.normal_index = corner.texcoord_index = -1;
+		relative = 0;
+
+		auto parseIndex = [&](int& index, int count, uint8_t bit) {
+			// Same result as tinyobj's atoi, without leaving the line or going through strtol
+			const char* cursor = tinyobj::skipSpaceAndTab(*token);
+			bool negative = *cursor == '-';
+			if (*cursor == '-' || *cursor == '+') cursor++;
+			int value = 0;
+			for (; *cursor >= '0' && *cursor <= '9'; cursor++)
+				value = value * 10 + (*cursor - '0');
+			if (negative) value = -value;
+			if (value == 0) return false;
+
+			if (value > 0)
+				index = value - 1;
+			else
+			{
+				index = count + value;
+				relative |= bit;
+			}
+			while (**token != '/' && !IS_SPACE(**token) && !IS_NEW_LINE(**token)) (*token)++;
+			return true;
+		};
+
+		int vertexCount		= static_cast<int>(chunk.vertices.size() / 3);
+		int normalCount		= static_cast<int>(chunk.normals.size() / 3);
+		int texcoordCount	= static_cast<int>(chunk.texcoords.size() / 2);
+
+		if (!parseIndex(corner.vertex_index, vertexCount, RELATIVE_VERTEX)) return false;
+		if ((*token)[0] != '/') return true;
+		(*token)++;
+
+		// i//k
+		if ((*token)[0] == '/')
+		{
+			(*token)++;
+			return parseIndex(corner.normal_index, normalCount, RELATIVE_NORMAL);
+		}
+
+		// i/j/k or i/j
+		if (!parseIndex(corner.texcoord_index, texcoordCount, RELATIVE_TEXCOORD)) return false;
+		if ((*token)[0] != '/') return true;
+		(*token)++;
+		return parseIndex(corner.normal_index, normalCount, RELATIVE_NORMAL);
+	}
+
+	inline void ParseChunk(Chunk& chunk)
+	{
+		// Lines are parsed in place, tinyobj's token parsers stop at the newline. Only the last line of
+		// the file can lack one, it gets a NUL terminated copy instead.
+		std::string lastLine;
+		const char* bodyEnd = chunk.end;
+		while (bodyEnd > chunk.begin && bodyEnd[-1] != '\n') bodyEnd--;
+		if (bodyEnd < chunk.end) lastLine.assign(bodyEnd, chunk.end);
+
+		const char* cursor = chunk.begin;
+		const char* token = cursor;
+		const char* lineEnd = nullptr;
+
+		// The newline is searched from wherever parsing stopped, so most of each line is only scanned once
+		auto findLineEnd = [&]() {
+			if (!lineEnd) lineEnd = static_cast<const char*>(memchr(token, '\n', bodyEnd - token));
+			return lineEnd;
+		};
+		auto contentEnd = [&]() {
+			const char* end = findLineEnd();
+			return end[-1] == '\r' ? end - 1 : end;
+		};
+		auto nextLine = [&]() {
+			cursor = cursor < bodyEnd ? findLineEnd() + 1 : chunk.end;
+		};
+
+		for (; cursor < chunk.end; nextLine())
+		{
+			token	= cursor < bodyEnd ? cursor : lastLine.c_str();
+			lineEnd	= cursor < bodyEnd ? nullptr : token + lastLine.size();
+			chunk.lines++;
+
+			token += strspn(token, " \t");
+			if (IS_NEW_LINE(token[0]) || token[0] == '#') continue;
+
+			if (token[0] == 'v' && IS_SPACE(token[1]))
+			{
+				token += 2;
+				tinyobj::real_t x, y, z, r, g, b;
+				tinyobj::parseVertexWithColor(&x, &y, &z, &r, &g, &b, &token);
+				chunk.vertices.insert(chunk.vertices.end(), { x, y, z });
+				chunk.colors.insert(chunk.colors.end(), { r, g, b });
+			}
+			else if (token[0] == 'v' && token[1] == 'n' && IS_SPACE(token[2]))
+			{
+				token += 3;
+				tinyobj::real_t x, y, z;
+				tinyobj::parseReal3(&x, &y, &z, &token);
+				chunk.normals.insert(chunk.normals.end(), { x, y, z });
+			}
+			else if (token[0] == 'v' && token[1] == 't' && IS_SPACE(token[2]))
+			{
+				token += 3;
+				tinyobj::real_t x, y;
+				tinyobj::parseReal2(&x, &y, &token);
+				chunk.texcoords.insert(chunk.texcoords.end(), { x, y });
+			}
+			else if (token[0] == 'f' && IS_SPACE(token[1]))
+			{
+				token += 2;
+				token += strspn(token, " \t");
+
+				uint32_t faceSize = 0;
+				while (!IS_NEW_LINE(token[0]))
+				{
+					tinyobj::index_t corner;
+					uint8_t relative;
+					if (!ParseCorner(&token, chunk, corner, relative))
+					{
+						chunk.failed	= true;
+						chunk.errorLine	= chunk.lines;
+						return;
+					}
+					chunk.corners.push_back(corner);
+					chunk.relative.push_back(relative);
+					faceSize++;
+					while (IS_SPACE(token[0]) || token[0] == '\r') token++;
+				}
+				chunk.faceSizes.push_back(faceSize);
+			}
+			else if (strncmp(token, "usemtl", 6) == 0)
+			{
+				token += 6;
+				chunk.events.push_back({ Event::UseMaterial, chunk.faceSizes.size(), chunk.lines, tinyobj::parseString(&token) });
+			}
+			else if (strncmp(token, "mtllib", 6) == 0 && IS_SPACE(token[6]))
+			{
+				chunk.events.push_back({ Event::MaterialLibrary, chunk.faceSizes.size(), chunk.lines, std::string(token + 7, std::max(token + 7, contentEnd())) });
+			}
+			else if (token[0] == 'g' && IS_SPACE(token[1]))
+			{
+				// Several group names are joined with a space like tinyobj does
+				std::vector<std::string> names;
+				while (!IS_NEW_LINE(token[0]))
+				{
+					names.push_back(tinyobj::parseString(&token));
+					token += strspn(token, " \t\r");
+				}
+
+				std::string name;
+				for (size_t i = 1; i < names.size(); i++)
+					name += (i > 1 ? " " : "") + names[i];
+				Event event{ Event::Group, chunk.faceSizes.size(), chunk.lines, name };
+				event.smoothingId = names.size() < 2; // flags an empty group name for the warning
+				chunk.events.push_back(event);
+			}
+			else if (token[0] == 'o' && IS_SPACE(token[1]))
+			{
+				chunk.events.push_back({ Event::Object, chunk.faceSizes.size(), chunk.lines, std::string(token + 2, std::max(token + 2, contentEnd())) });
+			}
+			else if (token[0] == 's' && IS_SPACE(token[1]))
+			{
+				token += 2;
+				token += strspn(token, " \t");
+				if (IS_NEW_LINE(token[0])) continue;
+
+				Event event{ Event::Smoothing, chunk.faceSizes.size(), chunk.lines, std::string() };
+				if (contentEnd() - token >= 3 && token[0] == 'o' && token[1] == 'f' && token[2] == 'f')
+					event.smoothingId = 0;
+				else
+				{
+					int id = tinyobj::parseInt(&token);
+					event.smoothingId = id < 0 ? 0 : static_cast<unsigned int>(id);
+				}
+				chunk.events.push_back(event);
+			}
+			else if ((token[0] == 'l' || token[0] == 'p' || token[0] == 't') && IS_SPACE(token[1]))
+			{
+				chunk.unsupported = true;
+				return;
+			}
+		}
+	}
+
+	// Splits [data, data + size) into up to count chunks that start at the beginning of a line
+	inline std::vector<Chunk> SplitChunks(const char* data, size_t size, size_t count)
+	{
+		std::vector<Chunk> chunks(count);
+		const char* begin = data;
+		const char* end = data + size;
+		for (size_t i = 0; i < count; i++)
+		{
+			const char* chunkEnd = i + 1 == count ? end : std::max(begin, data + size / count * (i + 1));
+			if (chunkEnd < end)
+			{
+				const char* newline = static_cast<const char*>(memchr(chunkEnd, '\n', end - chunkEnd));
+				chunkEnd = newline ? newline + 1 : end;
+			}
+			chunks[i].begin	= begin;
+			chunks[i].end	= chunkEnd;
+			begin = chunkEnd;
+		}
+		return chunks;
+	}
+
+	// chunkCount 0 picks one chunk per core, but none smaller than MIN_CHUNK_BYTES
+	inline bool LoadObj(tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes, std::vector<tinyobj::material_t>* materials,
+		std::string* warn, std::string* err, const char* data, size_t size, tinyobj::MaterialReader* readMatFn, size_t chunkCount = 0)
+	{
+		size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+		if (chunkCount == 0) chunkCount = std::min(threads, size / MIN_CHUNK_BYTES + 1);
+		std::vector<Chunk> chunks = SplitChunks(data, size, chunkCount);
+
+		ParallelFor(chunks.size(), [&](size_t i) { ParseChunk(chunks[i]); });
+
+		size_t lineBase = 0;
+		for (const auto& chunk : chunks)
+		{
+			if (chunk.unsupported)
+			{
+				std::istringstream stream(std::string(data, size));
+				return tinyobj::LoadObj(attrib, shapes, materials, warn, err, &stream, readMatFn);
+			}
+			if (chunk.failed)
+			{
+				if (err)
+				{
+					std::stringstream ss;
+					ss << "Failed parse `f' line(e.g. zero value for face index. line " << lineBase + chunk.errorLine << ".)\n";
+					(*err) += ss.str();
+				}
+				return false;
+			}
+			lineBase += chunk.lines;
+		}
+
+		// Prefix sums give every chunk the offset of its data in the merged arrays
+		std::vector<size_t> vertexBase(chunks.size() + 1, 0), normalBase(chunks.size() + 1, 0), texcoordBase(chunks.size() + 1, 0);
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			vertexBase[i + 1]	= vertexBase[i] + chunks[i].vertices.size();
+			normalBase[i + 1]	= normalBase[i] + chunks[i].normals.size();
+			texcoordBase[i + 1]	= texcoordBase[i] + chunks[i].texcoords.size();
+		}
+
+		*attrib = tinyobj::attrib_t();
+		attrib->vertices.resize(vertexBase.back());
+		attrib->colors.resize(vertexBase.back());
+		attrib->normals.resize(normalBase.back());
+		attrib->texcoords.resize(texcoordBase.back());
+
+		ParallelFor(chunks.size(), [&](size_t i) {
+			Chunk& chunk = chunks[i];
+			std::copy(chunk.vertices.begin(), chunk.vertices.end(), attrib->vertices.begin() + vertexBase[i]);
+			std::copy(chunk.colors.begin(), chunk.colors.end(), attrib->colors.begin() + vertexBase[i]);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), attrib->normals.begin() + normalBase[i]);
+			std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), attrib->texcoords.begin() + texcoordBase[i]);
+
+			int vertexOffset	= static_cast<int>(vertexBase[i] / 3);
+			int normalOffset	= static_cast<int>(normalBase[i] / 3);
+			int texcoordOffset	= static_cast<int>(texcoordBase[i] / 2);
+			for (size_t c = 0; c < chunk.corners.size(); c++)
+			{
+				tinyobj::index_t& corner = chunk.corners[c];
+				if (chunk.relative[c] & RELATIVE_VERTEX)	corner.vertex_index		+= vertexOffset;
+				if (chunk.relative[c] & RELATIVE_NORMAL)	corner.normal_index		+= normalOffset;
+				if (chunk.relative[c] & RELATIVE_TEXCOORD)	corner.texcoord_index	+= texcoordOffset;
+				chunk.greatestVertex	= std::max(chunk.greatestVertex, corner.vertex_index);
+				chunk.greatestNormal	= std::max(chunk.greatestNormal, corner.normal_index);
+				chunk.greatestTexcoord	= std::max(chunk.greatestTexcoord, corner.texcoord_index);
+			}
+
+			std::vector<tinyobj::real_t>().swap(chunk.vertices);
+			std::vector<tinyobj::real_t>().swap(chunk.colors);
+			std::vector<tinyobj::real_t>().swap(chunk.normals);
+			std::vector<tinyobj::real_t>().swap(chunk.texcoords);
+		});
+
+		// Replay faces and state changes in file order, following tinyobj::LoadObj
+		shapes->clear();
+		tinyobj::shape_t shape;
+		std::string name;
+		std::map<std::string, int> materialMap;
+		std::vector<tinyobj::tag_t> noTags;
+		int material = -1;
+		unsigned int smoothingId = 0;
+		size_t pendingFaces = 0; // faces since the last flush, tinyobj's prim_group
+
+		auto flush = [&]() {
+			bool hadFaces = pendingFaces > 0;
+			if (hadFaces) shape.name = name;
+			pendingFaces = 0;
+			return hadFaces;
+		};
+
+		lineBase = 0;
+		for (const auto& chunk : chunks)
+		{
+			size_t face = 0, corner = 0;
+			auto emitFaces = [&](size_t endFace) {
+				for (; face < endFace; corner += chunk.faceSizes[face], face++)
+				{
+					uint32_t faceSize = chunk.faceSizes[face];
+					pendingFaces++;
+					if (faceSize < 3) continue;
+
+					if (faceSize == 3)
+					{
+						shape.mesh.indices.insert(shape.mesh.indices.end(), chunk.corners.begin() + corner, chunk.corners.begin() + corner + 3);
+						shape.mesh.num_face_vertices.push_back(3);
+						shape.mesh.material_ids.push_back(material);
+						shape.mesh.smoothing_group_ids.push_back(smoothingId);
+						continue;
+					}
+
+					tinyobj::PrimGroup polygon;
+					polygon.faceGroup.resize(1);
+					polygon.faceGroup[0].smoothing_group_id = smoothingId;
+					for (uint32_t k = 0; k < faceSize; k++)
+					{
+						const tinyobj::index_t& index = chunk.corners[corner + k];
+						polygon.faceGroup[0].vertex_indices.emplace_back(index.vertex_index, index.texcoord_index, index.normal_index);
+					}
+					tinyobj::exportGroupsToShape(&shape, polygon, noTags, material, name, true, attrib->vertices);
+				}
+			};
+
+			for (const auto& event : chunk.events)
+			{
+				emitFaces(event.face);
+				switch (event.type)
+				{
+				case Event::UseMaterial:
+				{
+					auto it = materialMap.find(event.text);
+					int newMaterial = it != materialMap.end() ? it->second : -1;
+					if (it == materialMap.end() && warn)
+						(*warn) += "material [ '" + event.text + "' ] not found in .mtl\n";
+					if (newMaterial != material)
+					{
+						flush();
+						material = newMaterial;
+					}
+					break;
+				}
+				case Event::MaterialLibrary:
+				{
+					if (!readMatFn) break;
+
+					std::vector<std::string> filenames;
+					tinyobj::SplitString(event.text, ' ', filenames);
+					bool found = false;
+					for (size_t s = 0; s < filenames.size() && !found; s++)
+					{
+						std::string warnMtl, errMtl;
+						found = (*readMatFn)(filenames[s].c_str(), materials, &materialMap, &warnMtl, &errMtl);
+						if (warn) (*warn) += warnMtl;
+						if (err) (*err) += errMtl;
+					}
+					if (!found && warn)
+					{
+						if (filenames.empty())
+							(*warn) += "Looks like empty filename for mtllib. Use default material (line " + std::to_string(lineBase + event.line) + ".)\n";
+						else
+							(*warn) += "Failed to load material file(s). Use default material.\n";
+					}
+					break;
+				}
+				case Event::Group:
+				case Event::Object:
+					flush();
+					if (!shape.mesh.indices.empty())
+						shapes->push_back(std::move(shape));
+					shape = tinyobj::shape_t();
+					name = event.text;
+					if (event.type == Event::Group && event.smoothingId && warn)
+						(*warn) += "Empty group name. line: " + std::to_string(lineBase + event.line) + "\n";
+					break;
+				case Event::Smoothing:
+					smoothingId = event.smoothingId;
+					break;
+				}
+			}
+			emitFaces(chunk.faceSizes.size());
+			lineBase += chunk.lines;
+		}
+
+		if (flush() || !shape.mesh.indices.empty())
+			shapes->push_back(std::move(shape));
+
+		int greatestVertex = -1, greatestNormal = -1, greatestTexcoord = -1;
+		for (const auto& chunk : chunks)
+		{
+			greatestVertex		= std::max(greatestVertex, chunk.greatestVertex);
+			greatestNormal		= std::max(greatestNormal, chunk.greatestNormal);
+			greatestTexcoord	= std::max(greatestTexcoord, chunk.greatestTexcoord);
+		}
+		if (warn)
+		{
+			if (greatestVertex >= static_cast<int>(attrib->vertices.size() / 3))
+				(*warn) += "Vertex indices out of bounds (line " + std::to_string(lineBase) + ".)\n\n";
+			if (greatestNormal >= static_cast<int>(attrib->normals.size() / 3))
+				(*warn) += "Vertex normal indices out of bounds (line " + std::to_string(lineBase) + ".)\n\n";
+			if (greatestTexcoord >= static_cast<int>(attrib->texcoords.size() / 2))
+				(*warn) += "Vertex texcoord indices out of bounds (line " + std::to_string(lineBase) + ".)\n\n";
+		}
+		return true;
+	}
+}
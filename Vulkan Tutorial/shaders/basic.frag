@@ -1,13 +1,44 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
-
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
 
 layout(location = 0) in vec3 v_FragNormal;
 layout(location = 1) in vec2 v_TexCoords;
 layout(location = 2) in vec3 v_FragPos;
 
-layout (binding = 1) uniform sampler2D texSampler;
-layout (binding = 4) uniform sampler2D specSampler;
+#ifdef BINDLESS
+// Compiled to frag_bindless.spv. Every texture is in one array and the draw's first instance is the
+// material, which picks two of them. RecordModelDraws issues a separate command per material batch,
+// so every draw of a command has the same material and the index needs no nonuniformEXT. Drawing
+// several materials in one multi draw would need it, and shaderSampledImageArrayNonUniformIndexing.
+layout (set = 1, binding = 0) uniform sampler2D textures[];
+
+// BindlessMaterial
+struct Material {
+    uvec2 textures;         // diffuse, specular
+    uvec2 feedbackSlots;
+    uvec2 mipLevels;        // of the full chains
+};
+
+layout (std430, set = 1, binding = 1) readonly buffer Materials {
+    Material materials[];
+};
+
+layout(location = 3) flat in uint v_Material;
+
+#define DIFFUSE_TEXTURE textures[materials[v_Material].textures.x]
+#define SPECULAR_TEXTURE textures[materials[v_Material].textures.y]
+#else
+// Textures of the material being drawn
+layout (set = 1, binding = 0) uniform sampler2D texSampler;
+layout (set = 1, binding = 1) uniform sampler2D specSampler;
+
+#define DIFFUSE_TEXTURE texSampler
+#define SPECULAR_TEXTURE specSampler
+#endif
+
 layout (binding = 2) uniform Light {
     vec3 position;
     vec3 color;
@@ -19,11 +50,61 @@ layout (binding = 3) uniform Camera {
 
 layout(location = 0) out vec4 outColor;
 
+#ifdef TEXTURE_FEEDBACK
+// Compiled into the _feedback variants for texture streaming. Streamed textures report the finest mip level
+// they were sampled at, counted from the full chain, from one pixel of every 8x8 block.
+const uint NO_FEEDBACK = 0xffffffffu;
+
+layout (set = 1, binding = 2) buffer Feedback {
+    uint requestedLevels[];
+} feedback;
+
+// MaterialPushConstants, after the vertex shader's MeshDecode. The bindless variant only reads feedbackPixel.
+layout (push_constant) uniform MaterialFeedback {
+    layout (offset = 48) uvec2 feedbackSlots;   // diffuse, specular
+    uvec2 residentLevels;                       // level of the full chain the bound image starts at
+    uvec2 feedbackPixel;
+} material;
+
+#ifdef BINDLESS
+uvec2 FeedbackSlots() {
+    return materials[v_Material].feedbackSlots;
+}
+
+uvec2 ResidentLevels() {
+    return materials[v_Material].mipLevels - uvec2(textureQueryLevels(DIFFUSE_TEXTURE), textureQueryLevels(SPECULAR_TEXTURE));
+}
+#else
+uvec2 FeedbackSlots() {
+    return material.feedbackSlots;
+}
+
+uvec2 ResidentLevels() {
+    return material.residentLevels;
+}
+#endif
+
+void ReportLevel(uint slot, float lod) {
+    if (slot != NO_FEEDBACK)
+        atomicMin(feedback.requestedLevels[slot], uint(clamp(lod, 0.0, 31.0)));
+}
+#endif
+
 void main() {
+#ifdef TEXTURE_FEEDBACK
+    // Derivatives are only defined in uniform control flow, so the LODs are queried before the test
+    vec2 lods = vec2(textureQueryLod(DIFFUSE_TEXTURE, v_TexCoords).y, textureQueryLod(SPECULAR_TEXTURE, v_TexCoords).y) + vec2(ResidentLevels());
+    if (all(equal(uvec2(gl_FragCoord.xy) & 7u, material.feedbackPixel))) {
+        uvec2 slots = FeedbackSlots();
+        ReportLevel(slots.x, lods.x);
+        ReportLevel(slots.y, lods.y);
+    }
+#endif
+
     // ambient lighting
     float ambientStrength = 0.05;
     vec3 ambient = ambientStrength * light.color;
-    vec3 objectColor = texture(texSampler, v_TexCoords).xyz;
+    vec3 objectColor = texture(DIFFUSE_TEXTURE, v_TexCoords).xyz;
 
     // diffuse lighting
     vec3 norm = normalize(v_FragNormal);
@@ -35,7 +116,7 @@ void main() {
     vec3 viewDir = normalize(camera.position - v_FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);  
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-    vec3 specular = vec3(texture(specSampler, v_TexCoords)) * spec * light.color ;  
+    vec3 specular = vec3(texture(SPECULAR_TEXTURE, v_TexCoords)) * spec * light.color ;  
 
     // combine
     vec3 result = (/*ambient + diffuse*/ + specular) * objectColor;
@@ -7,6 +7,16 @@ layout (binding = 0) uniform UniformBufferObject {
     mat4 position;
 } ubo;
 
+// Set by CreateGraphicsPipeline when a_Normal holds an octahedral encoded normal in xy
+layout (constant_id = 0) const bool OCTAHEDRAL_NORMALS = false;
+
+// Undoes the bounds relative quantization of QuantizedVertex, identity for the other layouts
+layout (push_constant) uniform MeshDecode {
+    vec4 positionOffset;
+    vec4 positionScale;
+    vec4 texCoordTransform;
+} mesh;
+
 layout (location = 0) in vec3 a_Pos;
 layout (location = 1) in vec3 a_Normal;
 layout (location = 2) in vec2 a_TexCoords;
@@ -14,10 +24,22 @@ layout (location = 2) in vec2 a_TexCoords;
 layout(location = 0) out vec3 v_FragNormal;
 layout(location = 1) out vec2 v_TexCoords;
 layout(location = 2) out vec3 v_FragPos;
+layout(location = 3) flat out uint v_Material;  // the draw's first instance, read by frag_bindless.spv
 
+vec3 OctDecode(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-normal.z, 0.0);
+    normal.x += normal.x >= 0.0 ? -t : t;
+    normal.y += normal.y >= 0.0 ? -t : t;
+    return normalize(normal);
+}
 
 void main() {
-    gl_Position  = ubo.position  * ubo.view * ubo.model * vec4(a_Pos, 1.0);
-    v_FragNormal = mat3(transpose(inverse(ubo.model)))  * a_Normal;
-    v_TexCoords  = a_TexCoords;
+    vec3 position = a_Pos * mesh.positionScale.xyz + mesh.positionOffset.xyz;
+    vec3 normal   = OCTAHEDRAL_NORMALS ? OctDecode(a_Normal.xy) : a_Normal;
+
+    gl_Position  = ubo.position  * ubo.view * ubo.model * vec4(position, 1.0);
+    v_FragNormal = mat3(transpose(inverse(ubo.model)))  * normal;
+    v_TexCoords  = a_TexCoords * mesh.texCoordTransform.zw + mesh.texCoordTransform.xy;
+    v_Material   = uint(gl_InstanceIndex);
 }
\ No newline at end of file
@@ -1,3 +1,10 @@
 C:/VulkanSDK/1.2.135.0/Bin32/glslc.exe basic.vert -o vert.spv
 C:/VulkanSDK/1.2.135.0/Bin32/glslc.exe basic.frag -o frag.spv
+C:/VulkanSDK/1.2.135.0/Bin32/glslc.exe -DTEXTURE_FEEDBACK basic.frag -o frag_feedback.spv
+C:/VulkanSDK/1.2.135.0/Bin32/glslc.exe -DBINDLESS basic.frag -o frag_bindless.spv
+C:/VulkanSDK/1.2.135.0/Bin32/glslc.exe -DBINDLESS -DTEXTURE_FEEDBACK basic.frag -o frag_bindless_feedback.spv
+C:/VulkanSDK/1.2.135.0/Bin32/glslc.exe hud.vert -o hud_vert.spv
+C:/VulkanSDK/1.2.135.0/Bin32/glslc.exe hud.frag -o hud_frag.spv
+C:/VulkanSDK/1.2.135.0/Bin32/glslc.exe cull.comp -o cull_comp.spv
+C:/VulkanSDK/1.2.135.0/Bin32/glslc.exe mipgen.comp -o mipgen_comp.spv
 pause
\ No newline at end of file
@@ -0,0 +1,575 @@
+// Mip filtering and block encoding for the texture baker, run with --bake-textures
+#pragma once
+
+#include "ktx2.h"
+#include "bcn.h"
+
+#include <vulkan/vulkan.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <vector>
+
+/*
+Offline texture baking, run with --bake-textures. Every source image becomes a KTX2 file with a full
+mip chain the runtime uploads as it is.
+
+Mips are filtered in linear light: the sRGB texels are converted to linear floats once, each level is
+filtered from the previous one without rounding in between, and only the output is converted back to
+sRGB. Alpha is filtered as it is. The filters wrap around the edges like the REPEAT samplers do, and
+taps are four floats wide so one SSE2 multiply-add filters a whole texel. Box is the exact area
+average, which also handles odd sizes; Kaiser is a Kaiser windowed sinc three destination texels wide
+that keeps distant mips sharper at the cost of slight ringing.
+
+The block encoders aim for reasonable quality at bake speed rather than the best possible: BC1 and the
+colour half of BC3 fit endpoints along the principal axis of the block and refine them once with least
+squares, BC7 uses only mode 6 (one subset, RGBA endpoints with p-bits, 4 bit indices).
+*/
+namespace texbake {
+	enum class MipFilter { Box, Kaiser, Count };
+	const char* const MIP_FILTER_NAMES[] = { "box", "kaiser" };
+
+	constexpr float KAISER_RADIUS = 3.0f;	// in destination texels
+	constexpr float KAISER_ALPHA = 4.0f;
+
+	// Output formats of the baker, by --bake-format name
+	struct BakeFormat
+	{
+		const char*	name;
+		VkFormat	format;
+	};
+
+	constexpr BakeFormat BAKE_FORMATS[] = {
+		{ "rgba8",	VK_FORMAT_R8G8B8A8_SRGB },
+		{ "bc1",	VK_FORMAT_BC1_RGB_SRGB_BLOCK },
+		{ "bc3",	VK_FORMAT_BC3_SRGB_BLOCK },
+		{ "bc7",	VK_FORMAT_BC7_SRGB_BLOCK },
+	};
+
+	// Runs function(i) for every i below count on all cores, each worker taking the next i when it is done
+	template<typename Function>
+	void ParallelFor(size_t count, Function function)
+	{
+		std::atomic<size_t> next{ 0 };
+		auto worker = [&]() {
+			for (size_t i = next++; i < count; i = next++) function(i);
+		};
+
+		size_t threads = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < threads; i++)
+			workers.emplace_back(worker);
+		worker();
+		for (auto& thread : workers) thread.join();
+	}
+
+	inline float SrgbToLinear(float value)
+	{
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	inline float LinearToSrgb(float value)
+	{
+		return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+	}
+
+	// Level of a mip chain as linear RGBA floats
+	struct MipImage
+	{
+		uint32_t			width	= 0;
+		uint32_t			height	= 0;
+		std::vector<float>	texels;
+	};
+
+	inline MipImage FromRgba8(const uint8_t* rgba, uint32_t width, uint32_t height)
+	{
+		static const std::array<float, 256> toLinear = []() {
+			std::array<float, 256> table{};
+			for (int i = 0; i < 256; i++) table[i] = SrgbToLinear(static_cast<float>(i) / 255.0f);
+			return table;
+		}();
+
+		MipImage image{ width, height, std::vector<float>(static_cast<size_t>(width) * height * 4) };
+		for (size_t i = 0; i < image.texels.size(); i++)
+			image.texels[i] = (i & 3) == 3 ? rgba[i] / 255.0f : toLinear[rgba[i]];
+		return image;
+	}
+
+	inline std::vector<uint8_t> ToRgba8(const MipImage& image)
+	{
+		std::vector<uint8_t> rgba(image.texels.size());
+		for (size_t i = 0; i < rgba.size(); i++)
+		{
+			float value = std::clamp(image.texels[i], 0.0f, 1.0f);
+			rgba[i] = static_cast<uint8_t>(((i & 3) == 3 ? value : LinearToSrgb(value)) * 255.0f + 0.5f);
+		}
+		return rgba;
+	}
+
+	struct Tap
+	{
+		uint32_t	index;
+		float		weight;
+	};
+
+	// Zeroth order modified Bessel function of the first kind, by its power series
+	inline double BesselI0(double x)
+	{
+		double sum = 1.0, term = 1.0;
+		for (int k = 1; k < 32; k++)
+		{
+			term *= (x / (2.0 * k)) * (x / (2.0 * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	// Taps of every destination texel when filtering sourceSize texels down to destinationSize, normalized to sum to one
+	inline std::vector<std::vector<Tap>> BuildTaps(uint32_t sourceSize, uint32_t destinationSize, MipFilter filter)
+	{
+		std::vector<std::vector<Tap>> taps(destinationSize);
+		double scale = static_cast<double>(sourceSize) / destinationSize;
+		double radius = filter == MipFilter::Box ? scale * 0.5 : KAISER_RADIUS * scale;
+
+		for (uint32_t d = 0; d < destinationSize; d++)
+		{
+			double center = (d + 0.5) * scale;
+			int64_t first = static_cast<int64_t>(std::floor(center - radius));
+			int64_t last = static_cast<int64_t>(std::ceil(center + radius));
+			double total = 0.0;
+			for (int64_t s = first; s < last; s++)
+			{
+				double weight;
+				if (filter == MipFilter::Box)
+				{
+					weight = std::min(static_cast<double>(s + 1), center + radius) - std::max(static_cast<double>(s), center - radius);
+				}
+				else
+				{
+					double x = (static_cast<double>(s) + 0.5 - center) / scale;
+					double t = x / KAISER_RADIUS;
+					if (std::abs(t) >= 1.0) continue;
+					double sinc = x == 0.0 ? 1.0 : std::sin(3.14159265358979323846 * x) / (3.14159265358979323846 * x);
+					weight = sinc * BesselI0(KAISER_ALPHA * std::sqrt(1.0 - t * t)) / BesselI0(KAISER_ALPHA);
+				}
+				if (weight == 0.0) continue;
+
+				int64_t wrapped = ((s % sourceSize) + sourceSize) % sourceSize;
+				taps[d].push_back({ static_cast<uint32_t>(wrapped), static_cast<float>(weight) });
+				total += weight;
+			}
+			for (Tap& tap : taps[d]) tap.weight = static_cast<float>(tap.weight / total);
+		}
+		return taps;
+	}
+
+	// Sum of weight times texel over the taps, the texel of index i is at source + i * stride
+	inline void FilterTexel(const float* source, size_t stride, const std::vector<Tap>& taps, float* out)
+	{
+#ifdef USE_SSE2
+		__m128 sum = _mm_setzero_ps();
+		for (const Tap& tap : taps)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(source + tap.index * stride), _mm_set1_ps(tap.weight)));
+		_mm_storeu_ps(out, sum);
+#else
+		float sum[4] = {};
+		for (const Tap& tap : taps)
+			for (int c = 0; c < 4; c++) sum[c] += source[tap.index * stride + c] * tap.weight;
+		memcpy(out, sum, sizeof(sum));
+#endif
+	}
+
+	// Next level of a mip chain, filtered horizontally and then vertically
+	inline MipImage Downsample(const MipImage& source, MipFilter filter)
+	{
+		MipImage horizontal{ std::max(source.width / 2, 1u), source.height, {} };
+		horizontal.texels.resize(static_cast<size_t>(horizontal.width) * horizontal.height * 4);
+		auto columnTaps = BuildTaps(source.width, horizontal.width, filter);
+		for (uint32_t y = 0; y < horizontal.height; y++)
+		{
+			const float* row = source.texels.data() + static_cast<size_t>(y) * source.width * 4;
+			for (uint32_t x = 0; x < horizontal.width; x++)
+				FilterTexel(row, 4, columnTaps[x], horizontal.texels.data() + (static_cast<size_t>(y) * horizontal.width + x) * 4);
+		}
+
+		MipImage result{ horizontal.width, std::max(source.height / 2, 1u), {} };
+		result.texels.resize(static_cast<size_t>(result.width) * result.height * 4);
+		auto rowTaps = BuildTaps(horizontal.height, result.height, filter);
+		for (uint32_t y = 0; y < result.height; y++)
+		{
+			for (uint32_t x = 0; x < result.width; x++)
+				FilterTexel(horizontal.texels.data() + x * 4, static_cast<size_t>(horizontal.width) * 4, rowTaps[y], result.texels.data() + (static_cast<size_t>(y) * result.width + x) * 4);
+		}
+		return result;
+	}
+
+	// Fits a line through the 16 texels of a block along their principal axis, from the lowest to the
+	// highest projection
+	template<int Dimensions>
+	void FitLine(const float points[16][Dimensions], float start[Dimensions], float end[Dimensions])
+	{
+		float mean[Dimensions] = {};
+		for (int i = 0; i < 16; i++)
+			for (int c = 0; c < Dimensions; c++) mean[c] += points[i][c] / 16.0f;
+
+		float covariance[Dimensions][Dimensions] = {};
+		for (int i = 0; i < 16; i++)
+			for (int a = 0; a < Dimensions; a++)
+				for (int b = 0; b < Dimensions; b++)
+					covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+
+		// Power iteration, starting from the channel that varies the most
+		float axis[Dimensions] = {};
+		int widest = 0;
+		for (int c = 1; c < Dimensions; c++)
+			if (covariance[c][c] > covariance[widest][widest]) widest = c;
+		axis[widest] = 1.0f;
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[Dimensions] = {};
+			float length = 0.0f;
+			for (int a = 0; a < Dimensions; a++)
+			{
+				for (int b = 0; b < Dimensions; b++) next[a] += covariance[a][b] * axis[b];
+				length += next[a] * next[a];
+			}
+			if (length <= 1e-12f) break;
+			for (int c = 0; c < Dimensions; c++) axis[c] = next[c] / std::sqrt(length);
+		}
+
+		float lowest = std::numeric_limits<float>::max(), highest = std::numeric_limits<float>::lowest();
+		for (int i = 0; i < 16; i++)
+		{
+			float projected = 0.0f;
+			for (int c = 0; c < Dimensions; c++) projected += (points[i][c] - mean[c]) * axis[c];
+			lowest = std::min(lowest, projected);
+			highest = std::max(highest, projected);
+		}
+		for (int c = 0; c < Dimensions; c++)
+		{
+			start[c]	= std::clamp(mean[c] + axis[c] * lowest, 0.0f, 255.0f);
+			end[c]		= std::clamp(mean[c] + axis[c] * highest, 0.0f, 255.0f);
+		}
+	}
+
+	// Least squares endpoints for points placed at fractions along the line from start to end.
+	// Leaves the endpoints alone if every point sits at the same fraction.
+	template<int Dimensions>
+	void RefineLine(const float points[16][Dimensions], const float fractions[16], float start[Dimensions], float end[Dimensions])
+	{
+		double aa = 0.0, ab = 0.0, bb = 0.0;
+		double ax[Dimensions] = {}, bx[Dimensions] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			double b = fractions[i], a = 1.0 - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < Dimensions; c++)
+			{
+				ax[c] += a * points[i][c];
+				bx[c] += b * points[i][c];
+			}
+		}
+		double determinant = aa * bb - ab * ab;
+		if (std::abs(determinant) < 1e-8) return;
+		for (int c = 0; c < Dimensions; c++)
+		{
+			start[c]	= static_cast<float>(std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0, 255.0));
+			end[c]		= static_cast<float>(std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0, 255.0));
+		}
+	}
+
+	inline uint16_t Pack565(const float rgb[3])
+	{
+		uint32_t r = static_cast<uint32_t>(std::lround(rgb[0] * 31.0f / 255.0f));
+		uint32_t g = static_cast<uint32_t>(std::lround(rgb[1] * 63.0f / 255.0f));
+		uint32_t b = static_cast<uint32_t>(std::lround(rgb[2] * 31.0f / 255.0f));
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	// Four colour BC1 block, which is also the colour half of BC3. Returns the squared error.
+	inline uint32_t EncodeColorBlock(const uint8_t rgba[64], uint8_t out[8])
+	{
+		float points[16][3];
+		for (int i = 0; i < 16; i++)
+			for (int c = 0; c < 3; c++) points[i][c] = rgba[i * 4 + c];
+
+		float start[3], end[3];
+		FitLine<3>(points, start, end);
+
+		uint32_t bestError = std::numeric_limits<uint32_t>::max();
+		for (int attempt = 0; attempt < 2; attempt++)
+		{
+			uint16_t endpoints[2] = { Pack565(end), Pack565(start) };
+			if (endpoints[0] < endpoints[1]) std::swap(endpoints[0], endpoints[1]);
+
+			uint8_t palette[4][4];
+			bcn::ColorPalette(endpoints[0], endpoints[1], false, palette);
+
+			// With equal endpoints the decoder is in three colour mode, where only index 0 is the same colour
+			bool single = endpoints[0] == endpoints[1];
+			uint32_t indices = 0, error = 0;
+			float fractions[16];
+			const float FRACTIONS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+			for (int i = 0; i < 16; i++)
+			{
+				uint32_t best = 0, bestDistance = std::numeric_limits<uint32_t>::max();
+				for (uint32_t candidate = 0; candidate < (single ? 1u : 4u); candidate++)
+				{
+					uint32_t distance = 0;
+					for (int c = 0; c < 3; c++)
+					{
+						int delta = static_cast<int>(rgba[i * 4 + c]) - palette[candidate][c];
+						distance += delta * delta;
+					}
+					if (distance < bestDistance)
+					{
+						bestDistance	= distance;
+						best			= candidate;
+					}
+				}
+				indices |= best << (i * 2);
+				error += bestDistance;
+				fractions[i] = FRACTIONS[best];
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				out[0] = static_cast<uint8_t>(endpoints[0]);
+				out[1] = static_cast<uint8_t>(endpoints[0] >> 8);
+				out[2] = static_cast<uint8_t>(endpoints[1]);
+				out[3] = static_cast<uint8_t>(endpoints[1] >> 8);
+				for (int b = 0; b < 4; b++) out[4 + b] = static_cast<uint8_t>(indices >> (b * 8));
+			}
+			if (attempt == 0)
+			{
+				// The fractions run from endpoint 0, which becomes end on the next attempt
+				for (int c = 0; c < 3; c++)
+				{
+					end[c]		= palette[0][c];
+					start[c]	= palette[1][c];
+				}
+				RefineLine<3>(points, fractions, end, start);
+			}
+		}
+		return bestError;
+	}
+
+	// Eight value BC4 style block, the alpha half of BC3
+	inline void EncodeChannelBlock(const uint8_t* values, size_t stride, uint8_t out[8])
+	{
+		uint8_t lowest = 255, highest = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			lowest = std::min(lowest, values[i * stride]);
+			highest = std::max(highest, values[i * stride]);
+		}
+		out[0] = highest;
+		out[1] = lowest;
+		memset(out + 2, 0, 6);
+		if (highest == lowest) return;
+
+		uint8_t palette[8];
+		bcn::ChannelPalette(highest, lowest, palette);
+
+		uint64_t indices = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			uint32_t best = 0, bestDistance = 256;
+			for (uint32_t candidate = 0; candidate < 8; candidate++)
+			{
+				uint32_t distance = static_cast<uint32_t>(std::abs(static_cast<int>(values[i * stride]) - palette[candidate]));
+				if (distance < bestDistance)
+				{
+					bestDistance	= distance;
+					best			= candidate;
+				}
+			}
+			indices |= static_cast<uint64_t>(best) << (i * 3);
+		}
+		for (int b = 0; b < 6; b++) out[2 + b] = static_cast<uint8_t>(indices >> (b * 8));
+	}
+
+	// Writes fields into a 128 bit block from the lowest bit up
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(uint8_t* block) : m_Block(block) { memset(block, 0, 16); }
+
+		void Write(uint32_t value, uint32_t count)
+		{
+			for (uint32_t i = 0; i < count; i++, m_Position++)
+				m_Block[m_Position >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (m_Position & 7));
+		}
+
+	private:
+		uint8_t*	m_Block;
+		uint32_t	m_Position = 0;
+	};
+
+	// BC7 mode 6 block, trying every pair of p-bits for the fitted endpoints
+	inline void EncodeBc7Block(const uint8_t rgba[64], uint8_t out[16])
+	{
+		float points[16][4];
+		for (int i = 0; i < 16; i++)
+			for (int c = 0; c < 4; c++) points[i][c] = rgba[i * 4 + c];
+
+		float line[2][4];
+		FitLine<4>(points, line[0], line[1]);
+
+		uint64_t bestError = std::numeric_limits<uint64_t>::max();
+		uint32_t bestEndpoints[2][4] = {}, bestPBits[2] = {}, bestIndices[16] = {};
+		float fractions[16] = {};
+		for (int attempt = 0; attempt < 2; attempt++)
+		{
+			for (uint32_t pBits = 0; pBits < 4; pBits++)
+			{
+				uint32_t endpoints[2][4], expanded[2][4], p[2] = { pBits & 1, pBits >> 1 };
+				for (int e = 0; e < 2; e++)
+				{
+					for (int c = 0; c < 4; c++)
+					{
+						endpoints[e][c] = static_cast<uint32_t>(std::clamp(std::lround((line[e][c] - static_cast<float>(p[e])) / 2.0f), 0l, 127l));
+						expanded[e][c] = (endpoints[e][c] << 1) | p[e];
+					}
+				}
+
+				// The weights are close to i / 15, so projecting a texel on the endpoint line and checking
+				// the weights next to the nearest one finds its best index
+				int palette[16][4];
+				float axis[4], axisLength = 0.0f;
+				for (int c = 0; c < 4; c++)
+				{
+					for (uint32_t candidate = 0; candidate < 16; candidate++)
+						palette[candidate][c] = bcn::Interpolate(expanded[0][c], expanded[1][c], bcn::WEIGHTS_4[candidate]);
+					axis[c] = static_cast<float>(expanded[1][c]) - static_cast<float>(expanded[0][c]);
+					axisLength += axis[c] * axis[c];
+				}
+
+				uint64_t error = 0;
+				uint32_t indices[16];
+				float candidateFractions[16];
+				for (int i = 0; i < 16; i++)
+				{
+					float projected = 0.0f;
+					for (int c = 0; c < 4; c++) projected += (rgba[i * 4 + c] - static_cast<float>(expanded[0][c])) * axis[c];
+					int nearest = axisLength > 0.0f ? std::clamp(static_cast<int>(std::lround(projected / axisLength * 15.0f)), 0, 15) : 0;
+
+					uint32_t best = 0, bestDistance = std::numeric_limits<uint32_t>::max();
+					for (int candidate = std::max(nearest - 1, 0); candidate <= std::min(nearest + 1, 15); candidate++)
+					{
+						uint32_t distance = 0;
+						for (int c = 0; c < 4; c++)
+						{
+							int delta = static_cast<int>(rgba[i * 4 + c]) - palette[candidate][c];
+							distance += delta * delta;
+						}
+						if (distance < bestDistance)
+						{
+							bestDistance	= distance;
+							best			= static_cast<uint32_t>(candidate);
+						}
+					}
+					indices[i] = best;
+					candidateFractions[i] = bcn::WEIGHTS_4[best] / 64.0f;
+					error += bestDistance;
+				}
+
+				if (error < bestError)
+				{
+					bestError = error;
+					memcpy(bestEndpoints, endpoints, sizeof(endpoints));
+					memcpy(bestPBits, p, sizeof(p));
+					memcpy(bestIndices, indices, sizeof(indices));
+					memcpy(fractions, candidateFractions, sizeof(fractions));
+				}
+			}
+			if (attempt == 0)
+				RefineLine<4>(points, fractions, line[0], line[1]);
+		}
+
+		// Texel 0 stores its index without the top bit, so it has to be in the lower half
+		if (bestIndices[0] >= 8)
+		{
+			std::swap(bestEndpoints[0], bestEndpoints[1]);
+			std::swap(bestPBits[0], bestPBits[1]);
+			for (uint32_t& index : bestIndices) index = 15 - index;
+		}
+
+		BitWriter bits(out);
+		bits.Write(1 << 6, 7);
+		for (int c = 0; c < 4; c++)
+		{
+			bits.Write(bestEndpoints[0][c], 7);
+			bits.Write(bestEndpoints[1][c], 7);
+		}
+		bits.Write(bestPBits[0], 1);
+		bits.Write(bestPBits[1], 1);
+		for (int i = 0; i < 16; i++)
+			bits.Write(bestIndices[i], i == 0 ? 3 : 4);
+	}
+
+	// Encodes block rows [firstRow, lastRow) of a level into blocks, which holds the whole level.
+	// Blocks hanging over the edge repeat the last row and column.
+	inline void EncodeBlockRows(VkFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t firstRow, uint32_t lastRow, uint8_t* blocks)
+	{
+		const ktx2::FormatInfo& info = *ktx2::FindFormat(format);
+		uint32_t blocksX = (width + 3) / 4;
+		uint8_t texels[64];
+		for (uint32_t by = firstRow; by < lastRow; by++)
+		{
+			for (uint32_t bx = 0; bx < blocksX; bx++)
+			{
+				for (uint32_t y = 0; y < 4; y++)
+				{
+					for (uint32_t x = 0; x < 4; x++)
+					{
+						uint32_t sourceX = std::min(bx * 4 + x, width - 1), sourceY = std::min(by * 4 + y, height - 1);
+						memcpy(texels + (y * 4 + x) * 4, rgba + (static_cast<size_t>(sourceY) * width + sourceX) * 4, 4);
+					}
+				}
+
+				uint8_t* block = blocks + (static_cast<size_t>(by) * blocksX + bx) * info.blockBytes;
+				switch (format)
+				{
+				case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+					EncodeColorBlock(texels, block);
+					break;
+				case VK_FORMAT_BC3_SRGB_BLOCK:
+					EncodeChannelBlock(texels + 3, 4, block);
+					EncodeColorBlock(texels, block + 8);
+					break;
+				default:
+					EncodeBc7Block(texels, block);
+					break;
+				}
+			}
+		}
+	}
+
+	// Peak signal to noise ratio of b against a over all four channels, in dB
+	inline double Psnr(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b)
+	{
+		double squared = 0.0;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			double delta = static_cast<double>(a[i]) - b[i];
+			squared += delta * delta;
+		}
+		if (squared == 0.0) return std::numeric_limits<double>::infinity();
+		return 10.0 * std::log10(255.0 * 255.0 * static_cast<double>(a.size()) / squared);
+	}
+}
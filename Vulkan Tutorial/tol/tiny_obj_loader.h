@@ -631,6 +631,10 @@ namespace tinyobj {
 #include <fstream>
 #include <sstream>
 
+#if (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L
+#include <charconv>
+#endif
+
 namespace tinyobj {
 
     MaterialReader::~MaterialReader() {}
@@ -768,10 +772,22 @@ namespace tinyobj {
         return false;  // never reach here.
     }
 
+    // Inline equivalents of strspn(s, " \t") and strcspn(s, " \t\r\n") for
+    // the number parsers, the libc versions are slow on tokens this short.
+    static inline const char* skipSpaceAndTab(const char* s) {
+        while (*s == ' ' || *s == '\t') s++;
+        return s;
+    }
+
+    static inline const char* findTokenEnd(const char* s) {
+        while (*s != '\0' && *s != ' ' && *s != '\t' && *s != '\r' && *s != '\n') s++;
+        return s;
+    }
+
     static inline std::string parseString(const char** token) {
         std::string s;
         (*token) += strspn((*token), " \t");
-        size_t e = strcspn((*token), " \t\r");
+        size_t e = strcspn((*token), " \t\r\n");
         s = std::string((*token), &(*token)[e]);
         (*token) += e;
         return s;
@@ -780,7 +796,7 @@ namespace tinyobj {
     static inline int parseInt(const char** token) {
         (*token) += strspn((*token), " \t");
         int i = atoi((*token));
-        (*token) += strcspn((*token), " \t\r");
+        (*token) += strcspn((*token), " \t\r\n");
         return i;
     }
 
@@ -811,7 +827,7 @@ namespace tinyobj {
     //  - s >= s_end.
     //  - parse failure.
     //
-    static bool tryParseDouble(const char* s, const char* s_end, double* result) {
+    static bool tryParseDoubleLoop(const char* s, const char* s_end, double* result) {
         if (s >= s_end) {
             return false;
         }
@@ -944,9 +960,41 @@ namespace tinyobj {
         return false;
     }
 
+    // tryParseDoubleLoop with a fast path for the numbers OBJ files are made of.
+    // Tests/ObjParallelTests.cpp checks both give the same floats.
+    static bool tryParseDouble(const char* s, const char* s_end, double* result) {
+        if (s >= s_end) {
+            return false;
+        }
+
+#if defined(__cpp_lib_to_chars)
+        // Fast path through std::from_chars for everything the loop's grammar
+        // accepts. It is correctly rounded, so once converted to float it is
+        // bit identical to the loop for ordinary OBJ numbers and only
+        // differs where the loop loses precision (many digits, large
+        // exponents). Input it treats differently (inf/nan, a lone '.',
+        // an exponent without digits, out of range) takes the slow path.
+        {
+            const char* begin = (*s == '+') ? s + 1 : s;
+            const char* digits = (begin == s && *s == '-') ? s + 1 : begin;
+            if (digits < s_end && (IS_DIGIT(*digits) || *digits == '.')) {
+                double value;
+                std::from_chars_result parsed = std::from_chars(begin, s_end, value);
+                if (parsed.ec == std::errc() &&
+                    (parsed.ptr == s_end || (*parsed.ptr != 'e' && *parsed.ptr != 'E'))) {
+                    *result = value;
+                    return true;
+                }
+            }
+        }
+#endif
+
+        return tryParseDoubleLoop(s, s_end, result);
+    }
+
     static inline real_t parseReal(const char** token, double default_value = 0.0) {
-        (*token) += strspn((*token), " \t");
-        const char* end = (*token) + strcspn((*token), " \t\r");
+        (*token) = skipSpaceAndTab(*token);
+        const char* end = findTokenEnd(*token);
         double val = default_value;
         tryParseDouble((*token), end, &val);
         real_t f = static_cast<real_t>(val);
@@ -955,8 +1003,8 @@ namespace tinyobj {
     }
 
     static inline bool parseReal(const char** token, real_t* out) {
-        (*token) += strspn((*token), " \t");
-        const char* end = (*token) + strcspn((*token), " \t\r");
+        (*token) = skipSpaceAndTab(*token);
+        const char* end = findTokenEnd(*token);
         double val;
         bool ret = tryParseDouble((*token), end, &val);
         if (ret) {
@@ -1017,7 +1065,7 @@ namespace tinyobj {
 
     static inline bool parseOnOff(const char** token, bool default_value = true) {
         (*token) += strspn((*token), " \t");
-        const char* end = (*token) + strcspn((*token), " \t\r");
+        const char* end = (*token) + strcspn((*token), " \t\r\n");
 
         bool ret = default_value;
         if ((0 == strncmp((*token), "on", 2))) {
@@ -1034,7 +1082,7 @@ namespace tinyobj {
     static inline texture_type_t parseTextureType(
         const char** token, texture_type_t default_value = TEXTURE_TYPE_NONE) {
         (*token) += strspn((*token), " \t");
-        const char* end = (*token) + strcspn((*token), " \t\r");
+        const char* end = (*token) + strcspn((*token), " \t\r\n");
         texture_type_t ty = default_value;
 
         if ((0 == strncmp((*token), "cube_top", strlen("cube_top")))) {
@@ -1068,7 +1116,7 @@ namespace tinyobj {
 
         (*token) += strspn((*token), " \t");
         ts.num_ints = atoi((*token));
-        (*token) += strcspn((*token), "/ \t\r");
+        (*token) += strcspn((*token), "/ \t\r\n");
         if ((*token)[0] != '/') {
             return ts;
         }
@@ -1077,7 +1125,7 @@ namespace tinyobj {
 
         (*token) += strspn((*token), " \t");
         ts.num_reals = atoi((*token));
-        (*token) += strcspn((*token), "/ \t\r");
+        (*token) += strcspn((*token), "/ \t\r\n");
         if ((*token)[0] != '/') {
             return ts;
         }
@@ -1101,7 +1149,7 @@ namespace tinyobj {
             return false;
         }
 
-        (*token) += strcspn((*token), "/ \t\r");
+        (*token) += strcspn((*token), "/ \t\r\n");
         if ((*token)[0] != '/') {
             (*ret) = vi;
             return true;
@@ -1114,7 +1162,7 @@ namespace tinyobj {
             if (!fixIndex(atoi((*token)), vnsize, &(vi.vn_idx))) {
                 return false;
             }
-            (*token) += strcspn((*token), "/ \t\r");
+            (*token) += strcspn((*token), "/ \t\r\n");
             (*ret) = vi;
             return true;
         }
@@ -1124,7 +1172,7 @@ namespace tinyobj {
             return false;
         }
 
-        (*token) += strcspn((*token), "/ \t\r");
+        (*token) += strcspn((*token), "/ \t\r\n");
         if ((*token)[0] != '/') {
             (*ret) = vi;
             return true;
@@ -1135,7 +1183,7 @@ namespace tinyobj {
         if (!fixIndex(atoi((*token)), vnsize, &(vi.vn_idx))) {
             return false;
         }
-        (*token) += strcspn((*token), "/ \t\r");
+        (*token) += strcspn((*token), "/ \t\r\n");
 
         (*ret) = vi;
 
@@ -1147,7 +1195,7 @@ namespace tinyobj {
         vertex_index_t vi(static_cast<int>(0));  // 0 is an invalid index in OBJ
 
         vi.v_idx = atoi((*token));
-        (*token) += strcspn((*token), "/ \t\r");
+        (*token) += strcspn((*token), "/ \t\r\n");
         if ((*token)[0] != '/') {
             return vi;
         }
@@ -1157,13 +1205,13 @@ namespace tinyobj {
         if ((*token)[0] == '/') {
             (*token)++;
             vi.vn_idx = atoi((*token));
-            (*token) += strcspn((*token), "/ \t\r");
+            (*token) += strcspn((*token), "/ \t\r\n");
             return vi;
         }
 
         // i/j/k or i/j
         vi.vt_idx = atoi((*token));
-        (*token) += strcspn((*token), "/ \t\r");
+        (*token) += strcspn((*token), "/ \t\r\n");
         if ((*token)[0] != '/') {
             return vi;
         }
@@ -1171,7 +1219,7 @@ namespace tinyobj {
         // i/j/k
         (*token)++;  // skip '/'
         vi.vn_idx = atoi((*token));
-        (*token) += strcspn((*token), "/ \t\r");
+        (*token) += strcspn((*token), "/ \t\r\n");
         return vi;
     }
 
@@ -1232,7 +1280,7 @@ namespace tinyobj {
             else if ((0 == strncmp(token, "-imfchan", 8)) && IS_SPACE((token[8]))) {
                 token += 9;
                 token += strspn(token, " \t");
-                const char* end = token + strcspn(token, " \t\r");
+                const char* end = token + strcspn(token, " \t\r\n");
                 if ((end - token) == 1) {  // Assume one char for -imfchan
                     texopt->imfchan = (*token);
                 }
@@ -1250,7 +1298,7 @@ namespace tinyobj {
             else {
                 // Assume texture filename
 #if 0
-                size_t len = strcspn(token, " \t\r");  // untile next space
+                size_t len = strcspn(token, " \t\r\n");  // untile next space
                 texture_name = std::string(token, token + len);
                 token += len;
 
@@ -2978,13 +3026,13 @@ namespace tinyobj {
 
                 for (size_t i = 0; i < static_cast<size_t>(ts.num_ints); ++i) {
                     tag.intValues[i] = atoi(token);
-                    token += strcspn(token, "/ \t\r") + 1;
+                    token += strcspn(token, "/ \t\r\n") + 1;
                 }
 
                 tag.floatValues.resize(static_cast<size_t>(ts.num_reals));
                 for (size_t i = 0; i < static_cast<size_t>(ts.num_reals); ++i) {
                     tag.floatValues[i] = parseReal(&token);
-                    token += strcspn(token, "/ \t\r") + 1;
+                    token += strcspn(token, "/ \t\r\n") + 1;
                 }
 
                 tag.stringValues.resize(static_cast<size_t>(ts.num_strings));